@@ -21,6 +21,33 @@ class GBufferFilm;
 class GBufferMitsubaFilm;
 class PixelSensor;
 
+// VisibleSurfaceFields Definition
+// The _VisibleSurface_ attributes that a film uses; others aren't computed.
+enum class VisibleSurfaceFields : uint32_t {
+    None = 0,
+    // Positions, normals, depth derivatives and texture coordinates
+    Geometry = 1 << 0,
+    Albedo = 1 << 1,
+    DiffuseAlbedo = 1 << 2,
+    Roughness = 1 << 3,
+    All = Geometry | Albedo | DiffuseAlbedo | Roughness
+};
+
+PBRT_CPU_GPU
+constexpr VisibleSurfaceFields operator|(VisibleSurfaceFields a, VisibleSurfaceFields b) {
+    return VisibleSurfaceFields(uint32_t(a) | uint32_t(b));
+}
+
+PBRT_CPU_GPU
+constexpr uint32_t operator&(VisibleSurfaceFields a, VisibleSurfaceFields b) {
+    return uint32_t(a) & uint32_t(b);
+}
+
+PBRT_CPU_GPU
+inline VisibleSurfaceFields &operator|=(VisibleSurfaceFields &a, VisibleSurfaceFields b) {
+    return a = a | b;
+}
+
 // FilmHandle Definition
 class FilmHandle : public TaggedPointer<RGBFilm, GBufferFilm, GBufferMitsubaFilm> {
   public:
@@ -34,6 +61,8 @@ class FilmHandle : public TaggedPointer<RGBFilm, GBufferFilm, GBufferMitsubaFilm
 
     PBRT_CPU_GPU
     bool UsesVisibleSurface() const;
+    PBRT_CPU_GPU
+    VisibleSurfaceFields UsedVisibleSurfaceFields() const;
 
     PBRT_CPU_GPU
     void AddSplat(const Point2f &p, SampledSpectrum v, const SampledWavelengths &lambda);
@@ -48,6 +77,10 @@ class FilmHandle : public TaggedPointer<RGBFilm, GBufferFilm, GBufferMitsubaFilm
                                         const SampledWavelengths &lambda) const;
 
     Image GetImage(ImageMetadata *metadata, Float splatScale = 1);
+    // Adds any splats and partial sample sums that are buffered per thread
+    // to the film's pixels; it must not be called while samples or splats
+    // are being added.
+    void FlushSplats();
     PBRT_CPU_GPU
     RGB GetPixelRGB(const Point2i &p, Float splatScale = 1) const;
 
@@ -21,6 +21,8 @@
 #include <pbrt/util/sampling.h>
 #include <pbrt/util/stats.h>
 
+#include <map>
+#include <mutex>
 #include <unordered_map>
 
 namespace pbrt {
@@ -1015,7 +1017,9 @@ MeasuredBRDF *MeasuredBRDF::Create(const std::string &filename, Allocator alloc)
 
 MeasuredBRDF *MeasuredBxDF::BRDFDataFromFile(const std::string &filename,
                                              Allocator alloc) {
+    static std::mutex mutex;
     static std::map<std::string, MeasuredBRDF *> loadedData;
+    std::lock_guard<std::mutex> lock(mutex);
     if (loadedData.find(filename) == loadedData.end())
         loadedData[filename] = MeasuredBRDF::Create(filename, alloc);
     return loadedData[filename];
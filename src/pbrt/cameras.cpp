@@ -79,6 +79,15 @@ CameraTransform::CameraTransform(const AnimatedTransform &worldFromCamera, const
                                          worldFromCamera.endTime);
 }
 
+CameraTransform::CameraTransform(const AnimatedTransform &worldFromCamera,
+                                 const Transform &worldFromRender)
+    : worldFromRender(worldFromRender) {
+    Transform renderFromWorld = Inverse(worldFromRender);
+    Transform rfc[2] = {renderFromWorld * worldFromCamera.startTransform,
+                        renderFromWorld * worldFromCamera.endTransform};
+    renderFromCamera = AnimatedTransform(rfc[0], worldFromCamera.startTime, rfc[1],
+                                         worldFromCamera.endTime);
+}
 
 std::string CameraTransform::ToString() const {
     return StringPrintf("[ CameraTransform renderFromCamera: %s worldFromRender: %s ]",
@@ -31,6 +31,11 @@ class CameraTransform {
 
     CameraTransform(const AnimatedTransform &worldFromCamera, const std::string& space);
 
+    // Uses the given _worldFromRender_ so that a new viewpoint can be
+    // rendered with scene data already transformed to render space.
+    CameraTransform(const AnimatedTransform &worldFromCamera,
+                    const Transform &worldFromRender);
+
 
     PBRT_CPU_GPU
     Point3f RenderFromCamera(const Point3f &p, Float time) const {
@@ -48,6 +53,8 @@ class CameraTransform {
     PBRT_CPU_GPU
     Transform RenderFromWorld() const { return Inverse(worldFromRender); }
     PBRT_CPU_GPU
+    const Transform &WorldFromRender() const { return worldFromRender; }
+    PBRT_CPU_GPU
     Transform CameraFromRender(Float time) const {
         return Inverse(renderFromCamera.Interpolate(time));
     }
@@ -14,10 +14,12 @@
 #include <pbrt/util/image.h>
 #include <pbrt/util/log.h>
 #include <pbrt/util/math.h>
+#include <pbrt/util/mipmap.h>
 #include <pbrt/util/parallel.h>
 #include <pbrt/util/print.h>
 #include <pbrt/util/rng.h>
 #include <pbrt/util/sampling.h>
+#include <pbrt/util/simd.h>
 #include <pbrt/util/spectrum.h>
 #include <pbrt/util/string.h>
 #include <pbrt/util/vecmath.h>
@@ -157,6 +159,15 @@ static std::map<std::string, CommandUsage> commandUsage = {
     {"makeemitters", {"makeemitters [options] <filename>", std::string(R"(
     --downsample <n>   Downsample the image by a factor of n in both dimensions
                        (using simple box filtering). Default: 1.
+)")}},
+    {"makemip", {"makemip [options] <filename>", std::string(R"(
+    --encoding <name>  Color encoding of 8-bit images ("linear", "sRGB", or
+                       "gamma <value>"). Default: "sRGB" for PNG images,
+                       "linear" otherwise.
+    --outfile <name>   Filename of tiled MIP file.
+    --wrapmode <mode>  Wrap mode used when filtering the MIP levels ("clamp",
+                       "repeat", "black", or "octahedralsphere"). Should match
+                       the texture's "wrap" parameter. Default: repeat
 )")}},
     {"makesky", {"makesky [options] <filename>", std::string(R"(
     --albedo <a>       Albedo of ground-plane (range 0-1). Default: 0.5
@@ -1806,6 +1817,42 @@ int makeemitters(int argc, char *argv[]) {
     return 0;
 }
 
+int makemip(int argc, char *argv[]) {
+    std::string inFilename, outFilename;
+    std::string encoding, wrap = "repeat";
+
+    auto onError = [](const std::string &err) {
+        usage("makemip", "%s", err.c_str());
+        exit(1);
+    };
+    while (*argv != nullptr) {
+        if (ParseArg(&argv, "encoding", &encoding, onError) ||
+            ParseArg(&argv, "outfile", &outFilename, onError) ||
+            ParseArg(&argv, "wrapmode", &wrap, onError)) {
+            // success
+        } else if (argv[0][0] == '-')
+            usage("makemip", "%s: unknown command flag", *argv);
+        else if (inFilename.empty()) {
+            inFilename = *argv;
+            ++argv;
+        } else
+            usage("makemip", "multiple input filenames provided.");
+    }
+
+    if (inFilename.empty())
+        usage("makemip", "missing image filename");
+    if (outFilename.empty())
+        usage("makemip", "--outfile must be specified");
+    pstd::optional<WrapMode> wrapMode = ParseWrapMode(wrap.c_str());
+    if (!wrapMode)
+        usage("makemip", "%s: wrap mode unknown", wrap.c_str());
+    if (encoding.empty())
+        encoding = HasExtension(inFilename, "png") ? "sRGB" : "linear";
+
+    MIPMap::WriteTiledFile(inFilename, outFilename, *wrapMode, encoding);
+    return 0;
+}
+
 int makeequiarea(int argc, char *argv[]) {
     std::string inFilename, outFilename;
     int resolution = 0;
@@ -1906,161 +1953,200 @@ Image denoiseImage(const Image &in, const ImageChannelDesc &Ldesc,
                    const Image &varianceImage, const ImageChannelDesc &albedoDesc,
                    const ImageChannelDesc &zDesc, const ImageChannelDesc &deltaZDesc,
                    const ImageChannelDesc &nDesc, int halfWidth, int nLevels) {
-    Image illum(PixelFormat::Float, in.Resolution(), {"R", "G", "B"});
-    for (int y = 0; y < in.Resolution().y; ++y)
-        for (int x = 0; x < in.Resolution().x; ++x) {
-            ImageChannelValues albedo = in.GetChannels({x, y}, albedoDesc);
-            ImageChannelValues L = in.GetChannels({x, y}, Ldesc);
-            for (int c = 0; c < 3; ++c)
-                if (albedo[c] > 0)
-                    illum.SetChannel({x, y}, c, L[c] / albedo[c]);
-                else
-                    illum.SetChannel({x, y}, c, L[c]);
-        }
+    // Copy the channels the filter uses into planar float buffers
+    Point2i res = in.Resolution();
+    size_t nPixels = size_t(res.x) * size_t(res.y);
+    auto getPlane = [&](const Image &image, int channel, float scale) {
+        std::vector<float> plane(nPixels);
+        ParallelFor(0, res.y, [&](int64_t start, int64_t end) {
+            for (int y = start; y < end; ++y)
+                for (int x = 0; x < res.x; ++x)
+                    plane[size_t(y) * res.x + x] =
+                        scale * image.GetChannel({x, y}, channel);
+        });
+        return plane;
+    };
+    std::vector<float> z = getPlane(in, zDesc.offset[0], 1);
+    // FIXME: hack multiply to cancel out scaled ray differentials...
+    std::vector<float> dzdx = getPlane(in, deltaZDesc.offset[0], 8);
+    std::vector<float> dzdy = getPlane(in, deltaZDesc.offset[1], 8);
+    std::vector<float> nx = getPlane(in, nDesc.offset[0], 1);
+    std::vector<float> ny = getPlane(in, nDesc.offset[1], 1);
+    std::vector<float> nz = getPlane(in, nDesc.offset[2], 1);
+    std::vector<float> variance = getPlane(varianceImage, 0, 1);
+    std::array<std::vector<float>, 3> albedo, illum, filtered;
+    for (int c = 0; c < 3; ++c) {
+        albedo[c] = getPlane(in, albedoDesc.offset[c], 1);
+        illum[c] = getPlane(in, Ldesc.offset[c], 1);
+        filtered[c].resize(nPixels);
+    }
 
-    std::vector<Float> f(halfWidth + 1, 0.);
+    // Divide out the albedo so that texture detail isn't blurred
+    ParallelFor(0, nPixels, [&](int64_t start, int64_t end) {
+        for (int c = 0; c < 3; ++c)
+            for (int64_t i = start; i < end; ++i)
+                if (albedo[c][i] > 0)
+                    illum[c][i] /= albedo[c][i];
+    });
+
+    std::vector<float> f(halfWidth + 1, 0.);
     for (int i = 0; i <= halfWidth; ++i)
         f[i] = FastExp(-Float(i) / halfWidth * 3.f);
 
-    static int call = -1;
-    ++call;
-
-    Image currentImage = std::move(illum);
-    for (int i = 0; i < nLevels; ++i) {
-        int delta = 1 << i;  // A-Trous step between samples.
-
-        Image filtered(PixelFormat::Float, in.Resolution(), {"R", "G", "B"});
-        // Image wImage(PixelFormat::Float, in.Resolution(), 3, "Wp,Wn,Wc");
-        // Image dzImage(PixelFormat::Float, in.Resolution(), 1, "Y");
-
-        ParallelFor(0, currentImage.Resolution().y, [&](int64_t start, int64_t end) {
-            for (int y = start; y < end; ++y) {
-                for (int x = 0; x < currentImage.Resolution().x; ++x) {
-                    float wsum = 0;
-                    ImageChannelValues c = currentImage.GetChannels({x, y});
-
-                    Float z = in.GetChannels({x, y}, zDesc);
-                    // FIXME: hack multiply to cancel out scaled ray
-                    // differentials...
-                    Float dzdx = 8 * in.GetChannels({x, y}, deltaZDesc)[0];
-                    Float dzdy = 8 * in.GetChannels({x, y}, deltaZDesc)[1];
-
-                    ImageChannelValues nChan = in.GetChannels({x, y}, nDesc);
-                    Normal3f n = Normal3f(nChan[0], nChan[1], nChan[2]);
-                    if (n == Normal3f(0, 0, 0))
-                        // background pixel
-                        continue;
+    // The depth Gaussian and the color weight are evaluated with a single
+    // exponential: _wp * wc_ is _depthNorm * exp(-dz^2 / (2 sigma_z^2) - d2 / 90)_.
+    // Higher sigma -> more blur
+    const float sigma_z = .005f;
+    const float depthNorm = 1 / std::sqrt(2 * Pi * sigma_z * sigma_z);
+    const float depthScale = 1 / (2 * sigma_z * sigma_z), colorScale = 1.f / 90;
+
+    for (int level = 0; level < nLevels; ++level) {
+        int delta = 1 << level;  // A-Trous step between samples.
+        int radius = halfWidth * delta;
+
+        // Filters a single pixel; used at the image edges, where some of
+        // the taps fall outside the image.
+        auto filterPixel = [&](int x, int y) {
+            size_t i = size_t(y) * res.x + x;
+            if (nx[i] == 0 && ny[i] == 0 && nz[i] == 0) {
+                // background pixel
+                for (int c = 0; c < 3; ++c)
+                    filtered[c][i] = 0;
+                return;
+            }
 
-                    Float pixelVariance = varianceImage.GetChannel({x, y}, 0);
-                    float result[3] = {0.f};
-                    float wpSum = 0, wnSum = 0, wcSum = 0;
-                    // if (pixelVariance > .001) {
-                    // pixelVariance = std::max<Float>(pixelVariance,
-                    // .000001); {
-                    {
-                        // Higher sigma -> more blur
-                        // Float sigma_y = .05;
-                        Float sigma_z = .005;
-
-                        // sigma_y = pixelVariance * 50;
-                        // sigma_y = std::sqrt(std::sqrt(pixelVariance)) *
-                        // 10 * sigmaYScale;
-
-                        for (int dy = -halfWidth * delta; dy <= halfWidth * delta;
-                             dy += delta) {
-                            if (y + dy < 0 || y + dy >= currentImage.Resolution().y)
-                                continue;
-                            for (int dx = -halfWidth * delta; dx <= halfWidth * delta;
-                                 dx += delta) {
-                                if (x + dx < 0 || x + dx >= currentImage.Resolution().x)
-                                    continue;
-                                ImageChannelValues co =
-                                    currentImage.GetChannels({x + dx, y + dy});
-                                Float dc2 = (Sqr(c[0] - co[0]) + Sqr(c[1] - co[1]) +
-                                             Sqr(c[2] - co[2]));  // squared color
-                                                                  // difference
-                                Float otherVariance =
-                                    varianceImage.GetChannel({x + dx, y + dy}, 0);
-                                Float d2 =
-                                    std::max<Float>(0, dc2 - (pixelVariance +
-                                                              std::min(pixelVariance,
-                                                                       otherVariance))) /
-                                    (1e-4 + 0.36f * (pixelVariance + otherVariance));
-
-                                Float zo = in.GetChannels({x + dx, y + dy}, zDesc);
-                                ImageChannelValues noChan =
-                                    in.GetChannels({x + dx, y + dy}, nDesc);
-                                Normal3f no = Normal3f(noChan[0], noChan[1], noChan[2]);
-                                if (no == Normal3f(0, 0, 0))
-                                    // background pixel;
-                                    continue;
-
-                                Float zp = z + dx * dzdx + dy * dzdy;
-                                Float dz = (z - zp) / ((z + zp) * 0.5f);
-
-                                // Assume camera space position...
-                                Float wp = Gaussian(dz, 0, sigma_z) *
-                                           f[std::abs(dy / delta)] *
-                                           f[std::abs(dx / delta)];
-                                Float wn = Pow<32>(std::max<float>(0, Dot(n, no)));
-                                Float wc =
-                                    FastExp(-d2 / 90);  // Gaussian(dc, 0, sigma_y);
-                                CHECK(!std::isnan(wc));
-                                wpSum += wp;
-                                wnSum += wn;
-                                wcSum += wc;
-                                Float w = wp * wn * wc;
-
-                                // CO fprintf(stderr, "(%d, %d) dc2 %f var
-                                // %f other var %f -> d2 %f\n", CO x, y,
-                                // dc2, pixelVariance, otherVariance, d2);
-
-                                CHECK(!std::isnan(w));
-                                if (w == 0)
-                                    continue;
-
-                                for (int c = 0; c < 3; ++c) {
-                                    result[c] +=
-                                        w * currentImage.GetChannel({x + dx, y + dy}, c);
-                                    CHECK(!std::isnan(result[c]));
-                                }
-                                wsum += w;
-                            }
-                        }
-                    }
+            float result[3] = {0.f}, wsum = 0;
+            for (int dy = -radius; dy <= radius; dy += delta) {
+                if (y + dy < 0 || y + dy >= res.y)
+                    continue;
+                for (int dx = -radius; dx <= radius; dx += delta) {
+                    if (x + dx < 0 || x + dx >= res.x)
+                        continue;
+                    size_t o = size_t(y + dy) * res.x + (x + dx);
+                    float dc2 = Sqr(illum[0][i] - illum[0][o]) +
+                                Sqr(illum[1][i] - illum[1][o]) +
+                                Sqr(illum[2][i] - illum[2][o]);  // squared color
+                                                                 // difference
+                    float pv = variance[i], ov = variance[o];
+                    float d2 = std::max(0.f, dc2 - (pv + std::min(pv, ov))) /
+                               (1e-4f + 0.36f * (pv + ov));
+
+                    // Assume camera space position...
+                    float dzPredicted = dx * dzdx[i] + dy * dzdy[i];
+                    float dz = dzPredicted / (z[i] + 0.5f * dzPredicted);
+                    float wn = Pow<32>(
+                        std::max(0.f, nx[i] * nx[o] + ny[i] * ny[o] + nz[i] * nz[o]));
+                    float w = depthNorm * f[std::abs(dy) / delta] *
+                              f[std::abs(dx) / delta] * wn *
+                              FastExp(-Sqr(dz) * depthScale - d2 * colorScale);
                     for (int c = 0; c < 3; ++c)
-                        if (wsum > 0) {
-                            filtered.SetChannel({x, y}, c, result[c] / wsum);
-                            // wImage.SetChannels({x, y}, {wpSum, wnSum,
-                            // wcSum});
-                        } else
-                            filtered.SetChannel({x, y}, c,
-                                                currentImage.GetChannel({x, y}, c));
+                        result[c] += w * illum[c][o];
+                    wsum += w;
                 }
             }
-        });
+            for (int c = 0; c < 3; ++c)
+                filtered[c][i] = wsum > 0 ? result[c] / wsum : illum[c][i];
+        };
 
-        // filtered.Write(StringPrintf("filtered-%d-%d.exr", call, i));
-        // wImage.Write(StringPrintf("weights%d.exr", i));
-        //        if (i == 0)
-        //  dzImage.Write("dz.exr");
+#ifdef PBRT_HAVE_SIMD
+        // Filters _FloatVec::Width_ horizontally-adjacent pixels whose taps
+        // are all inside the image.
+        auto filterSpan = [&](int x, int y) {
+            size_t i = size_t(y) * res.x + x;
+            FloatVec zero(0.f);
+            FloatVec c0 = FloatVec::LoadUnaligned(&illum[0][i]);
+            FloatVec c1 = FloatVec::LoadUnaligned(&illum[1][i]);
+            FloatVec c2 = FloatVec::LoadUnaligned(&illum[2][i]);
+            FloatVec pv = FloatVec::LoadUnaligned(&variance[i]);
+            FloatVec pz = FloatVec::LoadUnaligned(&z[i]);
+            FloatVec pdzdx = FloatVec::LoadUnaligned(&dzdx[i]);
+            FloatVec pdzdy = FloatVec::LoadUnaligned(&dzdy[i]);
+            FloatVec pnx = FloatVec::LoadUnaligned(&nx[i]);
+            FloatVec pny = FloatVec::LoadUnaligned(&ny[i]);
+            FloatVec pnz = FloatVec::LoadUnaligned(&nz[i]);
+
+            FloatVec r0 = zero, r1 = zero, r2 = zero, wsum = zero;
+            for (int dy = -radius; dy <= radius; dy += delta) {
+                if (y + dy < 0 || y + dy >= res.y)
+                    continue;
+                for (int dx = -radius; dx <= radius; dx += delta) {
+                    size_t o = size_t(y + dy) * res.x + (x + dx);
+                    FloatVec o0 = FloatVec::LoadUnaligned(&illum[0][o]);
+                    FloatVec o1 = FloatVec::LoadUnaligned(&illum[1][o]);
+                    FloatVec o2 = FloatVec::LoadUnaligned(&illum[2][o]);
+                    FloatVec dc2 = (c0 - o0) * (c0 - o0) + (c1 - o1) * (c1 - o1) +
+                                   (c2 - o2) * (c2 - o2);
+                    FloatVec ov = FloatVec::LoadUnaligned(&variance[o]);
+                    FloatVec d2 = Max(zero, dc2 - (pv + Min(pv, ov))) /
+                                  (FloatVec(1e-4f) + FloatVec(0.36f) * (pv + ov));
+
+                    FloatVec dzPredicted =
+                        FloatVec(float(dx)) * pdzdx + FloatVec(float(dy)) * pdzdy;
+                    FloatVec dz = dzPredicted / (pz + FloatVec(0.5f) * dzPredicted);
+                    FloatVec wn =
+                        Max(zero, pnx * FloatVec::LoadUnaligned(&nx[o]) +
+                                      pny * FloatVec::LoadUnaligned(&ny[o]) +
+                                      pnz * FloatVec::LoadUnaligned(&nz[o]));
+                    for (int j = 0; j < 5; ++j)
+                        wn = wn * wn;
+                    FloatVec w = FloatVec(depthNorm * f[std::abs(dy) / delta] *
+                                          f[std::abs(dx) / delta]) *
+                                 wn *
+                                 FastExp(zero - dz * dz * FloatVec(depthScale) -
+                                         d2 * FloatVec(colorScale));
+                    r0 = r0 + w * o0;
+                    r1 = r1 + w * o1;
+                    r2 = r2 + w * o2;
+                    wsum = wsum + w;
+                }
+            }
 
-        pstd::swap(filtered, currentImage);
-    }
+            // Keep the unfiltered value where no tap contributed and zero
+            // background pixels
+            FloatVec haveWeight = NotEqual(wsum, zero);
+            FloatVec foreground =
+                NotEqual(pnx, zero) | NotEqual(pny, zero) | NotEqual(pnz, zero);
+            Select(foreground, Select(haveWeight, r0 / wsum, c0), zero)
+                .StoreUnaligned(&filtered[0][i]);
+            Select(foreground, Select(haveWeight, r1 / wsum, c1), zero)
+                .StoreUnaligned(&filtered[1][i]);
+            Select(foreground, Select(haveWeight, r2 / wsum, c2), zero)
+                .StoreUnaligned(&filtered[2][i]);
+        };
+#endif
 
-    // static int i = 0;
-    // currentImage.Write(StringPrintf("filteredillum-%d.exr", i++));
+        // Work in small 2D tiles so that the rows of neighbors each tap
+        // reads stay in cache while the pixels of a tile are filtered.
+        ParallelFor2D(Bounds2i(Point2i(0, 0), res), [&](Bounds2i tile) {
+            for (int y = tile.pMin.y; y < tile.pMax.y; ++y) {
+                int x = tile.pMin.x;
+#ifdef PBRT_HAVE_SIMD
+                for (; x < tile.pMax.x && x < radius; ++x)
+                    filterPixel(x, y);
+                for (; x + FloatVec::Width <= std::min(tile.pMax.x, res.x - radius);
+                     x += FloatVec::Width)
+                    filterSpan(x, y);
+#endif
+                for (; x < tile.pMax.x; ++x)
+                    filterPixel(x, y);
+            }
+        });
+
+        std::swap(filtered, illum);
+    }
 
     // reincorporate albedo
-    for (int y = 0; y < currentImage.Resolution().y; ++y)
-        for (int x = 0; x < currentImage.Resolution().x; ++x) {
-            ImageChannelValues albedo = in.GetChannels({x, y}, albedoDesc);
-            for (int c = 0; c < 3; ++c)
-                currentImage.SetChannel({x, y}, c,
-                                        currentImage.GetChannel({x, y}, c) * albedo[c]);
-        }
+    Image result(PixelFormat::Float, res, {"R", "G", "B"});
+    ParallelFor(0, res.y, [&](int64_t start, int64_t end) {
+        for (int y = start; y < end; ++y)
+            for (int x = 0; x < res.x; ++x) {
+                size_t i = size_t(y) * res.x + x;
+                for (int c = 0; c < 3; ++c)
+                    result.SetChannel({x, y}, c, illum[c][i] * albedo[c][i]);
+            }
+    });
 
-    return currentImage;
+    return result;
 }
 
 int denoise(int argc, char *argv[]) {
@@ -2119,16 +2205,8 @@ int denoise(int argc, char *argv[]) {
 
     int halfWidth = 3;
     int nLevels = 3;
-    Image denoisedImage = denoiseImage(in, rgbDesc, filteredVariance, albedoDesc, zDesc,
-                                       deltaZDesc, nsDesc, halfWidth, nLevels);
-
-    Image result(PixelFormat::Float, in.Resolution(), {"R", "G", "B"});
-    for (int y = 0; y < in.Resolution().y; ++y)
-        for (int x = 0; x < in.Resolution().x; ++x) {
-            ImageChannelValues Ldenoised = denoisedImage.GetChannels({x, y});
-            for (int c = 0; c < 3; ++c)
-                result.SetChannel({x, y}, c, Ldenoised[c]);
-        }
+    Image result = denoiseImage(in, rgbDesc, filteredVariance, albedoDesc, zDesc,
+                                deltaZDesc, nsDesc, halfWidth, nLevels);
 
     if (!result.Write(outFilename)) {
         fprintf(stderr, "%s: couldn't write image.\n", outFilename.c_str());
@@ -2317,6 +2395,8 @@ int main(int argc, char *argv[]) {
         return makeequiarea(argc - 2, argv + 2);
     else if (strcmp(argv[1], "makeemitters") == 0)
         return makeemitters(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "makemip") == 0)
+        return makemip(argc - 2, argv + 2);
     else if (strcmp(argv[1], "makesky") == 0)
         return makesky(argc - 2, argv + 2);
     else if (strcmp(argv[1], "whitebalance") == 0)
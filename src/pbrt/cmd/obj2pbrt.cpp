@@ -93,140 +93,6 @@ typedef struct {
   std::map<std::string, std::string> unknown_parameter;
 } material_t;
 
-typedef struct {
-  std::string name;
-
-  std::vector<int> intValues;
-  std::vector<float> floatValues;
-  std::vector<std::string> stringValues;
-} tag_t;
-
-typedef struct {
-  std::vector<float> positions;
-  std::vector<float> normals;
-  std::vector<float> texcoords;
-  std::vector<unsigned int> indices;
-  std::vector<unsigned char>
-      num_vertices;              // The number of vertices per face. Up to 255.
-  std::vector<int> material_ids; // per-face material ID
-  std::vector<tag_t> tags;       // SubD tag
-} mesh_t;
-
-typedef struct {
-  std::string name;
-  mesh_t mesh;
-} shape_t;
-
-typedef enum
-{
-  triangulation = 1,        // used whether triangulate polygon face in .obj
-  calculate_normals = 2,    // used whether calculate the normals if the .obj normals are empty
-  // Some nice stuff here
-} load_flags_t;
-
-class float3
-{
-public:
-  float3()
-    : x( 0.0f )
-    , y( 0.0f )
-    , z( 0.0f )
-  {
-  }
-
-  float3(float coord_x, float coord_y, float coord_z)
-    : x( coord_x )
-    , y( coord_y )
-    , z( coord_z )
-  {
-  }
-
-  float3(const float3& from, const float3& to)
-  {
-    coord[0] = to.coord[0] - from.coord[0];
-    coord[1] = to.coord[1] - from.coord[1];
-    coord[2] = to.coord[2] - from.coord[2];
-  }
-
-  float3 crossproduct ( const float3 & vec )
-  {
-    float a = y * vec.z - z * vec.y ;
-    float b = z * vec.x - x * vec.z ;
-    float c = x * vec.y - y * vec.x ;
-    return { a , b , c };
-  }
-
-  void normalize()
-  {
-    const float length = std::sqrt( ( coord[0] * coord[0] ) +
-                                               ( coord[1] * coord[1] ) +
-                                               ( coord[2] * coord[2] ) );
-    if( length != 1 )
-    {
-      coord[0] = (coord[0] / length);
-      coord[1] = (coord[1] / length);
-      coord[2] = (coord[2] / length);
-    }
-  }
-
-private:
-  union
-  {
-    float coord[3];
-    struct
-    {
-      float x,y,z;
-    };
-  };
-};
-
-class MaterialReader {
-public:
-  MaterialReader() {}
-  virtual ~MaterialReader();
-
-  virtual bool operator()(const std::string &matId,
-                          std::vector<material_t> &materials,
-                          std::map<std::string, int> &matMap,
-                          std::string &err) = 0;
-};
-
-class MaterialFileReader : public MaterialReader {
-public:
-  MaterialFileReader(const std::string &mtl_basepath)
-      : m_mtlBasePath(mtl_basepath) {}
-  virtual ~MaterialFileReader() {}
-  virtual bool operator()(const std::string &matId,
-                          std::vector<material_t> &materials,
-                          std::map<std::string, int> &matMap, std::string &err);
-
-private:
-  std::string m_mtlBasePath;
-};
-
-/// Loads .obj from a file.
-/// 'shapes' will be filled with parsed shape data
-/// The function returns error string.
-/// Returns true when loading .obj become success.
-/// Returns warning and error message into `err`
-/// 'mtl_basepath' is optional, and used for base path for .mtl file.
-/// 'optional flags
-bool LoadObj(std::vector<shape_t> &shapes,       // [output]
-             std::vector<material_t> &materials, // [output]
-             std::string &err,                   // [output]
-             const char *filename, const char *mtl_basepath = nullptr,
-             unsigned int flags = 1 );
-
-/// Loads object from a std::istream, uses GetMtlIStreamFn to retrieve
-/// std::istream for materials.
-/// Returns true when loading .obj become success.
-/// Returns warning and error message into `err`
-bool LoadObj(std::vector<shape_t> &shapes,       // [output]
-             std::vector<material_t> &materials, // [output]
-             std::string &err,                   // [output]
-             std::istream &inStream, MaterialReader &readMatFn,
-             unsigned int flags = 1);
-
 /// Loads materials into std::map
 void LoadMtl(std::map<std::string, int> &material_map, // [output]
              std::vector<material_t> &materials,       // [output]
@@ -242,47 +108,11 @@ void LoadMtl(std::map<std::string, int> &material_map, // [output]
 #include <cctype>
 
 #include <fstream>
-#include <sstream>
 
 namespace tinyobj {
 
-MaterialReader::~MaterialReader() {}
-
 #define TINYOBJ_SSCANF_BUFFER_SIZE (4096)
 
-struct vertex_index {
-  int v_idx, vt_idx, vn_idx;
-  vertex_index() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
-  explicit vertex_index(int idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
-  vertex_index(int vidx, int vtidx, int vnidx)
-      : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
-};
-
-struct tag_sizes {
-  tag_sizes() : num_ints(0), num_floats(0), num_strings(0) {}
-  int num_ints;
-  int num_floats;
-  int num_strings;
-};
-
-// for std::map
-static inline bool operator<(const vertex_index &a, const vertex_index &b) {
-  if (a.v_idx != b.v_idx)
-    return (a.v_idx < b.v_idx);
-  if (a.vn_idx != b.vn_idx)
-    return (a.vn_idx < b.vn_idx);
-  if (a.vt_idx != b.vt_idx)
-    return (a.vt_idx < b.vt_idx);
-
-  return false;
-}
-
-struct obj_shape {
-  std::vector<float> v;
-  std::vector<float> vn;
-  std::vector<float> vt;
-};
-
 //See http://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf
 std::istream& safeGetline(std::istream& is, std::string& t)
 {
@@ -319,25 +149,6 @@ std::istream& safeGetline(std::istream& is, std::string& t)
 
 #define IS_SPACE( x ) ( ( (x) == ' ') || ( (x) == '\t') )
 #define IS_DIGIT( x ) ( (unsigned int)( (x) - '0' ) < (unsigned int)10 )
-#define IS_NEW_LINE( x ) ( ( (x) == '\r') || ( (x) == '\n') || ( (x) == '\0') )
-
-// Make index zero-base, and also support relative index.
-static inline int fixIndex(int idx, int n) {
-  if (idx > 0)
-    return idx - 1;
-  if (idx == 0)
-    return 0;
-  return n + idx; // negative value = relative
-}
-
-static inline std::string parseString(const char *&token) {
-  std::string s;
-  token += strspn(token, " \t");
-  size_t e = strcspn(token, " \t\r");
-  s = std::string(token, &token[e]);
-  token += e;
-  return s;
-}
 
 static inline int parseInt(const char *&token) {
   token += strspn(token, " \t");
@@ -492,11 +303,6 @@ static inline float parseFloat(const char *&token) {
   return f;
 }
 
-static inline void parseFloat2(float &x, float &y, const char *&token) {
-  x = parseFloat(token);
-  y = parseFloat(token);
-}
-
 static inline void parseFloat3(float &x, float &y, float &z,
                                const char *&token) {
   x = parseFloat(token);
@@ -504,102 +310,6 @@ static inline void parseFloat3(float &x, float &y, float &z,
   z = parseFloat(token);
 }
 
-static tag_sizes parseTagTriple(const char *&token) {
-  tag_sizes ts;
-
-  ts.num_ints = atoi(token);
-  token += strcspn(token, "/ \t\r");
-  if (token[0] != '/') {
-    return ts;
-  }
-  token++;
-
-  ts.num_floats = atoi(token);
-  token += strcspn(token, "/ \t\r");
-  if (token[0] != '/') {
-    return ts;
-  }
-  token++;
-
-  ts.num_strings = atoi(token);
-  token += strcspn(token, "/ \t\r") + 1;
-
-  return ts;
-}
-
-// Parse triples: i, i/j/k, i//k, i/j
-static vertex_index parseTriple(const char *&token, int vsize, int vnsize,
-                                int vtsize) {
-  vertex_index vi(-1);
-
-  vi.v_idx = fixIndex(atoi(token), vsize);
-  token += strcspn(token, "/ \t\r");
-  if (token[0] != '/') {
-    return vi;
-  }
-  token++;
-
-  // i//k
-  if (token[0] == '/') {
-    token++;
-    vi.vn_idx = fixIndex(atoi(token), vnsize);
-    token += strcspn(token, "/ \t\r");
-    return vi;
-  }
-
-  // i/j/k or i/j
-  vi.vt_idx = fixIndex(atoi(token), vtsize);
-  token += strcspn(token, "/ \t\r");
-  if (token[0] != '/') {
-    return vi;
-  }
-
-  // i/j/k
-  token++; // skip '/'
-  vi.vn_idx = fixIndex(atoi(token), vnsize);
-  token += strcspn(token, "/ \t\r");
-  return vi;
-}
-
-static unsigned int
-updateVertex(std::map<vertex_index, unsigned int> &vertexCache,
-             std::vector<float> &positions, std::vector<float> &normals,
-             std::vector<float> &texcoords,
-             const std::vector<float> &in_positions,
-             const std::vector<float> &in_normals,
-             const std::vector<float> &in_texcoords, const vertex_index &i) {
-  const std::map<vertex_index, unsigned int>::iterator it = vertexCache.find(i);
-
-  if (it != vertexCache.end()) {
-    // found cache
-    return it->second;
-  }
-
-  assert(in_positions.size() > static_cast<unsigned int>(3 * i.v_idx + 2));
-
-  positions.push_back(in_positions[3 * static_cast<size_t>(i.v_idx) + 0]);
-  positions.push_back(in_positions[3 * static_cast<size_t>(i.v_idx) + 1]);
-  positions.push_back(in_positions[3 * static_cast<size_t>(i.v_idx) + 2]);
-
-  if ((i.vn_idx >= 0) &&
-      (static_cast<size_t>(i.vn_idx * 3 + 2) < in_normals.size())) {
-    normals.push_back(in_normals[3 * static_cast<size_t>(i.vn_idx) + 0]);
-    normals.push_back(in_normals[3 * static_cast<size_t>(i.vn_idx) + 1]);
-    normals.push_back(in_normals[3 * static_cast<size_t>(i.vn_idx) + 2]);
-  }
-
-  if ((i.vt_idx >= 0) &&
-      (static_cast<size_t>(i.vt_idx * 2 + 1) < in_texcoords.size())) {
-    texcoords.push_back(in_texcoords[2 * static_cast<size_t>(i.vt_idx) + 0]);
-    texcoords.push_back(in_texcoords[2 * static_cast<size_t>(i.vt_idx) + 1]);
-  }
-
-  unsigned int idx = static_cast<unsigned int>(positions.size() / 3 - 1);
-  vertexCache[i] = idx;
-
-  return idx;
-}
-
 static void InitMaterial(material_t &material) {
   material.name = "";
   material.ambient_texname = "";
@@ -623,108 +333,6 @@ static void InitMaterial(material_t &material) {
   material.unknown_parameter.clear();
 }
 
-static bool exportFaceGroupToShape(
-    shape_t &shape, std::map<vertex_index, unsigned int> vertexCache,
-    const std::vector<float> &in_positions,
-    const std::vector<float> &in_normals,
-    const std::vector<float> &in_texcoords,
-    const std::vector<std::vector<vertex_index> > &faceGroup,
-    std::vector<tag_t> &tags, const int material_id, const std::string &name,
-    bool clearCache, unsigned int flags, std::string& err ) {
-  if (faceGroup.empty()) {
-    return false;
-  }
-
-  bool triangulate( ( flags & triangulation ) == triangulation );
-  bool normals_calculation( ( flags & calculate_normals ) == calculate_normals );
-
-  // Flatten vertices and indices
-  for (size_t i = 0; i < faceGroup.size(); i++) {
-    const std::vector<vertex_index> &face = faceGroup[i];
-
-    vertex_index i0 = face[0];
-    vertex_index i1(-1);
-    vertex_index i2 = face[1];
-
-    size_t npolys = face.size();
-
-    if (triangulate) {
-
-      // Polygon -> triangle fan conversion
-      for (size_t k = 2; k < npolys; k++) {
-        i1 = i2;
-        i2 = face[k];
-
-        unsigned int v0 = updateVertex(
-            vertexCache, shape.mesh.positions, shape.mesh.normals,
-            shape.mesh.texcoords, in_positions, in_normals, in_texcoords, i0);
-        unsigned int v1 = updateVertex(
-            vertexCache, shape.mesh.positions, shape.mesh.normals,
-            shape.mesh.texcoords, in_positions, in_normals, in_texcoords, i1);
-        unsigned int v2 = updateVertex(
-            vertexCache, shape.mesh.positions, shape.mesh.normals,
-            shape.mesh.texcoords, in_positions, in_normals, in_texcoords, i2);
-
-        shape.mesh.indices.push_back(v0);
-        shape.mesh.indices.push_back(v1);
-        shape.mesh.indices.push_back(v2);
-
-        shape.mesh.num_vertices.push_back(3);
-        shape.mesh.material_ids.push_back(material_id);
-      }
-    } else {
-
-      for (size_t k = 0; k < npolys; k++) {
-        unsigned int v =
-            updateVertex(vertexCache, shape.mesh.positions, shape.mesh.normals,
-                         shape.mesh.texcoords, in_positions, in_normals,
-                         in_texcoords, face[k]);
-
-        shape.mesh.indices.push_back(v);
-      }
-
-      shape.mesh.num_vertices.push_back(static_cast<unsigned char>(npolys));
-      shape.mesh.material_ids.push_back(material_id); // per face
-    }
-  }
-
-  if (normals_calculation && shape.mesh.normals.empty()) {
-	  const size_t nIndexs = shape.mesh.indices.size();
-	  if (nIndexs % 3 == 0) {
-		  shape.mesh.normals.resize(shape.mesh.positions.size());
-		  for (size_t iIndices = 0; iIndices < nIndexs; iIndices += 3) {
-			  float3 v1, v2, v3;
-			  memcpy(&v1, &shape.mesh.positions[shape.mesh.indices[iIndices] * 3], sizeof(float3));
-			  memcpy(&v2, &shape.mesh.positions[shape.mesh.indices[iIndices + 1] * 3], sizeof(float3));
-			  memcpy(&v3, &shape.mesh.positions[shape.mesh.indices[iIndices + 2] * 3], sizeof(float3));
-
-			  float3 v12(v1, v2);
-			  float3 v13(v1, v3);
-
-			  float3 normal = v12.crossproduct(v13);
-			  normal.normalize();
-
-			  memcpy(&shape.mesh.normals[shape.mesh.indices[iIndices] * 3], &normal, sizeof(float3));
-			  memcpy(&shape.mesh.normals[shape.mesh.indices[iIndices + 1] * 3], &normal, sizeof(float3));
-			  memcpy(&shape.mesh.normals[shape.mesh.indices[iIndices + 2] * 3], &normal, sizeof(float3));
-		  }
-	  } else {
-
-		  std::stringstream ss;
-		  ss << "WARN: The shape " << name << " does not have a topology of triangles, therfore the normals calculation could not be performed. Select the tinyobj::triangulation flag for this object." << std::endl;
-		  err += ss.str();
-	  }
-  }
-
-  shape.name = name;
-  shape.mesh.tags.swap(tags);
-
-  if (clearCache)
-    vertexCache.clear();
-
-  return true;
-}
-
 void LoadMtl(std::map<std::string, int> &material_map,
              std::vector<material_t> &materials, std::istream &inStream) {
 
@@ -952,359 +560,681 @@ void LoadMtl(std::map<std::string, int> &material_map,
   }
 }
 
-bool MaterialFileReader::operator()(const std::string &matId,
-                                    std::vector<material_t> &materials,
-                                    std::map<std::string, int> &matMap,
-                                    std::string &err) {
-  std::string filepath;
-
-  if (!m_mtlBasePath.empty()) {
-    filepath = std::string(m_mtlBasePath) + matId;
-  } else {
-    filepath = matId;
-  }
-
-  std::ifstream matIStream(filepath.c_str());
-  LoadMtl(matMap, materials, matIStream);
-  if (!matIStream) {
-    std::stringstream ss;
-    ss << "WARN: Material file [ " << filepath
-       << " ] not found. Created a default material.";
-    err += ss.str();
-  }
-  return true;
-}
-
-bool LoadObj(std::vector<shape_t> &shapes,       // [output]
-             std::vector<material_t> &materials, // [output]
-             std::string &err, const char *filename, const char *mtl_basepath,
-             unsigned int flags) {
+} // namespace
 
-  shapes.clear();
+#endif
 
-  std::stringstream errss;
+#endif // TINY_OBJ_LOADER_H_
 
-  std::ifstream ifs(filename);
-  if (!ifs) {
-    errss << "Cannot open file [" << filename << "]" << std::endl;
-    err = errss.str();
-    return false;
-  }
+// clang-format on
 
-  std::string basePath;
-  if (mtl_basepath != nullptr) {
-    basePath = mtl_basepath;
-  }
-  MaterialFileReader matFileReader(basePath);
+///////////////////////////////////////////////////////////////////////////
+// The above is tiny_obj_loader.{h,cc} basically directly; pbrt specific
+// code follows...
 
-  return LoadObj(shapes, materials, err, ifs, matFileReader, flags);
-}
+#include <pbrt/pbrt.h>
 
-bool LoadObj(std::vector<shape_t> &shapes,       // [output]
-             std::vector<material_t> &materials, // [output]
-             std::string &err, std::istream &inStream,
-             MaterialReader &readMatFn, unsigned int flags) {
+#include <pbrt/options.h>
+#include <pbrt/util/file.h>
+#include <pbrt/util/hash.h>
+#include <pbrt/util/mesh.h>
+#include <pbrt/util/parallel.h>
+#include <pbrt/util/print.h>
+#include <pbrt/util/vecmath.h>
 
-  std::stringstream errss;
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <unordered_map>
 
-  std::vector<float> v;
-  std::vector<float> vn;
-  std::vector<float> vt;
-  std::vector<tag_t> tags;
-  std::vector<std::vector<vertex_index> > faceGroup;
-  std::string name;
+using namespace tinyobj;
+using namespace pbrt;
 
-  // material
-  std::map<std::string, int> material_map;
-  std::map<vertex_index, unsigned int> vertexCache;
-  int material = -1;
+static void usage() {
+    fprintf(stderr, "usage: obj2pbrt [--ptexquads] <OBJ filename> <pbrt filename>\n");
+    exit(1);
+}
 
-  shape_t shape;
+// The OBJ file is read in blocks of this size; each block is split at line
+// boundaries into ranges that are parsed in parallel.
+static constexpr size_t OBJBlockSize = 64 * 1024 * 1024;
+static constexpr size_t OBJMinRangeSize = 256 * 1024;
+
+// As with "pbrt --toply", meshes with fewer indices than this are written
+// inline rather than to a PLY file.
+static constexpr int MinPLYIndices = 500;
+
+// OBJIndex Definition
+// Zero-based position, texture coordinate, and normal indices of a face
+// vertex; missing indices are -1.
+struct OBJIndex {
+    bool operator==(const OBJIndex &o) const {
+        return p == o.p && uv == o.uv && n == o.n;
+    }
 
-  while (inStream.peek() != -1) {
-    std::string linebuf;
-    safeGetline(inStream, linebuf);
+    int p, uv, n;
+};
 
-    // Trim newline '\r\n' or '\n'
-    if (!linebuf.empty()) {
-      if (linebuf[linebuf.size() - 1] == '\n')
-        linebuf.erase(linebuf.size() - 1);
-    }
-    if (!linebuf.empty()) {
-      if (linebuf[linebuf.size() - 1] == '\r')
-        linebuf.erase(linebuf.size() - 1);
+struct OBJIndexHash {
+    size_t operator()(const OBJIndex &index) const {
+        return Hash(index.p, index.uv, index.n);
     }
+};
 
-    // Skip if empty line.
-    if (linebuf.empty()) {
-      continue;
-    }
+// OBJStatement Definition
+// Faces and the statements that change the current group or material are
+// recorded in the order they appear so that they can be replayed serially
+// once all of the ranges of a block have been parsed in parallel.
+struct OBJStatement {
+    enum class Type { Face, Group, Object, UseMtl, MtlLib };
+    Type type;
+    // For faces, the vertices are faceVertices[offset, offset + count) and
+    // hold the one-based or relative indices from the file; otherwise
+    // _offset_ gives the statement's argument in _names_.
+    int offset, count;
+    // Number of vertices of each type in the range before this statement;
+    // used to resolve relative indices.
+    int np, nuv, nn;
+};
 
-    // Skip leading space.
-    const char *token = linebuf.c_str();
-    token += strspn(token, " \t");
+// OBJRange Definition
+struct OBJRange {
+    std::vector<Point3f> p;
+    std::vector<Point2f> uv;
+    std::vector<Normal3f> n;
+    std::vector<OBJStatement> statements;
+    std::vector<OBJIndex> faceVertices;
+    std::vector<std::string> names;
+};
 
-    assert(token);
-    if (token[0] == '\0')
-      continue; // empty line
+// OBJ Parsing Function Definitions
+static inline bool IsOBJSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
 
-    if (token[0] == '#')
-      continue; // comment line
+static inline const char *SkipOBJSpace(const char *s, const char *end) {
+    while (s < end && IsOBJSpace(*s))
+        ++s;
+    return s;
+}
 
-    // vertex
-    if (token[0] == 'v' && IS_SPACE((token[1]))) {
-      token += 2;
-      float x, y, z;
-      parseFloat3(x, y, z, token);
-      v.push_back(x);
-      v.push_back(y);
-      v.push_back(z);
-      continue;
-    }
+static inline const char *OBJTokenEnd(const char *s, const char *end) {
+    while (s < end && !IsOBJSpace(*s))
+        ++s;
+    return s;
+}
 
-    // normal
-    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
-      token += 3;
-      float x, y, z;
-      parseFloat3(x, y, z, token);
-      vn.push_back(x);
-      vn.push_back(y);
-      vn.push_back(z);
-      continue;
+static double ParseOBJFloat(const char *s, const char *end) {
+    // Handle the plain decimal values that make up nearly all OBJ files
+    // directly; anything else goes through strtod().
+    static const double powersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                        1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                        1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *c = s;
+    bool negative = false;
+    if (c < end && (*c == '+' || *c == '-'))
+        negative = *c++ == '-';
+    uint64_t mantissa = 0;
+    int nDigits = 0, exponent = 0;
+    for (; c < end && IS_DIGIT(*c); ++c, ++nDigits)
+        mantissa = 10 * mantissa + (*c - '0');
+    if (c < end && *c == '.')
+        for (++c; c < end && IS_DIGIT(*c); ++c, ++nDigits, --exponent)
+            mantissa = 10 * mantissa + (*c - '0');
+    if (c < end && (*c == 'e' || *c == 'E') && nDigits > 0) {
+        const char *e = c + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '+' || *e == '-'))
+            negativeExponent = *e++ == '-';
+        int exp = 0;
+        for (; e < end && IS_DIGIT(*e) && exp < 1000; ++e)
+            exp = 10 * exp + (*e - '0');
+        exponent += negativeExponent ? -exp : exp;
+        c = e;
     }
 
-    // texcoord
-    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
-      token += 3;
-      float x, y;
-      parseFloat2(x, y, token);
-      vt.push_back(x);
-      vt.push_back(y);
-      continue;
+    if (c == end && nDigits > 0 && nDigits <= 19 && std::abs(exponent) <= 22) {
+        double v = exponent < 0 ? mantissa / powersOf10[-exponent]
+                                : mantissa * powersOf10[exponent];
+        return negative ? -v : v;
     }
+    std::string str(s, end);
+    return strtod(str.c_str(), nullptr);
+}
 
-    // face
-    if (token[0] == 'f' && IS_SPACE((token[1]))) {
-      token += 2;
-      token += strspn(token, " \t");
-
-      std::vector<vertex_index> face;
-      face.reserve(3);
-
-      while (!IS_NEW_LINE(token[0])) {
-        vertex_index vi = parseTriple(token, static_cast<int>(v.size() / 3),
-                                      static_cast<int>(vn.size() / 3),
-                                      static_cast<int>(vt.size() / 2));
-        face.push_back(vi);
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
-
-      // replace with emplace_back + std::move on C++11
-      faceGroup.push_back(std::vector<vertex_index>());
-      faceGroup[faceGroup.size() - 1].swap(face);
-
-      continue;
+// Parses up to _n_ values; missing values are set to zero.
+static void ParseOBJFloats(const char *s, const char *end, float *v, int n) {
+    for (int i = 0; i < n; ++i) {
+        s = SkipOBJSpace(s, end);
+        const char *tokenEnd = OBJTokenEnd(s, end);
+        v[i] = (s < tokenEnd) ? ParseOBJFloat(s, tokenEnd) : 0.f;
+        s = tokenEnd;
     }
+}
 
-    // use mtl
-    if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
-
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 7;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
-
-      int newMaterialId = -1;
-      if (material_map.find(namebuf) != material_map.end()) {
-        newMaterialId = material_map[namebuf];
-      } else {
-        // { error!! material not found }
-      }
-
-      if (newMaterialId != material) {
-        // Create per-face material
-        exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, tags,
-                               material, name, true, flags, err );
-        faceGroup.clear();
-        material = newMaterialId;
-      }
+// Returns zero, which is never a valid OBJ index, if there is no index.
+static int ParseOBJIndex(const char *&s, const char *end) {
+    bool negative = false;
+    if (s < end && (*s == '+' || *s == '-'))
+        negative = *s++ == '-';
+    int v = 0;
+    while (s < end && IS_DIGIT(*s))
+        v = 10 * v + (*s++ - '0');
+    return negative ? -v : v;
+}
 
-      continue;
+static void ParseOBJRange(const char *start, const char *end, OBJRange *range) {
+    while (start < end) {
+        const char *lineEnd = (const char *)memchr(start, '\n', end - start);
+        if (lineEnd == nullptr)
+            lineEnd = end;
+        const char *s = SkipOBJSpace(start, lineEnd);
+        start = lineEnd + 1;
+        if (s == lineEnd || *s == '#')
+            continue;
+
+        const char *keyEnd = OBJTokenEnd(s, lineEnd);
+        size_t keyLength = keyEnd - s;
+        auto isKeyword = [&](const char *keyword) {
+            return keyLength == strlen(keyword) && memcmp(s, keyword, keyLength) == 0;
+        };
+
+        if (isKeyword("v")) {
+            float v[3];
+            ParseOBJFloats(keyEnd, lineEnd, v, 3);
+            range->p.push_back(Point3f(v[0], v[1], v[2]));
+        } else if (isKeyword("vt")) {
+            float v[2];
+            ParseOBJFloats(keyEnd, lineEnd, v, 2);
+            range->uv.push_back(Point2f(v[0], v[1]));
+        } else if (isKeyword("vn")) {
+            float v[3];
+            ParseOBJFloats(keyEnd, lineEnd, v, 3);
+            range->n.push_back(Normal3f(v[0], v[1], v[2]));
+        } else if (isKeyword("f")) {
+            OBJStatement face{OBJStatement::Type::Face,
+                              int(range->faceVertices.size()),
+                              0,
+                              int(range->p.size()),
+                              int(range->uv.size()),
+                              int(range->n.size())};
+            // Face vertices are of the form p, p/uv, p//n, or p/uv/n.
+            for (s = SkipOBJSpace(keyEnd, lineEnd); s < lineEnd;
+                 s = SkipOBJSpace(s, lineEnd)) {
+                const char *tokenEnd = OBJTokenEnd(s, lineEnd);
+                OBJIndex index{ParseOBJIndex(s, tokenEnd), 0, 0};
+                if (s < tokenEnd && *s == '/') {
+                    index.uv = ParseOBJIndex(++s, tokenEnd);
+                    if (s < tokenEnd && *s == '/')
+                        index.n = ParseOBJIndex(++s, tokenEnd);
+                }
+                range->faceVertices.push_back(index);
+                ++face.count;
+                s = tokenEnd;
+            }
+            range->statements.push_back(face);
+        } else {
+            OBJStatement::Type type;
+            if (isKeyword("g"))
+                type = OBJStatement::Type::Group;
+            else if (isKeyword("o"))
+                type = OBJStatement::Type::Object;
+            else if (isKeyword("usemtl"))
+                type = OBJStatement::Type::UseMtl;
+            else if (isKeyword("mtllib"))
+                type = OBJStatement::Type::MtlLib;
+            else
+                // Ignore unknown statements.
+                continue;
+
+            // Only the first name is used for all of these.
+            const char *name = SkipOBJSpace(keyEnd, lineEnd);
+            range->statements.push_back(
+                OBJStatement{type, int(range->names.size()), 0, 0, 0, 0});
+            range->names.push_back(std::string(name, OBJTokenEnd(name, lineEnd)));
+        }
     }
+}
 
-    // load mtl
-    if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 7;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
-
-      std::string err_mtl;
-      bool ok = readMatFn(namebuf, materials, material_map, err_mtl);
-      err += err_mtl;
-
-      if (!ok) {
-        faceGroup.clear(); // for safety
-        return false;
-      }
+static void WriteMaterial(FILE *f, const material_t &mtl) {
+    bool hasDiffuseTex = (!mtl.diffuse_texname.empty());
+    if (!mtl.diffuse_texname.empty()) {
+        if (mtl.diffuse[0] != 0 || mtl.diffuse[1] != 0 || mtl.diffuse[2] != 0) {
+            fprintf(f,
+                    "Texture \"%s-kd-img\" \"spectrum\" \"imagemap\" "
+                    "\"string imagefile\" [\"%s\"]\n",
+                    mtl.name.c_str(), mtl.diffuse_texname.c_str());
+            float scale = (mtl.diffuse[0] + mtl.diffuse[1] + mtl.diffuse[2]) / 3;
+            if (mtl.diffuse[0] != mtl.diffuse[1] || mtl.diffuse[1] != mtl.diffuse[2])
+                fprintf(stderr,
+                        "Averaging non-constant RGB scale for \"%s\" (%f "
+                        "%f %f).\n",
+                        mtl.name.c_str(), mtl.diffuse[0], mtl.diffuse[1],
+                        mtl.diffuse[2]);
+            fprintf(f,
+                    "Texture \"%s-kd\" \"spectrum\" \"scale\" \"texture tex\" "
+                    "\"%s-kd-img\" \"float scale\" [%f]\n",
+                    mtl.name.c_str(), mtl.name.c_str(), scale);
+        } else {
+            fprintf(f,
+                    "Texture \"%s-kd\" \"spectrum\" \"imagemap\" "
+                    "\"string imagefile\" [\"%s\"]\n",
+                    mtl.name.c_str(), mtl.diffuse_texname.c_str());
+        }
+    }
 
-      continue;
+    bool hasSpecularTex = (!mtl.specular_texname.empty());
+    if (!mtl.specular_texname.empty()) {
+        if (mtl.specular[0] != 0 || mtl.specular[1] != 0 || mtl.specular[2] != 0) {
+            fprintf(f,
+                    "Texture \"%s-ks-img\" \"spectrum\" \"imagemap\" "
+                    "\"string imagefile\" [\"%s\"]\n",
+                    mtl.name.c_str(), mtl.specular_texname.c_str());
+            float scale = (mtl.specular[0] + mtl.specular[1] + mtl.specular[2]) / 3;
+            if (mtl.specular[0] != mtl.specular[1] || mtl.specular[1] != mtl.specular[2])
+                fprintf(stderr,
+                        "Averaging non-constant RGB scale for \"%s\" (%f "
+                        "%f %f).\n",
+                        mtl.name.c_str(), mtl.specular[0], mtl.specular[1],
+                        mtl.specular[2]);
+            fprintf(f,
+                    "Texture \"%s-ks\" \"spectrum\" \"scale\" \"texture tex\" "
+                    "\"%s-ks-img\" \"float scale\" [%f]\n",
+                    mtl.name.c_str(), mtl.name.c_str(), scale);
+        } else {
+            fprintf(f,
+                    "Texture \"%s-ks\" \"spectrum\" \"imagemap\" "
+                    "\"string imagefile\" [\"%s\"]\n",
+                    mtl.name.c_str(), mtl.specular_texname.c_str());
+        }
     }
 
-    // group name
-    if (token[0] == 'g' && IS_SPACE((token[1]))) {
+    if (!mtl.bump_texname.empty()) {
+        fprintf(f,
+                "Texture \"%s-bump\" \"float\" \"imagemap\" "
+                "\"string imagefile\" [\"%s\"]\n",
+                mtl.name.c_str(), mtl.bump_texname.c_str());
+    }
 
-      // flush previous face group.
-      bool ret =
-          exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, tags,
-                                 material, name, true, flags, err );
-      if (ret) {
-        shapes.push_back(shape);
-      }
+    float roughness = (mtl.shininess == 0) ? 0. : (1.f / mtl.shininess);
+    fprintf(f, R"(MakeNamedMaterial "%s" "string type" "uber" )", mtl.name.c_str());
+
+    if (hasDiffuseTex)
+        fprintf(f, R"("texture reflectance" "%s-kd" )", mtl.name.c_str());
+    else
+        fprintf(f, "\"rgb reflectance\" [%f %f %f] ", mtl.diffuse[0], mtl.diffuse[1],
+                mtl.diffuse[2]);
+    if (hasSpecularTex)
+        fprintf(f, R"("texture Ks" "%s-ks" )", mtl.name.c_str());
+    else
+        fprintf(f, "\"rgb Ks\" [%f %f %f] ", mtl.specular[0], mtl.specular[1],
+                mtl.specular[2]);
+    if (mtl.dissolve < 1)
+        fprintf(stderr, "Warning: ignoring opacity for \"%s\" material/\n",
+                mtl.name.c_str());
+    fprintf(f,
+            "\"float roughness\" [%f] "
+            "\"rgb Kt\" [%f %f %f] \"float eta\" [%f] ",
+            roughness, mtl.transmittance[0], mtl.transmittance[1], mtl.transmittance[2],
+            mtl.ior);
+    if (!mtl.bump_texname.empty())
+        fprintf(f, R"("texture displacement" "%s-bump" )", mtl.name.c_str());
+    fprintf(f, "\n\n");
+}
 
-      shape = shape_t();
+static void WriteInlineMesh(FILE *f, const std::vector<int> &indices,
+                            const std::vector<Point3f> &P,
+                            const std::vector<Normal3f> &N,
+                            const std::vector<Point2f> &st,
+                            const std::vector<int> &faceIndices) {
+    fprintf(f, "Shape \"trianglemesh\"\n");
+    fprintf(f, "  \"point3 P\" [ \n");
+    for (Point3f p : P)
+        fprintf(f, "\t%.10g %.10g %.10g\n", p.x, p.y, p.z);
+    fprintf(f, "]\n");
+    if (!N.empty()) {
+        fprintf(f, "  \"normal N\" [ \n");
+        for (Normal3f n : N)
+            fprintf(f, "\t%.10g %.10g %.10g\n", n.x, n.y, n.z);
+        fprintf(f, "]\n");
+    }
+    if (!st.empty()) {
+        fprintf(f, "  \"point2 uv\" [ \n");
+        for (Point2f tex : st)
+            fprintf(f, "\t%.10g %.10g\n", tex.x, tex.y);
+        fprintf(f, "]\n");
+    }
+    fprintf(f, "  \"integer indices\" [ \n\t");
+    for (size_t i = 0; i < indices.size(); ++i)
+        fprintf(f, "%d%s", indices[i], (i % 3) == 2 ? "\n\t" : " ");
+    if (!faceIndices.empty()) {
+        fprintf(f, "]\n  \"integer faceIndices\" [\n");
+        for (int i : faceIndices)
+            fprintf(f, "\t%d\n", i);
+    }
+    fprintf(f, "]\n\n");
+}
 
-      // material = -1;
-      faceGroup.clear();
+// OBJConverter Definition
+// Replays parsed OBJ ranges in file order, accumulating the faces of the
+// current group. When a group ends, its meshes are emitted; large ones are
+// queued and written to binary PLY files in parallel once the block has
+// been processed. Only the vertex arrays, which OBJ faces may index
+// anywhere into, grow with the size of the input.
+class OBJConverter {
+  public:
+    OBJConverter(FILE *f, std::string plyPrefix, std::string plyReferencePrefix,
+                 bool ptexQuads)
+        : f(f),
+          plyPrefix(std::move(plyPrefix)),
+          plyReferencePrefix(std::move(plyReferencePrefix)),
+          ptexQuads(ptexQuads) {}
+
+    void ProcessBlock(const char *start, const char *end);
+    void Finish();
+
+    int numAreaLights = 0, numTriangles = 0, numMeshes = 0;
+    float bounds[2][3] = {{1e30, 1e30, 1e30}, {-1e30, -1e30, -1e30}};
 
-      std::vector<std::string> names;
-      names.reserve(2);
+  private:
+    // OBJConverter Private Methods
+    void AddRange(const OBJRange &range);
+    void LoadMaterials(const std::string &filename);
+    void FlushGroup();
+    void WritePendingMeshes();
+    void BuildMesh(const std::vector<OBJIndex> &faces, std::vector<int> *indices,
+                   std::vector<Point3f> *P, std::vector<Normal3f> *N,
+                   std::vector<Point2f> *st, std::vector<int> *faceIndices) const;
+
+    // OBJConverter Private Members
+    FILE *f;
+    std::string plyPrefix, plyReferencePrefix;
+    bool ptexQuads;
+    int plyCount = 0;
+
+    std::vector<Point3f> p;
+    std::vector<Point2f> uv;
+    std::vector<Normal3f> n;
 
-      while (!IS_NEW_LINE(token[0])) {
-        std::string str = parseString(token);
-        names.push_back(str);
-        token += strspn(token, " \t\r"); // skip tag
-      }
+    std::vector<material_t> materials;
+    std::map<std::string, int> materialMap;
+    int currentMaterial = -1;
 
-      assert(names.size() > 0);
+    // Triangle (or, with _ptexQuads_, quad) vertices of the current group for
+    // each material id used in it.
+    std::string groupName;
+    std::map<int, std::vector<OBJIndex>> groupFaces;
 
-      // names[0] must be 'g', so skip the 0th element.
-      if (names.size() > 1) {
-        name = names[1];
-      } else {
-        name = "";
-      }
+    struct PendingMesh {
+        std::string filename;
+        std::vector<OBJIndex> faces;
+    };
+    std::vector<PendingMesh> pendingMeshes;
+};
 
-      continue;
+// OBJConverter Method Definitions
+void OBJConverter::ProcessBlock(const char *start, const char *end) {
+    // Split the block into ranges that start at the beginning of a line
+    size_t nRanges = std::max<size_t>(
+        1, std::min<size_t>(4 * RunningThreads(), (end - start) / OBJMinRangeSize));
+    std::vector<const char *> rangeStart(nRanges + 1);
+    rangeStart[0] = start;
+    rangeStart[nRanges] = end;
+    for (size_t i = 1; i < nRanges; ++i) {
+        const char *s = std::max(start + i * (end - start) / nRanges, rangeStart[i - 1]);
+        const char *newline = (const char *)memchr(s, '\n', end - s);
+        rangeStart[i] = newline ? newline + 1 : end;
     }
 
-    // object name
-    if (token[0] == 'o' && IS_SPACE((token[1]))) {
-
-      // flush previous face group.
-      bool ret =
-          exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, tags,
-                                 material, name, true, flags, err );
-      if (ret) {
-        shapes.push_back(shape);
-      }
-
-      // material = -1;
-      faceGroup.clear();
-      shape = shape_t();
-
-      // @todo { multiple object name? }
-      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-      token += 2;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
-      name = std::string(namebuf);
-
-      continue;
+    // Parse the ranges in parallel and then process them in order
+    std::vector<OBJRange> ranges(nRanges);
+    ParallelFor(0, nRanges, [&](int64_t i) {
+        ParseOBJRange(rangeStart[i], rangeStart[i + 1], &ranges[i]);
+    });
+    for (OBJRange &range : ranges) {
+        AddRange(range);
+        range = OBJRange();
     }
 
-    if (token[0] == 't' && IS_SPACE(token[1])) {
-      tag_t tag;
-
-      char namebuf[4096];
-      token += 2;
-#ifdef _MSC_VER
-      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-      sscanf(token, "%s", namebuf);
-#endif
-      tag.name = std::string(namebuf);
-
-      token += tag.name.size() + 1;
-
-      tag_sizes ts = parseTagTriple(token);
+    WritePendingMeshes();
+}
 
-      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+void OBJConverter::Finish() {
+    FlushGroup();
+    WritePendingMeshes();
+}
 
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-        tag.intValues[i] = atoi(token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
+void OBJConverter::AddRange(const OBJRange &range) {
+    int pBase = p.size(), uvBase = uv.size(), nBase = n.size();
+    p.insert(p.end(), range.p.begin(), range.p.end());
+    uv.insert(uv.end(), range.uv.begin(), range.uv.end());
+    n.insert(n.end(), range.n.begin(), range.n.end());
+    for (Point3f pt : range.p)
+        for (int c = 0; c < 3; ++c) {
+            bounds[0][c] = std::min(bounds[0][c], pt[c]);
+            bounds[1][c] = std::max(bounds[1][c], pt[c]);
+        }
 
-      tag.floatValues.resize(static_cast<size_t>(ts.num_floats));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_floats); ++i) {
-        tag.floatValues[i] = parseFloat(token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
+    // Convert one-based or relative OBJ index to a zero-based index, or -1.
+    auto resolve = [](int index, int base, int nBefore, int count, const char *what) {
+        if (index == 0)
+            return -1;
+        int resolved = (index > 0) ? index - 1 : base + nBefore + index;
+        if (resolved < 0 || resolved >= count) {
+            fprintf(stderr, "%d: %s index out of range.\n", index, what);
+            exit(1);
+        }
+        return resolved;
+    };
 
-      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        char stringValueBuffer[4096];
+    for (const OBJStatement &st : range.statements) {
+        switch (st.type) {
+        case OBJStatement::Type::Face: {
+            if (st.count < 3 || (ptexQuads && st.count != 4)) {
+                fprintf(stderr, "%d: %s\n", st.count,
+                        ptexQuads ? "Mesh has a non quad face.. Sorry."
+                                  : "Ignoring face with fewer than three vertices.");
+                if (ptexQuads)
+                    exit(1);
+                continue;
+            }
 
-#ifdef _MSC_VER
-        sscanf_s(token, "%s", stringValueBuffer, (unsigned)_countof(stringValueBuffer));
-#else
-        sscanf(token, "%s", stringValueBuffer);
-#endif
-        tag.stringValues[i] = stringValueBuffer;
-        token += tag.stringValues[i].size() + 1;
-      }
+            OBJIndex face[4];
+            auto vertex = [&](int i) {
+                const OBJIndex &v = range.faceVertices[st.offset + i];
+                OBJIndex index{resolve(v.p, pBase, st.np, p.size(), "Vertex"),
+                               resolve(v.uv, uvBase, st.nuv, uv.size(), "Texcoord"),
+                               resolve(v.n, nBase, st.nn, n.size(), "Normal")};
+                if (index.p == -1) {
+                    fprintf(stderr, "Face vertex is missing its position index.\n");
+                    exit(1);
+                }
+                return index;
+            };
 
-      tags.push_back(tag);
+            std::vector<OBJIndex> &faces = groupFaces[currentMaterial];
+            if (ptexQuads) {
+                for (int i = 0; i < 4; ++i)
+                    face[i] = vertex(i);
+                faces.insert(faces.end(), face, face + 4);
+            } else {
+                // Triangulate polygons as a fan around the first vertex
+                face[0] = vertex(0);
+                face[2] = vertex(1);
+                for (int i = 2; i < st.count; ++i) {
+                    face[1] = face[2];
+                    face[2] = vertex(i);
+                    faces.insert(faces.end(), face, face + 3);
+                }
+            }
+            break;
+        }
+        case OBJStatement::Type::Group:
+        case OBJStatement::Type::Object:
+            FlushGroup();
+            groupName = range.names[st.offset];
+            break;
+        case OBJStatement::Type::UseMtl: {
+            auto iter = materialMap.find(range.names[st.offset]);
+            currentMaterial = (iter != materialMap.end()) ? iter->second : -1;
+            break;
+        }
+        case OBJStatement::Type::MtlLib:
+            LoadMaterials(range.names[st.offset]);
+            break;
+        }
     }
+}
 
-    // Ignore unknown command.
-  }
-
-  bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup,
-                                    tags, material, name, true, flags, err );
-  if (ret) {
-    shapes.push_back(shape);
-  }
-  faceGroup.clear(); // for safety
-
-  err += errss.str();
+void OBJConverter::LoadMaterials(const std::string &filename) {
+    std::string path = ResolveFilename(filename);
+    std::ifstream matIStream(path.c_str());
+    if (!matIStream) {
+        fprintf(stderr, "%s: material file not found.\n", path.c_str());
+        return;
+    }
 
-  return true;
+    // Make named materials for all of the new materials.
+    size_t firstNew = materials.size();
+    LoadMtl(materialMap, materials, matIStream);
+    for (size_t i = firstNew; i < materials.size(); ++i) {
+        const material_t &mtl = materials[i];
+        for (const auto &param : mtl.unknown_parameter)
+            fprintf(stderr, "Unknown parameter: %s = %s\n", param.first.c_str(),
+                    param.second.c_str());
+        WriteMaterial(f, mtl);
+    }
 }
 
-} // namespace
-
-#endif
+void OBJConverter::FlushGroup() {
+    if (groupFaces.empty())
+        return;
+
+    fprintf(f, "AttributeBegin\n");
+    if (!groupName.empty())
+        fprintf(f, "Attribute \"shape\" \"string name\" \"%s\"\n", groupName.c_str());
+
+    // Now emit the chunks of the mesh for each material
+    for (auto &idFaces : groupFaces) {
+        int id = idFaces.first;
+        std::vector<OBJIndex> &faces = idFaces.second;
+        if (id == -1) {
+            fprintf(f, "# Material unspecified in OBJ file\n");
+        } else {
+            const material_t &mtl = materials[id];
+            if (mtl.emission[0] > 0 || mtl.emission[1] > 0 || mtl.emission[2] > 0) {
+                fprintf(f, "AreaLightSource \"area\" \"rgb L\" [ %f %f %f ]\n",
+                        mtl.emission[0], mtl.emission[1], mtl.emission[2]);
+                ++numAreaLights;
+            }
+            fprintf(f, "NamedMaterial \"%s\"\n", mtl.name.c_str());
+        }
 
-#endif // TINY_OBJ_LOADER_H_
+        ++numMeshes;
+        int nIndices = ptexQuads ? (faces.size() / 4 * 6) : faces.size();
+        numTriangles += nIndices / 3;
+        if (nIndices < MinPLYIndices) {
+            std::vector<int> indices, faceIndices;
+            std::vector<Point3f> P;
+            std::vector<Normal3f> N;
+            std::vector<Point2f> st;
+            BuildMesh(faces, &indices, &P, &N, &st, &faceIndices);
+            WriteInlineMesh(f, indices, P, N, st, faceIndices);
+        } else {
+            ++plyCount;
+            std::string fn = StringPrintf("%s_%05d.ply", plyPrefix, plyCount);
+            fprintf(f, "Shape \"plymesh\" \"string filename\" \"%s\"\n\n",
+                    StringPrintf("%s_%05d.ply", plyReferencePrefix, plyCount).c_str());
+            pendingMeshes.push_back(PendingMesh{fn, std::move(faces)});
+        }
+    }
+    fprintf(f, "AttributeEnd\n\n\n");
 
-// clang-format on
+    groupFaces.clear();
+}
 
-///////////////////////////////////////////////////////////////////////////
-// The above is tiny_obj_loader.{h,cc} basically directly; pbrt specific
-// code follows...
+void OBJConverter::WritePendingMeshes() {
+    std::atomic<bool> failed{false};
+    ParallelFor(0, pendingMeshes.size(), [&](int64_t i) {
+        std::vector<int> indices, faceIndices;
+        std::vector<Point3f> P;
+        std::vector<Normal3f> N;
+        std::vector<Point2f> st;
+        BuildMesh(pendingMeshes[i].faces, &indices, &P, &N, &st, &faceIndices);
+        pendingMeshes[i].faces = std::vector<OBJIndex>();
+        if (!TriangleMesh::WritePLY(pendingMeshes[i].filename, indices, P, N, st,
+                                    faceIndices)) {
+            fprintf(stderr, "%s: unable to write PLY file.\n",
+                    pendingMeshes[i].filename.c_str());
+            failed = true;
+        }
+    });
+    if (failed)
+        exit(1);
+    pendingMeshes.clear();
+}
 
-#include <set>
-#include <cstdio>
-#include <cstring>
-#include <algorithm>
+void OBJConverter::BuildMesh(const std::vector<OBJIndex> &faces,
+                             std::vector<int> *indices, std::vector<Point3f> *P,
+                             std::vector<Normal3f> *N, std::vector<Point2f> *st,
+                             std::vector<int> *faceIndices) const {
+    // Normals are only emitted if all vertices have them; missing texture
+    // coordinates are set to zero.
+    bool hasNormals = std::all_of(faces.begin(), faces.end(),
+                                  [](const OBJIndex &v) { return v.n != -1; });
+    bool hasUV = std::any_of(faces.begin(), faces.end(),
+                             [](const OBJIndex &v) { return v.uv != -1; });
+
+    if (ptexQuads) {
+        for (size_t i = 0; i < faces.size() / 4; ++i) {
+            faceIndices->push_back(i);
+            faceIndices->push_back(i);
+
+            int index = P->size();
+            // Triangulate
+            indices->push_back(index);
+            indices->push_back(index + 1);
+            indices->push_back(index + 2);
+
+            indices->push_back(index);
+            indices->push_back(index + 2);
+            indices->push_back(index + 3);
+
+            for (int v = 0; v < 4; ++v) {
+                const OBJIndex &vi = faces[4 * i + v];
+                P->push_back(p[vi.p]);
+                if (hasNormals)
+                    N->push_back(n[vi.n]);
+            }
 
-using namespace tinyobj;
+            // fixed texture coords over [0,1]
+            st->push_back({0.f, 0.f});
+            st->push_back({1.f, 0.f});
+            st->push_back({1.f, 1.f});
+            st->push_back({0.f, 1.f});
+        }
+        return;
+    }
 
-static void usage() {
-    fprintf(stderr, "usage: obj2pbrt [--ptexquads] <OBJ filename> <pbrt filename>\n");
-    exit(1);
+    // Compute vertex indices remapped to start from zero for this slice of
+    // the mesh, with a vertex for each distinct OBJ index triple.
+    std::unordered_map<OBJIndex, int, OBJIndexHash> indexRemap;
+    indices->reserve(faces.size());
+    for (const OBJIndex &v : faces) {
+        auto result = indexRemap.insert(std::make_pair(v, int(P->size())));
+        if (result.second) {
+            // First time we've seen this index.
+            P->push_back(p[v.p]);
+            if (hasNormals)
+                N->push_back(n[v.n]);
+            if (hasUV)
+                st->push_back(v.uv != -1 ? uv[v.uv] : Point2f(0, 0));
+        }
+        indices->push_back(result.first->second);
+    }
 }
 
 int main(int argc, char *argv[]) {
@@ -1325,294 +1255,85 @@ int main(int argc, char *argv[]) {
     if (pbrtFilename == nullptr)
         usage();
 
-    std::vector<shape_t> shapes;
-    std::vector<material_t> materials;
-    std::string err;
-    if (!LoadObj(shapes, materials, err, objFilename,
-                 /* mtl_basepath */ nullptr,
-                 ptexQuads ? 0 : load_flags_t(triangulation))) {
-        fprintf(stderr, "%s: errors loading OBJ file: %s\n", objFilename, err.c_str());
+    InitPBRT({});
+
+    FILE *objFile = fopen(objFilename, "rb");
+    if (objFile == nullptr) {
+        perror(objFilename);
         return 1;
     }
+    // Material libraries are found relative to the OBJ file.
+    SetSearchDirectory(objFilename);
 
-    FILE *f = (strcmp(pbrtFilename, "-") == 0) ? stdout : fopen(pbrtFilename, "w");
+    bool toStdout = (strcmp(pbrtFilename, "-") == 0);
+    FILE *f = toStdout ? stdout : fopen(pbrtFilename, "w");
     if (f == nullptr) {
         perror(pbrtFilename);
         return 1;
     }
 
-    float bounds[2][3] = {{1e30, 1e30, 1e30}, {-1e30, -1e30, -1e30}};
-    for (size_t i = 0; i < shapes.size(); ++i) {
-        const shape_t &shape = shapes[i];
-        const mesh_t &mesh = shape.mesh;
-        for (size_t i = 0; i < mesh.positions.size(); ++i) {
-            int c = i % 3;
-            bounds[0][c] = std::min(bounds[0][c], mesh.positions[i]);
-            bounds[1][c] = std::max(bounds[1][c], mesh.positions[i]);
-        }
+    // PLY files are written next to the pbrt file and named after it unless
+    // PLY_PREFIX is set.
+    std::string plyPrefix, plyReferencePrefix;
+    if (getenv("PLY_PREFIX") != nullptr)
+        plyPrefix = plyReferencePrefix = getenv("PLY_PREFIX");
+    else if (toStdout)
+        plyPrefix = plyReferencePrefix = "mesh";
+    else {
+        plyPrefix = RemoveExtension(pbrtFilename);
+        size_t slash = plyPrefix.find_last_of("/\\");
+        plyReferencePrefix =
+            (slash == std::string::npos) ? plyPrefix : plyPrefix.substr(slash + 1);
     }
-    fprintf(f, "# Converted from \"%s\" by obj2pbrt\n", objFilename);
-    fprintf(f, "# Scene bounds: (%f, %f, %f) - (%f, %f, %f)\n\n\n", bounds[0][0],
-            bounds[0][1], bounds[0][2], bounds[1][0], bounds[1][1], bounds[1][2]);
-
-    int numAreaLights = 0;
-    int numTriangles = 0;
-    int numMeshes = shapes.size();
-
-    // First, make named materials for all of the materials.
-    for (const material_t &mtl : materials) {
-        bool hasDiffuseTex = (!mtl.diffuse_texname.empty());
-        if (!mtl.diffuse_texname.empty()) {
-            if (mtl.diffuse[0] != 0 || mtl.diffuse[1] != 0 || mtl.diffuse[2] != 0) {
-                fprintf(f,
-                        "Texture \"%s-kd-img\" \"spectrum\" \"imagemap\" "
-                        "\"string imagefile\" [\"%s\"]\n",
-                        mtl.name.c_str(), mtl.diffuse_texname.c_str());
-                float scale = (mtl.diffuse[0] + mtl.diffuse[1] + mtl.diffuse[2]) / 3;
-                if (mtl.diffuse[0] != mtl.diffuse[1] || mtl.diffuse[1] != mtl.diffuse[2])
-                    fprintf(stderr,
-                            "Averaging non-constant RGB scale for \"%s\" (%f "
-                            "%f %f).\n",
-                            mtl.name.c_str(), mtl.diffuse[0], mtl.diffuse[1],
-                            mtl.diffuse[2]);
-                fprintf(f,
-                        "Texture \"%s-kd\" \"spectrum\" \"scale\" \"texture tex\" "
-                        "\"%s-kd-img\" \"float scale\" [%f]\n",
-                        mtl.name.c_str(), mtl.name.c_str(), scale);
-            } else {
-                fprintf(f,
-                        "Texture \"%s-kd\" \"spectrum\" \"imagemap\" "
-                        "\"string imagefile\" [\"%s\"]\n",
-                        mtl.name.c_str(), mtl.diffuse_texname.c_str());
-            }
-        }
 
-        bool hasSpecularTex = (!mtl.specular_texname.empty());
-        if (!mtl.specular_texname.empty()) {
-            if (mtl.specular[0] != 0 || mtl.specular[1] != 0 || mtl.specular[2] != 0) {
-                fprintf(f,
-                        "Texture \"%s-ks-img\" \"spectrum\" \"imagemap\" "
-                        "\"string imagefile\" [\"%s\"]\n",
-                        mtl.name.c_str(), mtl.specular_texname.c_str());
-                float scale = (mtl.specular[0] + mtl.specular[1] + mtl.specular[2]) / 3;
-                if (mtl.specular[0] != mtl.specular[1] ||
-                    mtl.specular[1] != mtl.specular[2])
-                    fprintf(stderr,
-                            "Averaging non-constant RGB scale for \"%s\" (%f "
-                            "%f %f).\n",
-                            mtl.name.c_str(), mtl.specular[0], mtl.specular[1],
-                            mtl.specular[2]);
-                fprintf(f,
-                        "Texture \"%s-ks\" \"spectrum\" \"scale\" \"texture tex\" "
-                        "\"%s-ks-img\" \"float scale\" [%f]\n",
-                        mtl.name.c_str(), mtl.name.c_str(), scale);
-            } else {
-                fprintf(f,
-                        "Texture \"%s-ks\" \"spectrum\" \"imagemap\" "
-                        "\"string imagefile\" [\"%s\"]\n",
-                        mtl.name.c_str(), mtl.specular_texname.c_str());
+    fprintf(f, "# Converted from \"%s\" by obj2pbrt\n\n\n", objFilename);
+
+    // Process the file a block at a time; the partial line at the end of
+    // each block is carried over to the next one.
+    OBJConverter converter(f, plyPrefix, plyReferencePrefix, ptexQuads);
+    std::vector<char> buffer(OBJBlockSize);
+    size_t nCarried = 0;
+    while (true) {
+        size_t nRead = fread(buffer.data() + nCarried, 1, buffer.size() - nCarried,
+                             objFile);
+        size_t size = nCarried + nRead;
+        bool atEnd = (size < buffer.size());
+        size_t parseEnd = size;
+        if (!atEnd) {
+            while (parseEnd > 0 && buffer[parseEnd - 1] != '\n')
+                --parseEnd;
+            if (parseEnd == 0) {
+                // The buffer doesn't hold a complete line; grow it.
+                nCarried = size;
+                buffer.resize(2 * buffer.size());
+                continue;
             }
         }
 
-        if (!mtl.bump_texname.empty()) {
-            fprintf(f,
-                    "Texture \"%s-bump\" \"float\" \"imagemap\" "
-                    "\"string imagefile\" [\"%s\"]\n",
-                    mtl.name.c_str(), mtl.bump_texname.c_str());
-        }
-
-        float roughness = (mtl.shininess == 0) ? 0. : (1.f / mtl.shininess);
-        fprintf(f, R"(MakeNamedMaterial "%s" "string type" "uber" )", mtl.name.c_str());
+        converter.ProcessBlock(buffer.data(), buffer.data() + parseEnd);
 
-        if (hasDiffuseTex)
-            fprintf(f, R"("texture reflectance" "%s-kd" )", mtl.name.c_str());
-        else
-            fprintf(f, "\"rgb reflectance\" [%f %f %f] ", mtl.diffuse[0], mtl.diffuse[1],
-                    mtl.diffuse[2]);
-        if (hasSpecularTex)
-            fprintf(f, R"("texture Ks" "%s-ks" )", mtl.name.c_str());
-        else
-            fprintf(f, "\"rgb Ks\" [%f %f %f] ", mtl.specular[0], mtl.specular[1],
-                    mtl.specular[2]);
-        if (mtl.dissolve < 1)
-            fprintf(stderr, "Warning: ignoring opacity for \"%s\" material/\n",
-                    mtl.name.c_str());
-        fprintf(f,
-                "\"float roughness\" [%f] "
-                "\"rgb Kt\" [%f %f %f] \"float eta\" [%f] ",
-                roughness, mtl.transmittance[0], mtl.transmittance[1],
-                mtl.transmittance[2], mtl.ior);
-        if (!mtl.bump_texname.empty())
-            fprintf(f, R"("texture displacement" "%s-bump" )", mtl.name.c_str());
-        fprintf(f, "\n\n");
+        if (atEnd)
+            break;
+        nCarried = size - parseEnd;
+        memmove(buffer.data(), buffer.data() + parseEnd, nCarried);
     }
+    if (ferror(objFile)) {
+        perror(objFilename);
+        return 1;
+    }
+    fclose(objFile);
 
-    for (const shape_t &shape : shapes) {
-        const mesh_t &mesh = shape.mesh;
-
-        fprintf(f, "AttributeBegin\n");
-        if (!shape.name.empty())
-            fprintf(f, "Attribute \"shape\" \"string name\" \"%s\"\n",
-                    shape.name.c_str());
-
-        // Get the set of material ids used for faces in this mesh.
-        std::set<int> materialIds;
-        for (int id : mesh.material_ids)
-            materialIds.insert(id);
-
-        // Now emit the chunks of the mesh for each material
-        for (int id : materialIds) {
-            if (id == -1) {
-                fprintf(f, "# Material unspecified in OBJ file\n");
-            } else {
-                const material_t &mtl = materials[id];
-
-                std::map<std::string, std::string>::const_iterator iter;
-                for (iter = mtl.unknown_parameter.begin();
-                     iter != mtl.unknown_parameter.end(); ++iter)
-                    fprintf(stderr, "Unknown parameter: %s = %s\n", iter->first.c_str(),
-                            iter->second.c_str());
-
-                if (mtl.emission[0] > 0 || mtl.emission[1] > 0 || mtl.emission[2] > 0) {
-                    fprintf(f, "AreaLightSource \"area\" \"rgb L\" [ %f %f %f ]\n",
-                            mtl.emission[0], mtl.emission[1], mtl.emission[2]);
-                    ++numAreaLights;
-                }
-
-                fprintf(f, "NamedMaterial \"%s\"\n", mtl.name.c_str());
-            }
-
-            // Now emit all the faces that have the matching material id.
-            struct Point3f {
-                float x, y, z;
-            };
-            struct Point2f {
-                float x, y;
-            };
-            struct Normal3f {
-                float x, y, z;
-            };
-            std::vector<Point3f> P;
-            std::vector<Normal3f> N;
-            std::vector<Point2f> st;
-            std::vector<int> indices, faceIndices;
-            std::map<int, int> indexRemap;
-            int nQuadFaces = 0;
-
-            // Loop over all of the triangles' material ids.
-            for (size_t i = 0; i < mesh.material_ids.size(); ++i) {
-                // Skip the ones that don't match the current id that we're
-                // emitting the mesh for.
-                if (mesh.material_ids[i] != id)
-                    continue;
-
-                if (ptexQuads) {
-                    if (mesh.num_vertices[i] != 4) {
-                        // We assume all quads when indexing into the indices
-                        // array
-                        fprintf(stderr, "%d: Mesh has a non quad face.. Sorry.\n",
-                                mesh.num_vertices[i]);
-                        exit(1);
-                    }
-
-                    faceIndices.push_back(nQuadFaces);
-                    faceIndices.push_back(nQuadFaces);
-
-                    int index = P.size();
-                    // Triangulate
-                    indices.push_back(index);
-                    indices.push_back(index + 1);
-                    indices.push_back(index + 2);
-
-                    indices.push_back(index);
-                    indices.push_back(index + 2);
-                    indices.push_back(index + 3);
-
-                    for (int v = 0; v < 4; ++v) {
-                        int vi = mesh.indices[4 * i + v];
-                        P.push_back({mesh.positions[3 * vi], mesh.positions[3 * vi + 1],
-                                     mesh.positions[3 * vi + 2]});
-                        if (!mesh.normals.empty())
-                            N.push_back({mesh.normals[3 * vi], mesh.normals[3 * vi + 1],
-                                         mesh.normals[3 * vi + 2]});
-                    }
-
-                    // fixed texture coords over [0,1]
-                    st.push_back({0.f, 0.f});
-                    st.push_back({1.f, 0.f});
-                    st.push_back({1.f, 1.f});
-                    st.push_back({0.f, 1.f});
-                    ++nQuadFaces;
-                    numTriangles += 2;
-                } else {
-                    if (mesh.num_vertices[i] != 3) {
-                        // These should have been triangulated by tinyobj.
-                        fprintf(stderr, "Mesh has a non-triangular face. Sorry.\n");
-                        exit(1);
-                    }
-
-                    // Compute remapped vertex indices.
-                    for (int v = 0; v < 3; ++v) {
-                        int objIndex = mesh.indices[3 * i + v];
-                        if (indexRemap.find(objIndex) == indexRemap.end()) {
-                            // First time we've seen this index.
-                            indexRemap.insert(
-                                std::make_pair(objIndex, (int)indexRemap.size()));
-
-                            P.push_back({mesh.positions[3 * objIndex],
-                                         mesh.positions[3 * objIndex + 1],
-                                         mesh.positions[3 * objIndex + 2]});
-                            if (!mesh.normals.empty())
-                                N.push_back({mesh.normals[3 * objIndex],
-                                             mesh.normals[3 * objIndex + 1],
-                                             mesh.normals[3 * objIndex + 2]});
-                            if (!mesh.texcoords.empty())
-                                st.push_back({mesh.texcoords[2 * objIndex],
-                                              mesh.texcoords[2 * objIndex + 1]});
-                        }
-
-                        // In any case emit the index (but remapped
-                        // starting from zero for this slice of the mesh).
-                        indices.push_back(indexRemap[objIndex]);
-                    }
-                    ++numTriangles;
-                }
-            }
+    converter.Finish();
 
-            fprintf(f, "Shape \"trianglemesh\"\n");
-            fprintf(f, "  \"point3 P\" [ \n");
-            for (Point3f p : P)
-                fprintf(f, "\t%.10g %.10g %.10g\n", p.x, p.y, p.z);
-            fprintf(f, "]\n");
-            if (!N.empty()) {
-                fprintf(f, "  \"normal N\" [ \n");
-                for (Normal3f n : N)
-                    fprintf(f, "\t%.10g %.10g %.10g\n", n.x, n.y, n.z);
-                fprintf(f, "]\n");
-            }
-            if (!st.empty()) {
-                fprintf(f, "  \"point2 uv\" [ \n");
-                for (Point2f tex : st)
-                    fprintf(f, "\t%.10g %.10g\n", tex.x, tex.y);
-                fprintf(f, "]\n");
-            }
-            fprintf(f, "  \"integer indices\" [ \n\t");
-            for (size_t i = 0; i < indices.size(); ++i)
-                fprintf(f, "%d%s", indices[i], (i % 3) == 2 ? "\n\t" : " ");
-            if (!faceIndices.empty()) {
-                fprintf(f, "]\n  \"integer faceIndices\" [\n");
-                for (int i : faceIndices)
-                    fprintf(f, "\t%d\n", i);
-            }
-            fprintf(f, "]\n\n");
-        }
-        fprintf(f, "AttributeEnd\n\n\n");
-    }
+    const float(&bounds)[2][3] = converter.bounds;
+    fprintf(f, "# Scene bounds: (%f, %f, %f) - (%f, %f, %f)\n", bounds[0][0],
+            bounds[0][1], bounds[0][2], bounds[1][0], bounds[1][1], bounds[1][2]);
     if (f != stdout)
         fclose(f);
 
-    fprintf(stderr, "Converted %d meshes (%d triangles, %d mesh emitters).\n", numMeshes,
-            numTriangles, numAreaLights);
+    fprintf(stderr, "Converted %d meshes (%d triangles, %d mesh emitters).\n",
+            converter.numMeshes, converter.numTriangles, converter.numAreaLights);
 
+    CleanupPBRT();
     return 0;
 }
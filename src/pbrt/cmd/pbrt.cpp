@@ -92,6 +92,8 @@ static void usage(const std::string &msg = {}) {
             R"(usage: pbrt [<options>] <filename.pbrt...>
 
 Rendering options:
+  --compress-textures          Store image textures in block-compressed formats to
+                               reduce their memory use.
   --cropwindow <x0,x1,y0,y1>   Specify an image crop window w.r.t. [0,1]^2
   --debugstart <values>        Inform the Integrator where to start rendering for
                                faster debugging. (<values> are Integrator-specific
@@ -100,6 +102,9 @@ Rendering options:
   --disable-wavelength-jitter  Always sample the same %d wavelengths of light.
   --display-server <addr:port> Connect to display server at given address and port
                                to display the image as it's being rendered.
+  --display-shared-memory      Send images to a display server on this host through
+                               shared memory. The server must support pbrt's shared
+                               framebuffer messages; tev does not.
   --force-diffuse              Convert all materials to be diffuse.)"
 #ifdef PBRT_BUILD_GPU_RENDERER
             R"(
@@ -114,16 +119,34 @@ Rendering options:
   --outfile <filename>         Write the final image to the given filename.
   --pixel <x,y>                Render just the specified pixel.
   --pixelbounds <x0,x1,y0,y1>  Specify an image crop window w.r.t. pixel coordinates.
+  --pixelcost                  Record the time, rays, and BVH nodes visited to render
+                               each pixel and write them as additional image channels.
   --pixelstats                 Record per-pixel statistics and write additional images
                                with their values.
+  --preview                    Render and write 1/8 and 1/4 resolution previews of
+                               the image before rendering it at full resolution.
   --quick                      Automatically reduce a number of quality settings
                                to render more quickly.
   --quiet                      Suppress all text output other than error messages.
   --render-coord-sys <name>    Coordinate system to use for the scene when rendering,
                                where name is "camera", "cameraworld", or "world".
   --seed <n>                   Set random number generator seed. Default: 0.
+  --serve <address>            Create the scene once and then render the views that
+                               are requested on the Unix domain socket at <address>,
+                               or on standard input if <address> is "-". Each request
+                               is a line with --outfile and optionally --spp, --seed,
+                               --cropwindow, --pixelbounds, and either --lookat with
+                               nine comma-separated values or --camera-matrix with
+                               a row-major world-from-camera matrix.
   --spp <n>                    Override number of pixel samples specified in scene
                                description file.
+  --texture-cache <MB>         Load image texture tiles on demand, keeping at most
+                               the given number of megabytes of them in memory.
+  --wave-seconds <s>           Target time for rendering each wave of pixel samples.
+                               Default: 1.
+  --write-interval <s>         Minimum time between writes of the image while it is
+                               being rendered; 0 writes it after every wave.
+                               Default: 60.
   --camerafile <filename>      Given a file of multiple camera transforms.
 
 Logging options:
@@ -158,6 +181,7 @@ int main(int argc, char *argv[]) {
     std::string logLevel = "error";
     std::string renderCoordSys = "cameraworld";
     bool format = false, toPly = false;
+    std::string serveAddress;
 
     // Process command-line arguments
     ++argv;
@@ -201,12 +225,15 @@ int main(int argc, char *argv[]) {
             ParseArg(&argv, "gpu", &options.useGPU, onError) ||
             ParseArg(&argv, "gpu-device", &options.gpuDevice, onError) ||
 #endif
+            ParseArg(&argv, "compress-textures", &options.compressTextures, onError) ||
             ParseArg(&argv, "debugstart", &options.debugStart, onError) ||
             ParseArg(&argv, "disable-pixel-jitter", &options.disablePixelJitter,
                      onError) ||
             ParseArg(&argv, "disable-wavelength-jitter", &options.disableWavelengthJitter,
                      onError) ||
             ParseArg(&argv, "display-server", &options.displayServer, onError) ||
+            ParseArg(&argv, "display-shared-memory", &options.displaySharedMemory,
+                     onError) ||
             ParseArg(&argv, "force-diffuse", &options.forceDiffuse, onError) ||
             ParseArg(&argv, "format", &format, onError) ||
             ParseArg(&argv, "log-level", &logLevel, onError) ||
@@ -215,14 +242,20 @@ int main(int argc, char *argv[]) {
             ParseArg(&argv, "nthreads", &options.nThreads, onError) ||
             ParseArg(&argv, "outfile", &options.imageFile, onError) ||
             ParseArg(&argv, "camerafile", &options.cameraFile, onError) ||
+            ParseArg(&argv, "pixelcost", &options.recordPixelCost, onError) ||
             ParseArg(&argv, "pixelstats", &options.recordPixelStatistics, onError) ||
+            ParseArg(&argv, "preview", &options.renderPreview, onError) ||
             ParseArg(&argv, "quick", &options.quickRender, onError) ||
             ParseArg(&argv, "quiet", &options.quiet, onError) ||
             ParseArg(&argv, "render-coord-sys", &renderCoordSys, onError) ||
             ParseArg(&argv, "seed", &options.seed, onError) ||
+            ParseArg(&argv, "serve", &serveAddress, onError) ||
             ParseArg(&argv, "spp", &options.pixelSamples, onError) ||
+            ParseArg(&argv, "texture-cache", &options.textureCacheMB, onError) ||
             ParseArg(&argv, "toply", &toPly, onError) ||
-            ParseArg(&argv, "upgrade", &options.upgrade, onError)) {
+            ParseArg(&argv, "upgrade", &options.upgrade, onError) ||
+            ParseArg(&argv, "wave-seconds", &options.waveSeconds, onError) ||
+            ParseArg(&argv, "write-interval", &options.writeIntervalSeconds, onError)) {
             // success
         } else if ((strcmp(*argv, "--help") == 0) || (strcmp(*argv, "-help") == 0) ||
                    (strcmp(*argv, "-h") == 0)) {
@@ -234,8 +267,9 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // Print welcome banner
-    if (!options.quiet && !format && !toPly && !options.upgrade) {
+    // Print welcome banner; when serving on standard input, standard
+    // output only carries the replies to requests.
+    if (!options.quiet && !format && !toPly && !options.upgrade && serveAddress != "-") {
         printf("pbrt version 4 (built %s at %s)\n", __DATE__, __TIME__);
 #ifndef NDEBUG
         LOG_VERBOSE("Running debug build");
@@ -264,6 +298,17 @@ int main(int argc, char *argv[]) {
     if (!options.mseReferenceOutput.empty() && options.mseReferenceImage.empty())
         ErrorExit("Must provide MSE reference image via --mse-reference-image");
 
+    // The scene would otherwise be read from standard input, which then
+    // carries the requests.
+    if (serveAddress == "-" && filenames.empty())
+        ErrorExit("Scene files must be given on the command line with --serve -.");
+
+    if (options.waveSeconds <= 0)
+        ErrorExit("%f: --wave-seconds must be positive.", options.waveSeconds);
+    if (options.writeIntervalSeconds < 0)
+        ErrorExit("%f: --write-interval must not be negative.",
+                  options.writeIntervalSeconds);
+
     options.logLevel = LogLevelFromString(logLevel);
 
     // Initialize pbrt
@@ -279,7 +324,11 @@ int main(int argc, char *argv[]) {
         
 
         // Render the scene
-        if(options.cameraFile.empty()) {
+        if (!serveAddress.empty()) {
+            if (options.useGPU)
+                ErrorExit("--serve is not supported with GPU rendering.");
+            CPURenderServer(scene, serveAddress);
+        } else if(options.cameraFile.empty()) {
             if (options.useGPU)
                 GPURender(scene);
             else
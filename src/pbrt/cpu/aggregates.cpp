@@ -581,6 +581,7 @@ pstd::optional<ShapeIntersection> BVHAggregate::Intersect(const Ray &ray,
     }
 
     bvhNodesVisited += nodesVisited;
+    threadPixelCost.bvhNodesVisited += nodesVisited;
     return si;
 }
 
@@ -603,6 +604,7 @@ bool BVHAggregate::IntersectP(const Ray &ray, Float tMax) const {
                 for (int i = 0; i < node->nPrimitives; ++i) {
                     if (primitives[node->primitivesOffset + i].IntersectP(ray, tMax)) {
                         bvhNodesVisited += nodesVisited;
+                        threadPixelCost.bvhNodesVisited += nodesVisited;
                         return true;
                     }
                 }
@@ -626,6 +628,7 @@ bool BVHAggregate::IntersectP(const Ray &ray, Float tMax) const {
         }
     }
     bvhNodesVisited += nodesVisited;
+    threadPixelCost.bvhNodesVisited += nodesVisited;
     return false;
 }
 
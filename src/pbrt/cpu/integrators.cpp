@@ -38,6 +38,10 @@
 #include <pbrt/util/stats.h>
 #include <pbrt/util/string.h>
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+
 namespace pbrt {
 
 STAT_COUNTER("Integrator/Camera rays traced", nCameraRays);
@@ -109,6 +113,53 @@ SampledSpectrum RandomWalkIntegrator::LiRandomWalk(RayDifferential ray,
 // Integrator Method Definitions
 Integrator::~Integrator() {}
 
+// PixelCost Definition
+// Totals of the work done to render a pixel's samples, recorded with
+// --pixelcost.
+struct PixelCost {
+    double ms = 0;
+    int64_t samples = 0, closestHitRays = 0, shadowRays = 0, bvhNodesVisited = 0;
+};
+
+// Write the film's image with additional channels that give each pixel's
+// render cost; they are written to a separate EXR if the image format
+// can't store them.
+static void WriteImageWithPixelCost(FilmHandle film, ImageMetadata metadata,
+                                    Float splatScale, const Array2D<PixelCost> &cost) {
+    Image image = film.GetImage(&metadata, splatScale);
+    std::string filename = film.GetFilename();
+    std::vector<std::string> channelNames;
+    if (HasExtension(filename, "exr"))
+        channelNames = image.ChannelNames();
+    else {
+        image.Write(filename, metadata);
+        filename = RemoveExtension(filename) + "-cost.exr";
+    }
+    int nImageChannels = channelNames.size();
+    for (const char *name : {"Cost.ms", "Cost.rays", "Cost.bvhNodes", "Cost.pathDepth"})
+        channelNames.push_back(name);
+
+    Image result(PixelFormat::Float, image.Resolution(), channelNames);
+    Bounds2i pixelBounds = film.PixelBounds();
+    ParallelFor(0, image.Resolution().y, [&](int64_t y0, int64_t y1) {
+        for (int y = y0; y < y1; ++y)
+            for (int x = 0; x < image.Resolution().x; ++x) {
+                for (int c = 0; c < nImageChannels; ++c)
+                    result.SetChannel({x, y}, c, image.GetChannel({x, y}, c));
+                // Path depth is measured as closest-hit rays per sample
+                const PixelCost &pc = cost[pixelBounds.pMin + Vector2i(x, y)];
+                int c = nImageChannels;
+                result.SetChannel({x, y}, c++, pc.ms);
+                result.SetChannel({x, y}, c++, pc.closestHitRays + pc.shadowRays);
+                result.SetChannel({x, y}, c++, pc.bvhNodesVisited);
+                result.SetChannel({x, y}, c++,
+                                  pc.samples > 0 ? Float(pc.closestHitRays) / pc.samples
+                                                 : 0);
+            }
+    });
+    result.Write(filename, metadata);
+}
+
 // ImageTileIntegrator Method Definitions
 void ImageTileIntegrator::Render() {
     // Handle debugStart, if set
@@ -154,7 +205,113 @@ void ImageTileIntegrator::Render() {
     ProgressReporter progress(int64_t(spp) * pixelBounds.Area(), "Rendering",
                               Options->quiet);
 
-    int waveStart = 0, waveEnd = 1, nextWaveSize = 1;
+    // Allocate storage for per-pixel render costs, if requested; each pixel
+    // is only rendered by one thread at a time, so no locking is needed.
+    Array2D<PixelCost> pixelCost;
+    if (Options->recordPixelCost)
+        pixelCost = Array2D<PixelCost>(pixelBounds);
+
+    // The low-resolution previews render the first sample of the pixels
+    // whose offsets from the image origin are multiples of _previewStride_;
+    // it is zero if there were no previews.
+    int previewStride = 0;
+    auto isPreviewPixel = [&](Point2i pPixel, int stride) {
+        Vector2i offset = pPixel - pixelBounds.pMin;
+        return stride > 0 && offset.x % stride == 0 && offset.y % stride == 0;
+    };
+
+    // Render the given range of sample indices in pixel _pPixel_
+    auto renderPixel = [&](Point2i pPixel, int waveStart, int waveEnd) {
+        ScratchBuffer &scratchBuffer = scratchBuffers[ThreadIndex];
+        SamplerHandle &sampler = samplers[ThreadIndex];
+        StatsReportPixelStart(pPixel);
+        threadPixel = pPixel;
+        PixelCostCounters startCounters = threadPixelCost;
+        std::chrono::steady_clock::time_point startTime;
+        if (Options->recordPixelCost)
+            startTime = std::chrono::steady_clock::now();
+
+        for (int sampleIndex = waveStart; sampleIndex < waveEnd; ++sampleIndex) {
+            threadSampleIndex = sampleIndex;
+            sampler.StartPixelSample(pPixel, sampleIndex);
+            EvaluatePixelSample(pPixel, sampleIndex, sampler, scratchBuffer);
+            scratchBuffer.Reset();
+        }
+
+        if (Options->recordPixelCost) {
+            // Add the work done for _pPixel_ to its cost
+            PixelCost &cost = pixelCost[pPixel];
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - startTime;
+            cost.ms += elapsed.count();
+            cost.samples += waveEnd - waveStart;
+            cost.closestHitRays +=
+                threadPixelCost.closestHitRays - startCounters.closestHitRays;
+            cost.shadowRays += threadPixelCost.shadowRays - startCounters.shadowRays;
+            cost.bvhNodesVisited +=
+                threadPixelCost.bvhNodesVisited - startCounters.bvhNodesVisited;
+        }
+        StatsReportPixelEnd(pPixel);
+    };
+
+    // Render image tiles in the given range of sample indices
+    auto renderTile = [&](Bounds2i tileBounds, int waveStart, int waveEnd) {
+        PBRT_DBG("Starting image tile (%d,%d)-(%d,%d) waveStart %d, waveEnd %d\n",
+                 tileBounds.pMin.x, tileBounds.pMin.y, tileBounds.pMax.x,
+                 tileBounds.pMax.y, waveStart, waveEnd);
+        for (Point2i pPixel : tileBounds) {
+            // Skip the first sample if a preview already rendered it
+            if (waveStart == 0 && isPreviewPixel(pPixel, previewStride))
+                renderPixel(pPixel, 1, waveEnd);
+            else
+                renderPixel(pPixel, waveStart, waveEnd);
+        }
+        PBRT_DBG("Finished image tile (%d,%d)-(%d,%d)\n", tileBounds.pMin.x,
+                 tileBounds.pMin.y, tileBounds.pMax.x, tileBounds.pMax.y);
+        progress.Update((waveEnd - waveStart) * tileBounds.Area());
+    };
+
+    // Render tile-major if the film streams its tiles to disk
+    RGBFilm *streamingFilm = camera.GetFilm().CastOrNullptr<RGBFilm>();
+    if (streamingFilm && streamingFilm->StreamTileSize() > 0) {
+        if (!Options->mseReferenceImage.empty())
+            ErrorExit("MSE reference images can't be used with films that stream tiles.");
+        if (Options->recordPixelCost)
+            ErrorExit("--pixelcost can't be used with films that stream tiles.");
+        if (!Options->displayServer.empty())
+            Warning("Images aren't sent to the display server when the film "
+                    "streams tiles.");
+        if (Options->renderPreview)
+            Warning("Previews aren't rendered when the film streams tiles.");
+        if (Options->recordPixelStatistics)
+            StatsEnablePixelStats(pixelBounds,
+                                  RemoveExtension(camera.GetFilm().GetFilename()));
+
+        // Render each tile with all of its samples, then write it to disk
+        ImageMetadata metadata;
+        metadata.samplesPerPixel = spp;
+        camera.InitMetadata(&metadata);
+        streamingFilm->BeginTileStream(metadata);
+        int tileSize = streamingFilm->StreamTileSize();
+        Vector2i nTiles((pixelBounds.Diagonal().x + tileSize - 1) / tileSize,
+                        (pixelBounds.Diagonal().y + tileSize - 1) / tileSize);
+        ParallelFor(0, nTiles.x * nTiles.y, [&](int64_t tile) {
+            Point2i pMin(pixelBounds.pMin.x + (tile % nTiles.x) * tileSize,
+                         pixelBounds.pMin.y + (tile / nTiles.x) * tileSize);
+            Bounds2i tileBounds = pbrt::Intersect(
+                Bounds2i(pMin, pMin + Vector2i(tileSize, tileSize)), pixelBounds);
+            streamingFilm->BeginTile(tileBounds);
+            renderTile(tileBounds, 0, spp);
+            streamingFilm->EndTile(tileBounds, 1.f / spp);
+        });
+        streamingFilm->EndTileStream();
+
+        progress.Done();
+        LOG_VERBOSE("Rendering finished");
+        return;
+    }
+
+    int waveStart = 0, waveEnd = 1;
 
     if (Options->recordPixelStatistics)
         StatsEnablePixelStats(pixelBounds,
@@ -190,15 +347,23 @@ void ImageTileIntegrator::Render() {
             ErrorExit("%s: %s", Options->mseReferenceOutput, ErrorString());
     }
 
+    // Until the first full-resolution wave is done, each block of
+    // _displayStride_ x _displayStride_ pixels shows its preview pixel.
+    std::shared_ptr<std::atomic<int>> displayStride =
+        std::make_shared<std::atomic<int>>(1);
+
     // Connect to display server if needed
     if (!Options->displayServer.empty()) {
         FilmHandle film = camera.GetFilm();
         DisplayDynamic(film.GetFilename(), Point2i(pixelBounds.Diagonal()),
                        {"R", "G", "B"},
                        [=](Bounds2i b, pstd::span<pstd::span<Float>> displayValue) {
+                           int stride = *displayStride;
                            int index = 0;
                            for (Point2i p : b) {
-                               RGB rgb = film.GetPixelRGB(pixelBounds.pMin + p);
+                               Point2i pBlock(p.x / stride * stride,
+                                              p.y / stride * stride);
+                               RGB rgb = film.GetPixelRGB(pixelBounds.pMin + pBlock);
                                for (int c = 0; c < 3; ++c)
                                    displayValue[c][index] = rgb[c];
                                ++index;
@@ -206,42 +371,72 @@ void ImageTileIntegrator::Render() {
                        });
     }
 
+    // Render low-resolution previews, if requested
+    if (Options->renderPreview) {
+        for (int stride : {8, 4}) {
+            // Render the first sample of one pixel in each _stride_ x _stride_
+            // block; the full-resolution waves then skip those samples.
+            Bounds2i blocks(Point2i(0, 0),
+                            Point2i((pixelBounds.Diagonal().x + stride - 1) / stride,
+                                    (pixelBounds.Diagonal().y + stride - 1) / stride));
+            ParallelFor2D(blocks, [&](Bounds2i b) {
+                for (Point2i pBlock : b) {
+                    Point2i pPixel = pixelBounds.pMin + Vector2i(pBlock * stride);
+                    if (!isPreviewPixel(pPixel, previewStride))
+                        renderPixel(pPixel, 0, 1);
+                }
+            });
+            camera.GetFilm().FlushSplats();
+            previewStride = stride;
+            *displayStride = stride;
+
+            // Write the preview with each block set to its rendered pixel
+            LOG_VERBOSE("Writing 1/%d resolution preview", stride);
+            ImageMetadata metadata;
+            metadata.renderTimeSeconds = progress.ElapsedSeconds();
+            metadata.samplesPerPixel = 1;
+            camera.InitMetadata(&metadata);
+            Image image = camera.GetFilm().GetImage(&metadata, 1.f);
+            Image preview(image.Format(), image.Resolution(), image.ChannelNames());
+            ParallelFor(0, image.Resolution().y, [&](int64_t y0, int64_t y1) {
+                for (int y = y0; y < y1; ++y)
+                    for (int x = 0; x < image.Resolution().x; ++x) {
+                        Point2i pBlock(x / stride * stride, y / stride * stride);
+                        for (int c = 0; c < image.NChannels(); ++c)
+                            preview.SetChannel({x, y}, c, image.GetChannel(pBlock, c));
+                    }
+            });
+            preview.Write(camera.GetFilm().GetFilename(), metadata);
+        }
+    }
+
     // Render image in waves
+    Timer lastWriteTimer;
     while (waveStart < spp) {
         // Render current wave's image tiles in parallel
+        Timer waveTimer;
         ParallelFor2D(pixelBounds, [&](Bounds2i tileBounds) {
-            // Render image tile given by _tileBounds_
-            ScratchBuffer &scratchBuffer = scratchBuffers[ThreadIndex];
-            SamplerHandle &sampler = samplers[ThreadIndex];
-            PBRT_DBG("Starting image tile (%d,%d)-(%d,%d) waveStart %d, waveEnd %d\n",
-                     tileBounds.pMin.x, tileBounds.pMin.y, tileBounds.pMax.x,
-                     tileBounds.pMax.y, waveStart, waveEnd);
-            for (Point2i pPixel : tileBounds) {
-                StatsReportPixelStart(pPixel);
-                threadPixel = pPixel;
-                // Render samples in pixel _pPixel_
-                for (int sampleIndex = waveStart; sampleIndex < waveEnd; ++sampleIndex) {
-                    threadSampleIndex = sampleIndex;
-                    sampler.StartPixelSample(pPixel, sampleIndex);
-                    EvaluatePixelSample(pPixel, sampleIndex, sampler, scratchBuffer);
-                    scratchBuffer.Reset();
-                }
-
-                StatsReportPixelEnd(pPixel);
-            }
-            PBRT_DBG("Finished image tile (%d,%d)-(%d,%d)\n", tileBounds.pMin.x,
-                     tileBounds.pMin.y, tileBounds.pMax.x, tileBounds.pMax.y);
-            progress.Update((waveEnd - waveStart) * tileBounds.Area());
+            renderTile(tileBounds, waveStart, waveEnd);
         });
-
-        // Update start and end wave
+        // Make buffered splats visible to the display and image writes
+        camera.GetFilm().FlushSplats();
+        *displayStride = 1;
+        double waveSeconds = waveTimer.ElapsedSeconds();
+
+        // Update start and end wave; the next wave is sized to take about
+        // _Options->waveSeconds_, with its growth limited in case this
+        // wave's time was unrepresentative. MSE computation uses one-sample
+        // waves.
+        int waveSize = waveEnd - waveStart, nextWaveSize = 1;
+        if (!referenceImage) {
+            double secondsPerSample = std::max(waveSeconds, 1e-6) / waveSize;
+            nextWaveSize = std::max<double>(
+                1, std::min<double>(Options->waveSeconds / secondsPerSample,
+                                    4 * waveSize));
+        }
         waveStart = waveEnd;
         waveEnd = std::min(spp, waveEnd + nextWaveSize);
-        if (!referenceImage)
-            nextWaveSize = std::min(2 * nextWaveSize, 64);
 
-        // Write current image to disk
-        LOG_VERBOSE("Writing image with spp = %d", waveStart);
         ImageMetadata metadata;
         metadata.renderTimeSeconds = progress.ElapsedSeconds();
         metadata.samplesPerPixel = waveStart;
@@ -254,8 +449,20 @@ void ImageTileIntegrator::Render() {
             metadata.MSE = mse.Average();
             fflush(mseOutFile);
         }
+
+        // Write current image to disk if enough time has passed since the
+        // last write or rendering is finished
+        if (waveStart < spp &&
+            lastWriteTimer.ElapsedSeconds() < Options->writeIntervalSeconds)
+            continue;
+        LOG_VERBOSE("Writing image with spp = %d", waveStart);
+        lastWriteTimer = Timer();
         camera.InitMetadata(&metadata);
-        camera.GetFilm().WriteImage(metadata, 1.0f / waveStart);
+        if (Options->recordPixelCost)
+            WriteImageWithPixelCost(camera.GetFilm(), metadata, 1.0f / waveStart,
+                                    pixelCost);
+        else
+            camera.GetFilm().WriteImage(metadata, 1.0f / waveStart);
     }
 
     if (mseOutFile)
@@ -341,6 +548,7 @@ STAT_COUNTER("Intersections/Shadow ray intersection tests", nShadowTests);
 pstd::optional<ShapeIntersection> Integrator::Intersect(const Ray &ray,
                                                         Float tMax) const {
     ++nIntersectionTests;
+    ++threadPixelCost.closestHitRays;
     DCHECK_NE(ray.d, Vector3f(0, 0, 0));
     if (aggregate)
         return aggregate.Intersect(ray, tMax);
@@ -350,6 +558,7 @@ pstd::optional<ShapeIntersection> Integrator::Intersect(const Ray &ray,
 
 bool Integrator::IntersectP(const Ray &ray, Float tMax) const {
     ++nShadowTests;
+    ++threadPixelCost.shadowRays;
     DCHECK_NE(ray.d, Vector3f(0, 0, 0));
     if (aggregate)
         return aggregate.IntersectP(ray, tMax);
@@ -741,24 +950,28 @@ SampledSpectrum PathIntegrator::Li(RayDifferential ray, SampledWavelengths &lamb
 
         // Initialize _visibleSurf_ at first intersection
         if (depth == 0 && visibleSurf != nullptr) {
-            // Estimate BSDF's albedo
-            constexpr int nRhoSamples = 16;
-            SampledSpectrum rho(0.f);
-            for (int i = 0; i < nRhoSamples; ++i) {
-                // Generate sample for hemispherical-directional reflectance
-                Float uc = RadicalInverse(0, i + 1);
-                Point2f u(RadicalInverse(1, i + 1), RadicalInverse(2, i + 1));
-
-                // Estimate one term of $\rho_\roman{hd}$
-                pstd::optional<BSDFSample> bs = bsdf.Sample_f(si->intr.wo, uc, u);
-                if (bs)
-                    rho += bs->f * AbsDot(bs->wi, si->intr.shading.n) / bs->pdf;
-            }
-            SampledSpectrum albedo = rho / nRhoSamples;
-            SampledSpectrum diffuse_albedo(0.);
-            Point2f roughness(0.,0.); 
-            *visibleSurf =
-                VisibleSurface(si->intr, camera.GetCameraTransform(), albedo, diffuse_albedo, roughness, lambda);
+            auto albedo = [&]() {
+                // Estimate BSDF's albedo
+                constexpr int nRhoSamples = 16;
+                SampledSpectrum rho(0.f);
+                for (int i = 0; i < nRhoSamples; ++i) {
+                    // Generate sample for hemispherical-directional reflectance
+                    Float uc = RadicalInverse(0, i + 1);
+                    Point2f u(RadicalInverse(1, i + 1), RadicalInverse(2, i + 1));
+
+                    // Estimate one term of $\rho_\roman{hd}$
+                    pstd::optional<BSDFSample> bs = bsdf.Sample_f(si->intr.wo, uc, u);
+                    if (bs)
+                        rho += bs->f * AbsDot(bs->wi, si->intr.shading.n) / bs->pdf;
+                }
+                return rho / nRhoSamples;
+            };
+            // Diffuse albedo and roughness aren't available on the CPU
+            auto diffuseAlbedo = []() { return SampledSpectrum(0.f); };
+            auto roughness = []() { return Point2f(0, 0); };
+            *visibleSurf = VisibleSurface::Create(
+                camera.GetFilm().UsedVisibleSurfaceFields(), si->intr,
+                camera.GetCameraTransform(), albedo, diffuseAlbedo, roughness);
         }
 
         // End path if maximum depth reached
@@ -3325,6 +3538,17 @@ std::unique_ptr<Integrator> Integrator::Create(
     const std::string &name, const ParameterDictionary &parameters, CameraHandle camera,
     SamplerHandle sampler, PrimitiveHandle aggregate, std::vector<LightHandle> lights,
     const RGBColorSpace *colorSpace, const FileLoc *loc) {
+    // Films that stream tiles only have storage for the tiles being
+    // rendered, so integrators that add samples elsewhere can't use them
+    if (RGBFilm *film = camera.GetFilm().CastOrNullptr<RGBFilm>();
+        film && film->StreamTileSize() > 0 &&
+        (name == "lightpath" || name == "bdpt" || name == "mlt" || name == "sppm"))
+        ErrorExit(loc, "%s: integrator can't be used with a film that streams tiles.",
+                  name);
+    if (Options->recordPixelCost && (name == "mlt" || name == "sppm"))
+        Warning(loc, "%s: integrator doesn't record per-pixel costs for --pixelcost.",
+                name);
+
     std::unique_ptr<Integrator> integrator;
 
     if (name == "path")
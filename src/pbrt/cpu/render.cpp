@@ -7,28 +7,61 @@
 #include <pbrt/cameras.h>
 #include <pbrt/cpu/aggregates.h>
 #include <pbrt/cpu/integrators.h>
+#include <pbrt/cpu/renderserver.h>
 #include <pbrt/film.h>
 #include <pbrt/filters.h>
 #include <pbrt/lights.h>
 #include <pbrt/materials.h>
 #include <pbrt/media.h>
+#include <pbrt/options.h>
 #include <pbrt/parsedscene.h>
 #include <pbrt/samplers.h>
 #include <pbrt/shapes.h>
 #include <pbrt/textures.h>
 #include <pbrt/util/colorspace.h>
+#include <pbrt/util/file.h>
+#include <pbrt/util/parallel.h>
+#include <pbrt/util/progressreporter.h>
+#include <pbrt/util/stats.h>
 
 namespace pbrt {
 
-void CPURender(ParsedScene &parsedScene) {
+STAT_TIMER("Scene/Light creation time", lightCreationTime);
+
+// CPUScene Definition
+// The parts of the scene that don't depend on the camera or the film, so
+// that they can be reused to render multiple views.
+class CPUScene {
+  public:
+    // CPUScene Public Methods
+    CPUScene(ParsedScene &parsedScene);
+
+    std::unique_ptr<Integrator> CreateIntegrator(const CameraTransform &cameraTransform,
+                                                 Allocator alloc) const;
+    void WarnAboutUnsupportedFeatures() const;
+
+    // CPUScene Public Members
+    ParsedScene &parsedScene;
+    std::map<std::string, MediumHandle> media;
+    MediumHandle cameraMedium;
+    bool haveScatteringMedia = false, haveSubsurface = false;
+    FilterHandle filter;
+    Float exposureTime;
+    NamedTextures textures;
+    std::map<std::string, MaterialHandle> namedMaterials;
+    std::vector<MaterialHandle> materials;
+    std::vector<LightHandle> lights;
+    PrimitiveHandle accel = nullptr;
+};
+
+// CPUScene Method Definitions
+CPUScene::CPUScene(ParsedScene &parsedScene) : parsedScene(parsedScene) {
     Allocator alloc;
 
     // Create media first (so have them for the camera...)
-    std::map<std::string, MediumHandle> media = parsedScene.CreateMedia(alloc);
+    media = parsedScene.CreateMedia(alloc);
 
-    bool haveScatteringMedia = false;
-    auto findMedium = [&media, &haveScatteringMedia](const std::string &s,
-                                                     const FileLoc *loc) -> MediumHandle {
+    auto findMedium = [this](const std::string &s, const FileLoc *loc) -> MediumHandle {
         if (s.empty())
             return nullptr;
 
@@ -40,46 +73,27 @@ void CPURender(ParsedScene &parsedScene) {
     };
 
     // Filter
-    FilterHandle filter =
-        FilterHandle::Create(parsedScene.filter.name, parsedScene.filter.parameters,
-                             &parsedScene.filter.loc, alloc);
+    filter = FilterHandle::Create(parsedScene.filter.name, parsedScene.filter.parameters,
+                                  &parsedScene.filter.loc, alloc);
 
-    // Film
     // It's a little ugly to poke into the camera's parameters here, but we
     // have this circular dependency that CameraHandle::Create() expects a
     // FilmHandle, yet now the film needs to know the exposure time from
     // the camera....
-    Float exposureTime = parsedScene.camera.parameters.GetOneFloat("shutterclose", 1.f) -
-                         parsedScene.camera.parameters.GetOneFloat("shutteropen", 0.f);
+    exposureTime = parsedScene.camera.parameters.GetOneFloat("shutterclose", 1.f) -
+                   parsedScene.camera.parameters.GetOneFloat("shutteropen", 0.f);
     if (exposureTime <= 0)
         ErrorExit(&parsedScene.camera.loc,
                   "The specified camera shutter times imply that the shutter "
                   "does not open.  A black image will result.");
-    FilmHandle film =
-        FilmHandle::Create(parsedScene.film.name, parsedScene.film.parameters,
-                           exposureTime, filter, &parsedScene.film.loc, alloc);
 
-    // Camera
-    MediumHandle cameraMedium =
-        findMedium(parsedScene.camera.medium, &parsedScene.camera.loc);
-    CameraHandle camera = CameraHandle::Create(
-        parsedScene.camera.name, parsedScene.camera.parameters, cameraMedium,
-        parsedScene.camera.cameraTransform, film, &parsedScene.camera.loc, alloc);
-
-    // Create _Sampler_ for rendering
-    Point2i fullImageResolution = camera.GetFilm().FullResolution();
-    SamplerHandle sampler =
-        SamplerHandle::Create(parsedScene.sampler.name, parsedScene.sampler.parameters,
-                              fullImageResolution, &parsedScene.sampler.loc, alloc);
+    cameraMedium = findMedium(parsedScene.camera.medium, &parsedScene.camera.loc);
 
     // Textures
-    NamedTextures textures = parsedScene.CreateTextures(alloc, false);
+    textures = parsedScene.CreateTextures(alloc, false);
 
     // Materials
-    std::map<std::string, MaterialHandle> namedMaterials;
-    std::vector<MaterialHandle> materials;
     parsedScene.CreateMaterials(textures, alloc, &namedMaterials, &materials);
-    bool haveSubsurface = false;
     for (const auto &mtl : parsedScene.materials)
         if (mtl.name == "subsurface")
             haveSubsurface = true;
@@ -88,20 +102,26 @@ void CPURender(ParsedScene &parsedScene) {
             haveSubsurface = true;
 
     // Lights (area lights will be done later, with shapes...)
-    std::vector<LightHandle> lights;
+    Timer lightTimer;
     std::mutex lightsMutex;
     lights.reserve(parsedScene.lights.size() + parsedScene.areaLights.size());
+    std::vector<MediumHandle> lightMedia;
     for (const auto &light : parsedScene.lights) {
-        MediumHandle outsideMedium = findMedium(light.medium, &light.loc);
+        lightMedia.push_back(findMedium(light.medium, &light.loc));
         if (light.renderFromObject.IsAnimated())
             Warning(&light.loc,
                     "Animated lights aren't supported. Using the start transform.");
-        LightHandle l = LightHandle::Create(
-            light.name, light.parameters, light.renderFromObject.startTransform,
-            parsedScene.camera.cameraTransform, outsideMedium, &light.loc, alloc);
-        // No need to hold the mutex here
-        lights.push_back(l);
     }
+    // Light creation may load image files, so create the lights in parallel
+    lights.resize(parsedScene.lights.size());
+    ParallelFor(0, parsedScene.lights.size(), [&](int64_t i) {
+        const auto &light = parsedScene.lights[i];
+        // No need to hold the mutex here
+        lights[i] = LightHandle::Create(
+            light.name, light.parameters, light.renderFromObject.startTransform,
+            parsedScene.camera.cameraTransform, lightMedia[i], &light.loc, alloc);
+    });
+    lightCreationTime += lightTimer.ElapsedSeconds();
 
     // Primitives
     auto getAlphaTexture = [&](const ParameterDictionary &parameters,
@@ -313,18 +333,37 @@ void CPURender(ParsedScene &parsedScene) {
     }
 
     // Accelerator
-    PrimitiveHandle accel = nullptr;
     if (!primitives.empty())
         accel = CreateAccelerator(parsedScene.accelerator.name, std::move(primitives),
                                   parsedScene.accelerator.parameters);
+}
+
+std::unique_ptr<Integrator> CPUScene::CreateIntegrator(
+    const CameraTransform &cameraTransform, Allocator alloc) const {
+    // Film
+    FilmHandle film =
+        FilmHandle::Create(parsedScene.film.name, parsedScene.film.parameters,
+                           exposureTime, filter, &parsedScene.film.loc, alloc);
+
+    // Camera
+    CameraHandle camera = CameraHandle::Create(
+        parsedScene.camera.name, parsedScene.camera.parameters, cameraMedium,
+        cameraTransform, film, &parsedScene.camera.loc, alloc);
+
+    // Create _Sampler_ for rendering
+    Point2i fullImageResolution = camera.GetFilm().FullResolution();
+    SamplerHandle sampler =
+        SamplerHandle::Create(parsedScene.sampler.name, parsedScene.sampler.parameters,
+                              fullImageResolution, &parsedScene.sampler.loc, alloc);
 
     // Integrator
     const RGBColorSpace *integratorColorSpace = parsedScene.film.parameters.ColorSpace();
-    std::unique_ptr<Integrator> integrator(Integrator::Create(
-        parsedScene.integrator.name, parsedScene.integrator.parameters, camera, sampler,
-        accel, lights, integratorColorSpace, &parsedScene.integrator.loc));
+    return Integrator::Create(parsedScene.integrator.name,
+                              parsedScene.integrator.parameters, camera, sampler, accel,
+                              lights, integratorColorSpace, &parsedScene.integrator.loc);
+}
 
-    // Helpful warnings
+void CPUScene::WarnAboutUnsupportedFeatures() const {
     if (haveScatteringMedia && parsedScene.integrator.name != "volpath" &&
         parsedScene.integrator.name != "simplevolpath" &&
         parsedScene.integrator.name != "bdpt" && parsedScene.integrator.name != "mlt")
@@ -358,6 +397,13 @@ void CPURender(ParsedScene &parsedScene) {
                 "not supported by the %s integrator. Use the \"volpath\" integrator "
                 "to render them correctly.",
                 parsedScene.integrator.name);
+}
+
+void CPURender(ParsedScene &parsedScene) {
+    CPUScene scene(parsedScene);
+    std::unique_ptr<Integrator> integrator =
+        scene.CreateIntegrator(parsedScene.camera.cameraTransform, Allocator());
+    scene.WarnAboutUnsupportedFeatures();
 
     LOG_VERBOSE("Memory used after scene creation: %d", GetCurrentRSS());
 
@@ -370,6 +416,110 @@ void CPURender(ParsedScene &parsedScene) {
 
     PtexTextureBase::ReportStats();
     ImageTextureBase::ClearCache();
+    ClearDenselySampledSpectrumCache();
+    ClearRGBSpectrumCache();
+    FreeBufferCaches();
+}
+
+// Returns a description of the problem if _job_ asks for something that the
+// film would report with _ErrorExit()_, so that the server can reply with an
+// error and keep serving instead.
+static std::string RenderJobError(const RenderJob &job, const ParsedScene &parsedScene) {
+    const std::string &filename = job.imageFile;
+    if (!HasExtension(filename, "exr") && !HasExtension(filename, "pfm") &&
+        !HasExtension(filename, "png"))
+        return StringPrintf("%s: no support for writing images with this extension",
+                            filename);
+
+    const std::string &filmName = parsedScene.film.name;
+    const ParameterDictionary &filmParameters = parsedScene.film.parameters;
+    if ((filmName == "gbuffer" || filmName == "gbuffer_mitsuba" ||
+         filmParameters.GetOneInt("streamtilesize", 0) > 0) &&
+        !HasExtension(filename, "exr"))
+        return StringPrintf("%s: the scene's film can only write EXR files", filename);
+
+    // Check that the requested part of the image isn't empty
+    Point2i fullResolution(filmParameters.GetOneInt("xresolution", 1280),
+                           filmParameters.GetOneInt("yresolution", 720));
+    if (Options->quickRender) {
+        fullResolution.x = std::max(1, fullResolution.x / 4);
+        fullResolution.y = std::max(1, fullResolution.y / 4);
+    }
+    Bounds2i pixelBounds(Point2i(0, 0), fullResolution);
+    if (job.cropWindow) {
+        Bounds2f crop = *job.cropWindow;
+        pixelBounds = Bounds2i(Point2i(std::ceil(fullResolution.x * crop.pMin.x),
+                                       std::ceil(fullResolution.y * crop.pMin.y)),
+                               Point2i(std::ceil(fullResolution.x * crop.pMax.x),
+                                       std::ceil(fullResolution.y * crop.pMax.y)));
+    } else if (job.pixelBounds && !Options->cropWindow)
+        pixelBounds = Intersect(*job.pixelBounds, pixelBounds);
+    if (pixelBounds.IsEmpty())
+        return StringPrintf("Degenerate pixel bounds %s for %dx%d image", pixelBounds,
+                            fullResolution.x, fullResolution.y);
+
+    return {};
+}
+
+void CPURenderServer(ParsedScene &parsedScene, const std::string &address) {
+    CPUScene scene(parsedScene);
+    scene.WarnAboutUnsupportedFeatures();
+
+    LOG_VERBOSE("Memory used after scene creation: %d", GetCurrentRSS());
+
+    // Shapes and lights have already been transformed to the render space
+    // that was set up for the scene's camera, so new views must use it too.
+    const Transform &worldFromRender =
+        parsedScene.camera.cameraTransform.WorldFromRender();
+
+    RenderJobServer server(address);
+    while (pstd::optional<RenderJob> job = server.NextJob()) {
+        if (std::string error = RenderJobError(*job, parsedScene); !error.empty()) {
+            server.Reply("error " + error);
+            continue;
+        }
+
+        LOG_VERBOSE("Starting render job %s", *job);
+        Timer timer;
+        // Apply the job's overrides to the options that the film and the
+        // sampler consult when they are created and while rendering.
+        PBRTOptions savedOptions = *Options;
+        Options->imageFile = job->imageFile;
+        if (job->pixelSamples)
+            Options->pixelSamples = job->pixelSamples;
+        if (job->seed)
+            Options->seed = *job->seed;
+        if (job->cropWindow)
+            Options->cropWindow = job->cropWindow;
+        if (job->pixelBounds)
+            Options->pixelBounds = job->pixelBounds;
+
+        CameraTransform cameraTransform = parsedScene.camera.cameraTransform;
+        if (job->worldFromCamera)
+            cameraTransform = CameraTransform(AnimatedTransform(*job->worldFromCamera),
+                                              worldFromRender);
+
+        {
+            // Per-view objects are freed after each job
+            pstd::pmr::monotonic_buffer_resource jobResource;
+            std::unique_ptr<Integrator> integrator =
+                scene.CreateIntegrator(cameraTransform, Allocator(&jobResource));
+            integrator->Render();
+        }
+        // Spectra allocated from _jobResource_ may have been cached, and a
+        // later job's resource may have the same address
+        ClearDenselySampledSpectrumCache();
+        ClearRGBSpectrumCache();
+
+        *Options = savedOptions;
+        server.Reply(
+            StringPrintf("done %s %.3f", job->imageFile, timer.ElapsedSeconds()));
+    }
+
+    PtexTextureBase::ReportStats();
+    ImageTextureBase::ClearCache();
+    ClearDenselySampledSpectrumCache();
+    ClearRGBSpectrumCache();
     FreeBufferCaches();
 }
 
@@ -14,6 +14,9 @@ namespace pbrt {
 class ParsedScene;
 
 void CPURender(ParsedScene &scene);
+// Creates the scene once and then renders the views requested by clients
+// of a _RenderJobServer_ at the given address until it is shut down.
+void CPURenderServer(ParsedScene &scene, const std::string &address);
 void CPURenderMultipleViews(ParsedScene &scene, const std::vector<CameraTransform>& camera_lists, const std::vector<std::string>& outfiles);
 
 }  // namespace pbrt
@@ -0,0 +1,270 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <pbrt/cpu/renderserver.h>
+
+#include <pbrt/util/args.h>
+#include <pbrt/util/error.h>
+#include <pbrt/util/print.h>
+#include <pbrt/util/string.h>
+
+#include <cstring>
+#include <vector>
+
+#ifdef PBRT_IS_WINDOWS
+#include <io.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace pbrt {
+
+// RenderJob Method Definitions
+std::string RenderJob::ToString() const {
+    return StringPrintf("[ RenderJob imageFile: %s pixelSamples: %s seed: %s "
+                        "cropWindow: %s pixelBounds: %s worldFromCamera: %s ]",
+                        imageFile, pixelSamples, seed, cropWindow, pixelBounds,
+                        worldFromCamera);
+}
+
+pstd::optional<RenderJob> ParseRenderJob(const std::string &line, std::string *error) {
+    std::vector<std::string> args = SplitStringsFromWhitespace(line);
+    std::vector<char *> argv;
+    for (std::string &arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    RenderJob job;
+    error->clear();
+    auto onError = [error](const std::string &err) { *error = err; };
+    // _ParseArg()_ may have advanced past the end of the arguments after
+    // an error, so stop trying to match once one has been reported.
+    auto parseArg = [&](char ***argv, const char *name, auto out) {
+        return error->empty() && ParseArg(argv, name, out, onError);
+    };
+
+    char **arg = argv.data();
+    while (*arg != nullptr) {
+        if ((*arg)[0] != '-') {
+            *error = StringPrintf("unexpected argument \"%s\"", *arg);
+            return {};
+        }
+
+        std::string spp, seed, cropWindow, pixelBounds, lookAt, cameraMatrix;
+        if (parseArg(&arg, "outfile", &job.imageFile) || parseArg(&arg, "spp", &spp) ||
+            parseArg(&arg, "seed", &seed) || parseArg(&arg, "cropwindow", &cropWindow) ||
+            parseArg(&arg, "pixelbounds", &pixelBounds) ||
+            parseArg(&arg, "lookat", &lookAt) ||
+            parseArg(&arg, "camera-matrix", &cameraMatrix)) {
+            int value;
+            if (!spp.empty()) {
+                if (!Atoi(spp, &value) || value <= 0) {
+                    *error = StringPrintf("invalid value \"%s\" for spp argument", spp);
+                    return {};
+                }
+                job.pixelSamples = value;
+            } else if (!seed.empty()) {
+                if (!Atoi(seed, &value)) {
+                    *error = StringPrintf("invalid value \"%s\" for seed argument", seed);
+                    return {};
+                }
+                job.seed = value;
+            } else if (!cropWindow.empty()) {
+                std::vector<Float> c = SplitStringToFloats(cropWindow, ',');
+                if (c.size() != 4) {
+                    *error = "Didn't find four values after --cropwindow";
+                    return {};
+                }
+                for (Float v : c)
+                    if (!(v >= 0 && v <= 1)) {
+                        *error = StringPrintf("%f: --cropwindow values must be "
+                                              "between 0 and 1",
+                                              v);
+                        return {};
+                    }
+                job.cropWindow = Bounds2f(Point2f(c[0], c[2]), Point2f(c[1], c[3]));
+            } else if (!pixelBounds.empty()) {
+                std::vector<int> p = SplitStringToInts(pixelBounds, ',');
+                if (p.size() != 4) {
+                    *error = "Didn't find four integer values after --pixelbounds";
+                    return {};
+                }
+                job.pixelBounds = Bounds2i(Point2i(p[0], p[2]), Point2i(p[1], p[3]));
+            } else if (!lookAt.empty()) {
+                // As with the LookAt directive, the nine values give the eye
+                // position, the point looked at, and the up vector.
+                std::vector<Float> v = SplitStringToFloats(lookAt, ',');
+                if (v.size() != 9) {
+                    *error = "Didn't find nine values after --lookat";
+                    return {};
+                }
+                Point3f pos(v[0], v[1], v[2]), look(v[3], v[4], v[5]);
+                Vector3f up(v[6], v[7], v[8]);
+                if (pos == look || LengthSquared(up) == 0 ||
+                    LengthSquared(Cross(Normalize(up), Normalize(look - pos))) == 0) {
+                    *error = "Degenerate viewing direction or up vector for --lookat";
+                    return {};
+                }
+                job.worldFromCamera = Inverse(LookAt(pos, look, up));
+            } else if (!cameraMatrix.empty()) {
+                // The world-from-camera matrix is given in row-major order,
+                // as in the files passed to --camerafile.
+                std::vector<Float> m = SplitStringToFloats(cameraMatrix, ',');
+                if (m.size() != 16) {
+                    *error = "Didn't find sixteen values after --camera-matrix";
+                    return {};
+                }
+                SquareMatrix<4> worldFromCamera(pstd::MakeConstSpan(m));
+                if (!Inverse(worldFromCamera)) {
+                    *error = "Singular matrix given for --camera-matrix";
+                    return {};
+                }
+                job.worldFromCamera = Transform(worldFromCamera);
+            }
+        } else if (error->empty())
+            *error = StringPrintf("argument \"%s\" unknown", *arg);
+
+        if (!error->empty())
+            return {};
+    }
+
+    if (job.imageFile.empty()) {
+        *error = "No output filename given via --outfile";
+        return {};
+    }
+    return job;
+}
+
+// RenderJobServer Method Definitions
+RenderJobServer::RenderJobServer(const std::string &address) : address(address) {
+    if (address == "-") {
+        // Replies go to the original standard output; anything else that
+        // pbrt prints there while rendering (progress bars, statistics)
+        // is sent to standard error so that it can't be mistaken for one.
+        in = stdin;
+        fflush(stdout);
+        out = fdopen(dup(fileno(stdout)), "w");
+        if (!out || dup2(fileno(stderr), fileno(stdout)) == -1)
+            ErrorExit("Unable to redirect standard output: %s", ErrorString());
+        return;
+    }
+
+#ifdef PBRT_IS_WINDOWS
+    ErrorExit("%s: only \"-\" (standard input) is supported as a render server "
+              "address on Windows.",
+              address);
+#else
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (address.size() >= sizeof(addr.sun_path))
+        ErrorExit("%s: socket path is too long.", address);
+    std::strcpy(addr.sun_path, address.c_str());
+
+    // Don't die if a client disconnects before it has read its reply
+    signal(SIGPIPE, SIG_IGN);
+
+    listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket == -1)
+        ErrorExit("socket: %s", ErrorString());
+    // Remove a socket left behind by an earlier server, but nothing else
+    struct stat st;
+    if (lstat(address.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode))
+            ErrorExit("%s: file exists and isn't a socket.", address);
+        unlink(address.c_str());
+    }
+    if (bind(listenSocket, (sockaddr *)&addr, sizeof(addr)) == -1)
+        ErrorExit("%s: bind: %s", address, ErrorString());
+    if (listen(listenSocket, 4) == -1)
+        ErrorExit("%s: listen: %s", address, ErrorString());
+#endif
+}
+
+RenderJobServer::~RenderJobServer() {
+    if (listenSocket == -1)
+        return;
+    CloseClient();
+#ifndef PBRT_IS_WINDOWS
+    close(listenSocket);
+    unlink(address.c_str());
+#endif
+}
+
+void RenderJobServer::CloseClient() {
+    if (listenSocket == -1)
+        return;
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    in = out = nullptr;
+}
+
+bool RenderJobServer::ReadLine(std::string *line) {
+    line->clear();
+    while (true) {
+#ifndef PBRT_IS_WINDOWS
+        if (!in) {
+            // Wait for the next client to connect
+            int fd = accept(listenSocket, nullptr, nullptr);
+            if (fd == -1) {
+                if (errno == EINTR)
+                    continue;
+                ErrorExit("%s: accept: %s", address, ErrorString());
+            }
+            in = fdopen(fd, "r");
+            out = fdopen(dup(fd), "w");
+            if (!in || !out)
+                ErrorExit("%s: fdopen: %s", address, ErrorString());
+            LOG_VERBOSE("%s: client connected", address);
+        }
+#endif
+
+        int c = fgetc(in);
+        if (c == EOF) {
+            // Standard input is finished; otherwise the client has
+            // disconnected and we go back to waiting for another one.
+            if (listenSocket == -1)
+                return false;
+            CloseClient();
+            line->clear();
+        } else if (c == '\n')
+            return true;
+        else if (c != '\r')
+            *line += char(c);
+    }
+}
+
+pstd::optional<RenderJob> RenderJobServer::NextJob() {
+    std::string line;
+    while (ReadLine(&line)) {
+        // Skip blank lines and comments
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+        if (SplitStringsFromWhitespace(line) == std::vector<std::string>{"quit"})
+            return {};
+
+        std::string error;
+        if (pstd::optional<RenderJob> job = ParseRenderJob(line, &error); job)
+            return job;
+        Reply("error " + error);
+    }
+    return {};
+}
+
+void RenderJobServer::Reply(const std::string &message) {
+    if (!out)
+        return;
+    fprintf(out, "%s\n", message.c_str());
+    fflush(out);
+}
+
+}  // namespace pbrt
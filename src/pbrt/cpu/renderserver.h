@@ -0,0 +1,74 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#ifndef PBRT_CPU_RENDERSERVER_H
+#define PBRT_CPU_RENDERSERVER_H
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/pstd.h>
+#include <pbrt/util/transform.h>
+#include <pbrt/util/vecmath.h>
+
+#include <cstdio>
+#include <string>
+
+namespace pbrt {
+
+// RenderJob Definition
+// A single request to a long-lived render server. Jobs are given as one
+// line of text using the same syntax as pbrt's command-line options, e.g.
+//     --outfile view3.exr --spp 64 --lookat 0,1,5,0,0,0,0,1,0
+// Unspecified settings fall back to the values from the scene and the
+// command line.
+struct RenderJob {
+    std::string imageFile;
+    pstd::optional<int> pixelSamples, seed;
+    pstd::optional<Bounds2f> cropWindow;
+    pstd::optional<Bounds2i> pixelBounds;
+    // World-from-camera transformation for the view; the scene's camera
+    // is used if it isn't given.
+    pstd::optional<Transform> worldFromCamera;
+
+    std::string ToString() const;
+};
+
+pstd::optional<RenderJob> ParseRenderJob(const std::string &line, std::string *error);
+
+// RenderJobServer Definition
+// Reads newline-terminated jobs either from standard input (with address
+// "-") or from clients that connect to a Unix domain socket at the given
+// path. Clients are served one at a time; a reply line is written back to
+// the client after each job. With "-", everything else that pbrt prints to
+// standard output is redirected to standard error.
+class RenderJobServer {
+  public:
+    // RenderJobServer Public Methods
+    RenderJobServer(const std::string &address);
+    ~RenderJobServer();
+
+    RenderJobServer(const RenderJobServer &) = delete;
+    RenderJobServer &operator=(const RenderJobServer &) = delete;
+
+    // Returns the next job, replying with an error message to any that
+    // can't be parsed. An unset value is returned once the server should
+    // shut down, either after a "quit" request or at the end of standard
+    // input.
+    pstd::optional<RenderJob> NextJob();
+    void Reply(const std::string &message);
+
+  private:
+    // RenderJobServer Private Methods
+    bool ReadLine(std::string *line);
+    void CloseClient();
+
+    // RenderJobServer Private Members
+    std::string address;
+    int listenSocket = -1;
+    FILE *in = nullptr, *out = nullptr;
+};
+
+}  // namespace pbrt
+
+#endif  // PBRT_CPU_RENDERSERVER_H
@@ -0,0 +1,70 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <pbrt/pbrt.h>
+#include <pbrt/cpu/renderserver.h>
+
+#include <string>
+
+using namespace pbrt;
+
+TEST(RenderJob, Parse) {
+    std::string error;
+    pstd::optional<RenderJob> job = ParseRenderJob(
+        "  --outfile view.exr --spp=16 --seed 7 --cropwindow 0,0.5,0.25,1", &error);
+    ASSERT_TRUE(job.has_value()) << error;
+    EXPECT_EQ("view.exr", job->imageFile);
+    EXPECT_EQ(16, *job->pixelSamples);
+    EXPECT_EQ(7, *job->seed);
+    EXPECT_EQ(Bounds2f(Point2f(0, 0.25), Point2f(0.5, 1)), *job->cropWindow);
+    EXPECT_FALSE(job->pixelBounds.has_value());
+    EXPECT_FALSE(job->worldFromCamera.has_value());
+
+    job = ParseRenderJob("--pixelbounds 0,10,20,40 --outfile a.png", &error);
+    ASSERT_TRUE(job.has_value()) << error;
+    EXPECT_EQ(Bounds2i(Point2i(0, 20), Point2i(10, 40)), *job->pixelBounds);
+    EXPECT_FALSE(job->pixelSamples.has_value());
+}
+
+TEST(RenderJob, Camera) {
+    std::string error;
+    pstd::optional<RenderJob> job =
+        ParseRenderJob("--outfile a.exr --lookat 1,2,3,1,2,10,0,1,0", &error);
+    ASSERT_TRUE(job.has_value()) << error;
+    ASSERT_TRUE(job->worldFromCamera.has_value());
+    Point3f pCamera = (*job->worldFromCamera)(Point3f(0, 0, 0));
+    EXPECT_FLOAT_EQ(1, pCamera.x);
+    EXPECT_FLOAT_EQ(2, pCamera.y);
+    EXPECT_FLOAT_EQ(3, pCamera.z);
+    Vector3f dir = (*job->worldFromCamera)(Vector3f(0, 0, 1));
+    EXPECT_FLOAT_EQ(1, dir.z);
+
+    job = ParseRenderJob(
+        "--outfile a.exr --camera-matrix 1,0,0,4,0,1,0,5,0,0,1,6,0,0,0,1", &error);
+    ASSERT_TRUE(job.has_value()) << error;
+    pCamera = (*job->worldFromCamera)(Point3f(0, 0, 0));
+    EXPECT_EQ(Point3f(4, 5, 6), pCamera);
+}
+
+TEST(RenderJob, Errors) {
+    std::string error;
+    // Missing output file
+    EXPECT_FALSE(ParseRenderJob("--spp 4", &error).has_value());
+    EXPECT_FALSE(error.empty());
+
+    for (const char *line :
+         {"--outfile a.exr --spp none", "--outfile a.exr --spp 0",
+          "--outfile a.exr --cropwindow 0,1",
+          "--outfile a.exr --cropwindow 0,2,0,1",
+          "--outfile a.exr --lookat 0,0,0,0,0,0,0,1,0",
+          "--outfile a.exr --lookat 0,0,0,0,1,0,0,1,0",
+          "--outfile a.exr --camera-matrix 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0",
+          "--outfile a.exr --nosuchoption 1", "--outfile a.exr stray", "--outfile"}) {
+        error.clear();
+        EXPECT_FALSE(ParseRenderJob(line, &error).has_value()) << line;
+        EXPECT_FALSE(error.empty()) << line;
+    }
+}
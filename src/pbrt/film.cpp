@@ -64,6 +64,11 @@ void FilmHandle::SetFilename(const std::string& name) {
     return DispatchCPU(get);
 }
 
+void FilmHandle::FlushSplats() {
+    auto flush = [&](auto ptr) { ptr->FlushSplats(); };
+    return DispatchCPU(flush);
+}
+
 void FilmHandle::Reset() {
     auto get = [&](auto ptr) { ptr->Reset(); };
     return Dispatch(get);
@@ -163,6 +168,112 @@ FilmBaseParameters::FilmBaseParameters(const ParameterDictionary &parameters,
         ErrorExit(loc, "Degenerate pixel bounds provided to film: %s.", pixelBounds);
 
     diagonal = parameters.GetOneFloat("diagonal", 35.);
+
+    // Only the CPU integrators buffer their splats
+    splatBufferMB = parameters.GetOneFloat("splatbuffermb", 0);
+    if (Options->useGPU)
+        splatBufferMB = 0;
+    if (splatBufferMB < 0)
+        ErrorExit(loc, "%f: \"splatbuffermb\" must not be negative.", splatBufferMB);
+
+    std::string accumulation = parameters.GetOneString("accumulation", "double");
+    if (accumulation == "float")
+        singlePrecisionPixels = true;
+    else if (accumulation != "double")
+        ErrorExit(loc, "%s: unknown film accumulation precision. Expected "
+                       "\"double\" or \"float\".", accumulation);
+}
+
+// RGBPixelSums Method Definitions
+// Returns the extent of the pixel storage needed for _bounds_; with tiles,
+// there is a column of tile slots, one for each thread.
+static Bounds2i pixelStorageBounds(const Bounds2i &bounds, int tileSize) {
+    if (tileSize == 0)
+        return bounds;
+    return Bounds2i(Point2i(0, 0), Point2i(tileSize, tileSize * MaxThreadIndex()));
+}
+
+RGBPixelSums::RGBPixelSums(const Bounds2i &bounds, bool singlePrecision, int tileSize,
+                           Allocator alloc)
+    : singlePrecision(singlePrecision),
+      doublePixels(singlePrecision ? Bounds2i({0, 0}, {0, 0})
+                                   : pixelStorageBounds(bounds, tileSize),
+                   alloc),
+      floatPixels(singlePrecision ? pixelStorageBounds(bounds, tileSize)
+                                  : Bounds2i({0, 0}, {0, 0}),
+                  alloc),
+      partialSums(singlePrecision ? MaxThreadIndex() : 0, alloc),
+      bounds(bounds),
+      tileSize(tileSize),
+      tileSlots(alloc) {
+    if (tileSize > 0) {
+        nTiles = Vector2i((bounds.Diagonal().x + tileSize - 1) / tileSize,
+                          (bounds.Diagonal().y + tileSize - 1) / tileSize);
+        tileSlots.resize(nTiles.x * nTiles.y, -1);
+    }
+}
+
+void RGBPixelSums::MapTile(const Bounds2i &tileBounds, int slot) {
+    CHECK_GT(tileSize, 0);
+    CHECK_LT(slot, MaxThreadIndex());
+    Vector2i pb = tileBounds.pMin - bounds.pMin;
+    CHECK(pb.x % tileSize == 0 && pb.y % tileSize == 0);
+    tileSlots[(pb.y / tileSize) * nTiles.x + pb.x / tileSize] = slot;
+
+    // Clear the values left in the slot by the last tile it held
+    for (Point2i p : tileBounds)
+        if (singlePrecision)
+            floatPixels[StoragePoint(p)].Clear();
+        else
+            doublePixels[StoragePoint(p)].Clear();
+}
+
+void RGBPixelSums::UnmapTile(const Bounds2i &tileBounds) {
+    Vector2i pb = tileBounds.pMin - bounds.pMin;
+    tileSlots[(pb.y / tileSize) * nTiles.x + pb.x / tileSize] = -1;
+}
+
+// SplatBuffer Method Definitions
+SplatBuffer::SplatBuffer(Bounds2i pixelBounds, size_t maxBytes,
+                         std::function<void(Point2i, const RGB &)> flushPixel)
+    : pixelBounds(pixelBounds),
+      nTiles((pixelBounds.Diagonal().x + TileSize - 1) / TileSize,
+             (pixelBounds.Diagonal().y + TileSize - 1) / TileSize),
+      flushPixel(std::move(flushPixel)),
+      threadBuffers(MaxThreadIndex()) {
+    maxTilesPerThread = std::max<size_t>(
+        1, maxBytes / (threadBuffers.size() * TileValues * sizeof(double)));
+}
+
+void SplatBuffer::Flush() {
+    // Threads' tiles may overlap, so they are added to the film atomically
+    ParallelFor(0, threadBuffers.size(), [&](int64_t index) {
+        ThreadBuffer &buffer = threadBuffers[index];
+        for (size_t slot = 0; slot < buffer.liveTiles.size(); ++slot) {
+            int tile = buffer.liveTiles[slot];
+            Point2i pTile(pixelBounds.pMin.x + (tile % nTiles.x) * TileSize,
+                          pixelBounds.pMin.y + (tile / nTiles.x) * TileSize);
+            Bounds2i tileBounds = Intersect(
+                Bounds2i(pTile, pTile + Vector2i(TileSize, TileSize)), pixelBounds);
+            const double *values = &buffer.values[slot * TileValues];
+            for (Point2i p : tileBounds) {
+                const double *v =
+                    &values[3 * ((p.y - pTile.y) * TileSize + (p.x - pTile.x))];
+                if (v[0] != 0 || v[1] != 0 || v[2] != 0)
+                    flushPixel(p, RGB(v[0], v[1], v[2]));
+            }
+        }
+    });
+    Clear();
+}
+
+void SplatBuffer::Clear() {
+    for (ThreadBuffer &buffer : threadBuffers) {
+        for (int tile : buffer.liveTiles)
+            buffer.tileSlots[tile] = -1;
+        buffer.liveTiles.clear();
+        std::fill(buffer.values.begin(), buffer.values.end(), 0.);
+    }
 }
 
 // FilmBase Method Definitions
@@ -179,14 +290,8 @@ Bounds2f FilmBase::SampleBounds() const {
 }
 
 // VisibleSurface Method Definitions
-VisibleSurface::VisibleSurface(const SurfaceInteraction &si,
-                               const CameraTransform &cameraTransform,
-                               const SampledSpectrum &albedo,
-                               const SampledSpectrum &diffuse_albedo,  
-                                const Point2f& roughness,
-                               const SampledWavelengths &lambda)
-    : albedo(albedo), diffuse_albedo(diffuse_albedo), roughness(roughness) {
-    set = true;
+void VisibleSurface::InitializeGeometry(const SurfaceInteraction &si,
+                                        const CameraTransform &cameraTransform) {
     // Initialize geometric _VisibleSurface_ members
     Transform cameraFromRender = cameraTransform.CameraFromRender(si.time);
     p = cameraFromRender(si.p());
@@ -509,17 +614,25 @@ STAT_MEMORY_COUNTER("Memory/Film pixels", filmPixelMemory);
 
 // RGBFilm Method Definitions
 RGBFilm::RGBFilm(FilmBaseParameters p, const RGBColorSpace *colorSpace,
-                 Float maxComponentValue, bool writeFP16, Allocator alloc)
+                 Float maxComponentValue, bool writeFP16, int streamTileSize,
+                 Allocator alloc)
     : FilmBase(p),
-      pixels(p.pixelBounds, alloc),
+      pixels(p.pixelBounds, p.singlePrecisionPixels, streamTileSize, alloc),
       colorSpace(colorSpace),
       maxComponentValue(maxComponentValue),
-      writeFP16(writeFP16) {
+      writeFP16(writeFP16),
+      streamTileSize(streamTileSize) {
     filterIntegral = filter.Integral();
     CHECK(!pixelBounds.IsEmpty());
     CHECK(colorSpace != nullptr);
-    filmPixelMemory += pixelBounds.Area() * sizeof(Pixel);
+    filmPixelMemory += pixels.BytesUsed();
     outputRGBFromSensorRGB = colorSpace->RGBFromXYZ * sensor->XYZFromSensorRGB;
+    if (p.splatBufferMB > 0)
+        splatBuffer = alloc.new_object<SplatBuffer>(
+            pixelBounds, size_t(p.splatBufferMB * 1024 * 1024),
+            [this](Point2i pPixel, const RGB &v) {
+                pixels.AddSplat(pPixel, v);
+            });
 }
 
 SampledWavelengths RGBFilm::SampleWavelengths(Float u) const {
@@ -551,9 +664,11 @@ void RGBFilm::AddSplat(const Point2f &p, SampledSpectrum L,
         // Evaluate filter at _pi_ and add splat contribution
         Float wt = filter.Evaluate(Point2f(p - pi - Vector2f(0.5, 0.5)));
         if (wt != 0) {
-            Pixel &pixel = pixels[pi];
-            for (int i = 0; i < 3; ++i)
-                pixel.splatRGB[i].Add(wt * rgb[i]);
+#ifndef PBRT_IS_GPU_CODE
+            if (splatBuffer && splatBuffer->Add(pi, wt * rgb))
+                continue;
+#endif
+            pixels.AddSplat(pi, wt * rgb);
         }
     }
 }
@@ -565,8 +680,11 @@ void RGBFilm::WriteImage(ImageMetadata metadata, Float splatScale) {
 }
 
 Image RGBFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
+    // Only the tiles being rendered have storage when tiles are streamed
+    CHECK_EQ(streamTileSize, 0);
     // Convert image to RGB and compute final pixel values
     LOG_VERBOSE("Converting image to RGB and computing final weighted pixel values");
+    FlushSplats();
     PixelFormat format = writeFP16 ? PixelFormat::Half : PixelFormat::Float;
     Image image(format, Point2i(pixelBounds.Diagonal()), {"R", "G", "B"});
 
@@ -584,10 +702,49 @@ Image RGBFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
     return image;
 }
 
+void RGBFilm::BeginTileStream(ImageMetadata metadata) {
+    CHECK_GT(streamTileSize, 0);
+    metadata.pixelBounds = pixelBounds;
+    metadata.fullResolution = fullResolution;
+    metadata.colorSpace = colorSpace;
+    LOG_VERBOSE("Streaming tiles of image %s with bounds %s", filename, pixelBounds);
+    PixelFormat format = writeFP16 ? PixelFormat::Half : PixelFormat::Float;
+    std::vector<std::string> channelNames = {"R", "G", "B"};
+    tileWriter = new TiledEXRWriter(filename, metadata, Point2i(pixelBounds.Diagonal()),
+                                    format, channelNames, streamTileSize);
+}
+
+void RGBFilm::BeginTile(const Bounds2i &tileBounds) {
+    // Each thread renders one tile at a time, so the thread's index gives
+    // a free storage slot
+    pixels.MapTile(tileBounds, ThreadIndex);
+}
+
+void RGBFilm::EndTile(const Bounds2i &tileBounds, Float splatScale) {
+    // The tile was rendered by this thread, which may still hold a partial
+    // sum for its last pixel
+    pixels.FoldPartialSum(ThreadIndex);
+    PixelFormat format = writeFP16 ? PixelFormat::Half : PixelFormat::Float;
+    Image image(format, Point2i(tileBounds.Diagonal()), {"R", "G", "B"});
+    for (Point2i p : tileBounds) {
+        RGB rgb = GetPixelRGB(p, splatScale);
+        image.SetChannels(Point2i(p - tileBounds.pMin), {rgb[0], rgb[1], rgb[2]});
+    }
+    tileWriter->WriteTile(tileBounds.pMin, image);
+    pixels.UnmapTile(tileBounds);
+}
+
+void RGBFilm::EndTileStream() {
+    // Destroying the writer finishes the file
+    delete tileWriter;
+    tileWriter = nullptr;
+}
+
 std::string RGBFilm::ToString() const {
-    return StringPrintf(
-        "[ RGBFilm %s colorSpace: %s maxComponentValue: %f writeFP16: %s ]",
-        BaseToString(), *colorSpace, maxComponentValue, writeFP16);
+    return StringPrintf("[ RGBFilm %s colorSpace: %s maxComponentValue: %f writeFP16: %s "
+                        "streamTileSize: %d ]",
+                        BaseToString(), *colorSpace, maxComponentValue, writeFP16,
+                        streamTileSize);
 }
 
 RGBFilm *RGBFilm::Create(const ParameterDictionary &parameters, Float exposureTime,
@@ -600,8 +757,20 @@ RGBFilm *RGBFilm::Create(const ParameterDictionary &parameters, Float exposureTi
         PixelSensor::Create(parameters, colorSpace, exposureTime, loc, alloc);
     FilmBaseParameters filmBaseParameters(parameters, filter, sensor, loc);
 
+    // Optionally render one tile at a time, writing tiles as they finish
+    int streamTileSize = parameters.GetOneInt("streamtilesize", 0);
+    if (streamTileSize < 0)
+        ErrorExit(loc, "%d: \"streamtilesize\" must not be negative.", streamTileSize);
+    if (streamTileSize > 0) {
+        if (Options->useGPU)
+            ErrorExit(loc, "\"streamtilesize\" is not supported with the GPU.");
+        if (!HasExtension(filmBaseParameters.filename, "exr"))
+            ErrorExit(loc, "%s: tiles can only be streamed to EXR files.",
+                      filmBaseParameters.filename);
+    }
+
     return alloc.new_object<RGBFilm>(filmBaseParameters, colorSpace, maxComponentValue,
-                                     writeFP16, alloc);
+                                     writeFP16, streamTileSize, alloc);
 }
 
 // GBufferFilm Method Definitions
@@ -617,44 +786,56 @@ void GBufferFilm::AddSample(const Point2i &pFilm, SampledSpectrum L,
         rgb *= maxComponentValue / m;
     }
 
-    Pixel &p = pixels[pFilm];
     if (visibleSurface && *visibleSurface) {
         // Update variance estimates.
+        pstd::array<VarianceEstimator<Float>, 3> &varianceEstimator =
+            varianceEstimators[pFilm];
         for (int c = 0; c < 3; ++c)
-            p.varianceEstimator[c].Add(rgb[c]);
+            varianceEstimator[c].Add(rgb[c]);
 
-        p.pSum += weight * visibleSurface->p;
+        pSum[pFilm] += weight * visibleSurface->p;
 
-        p.nSum += weight * visibleSurface->n;
-        p.nsSum += weight * visibleSurface->ns;
+        nSum[pFilm] += weight * visibleSurface->n;
+        nsSum[pFilm] += weight * visibleSurface->ns;
 
-        p.dzdxSum += weight * visibleSurface->dzdx;
-        p.dzdySum += weight * visibleSurface->dzdy;
+        dzSum[pFilm] += weight * Vector2f(visibleSurface->dzdx, visibleSurface->dzdy);
 
         SampledSpectrum albedo =
             visibleSurface->albedo * colorSpace->illuminant.Sample(lambda);
         RGB albedoRGB = albedo.ToRGB(lambda, *colorSpace);
-        for (int c = 0; c < 3; ++c)
-            p.albedoSum[c] += weight * albedoRGB[c];
+        albedoSum.Add(pFilm, weight * albedoRGB);
     }
 
-    for (int c = 0; c < 3; ++c)
-        p.rgbSum[c] += rgb[c] * weight;
-    p.weightSum += weight;
+    pixels.AddSample(pFilm, rgb, weight);
 }
 
 
 GBufferFilm::GBufferFilm(FilmBaseParameters p, const RGBColorSpace *colorSpace,
                          Float maxComponentValue, bool writeFP16,  Allocator alloc)
     : FilmBase(p),
-      pixels(pixelBounds, alloc),
+      pixels(pixelBounds, p.singlePrecisionPixels, 0, alloc),
+      pSum(pixelBounds, alloc),
+      dzSum(pixelBounds, alloc),
+      nSum(pixelBounds, alloc),
+      nsSum(pixelBounds, alloc),
+      albedoSum(pixelBounds, p.singlePrecisionPixels, alloc),
+      varianceEstimators(pixelBounds, alloc),
       colorSpace(colorSpace),
       maxComponentValue(maxComponentValue),
       writeFP16(writeFP16),
       filterIntegral(filter.Integral()) {
     CHECK(!pixelBounds.IsEmpty());
-    filmPixelMemory += pixelBounds.Area() * sizeof(Pixel);
+    filmPixelMemory +=
+        pixels.BytesUsed() + albedoSum.BytesUsed() +
+        pixelBounds.Area() * (sizeof(Point3f) + sizeof(Vector2f) + 2 * sizeof(Normal3f) +
+                              sizeof(pstd::array<VarianceEstimator<Float>, 3>));
     outputRGBFromSensorRGB = colorSpace->RGBFromXYZ * sensor->XYZFromSensorRGB;
+    if (p.splatBufferMB > 0)
+        splatBuffer = alloc.new_object<SplatBuffer>(
+            pixelBounds, size_t(p.splatBufferMB * 1024 * 1024),
+            [this](Point2i pPixel, const RGB &v) {
+                pixels.AddSplat(pPixel, v);
+            });
 }
 
 SampledWavelengths GBufferFilm::SampleWavelengths(Float u) const {
@@ -679,9 +860,11 @@ void GBufferFilm::AddSplat(const Point2f &p, SampledSpectrum v,
     for (Point2i pi : splatBounds) {
         Float wt = filter.Evaluate(Point2f(p - pi - Vector2f(0.5, 0.5)));
         if (wt != 0) {
-            Pixel &pixel = pixels[pi];
-            for (int i = 0; i < 3; ++i)
-                pixel.splatRGB[i].Add(wt * rgb[i]);
+#ifndef PBRT_IS_GPU_CODE
+            if (splatBuffer && splatBuffer->Add(pi, wt * rgb))
+                continue;
+#endif
+            pixels.AddSplat(pi, wt * rgb);
         }
     }
 }
@@ -695,6 +878,7 @@ void GBufferFilm::WriteImage(ImageMetadata metadata, Float splatScale) {
 Image GBufferFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
     // Convert image to RGB and compute final pixel values
     LOG_VERBOSE("Converting image to RGB and computing final weighted pixel values");
+    FlushSplats();
     PixelFormat format = writeFP16 ? PixelFormat::Half : PixelFormat::Float;
 
     Image image(format, Point2i(pixelBounds.Diagonal()),
@@ -735,14 +919,13 @@ Image GBufferFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
         {"RelativeVariance.R", "RelativeVariance.G", "RelativeVariance.B"});
 
     ParallelFor2D(pixelBounds, [&](Point2i p) {
-        Pixel &pixel = pixels[p];
-        RGB rgb(pixel.rgbSum[0], pixel.rgbSum[1], pixel.rgbSum[2]);
-        RGB albedoRgb(pixel.albedoSum[0], pixel.albedoSum[1], pixel.albedoSum[2]);
+        RGB rgb = pixels.RGBSum(p);
+        RGB albedoRgb = albedoSum.Sum(p);
 
         // Normalize pixel with weight sum
-        Float weightSum = pixel.weightSum;
-        Point3f pt = pixel.pSum;
-        Float dzdx = pixel.dzdxSum, dzdy = pixel.dzdySum;
+        Float weightSum = pixels.WeightSum(p);
+        Point3f pt = pSum[p];
+        Float dzdx = dzSum[p].x, dzdy = dzSum[p].y;
         if (weightSum != 0) {
             rgb /= weightSum;
             albedoRgb /= weightSum;
@@ -752,8 +935,7 @@ Image GBufferFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
         }
 
         // Add splat value at pixel
-        for (int c = 0; c < 3; ++c)
-            rgb[c] += splatScale * pixel.splatRGB[c] / filterIntegral;
+        rgb += splatScale * pixels.SplatRGB(p) / filterIntegral;
 
         rgb = outputRGBFromSensorRGB * rgb;
 
@@ -762,24 +944,25 @@ Image GBufferFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
         image.SetChannels(pOffset, albedoRgbDesc,
                           {albedoRgb[0], albedoRgb[1], albedoRgb[2]});
 
-        Normal3f n =
-            LengthSquared(pixel.nSum) > 0 ? Normalize(pixel.nSum) : Normal3f(0, 0, 0);
+        Normal3f n = LengthSquared(nSum[p]) > 0 ? Normalize(nSum[p]) : Normal3f(0, 0, 0);
         Normal3f ns =
-            LengthSquared(pixel.nsSum) > 0 ? Normalize(pixel.nsSum) : Normal3f(0, 0, 0);
+            LengthSquared(nsSum[p]) > 0 ? Normalize(nsSum[p]) : Normal3f(0, 0, 0);
         image.SetChannels(pOffset, nDesc, {n.x, n.y, n.z});
         image.SetChannels(pOffset, nsDesc, {ns.x, ns.y, ns.z});
 
         image.SetChannels(pOffset, pDesc, {pt.x, pt.y, pt.z});
         image.SetChannels(pOffset, dzDesc, {std::abs(dzdx), std::abs(dzdy)});
 
-        image.SetChannels(
-            pOffset, varianceDesc,
-            {pixel.varianceEstimator[0].Variance(), pixel.varianceEstimator[1].Variance(),
-             pixel.varianceEstimator[2].Variance()});
+        const pstd::array<VarianceEstimator<Float>, 3> &varianceEstimator =
+            varianceEstimators[p];
+        image.SetChannels(pOffset, varianceDesc,
+                          {varianceEstimator[0].Variance(),
+                           varianceEstimator[1].Variance(),
+                           varianceEstimator[2].Variance()});
         image.SetChannels(pOffset, relVarianceDesc,
-                          {pixel.varianceEstimator[0].RelativeVariance(),
-                           pixel.varianceEstimator[1].RelativeVariance(),
-                           pixel.varianceEstimator[2].RelativeVariance()});
+                          {varianceEstimator[0].RelativeVariance(),
+                           varianceEstimator[1].RelativeVariance(),
+                           varianceEstimator[2].RelativeVariance()});
 
     });
 
@@ -842,43 +1025,48 @@ void GBufferMitsubaFilm::AddSample(const Point2i &pFilm, SampledSpectrum L,
         rgb *= maxComponentValue / m;
     }
 
-    Pixel &p = pixels[pFilm];
+    // Only update the planes of the requested fields
     if (visibleSurface && *visibleSurface) {
         // Update variance estimates.
-        for (int c = 0; c < 3; ++c)
-            p.varianceEstimator[c].Add(rgb[c]);
-
-        p.pSum += weight * visibleSurface->p;
-        p.pWorldSum += weight * visibleSurface->p_world;
-
-        p.nSum += weight * visibleSurface->_n;
-        p.nsSum += weight * visibleSurface->_ns;
-
-        p.dzdxSum += weight * visibleSurface->dzdx;
-        p.dzdySum += weight * visibleSurface->dzdy;
-
-        p.uvSum += weight * visibleSurface->texcoords;
-
-        SampledSpectrum albedo =
-            visibleSurface->albedo * colorSpace->illuminant.Sample(lambda);
-        RGB albedoRGB = albedo.ToRGB(lambda, *colorSpace);
-        for (int c = 0; c < 3; ++c)
-            p.albedoSum[c] += weight * albedoRGB[c];
-
-        
+        if (HasField(Field::Variance) || HasField(Field::RelativeVariance))
+            for (int c = 0; c < 3; ++c)
+                varianceEstimators[pFilm][c].Add(rgb[c]);
+
+        if (HasField(Field::RelPosition))
+            pSum[pFilm] += weight * visibleSurface->p;
+        if (HasField(Field::Position))
+            pWorldSum[pFilm] += weight * visibleSurface->p_world;
+
+        if (HasField(Field::Normal))
+            nSum[pFilm] += weight * visibleSurface->_n;
+        if (HasField(Field::shNormal))
+            nsSum[pFilm] += weight * visibleSurface->_ns;
+
+        if (HasField(Field::Gradient))
+            dzSum[pFilm] += weight * Vector2f(visibleSurface->dzdx, visibleSurface->dzdy);
+
+        if (HasField(Field::UV))
+            uvSum[pFilm] += weight * visibleSurface->texcoords;
+
+        if (HasField(Field::Albedo)) {
+            SampledSpectrum albedo =
+                visibleSurface->albedo * colorSpace->illuminant.Sample(lambda);
+            RGB albedoRGB = albedo.ToRGB(lambda, *colorSpace);
+            albedoSum.Add(pFilm, weight * albedoRGB);
+        }
 
-        SampledSpectrum diffuse_albedo =
-            visibleSurface->diffuse_albedo * colorSpace->illuminant.Sample(lambda);
-        RGB diffuseAlbedoRGB = diffuse_albedo.ToRGB(lambda, *colorSpace);
-        for (int c = 0; c < 3; ++c)
-            p.diffuseAlbedoSum[c] += weight * diffuseAlbedoRGB[c];
+        if (HasField(Field::Diffuse)) {
+            SampledSpectrum diffuse_albedo =
+                visibleSurface->diffuse_albedo * colorSpace->illuminant.Sample(lambda);
+            RGB diffuseAlbedoRGB = diffuse_albedo.ToRGB(lambda, *colorSpace);
+            diffuseAlbedoSum.Add(pFilm, weight * diffuseAlbedoRGB);
+        }
 
-        p.roughnessSum += weight * visibleSurface->roughness;
+        if (HasField(Field::Roughness))
+            roughnessSum[pFilm] += weight * visibleSurface->roughness;
     }
 
-    for (int c = 0; c < 3; ++c)
-        p.rgbSum[c] += rgb[c] * weight;
-    p.weightSum += weight;
+    pixels.AddSample(pFilm, rgb, weight);
 }
 
 
@@ -886,15 +1074,77 @@ GBufferMitsubaFilm::GBufferMitsubaFilm(FilmBaseParameters p, const RGBColorSpace
 const std::vector<std::string>& fields,
                          Float maxComponentValue, bool writeFP16,  Allocator alloc)
     : FilmBase(p),
-      pixels(pixelBounds, alloc),
+      fields(fields),
+      fieldMask([&]() {
+          uint32_t mask = 0;
+          for (const std::string &name : fields)
+              if (pstd::optional<Field> field = FieldFromName(name); field)
+                  mask |= uint32_t(*field);
+          return mask;
+      }()),
+      pixels(pixelBounds, p.singlePrecisionPixels, 0, alloc),
+      pSum(PlaneBounds({Field::RelPosition}), alloc),
+      pWorldSum(PlaneBounds({Field::Position}), alloc),
+      dzSum(PlaneBounds({Field::Gradient}), alloc),
+      nSum(PlaneBounds({Field::Normal}), alloc),
+      nsSum(PlaneBounds({Field::shNormal}), alloc),
+      uvSum(PlaneBounds({Field::UV}), alloc),
+      roughnessSum(PlaneBounds({Field::Roughness}), alloc),
+      albedoSum(PlaneBounds({Field::Albedo}), p.singlePrecisionPixels, alloc),
+      diffuseAlbedoSum(PlaneBounds({Field::Diffuse}), p.singlePrecisionPixels, alloc),
+      varianceEstimators(PlaneBounds({Field::Variance, Field::RelativeVariance}), alloc),
       colorSpace(colorSpace),
       maxComponentValue(maxComponentValue),
       writeFP16(writeFP16),
-      filterIntegral(filter.Integral()), 
-      fields(fields) {
+      filterIntegral(filter.Integral()) {
     CHECK(!pixelBounds.IsEmpty());
-    filmPixelMemory += pixelBounds.Area() * sizeof(Pixel);
+    // Only have the _VisibleSurface_ attributes that the fields use computed
+    if (HasField(Field::Position) || HasField(Field::RelPosition) ||
+        HasField(Field::Normal) || HasField(Field::shNormal) ||
+        HasField(Field::Gradient) || HasField(Field::UV))
+        visibleSurfaceFields |= VisibleSurfaceFields::Geometry;
+    if (HasField(Field::Albedo))
+        visibleSurfaceFields |= VisibleSurfaceFields::Albedo;
+    if (HasField(Field::Diffuse))
+        visibleSurfaceFields |= VisibleSurfaceFields::DiffuseAlbedo;
+    if (HasField(Field::Roughness))
+        visibleSurfaceFields |= VisibleSurfaceFields::Roughness;
+
+    filmPixelMemory +=
+        pixels.BytesUsed() + pSum.size() * sizeof(Point3f) +
+        pWorldSum.size() * sizeof(Point3f) + dzSum.size() * sizeof(Vector2f) +
+        (nSum.size() + nsSum.size()) * sizeof(Normal3f) +
+        (uvSum.size() + roughnessSum.size()) * sizeof(Point2f) +
+        albedoSum.BytesUsed() + diffuseAlbedoSum.BytesUsed() +
+        varianceEstimators.size() * sizeof(pstd::array<VarianceEstimator<Float>, 3>);
     outputRGBFromSensorRGB = colorSpace->RGBFromXYZ * sensor->XYZFromSensorRGB;
+    if (p.splatBufferMB > 0)
+        splatBuffer = alloc.new_object<SplatBuffer>(
+            pixelBounds, size_t(p.splatBufferMB * 1024 * 1024),
+            [this](Point2i pPixel, const RGB &v) {
+                pixels.AddSplat(pPixel, v);
+            });
+}
+
+pstd::optional<GBufferMitsubaFilm::Field> GBufferMitsubaFilm::FieldFromName(
+    const std::string &name) {
+    static const std::map<std::string, Field> fieldNames = {
+        {"Image", Field::Image},
+        {"Albedo", Field::Albedo},
+        {"Diffuse", Field::Diffuse},
+        {"Position", Field::Position},
+        {"RelPosition", Field::RelPosition},
+        {"shNormal", Field::shNormal},
+        {"Normal", Field::Normal},
+        {"Variance", Field::Variance},
+        {"RelativeVariance", Field::RelativeVariance},
+        {"gradient", Field::Gradient},
+        {"UV", Field::UV},
+        {"Roughness", Field::Roughness}};
+    auto iter = fieldNames.find(name);
+    if (iter == fieldNames.end())
+        return {};
+    return iter->second;
 }
 
 SampledWavelengths GBufferMitsubaFilm::SampleWavelengths(Float u) const {
@@ -919,9 +1169,11 @@ void GBufferMitsubaFilm::AddSplat(const Point2f &p, SampledSpectrum v,
     for (Point2i pi : splatBounds) {
         Float wt = filter.Evaluate(Point2f(p - pi - Vector2f(0.5, 0.5)));
         if (wt != 0) {
-            Pixel &pixel = pixels[pi];
-            for (int i = 0; i < 3; ++i)
-                pixel.splatRGB[i].Add(wt * rgb[i]);
+#ifndef PBRT_IS_GPU_CODE
+            if (splatBuffer && splatBuffer->Add(pi, wt * rgb))
+                continue;
+#endif
+            pixels.AddSplat(pi, wt * rgb);
         }
     }
 }
@@ -935,6 +1187,7 @@ void GBufferMitsubaFilm::WriteImage(ImageMetadata metadata, Float splatScale) {
 Image GBufferMitsubaFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
     // Convert image to RGB and compute final pixel values
     LOG_VERBOSE("Converting image to RGB and computing final weighted pixel values");
+    FlushSplats();
     PixelFormat format = writeFP16 ? PixelFormat::Half : PixelFormat::Float;
 
     std::vector<std::string> channels;
@@ -1023,101 +1276,111 @@ Image GBufferMitsubaFilm::GetImage(ImageMetadata *metadata, Float splatScale) {
     ImageChannelDesc uvDesc = image.GetChannelDesc({"UV.R", "UV.G", "UV.B"});
     ImageChannelDesc roughnessDesc = image.GetChannelDesc({"Roughness.R", "Roughness.G", "Roughness.B"});
 
-    ParallelFor2D(pixelBounds, [&](Point2i p) {
-        Pixel &pixel = pixels[p];
-        RGB rgb(pixel.rgbSum[0], pixel.rgbSum[1], pixel.rgbSum[2]);
-        RGB albedoRgb(pixel.albedoSum[0], pixel.albedoSum[1], pixel.albedoSum[2]);
-        RGB diffuseAlbedoRgb(pixel.diffuseAlbedoSum[0], pixel.diffuseAlbedoSum[1], pixel.diffuseAlbedoSum[2] );
+    std::vector<Field> fieldIds;
+    for (const std::string &name : fields)
+        if (pstd::optional<Field> field = FieldFromName(name); field)
+            fieldIds.push_back(*field);
 
+    ParallelFor2D(pixelBounds, [&](Point2i p) {
         // Normalize pixel with weight sum
-        Float weightSum = pixel.weightSum;
-        Point3f pt = pixel.pSum;
-        Point3f pt_world = pixel.pWorldSum;
-        Float dzdx = pixel.dzdxSum, dzdy = pixel.dzdySum;
-        Point2f uv = pixel.uvSum;
-        Point2f roughness = pixel.roughnessSum;
-
-        if (weightSum != 0) {
-            rgb /= weightSum;
-            albedoRgb /= weightSum;
-            pt /= weightSum;
-            pt_world /= weightSum;
-            dzdx /= weightSum;
-            dzdy /= weightSum;
-            uv /= weightSum;
-            diffuseAlbedoRgb /= weightSum;
-            roughness /= weightSum;
-        }
-
-        // Add splat value at pixel
-        for (int c = 0; c < 3; ++c)
-            rgb[c] += splatScale * pixel.splatRGB[c] / filterIntegral;
-
-        rgb = outputRGBFromSensorRGB * rgb;
+        Float weightSum = pixels.WeightSum(p);
+        Float invWeightSum = weightSum != 0 ? 1 / weightSum : 1;
 
         Point2i pOffset(p.x - pixelBounds.pMin.x, p.y - pixelBounds.pMin.y);
 
+        for (Field field : fieldIds) {
+            switch (field) {
+            case Field::Image: {
+                RGB rgb = pixels.RGBSum(p);
+                if (weightSum != 0)
+                    rgb /= weightSum;
 
+                // Add splat value at pixel
+                rgb += splatScale * pixels.SplatRGB(p) / filterIntegral;
 
-        for(auto field : fields) {
-            if(field == "Image") {
+                rgb = outputRGBFromSensorRGB * rgb;
                 image.SetChannels(pOffset, rgbDesc, {rgb[0], rgb[1], rgb[2]});
+                break;
             }
-            else if(field == "Albedo") {
+            case Field::Albedo: {
+                RGB albedo = albedoSum.Sum(p);
                 image.SetChannels(pOffset, albedoRgbDesc,
-                    {albedoRgb[0], albedoRgb[1], albedoRgb[2]});
+                                  {Float(albedo[0] * invWeightSum),
+                                   Float(albedo[1] * invWeightSum),
+                                   Float(albedo[2] * invWeightSum)});
+                break;
             }
-             else if(field == "Diffuse") {
+            case Field::Diffuse: {
+                RGB diffuseAlbedo = diffuseAlbedoSum.Sum(p);
                 image.SetChannels(pOffset, diffuseAlbedoRgbDesc,
-                    {diffuseAlbedoRgb[0], diffuseAlbedoRgb[1], diffuseAlbedoRgb[2]});
+                                  {Float(diffuseAlbedo[0] * invWeightSum),
+                                   Float(diffuseAlbedo[1] * invWeightSum),
+                                   Float(diffuseAlbedo[2] * invWeightSum)});
+                break;
             }
-            else if(field == "RelPosition") {
-                image.SetChannels(pOffset, pDesc, {-pt.x, pt.y, pt.z});   // !!! left hand to right hand              
+            case Field::RelPosition: {
+                Point3f pt = pSum[p] * invWeightSum;
+                // !!! left hand to right hand
+                image.SetChannels(pOffset, pDesc, {-pt.x, pt.y, pt.z});
+                break;
             }
-            else if(field == "Position") {
-                image.SetChannels(pOffset, pWorldDesc, {pt_world.x, pt_world.y, pt_world.z});            
+            case Field::Position: {
+                Point3f pt_world = pWorldSum[p] * invWeightSum;
+                image.SetChannels(pOffset, pWorldDesc,
+                                  {pt_world.x, pt_world.y, pt_world.z});
+                break;
             }
-            else if(field == "shNormal") {
+            case Field::shNormal: {
                 Normal3f ns =
-                    LengthSquared(pixel.nsSum) > 0 ? Normalize(pixel.nsSum) : Normal3f(0, 0, 0);
+                    LengthSquared(nsSum[p]) > 0 ? Normalize(nsSum[p]) : Normal3f(0, 0, 0);
                 image.SetChannels(pOffset, nsDesc, {ns.x, ns.y, ns.z});
+                break;
             }
-            else if(field == "Normal") {
+            case Field::Normal: {
                 Normal3f n =
-                    LengthSquared(pixel.nSum) > 0 ? Normalize(pixel.nSum) : Normal3f(0, 0, 0);
+                    LengthSquared(nSum[p]) > 0 ? Normalize(nSum[p]) : Normal3f(0, 0, 0);
                 image.SetChannels(pOffset, nDesc, {n.x, n.y, n.z});
+                break;
             }
-            else if(field == "Variance") {
-                image.SetChannels(
-                    pOffset, varianceDesc,
-                    {pixel.varianceEstimator[0].Variance(), pixel.varianceEstimator[1].Variance(),
-                    pixel.varianceEstimator[2].Variance()});    
+            case Field::Variance: {
+                const pstd::array<VarianceEstimator<Float>, 3> &varianceEstimator =
+                    varianceEstimators[p];
+                image.SetChannels(pOffset, varianceDesc,
+                                  {varianceEstimator[0].Variance(),
+                                   varianceEstimator[1].Variance(),
+                                   varianceEstimator[2].Variance()});
+                break;
             }
-            else if(field == "RelativeVariance") {
+            case Field::RelativeVariance: {
+                const pstd::array<VarianceEstimator<Float>, 3> &varianceEstimator =
+                    varianceEstimators[p];
                 image.SetChannels(pOffset, relVarianceDesc,
-                    {pixel.varianceEstimator[0].RelativeVariance(),
-                    pixel.varianceEstimator[1].RelativeVariance(),
-                    pixel.varianceEstimator[2].RelativeVariance()});  
+                                  {varianceEstimator[0].RelativeVariance(),
+                                   varianceEstimator[1].RelativeVariance(),
+                                   varianceEstimator[2].RelativeVariance()});
+                break;
             }
-            else if(field == "gradient") {
-                image.SetChannels(pOffset, dzDesc, {std::abs(dzdx), std::abs(dzdy)});
+            case Field::Gradient: {
+                Vector2f dz = dzSum[p] * invWeightSum;
+                image.SetChannels(pOffset, dzDesc, {std::abs(dz.x), std::abs(dz.y)});
+                break;
             }
-            else if (field == "UV") {
-                 image.SetChannels(pOffset, uvDesc, {uv.x, uv.y, 0.0});
+            case Field::UV: {
+                Point2f uv = uvSum[p] * invWeightSum;
+                image.SetChannels(pOffset, uvDesc, {uv.x, uv.y, 0.0});
+                break;
             }
-            else if (field == "Roughness") {
+            case Field::Roughness: {
+                Point2f roughness = roughnessSum[p] * invWeightSum;
                 if(1.0 - roughness.x < 0 || 1.0 - roughness.y < 0) {
                      std::cout<<"Negtive value in roughness" <<std::endl;
                 }
-                 image.SetChannels(pOffset, roughnessDesc, {1.0f - roughness.x, 1.0f - roughness.y, 0.0}); 
+                image.SetChannels(pOffset, roughnessDesc,
+                                  {1.0f - roughness.x, 1.0f - roughness.y, 0.0});
+                break;
             }
-            else {
-                std::cout<<"Unknown field [" << field << ", ignored" <<std::endl;
             }
-         }
-
-     
-
+        }
     });
 
     metadata->pixelBounds = pixelBounds;
@@ -1150,6 +1413,9 @@ GBufferMitsubaFilm *GBufferMitsubaFilm::Create(const ParameterDictionary &parame
         fields.push_back("UV");
         fields.push_back("Roughness");
     }
+    for (const std::string &field : fields)
+        if (!FieldFromName(field))
+            Warning(loc, "%s: unknown field for GBufferMitsubaFilm ignored.", field);
 
     PixelSensor *sensor =
         PixelSensor::Create(parameters, colorSpace, exposureTime, loc, alloc);
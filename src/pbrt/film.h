@@ -25,6 +25,7 @@
 #include <pbrt/util/vecmath.h>
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <string>
 #include <thread>
@@ -128,10 +129,37 @@ inline Triplet PixelSensor::ProjectReflectance(SpectrumHandle refl, SpectrumHand
 class VisibleSurface {
   public:
     // VisibleSurface Public Methods
-    PBRT_CPU_GPU
-    VisibleSurface(const SurfaceInteraction &si, const CameraTransform &cameraTransform,
-                   const SampledSpectrum &albedo, const SampledSpectrum &diffuse_albedo,  
-                   const Point2f& roughness, const SampledWavelengths &lambda);
+    // Returns a _VisibleSurface_ with only the attributes in _Fields_
+    // initialized. The albedos and roughness are given by functions that
+    // are only called if they are needed, since they may be expensive to
+    // compute.
+    template <VisibleSurfaceFields Fields, typename AlbedoFunc,
+              typename DiffuseAlbedoFunc, typename RoughnessFunc>
+    PBRT_CPU_GPU static VisibleSurface Create(const SurfaceInteraction &si,
+                                              const CameraTransform &cameraTransform,
+                                              AlbedoFunc albedo,
+                                              DiffuseAlbedoFunc diffuseAlbedo,
+                                              RoughnessFunc roughness) {
+        VisibleSurface vs;
+        vs.set = true;
+        if constexpr ((Fields & VisibleSurfaceFields::Geometry) != 0)
+            vs.InitializeGeometry(si, cameraTransform);
+        if constexpr ((Fields & VisibleSurfaceFields::Albedo) != 0)
+            vs.albedo = albedo();
+        if constexpr ((Fields & VisibleSurfaceFields::DiffuseAlbedo) != 0)
+            vs.diffuse_albedo = diffuseAlbedo();
+        if constexpr ((Fields & VisibleSurfaceFields::Roughness) != 0)
+            vs.roughness = roughness();
+        return vs;
+    }
+
+    // Calls the _Create()_ specialization for fields that are only known
+    // at runtime, e.g. from _FilmHandle::UsedVisibleSurfaceFields()_.
+    template <typename... Args>
+    PBRT_CPU_GPU static VisibleSurface Create(VisibleSurfaceFields fields,
+                                              Args &&... args) {
+        return CreateSpecialized<0, 0>(uint32_t(fields), std::forward<Args>(args)...);
+    }
 
     PBRT_CPU_GPU
     operator bool() const { return set; }
@@ -152,6 +180,28 @@ class VisibleSurface {
     SampledSpectrum albedo;
     SampledSpectrum diffuse_albedo;
     Point2f roughness;
+
+  private:
+    // VisibleSurface Private Methods
+    PBRT_CPU_GPU
+    void InitializeGeometry(const SurfaceInteraction &si,
+                            const CameraTransform &cameraTransform);
+
+    // Tests the bits of _fields_ one at a time to find the matching
+    // specialization; _Fields_ holds the bits found so far.
+    template <uint32_t Fields, int Bit, typename... Args>
+    PBRT_CPU_GPU static VisibleSurface CreateSpecialized(uint32_t fields,
+                                                         Args &&... args) {
+        if constexpr ((1u << Bit) > uint32_t(VisibleSurfaceFields::All))
+            return Create<VisibleSurfaceFields(Fields)>(std::forward<Args>(args)...);
+        else {
+            if (fields & (1u << Bit))
+                return CreateSpecialized<Fields | (1u << Bit), Bit + 1>(
+                    fields, std::forward<Args>(args)...);
+            return CreateSpecialized<Fields, Bit + 1>(fields,
+                                                      std::forward<Args>(args)...);
+        }
+    }
 };
 
 // FilmBaseParameters Definition
@@ -173,6 +223,324 @@ struct FilmBaseParameters {
     Float diagonal;
     const PixelSensor *sensor;
     std::string filename;
+    // Memory for per-thread splat accumulation; zero disables it.
+    Float splatBufferMB = 0;
+    bool singlePrecisionPixels = false;
+};
+
+// SplatBuffer Definition
+// Splatted values are accumulated in a sparse set of pixel tiles for each
+// thread, so that light-tracing integrators don't need to atomically update
+// film pixels for most of their splats. Threads claim tiles as they first
+// splat to them until they have used their share of the memory budget;
+// Add() returns false for splats to other tiles, which the caller should
+// then add to the film itself. Values are buffered in double precision.
+// Flush() adds all buffered values to the film and must not be called
+// concurrently with Add(); image tile integrators call it after each wave.
+class SplatBuffer {
+  public:
+    // SplatBuffer Public Methods
+    SplatBuffer(Bounds2i pixelBounds, size_t maxBytes,
+                std::function<void(Point2i, const RGB &)> flushPixel);
+
+    bool Add(Point2i p, const RGB &v) {
+        DCHECK_LT(ThreadIndex, threadBuffers.size());
+        ThreadBuffer &buffer = threadBuffers[ThreadIndex];
+        if (buffer.tileSlots.empty())
+            buffer.tileSlots.resize(nTiles.x * nTiles.y, -1);
+
+        // Find the thread's slot for the tile that contains _p_
+        Vector2i pb = p - pixelBounds.pMin;
+        int tile = (pb.y / TileSize) * nTiles.x + pb.x / TileSize;
+        int slot = buffer.tileSlots[tile];
+        if (slot == -1) {
+            if (buffer.liveTiles.size() == maxTilesPerThread)
+                return false;
+            slot = buffer.liveTiles.size();
+            buffer.liveTiles.push_back(tile);
+            buffer.tileSlots[tile] = slot;
+            if (buffer.values.size() < (slot + 1) * TileValues)
+                buffer.values.resize((slot + 1) * TileValues, 0.);
+        }
+
+        int offset = 3 * ((pb.y % TileSize) * TileSize + pb.x % TileSize);
+        double *value = &buffer.values[slot * TileValues + offset];
+        for (int c = 0; c < 3; ++c)
+            value[c] += v[c];
+        return true;
+    }
+
+    void Flush();
+    void Clear();
+
+  private:
+    // SplatBuffer Private Members
+    static constexpr int TileSize = 16;
+    static constexpr size_t TileValues = 3 * TileSize * TileSize;
+
+    // SplatBuffer::ThreadBuffer Definition
+    struct alignas(64) ThreadBuffer {
+        // Slot in _values_ for each tile in the film, or -1.
+        std::vector<int> tileSlots;
+        std::vector<int> liveTiles;
+        std::vector<double> values;
+    };
+
+    Bounds2i pixelBounds;
+    Vector2i nTiles;
+    size_t maxTilesPerThread;
+    std::function<void(Point2i, const RGB &)> flushPixel;
+    std::vector<ThreadBuffer> threadBuffers;
+};
+
+// RGBPixelSums Definition
+// Filter-weighted sums of the RGB samples, of the filter weights, and of
+// the splats at each of a film's pixels. These are stored in double
+// precision (56 bytes per pixel) unless single precision is requested,
+// which halves that to 28 bytes. To limit the precision lost in the
+// single-precision sums, each thread sums the samples that it adds to a
+// pixel in a separate partial sum, which is only added to the pixel's
+// totals once the thread moves on to another pixel, after
+// _MaxPartialSamples_ samples, or when _FoldPartialSums()_ is called at
+// the end of a wave. Large totals then see one rounding error per wave
+// or per 1024 samples rather than one per sample.
+//
+// If a tile size is given, storage is only provided for one tile per
+// thread: tiles must be mapped to a thread's slot before samples are
+// added to their pixels, and they no longer have storage once unmapped.
+class RGBPixelSums {
+  public:
+    // RGBPixelSums Public Methods
+    RGBPixelSums(Allocator alloc = {})
+        : doublePixels(alloc), floatPixels(alloc), partialSums(alloc), tileSlots(alloc) {}
+    RGBPixelSums(const Bounds2i &bounds, bool singlePrecision, int tileSize = 0,
+                 Allocator alloc = {});
+
+    void MapTile(const Bounds2i &tileBounds, int slot);
+    void UnmapTile(const Bounds2i &tileBounds);
+
+    PBRT_CPU_GPU
+    void AddSample(const Point2i &p, const RGB &rgb, Float weight) {
+        if (singlePrecision) {
+#ifdef PBRT_IS_GPU_CODE
+            FloatPixel &pixel = floatPixels[StoragePoint(p)];
+            for (int c = 0; c < 3; ++c)
+                pixel.rgbSum[c] += weight * rgb[c];
+            pixel.weightSum += weight;
+#else
+            PartialSum &partial = partialSums[ThreadIndex];
+            if (partial.active && partial.p != p)
+                FoldPartialSum(partial);
+            partial.p = p;
+            partial.active = true;
+            for (int c = 0; c < 3; ++c)
+                partial.rgbSum[c] += weight * rgb[c];
+            partial.weightSum += weight;
+            if (++partial.nSamples == MaxPartialSamples)
+                FoldPartialSum(partial);
+#endif
+        } else {
+            DoublePixel &pixel = doublePixels[StoragePoint(p)];
+            for (int c = 0; c < 3; ++c)
+                pixel.rgbSum[c] += weight * rgb[c];
+            pixel.weightSum += weight;
+        }
+    }
+
+    PBRT_CPU_GPU
+    void AddSplat(const Point2i &p, const RGB &v) {
+        for (int c = 0; c < 3; ++c)
+            if (singlePrecision)
+                floatPixels[StoragePoint(p)].splatRGB[c].Add(v[c]);
+            else
+                doublePixels[StoragePoint(p)].splatRGB[c].Add(v[c]);
+    }
+
+    PBRT_CPU_GPU
+    RGB RGBSum(const Point2i &p) const {
+        if (singlePrecision) {
+            const FloatPixel &pixel = floatPixels[StoragePoint(p)];
+            return RGB(pixel.rgbSum[0], pixel.rgbSum[1], pixel.rgbSum[2]);
+        }
+        const DoublePixel &pixel = doublePixels[StoragePoint(p)];
+        return RGB(pixel.rgbSum[0], pixel.rgbSum[1], pixel.rgbSum[2]);
+    }
+
+    PBRT_CPU_GPU
+    Float WeightSum(const Point2i &p) const {
+        return singlePrecision ? floatPixels[StoragePoint(p)].weightSum
+                               : doublePixels[StoragePoint(p)].weightSum;
+    }
+
+    PBRT_CPU_GPU
+    RGB SplatRGB(const Point2i &p) const {
+        if (singlePrecision) {
+            const FloatPixel &pixel = floatPixels[StoragePoint(p)];
+            return RGB(pixel.splatRGB[0], pixel.splatRGB[1], pixel.splatRGB[2]);
+        }
+        const DoublePixel &pixel = doublePixels[StoragePoint(p)];
+        return RGB(pixel.splatRGB[0], pixel.splatRGB[1], pixel.splatRGB[2]);
+    }
+
+    // Adds the threads' partial sums to the pixels. This must not be called
+    // concurrently with _AddSample()_; _FoldPartialSum()_ may be called by
+    // a thread for its own partial sum.
+    void FoldPartialSums() {
+        for (PartialSum &partial : partialSums)
+            FoldPartialSum(partial);
+    }
+    void FoldPartialSum(int threadIndex) {
+        if (!partialSums.empty())
+            FoldPartialSum(partialSums[threadIndex]);
+    }
+
+    PBRT_CPU_GPU
+    void Reset() {
+        for (DoublePixel &pixel : doublePixels)
+            pixel.Clear();
+        for (FloatPixel &pixel : floatPixels)
+            pixel.Clear();
+        for (PartialSum &partial : partialSums)
+            partial.Clear();
+    }
+
+    size_t BytesUsed() const {
+        return doublePixels.size() * sizeof(DoublePixel) +
+               floatPixels.size() * sizeof(FloatPixel);
+    }
+
+  private:
+    // RGBPixelSums Private Methods
+    PBRT_CPU_GPU
+    Point2i StoragePoint(const Point2i &p) const {
+        if (tileSize == 0)
+            return p;
+        // Find the pixel in the storage for the slot that _p_'s tile is mapped to
+        Vector2i pb = p - bounds.pMin;
+        int slot = tileSlots[(pb.y / tileSize) * nTiles.x + pb.x / tileSize];
+        DCHECK_GE(slot, 0);
+        return Point2i(pb.x % tileSize, slot * tileSize + pb.y % tileSize);
+    }
+
+    // RGBPixelSums::PartialSum Definition
+    struct alignas(64) PartialSum {
+        PBRT_CPU_GPU
+        void Clear() {
+            active = false;
+            nSamples = 0;
+            rgbSum[0] = rgbSum[1] = rgbSum[2] = 0;
+            weightSum = 0;
+        }
+
+        Point2i p;
+        bool active = false;
+        int nSamples = 0;
+        float rgbSum[3] = {0.f, 0.f, 0.f};
+        float weightSum = 0.f;
+    };
+
+    PBRT_CPU_GPU
+    void FoldPartialSum(PartialSum &partial) {
+        if (!partial.active)
+            return;
+        FloatPixel &pixel = floatPixels[StoragePoint(partial.p)];
+        for (int c = 0; c < 3; ++c)
+            pixel.rgbSum[c] += partial.rgbSum[c];
+        pixel.weightSum += partial.weightSum;
+        partial.Clear();
+    }
+
+    // RGBPixelSums::DoublePixel Definition
+    struct DoublePixel {
+        PBRT_CPU_GPU
+        void Clear() {
+            rgbSum[0] = rgbSum[1] = rgbSum[2] = 0;
+            weightSum = 0;
+            splatRGB[0] = splatRGB[1] = splatRGB[2] = 0;
+        }
+
+        double rgbSum[3] = {0., 0., 0.};
+        double weightSum = 0.;
+        AtomicDouble splatRGB[3];
+    };
+
+    // RGBPixelSums::FloatPixel Definition
+    struct FloatPixel {
+        PBRT_CPU_GPU
+        void Clear() {
+            rgbSum[0] = rgbSum[1] = rgbSum[2] = 0;
+            weightSum = 0;
+            splatRGB[0] = splatRGB[1] = splatRGB[2] = 0;
+        }
+
+        float rgbSum[3] = {0.f, 0.f, 0.f};
+        float weightSum = 0.f;
+        AtomicFloat splatRGB[3];
+    };
+
+    // RGBPixelSums Private Members
+    static constexpr int MaxPartialSamples = 1024;
+    bool singlePrecision = false;
+    // Only the array for the chosen precision is non-empty.
+    Array2D<DoublePixel> doublePixels;
+    Array2D<FloatPixel> floatPixels;
+    // One partial sum for each thread with single precision.
+    pstd::vector<PartialSum> partialSums;
+    Bounds2i bounds;
+    int tileSize = 0;
+    Vector2i nTiles;
+    // Storage slot for each tile, or -1 if it isn't mapped.
+    pstd::vector<int> tileSlots;
+};
+
+// RGBSumPlane Definition
+// Per-pixel sums of an RGB AOV such as the albedo, stored with the same
+// precision as the film's _RGBPixelSums_. A plane created with empty
+// bounds has no storage.
+class RGBSumPlane {
+  public:
+    // RGBSumPlane Public Methods
+    RGBSumPlane(Allocator alloc = {}) : doubleSums(alloc), floatSums(alloc) {}
+    RGBSumPlane(const Bounds2i &bounds, bool singlePrecision, Allocator alloc = {})
+        : singlePrecision(singlePrecision),
+          doubleSums(singlePrecision ? Bounds2i({0, 0}, {0, 0}) : bounds, alloc),
+          floatSums(singlePrecision ? bounds : Bounds2i({0, 0}, {0, 0}), alloc) {}
+
+    PBRT_CPU_GPU
+    void Add(const Point2i &p, const RGB &rgb) {
+        for (int c = 0; c < 3; ++c)
+            if (singlePrecision)
+                floatSums[p][c] += rgb[c];
+            else
+                doubleSums[p][c] += rgb[c];
+    }
+
+    PBRT_CPU_GPU
+    RGB Sum(const Point2i &p) const {
+        if (singlePrecision)
+            return RGB(floatSums[p][0], floatSums[p][1], floatSums[p][2]);
+        return RGB(doubleSums[p][0], doubleSums[p][1], doubleSums[p][2]);
+    }
+
+    PBRT_CPU_GPU
+    void Reset() {
+        for (pstd::array<double, 3> &sum : doubleSums)
+            sum = {0., 0., 0.};
+        for (pstd::array<float, 3> &sum : floatSums)
+            sum = {0.f, 0.f, 0.f};
+    }
+
+    size_t BytesUsed() const {
+        return doubleSums.size() * sizeof(pstd::array<double, 3>) +
+               floatSums.size() * sizeof(pstd::array<float, 3>);
+    }
+
+  private:
+    // RGBSumPlane Private Members
+    bool singlePrecision = false;
+    // As with _RGBPixelSums_, only one of these is non-empty.
+    Array2D<pstd::array<double, 3>> doubleSums;
+    Array2D<pstd::array<float, 3>> floatSums;
 };
 
 // FilmBase Definition
@@ -229,6 +597,10 @@ class RGBFilm : public FilmBase {
     // RGBFilm Public Methods
     PBRT_CPU_GPU
     bool UsesVisibleSurface() const { return false; }
+    PBRT_CPU_GPU
+    VisibleSurfaceFields UsedVisibleSurfaceFields() const {
+        return VisibleSurfaceFields::None;
+    }
 
     PBRT_CPU_GPU
     void AddSample(const Point2i &pFilm, SampledSpectrum L,
@@ -247,24 +619,19 @@ class RGBFilm : public FilmBase {
 
         DCHECK(InsideExclusive(pFilm, pixelBounds));
         // Update pixel values with filtered sample contribution
-        Pixel &pixel = pixels[pFilm];
-        for (int c = 0; c < 3; ++c)
-            pixel.rgbSum[c] += weight * rgb[c];
-        pixel.weightSum += weight;
+        pixels.AddSample(pFilm, rgb, weight);
     }
 
     PBRT_CPU_GPU
     RGB GetPixelRGB(const Point2i &p, Float splatScale = 1) const {
-        const Pixel &pixel = pixels[p];
-        RGB rgb(pixel.rgbSum[0], pixel.rgbSum[1], pixel.rgbSum[2]);
+        RGB rgb = pixels.RGBSum(p);
         // Normalize _rgb_ with weight sum
-        Float weightSum = pixel.weightSum;
+        Float weightSum = pixels.WeightSum(p);
         if (weightSum != 0)
             rgb /= weightSum;
 
         // Add splat value at pixel
-        for (int c = 0; c < 3; ++c)
-            rgb[c] += splatScale * pixel.splatRGB[c] / filterIntegral;
+        rgb += splatScale * pixels.SplatRGB(p) / filterIntegral;
 
         // Convert _rgb_ to output RGB color space
         rgb = outputRGBFromSensorRGB * rgb;
@@ -275,7 +642,7 @@ class RGBFilm : public FilmBase {
     RGBFilm() = default;
     RGBFilm(FilmBaseParameters p, const RGBColorSpace *colorSpace,
             Float maxComponentValue = Infinity, bool writeFP16 = true,
-            Allocator alloc = {});
+            int streamTileSize = 0, Allocator alloc = {});
 
     static RGBFilm *Create(const ParameterDictionary &parameters, Float exposureTime,
                            FilterHandle filter, const RGBColorSpace *colorSpace,
@@ -289,6 +656,20 @@ class RGBFilm : public FilmBase {
 
     void WriteImage(ImageMetadata metadata, Float splatScale = 1);
     Image GetImage(ImageMetadata *metadata, Float splatScale = 1);
+    void FlushSplats() {
+        if (splatBuffer)
+            splatBuffer->Flush();
+        pixels.FoldPartialSums();
+    }
+
+    // If the film streams tiles, it only has storage for the tiles being
+    // rendered; each is written to a tiled EXR file once it is complete
+    // rather than the whole image being written by _WriteImage()_.
+    int StreamTileSize() const { return streamTileSize; }
+    void BeginTileStream(ImageMetadata metadata);
+    void BeginTile(const Bounds2i &tileBounds);
+    void EndTile(const Bounds2i &tileBounds, Float splatScale = 1);
+    void EndTileStream();
 
     std::string ToString() const;
 
@@ -300,31 +681,33 @@ class RGBFilm : public FilmBase {
 
     PBRT_CPU_GPU
     void Reset() {
-        for(auto i = pixels.begin(); i!=pixels.end();++i) {
-            i->rgbSum[0] = i->rgbSum[1] = i->rgbSum[2] = 0;
-            i->weightSum = 0.;
-            i->splatRGB[0] = i->splatRGB[1] = i->splatRGB[2] = 0.;
-        }
+        pixels.Reset();
+#ifndef PBRT_IS_GPU_CODE
+        if (splatBuffer)
+            splatBuffer->Clear();
+#endif
     }
 
   private:
-    // RGBFilm::Pixel Definition
-    struct Pixel {
-        Pixel() = default;
-        double rgbSum[3] = {0., 0., 0.};
-        double weightSum = 0.;
-        AtomicDouble splatRGB[3];
-    };
-
     // RGBFilm Private Members
     const RGBColorSpace *colorSpace;
     Float maxComponentValue;
     bool writeFP16;
     Float filterIntegral;
     SquareMatrix<3> outputRGBFromSensorRGB;
-    Array2D<Pixel> pixels;
+    RGBPixelSums pixels;
+    SplatBuffer *splatBuffer = nullptr;
+    int streamTileSize = 0;
+    TiledEXRWriter *tileWriter = nullptr;
 };
 
+// Film Inline Functions
+template <typename T>
+PBRT_CPU_GPU inline void ClearPixelPlane(Array2D<T> &plane) {
+    for (T &value : plane)
+        value = T();
+}
+
 // GBufferFilm Definition
 class GBufferFilm : public FilmBase {
   public:
@@ -356,20 +739,22 @@ class GBufferFilm : public FilmBase {
 
     PBRT_CPU_GPU
     bool UsesVisibleSurface() const { return true; }
+    PBRT_CPU_GPU
+    VisibleSurfaceFields UsedVisibleSurfaceFields() const {
+        return VisibleSurfaceFields::Geometry | VisibleSurfaceFields::Albedo;
+    }
 
     PBRT_CPU_GPU
     RGB GetPixelRGB(const Point2i &p, Float splatScale = 1) const {
-        const Pixel &pixel = pixels[p];
-        RGB rgb(pixel.rgbSum[0], pixel.rgbSum[1], pixel.rgbSum[2]);
+        RGB rgb = pixels.RGBSum(p);
 
         // Normalize pixel with weight sum
-        Float weightSum = pixel.weightSum;
+        Float weightSum = pixels.WeightSum(p);
         if (weightSum != 0)
             rgb /= weightSum;
 
         // Add splat value at pixel
-        for (int c = 0; c < 3; ++c)
-            rgb[c] += splatScale * pixel.splatRGB[c] / filterIntegral;
+        rgb += splatScale * pixels.SplatRGB(p) / filterIntegral;
 
         rgb = outputRGBFromSensorRGB * rgb;
 
@@ -378,46 +763,46 @@ class GBufferFilm : public FilmBase {
 
     void WriteImage(ImageMetadata metadata, Float splatScale = 1);
     Image GetImage(ImageMetadata *metadata, Float splatScale = 1);
+    void FlushSplats() {
+        if (splatBuffer)
+            splatBuffer->Flush();
+        pixels.FoldPartialSums();
+    }
 
     PBRT_CPU_GPU
     void Reset() {
-        for(auto i = pixels.begin(); i!=pixels.end();++i) {
-            i->rgbSum[0] = i->rgbSum[1] = i->rgbSum[2] = 0;
-            i->weightSum = 0.;
-            i->splatRGB[0] = i->splatRGB[1] = i->splatRGB[2] = 0.;
-
-            i->pSum = Point3f();
-            i->dzdxSum = i->dzdySum = 0.;
-            i->nSum = i->nsSum = Normal3f();
-            i->albedoSum[0] = i->albedoSum[1] = i->albedoSum[2] = 0.;
-            i->varianceEstimator[0] = i->varianceEstimator[1] = i->varianceEstimator[2] =  VarianceEstimator<Float>();
-
-        }
+        pixels.Reset();
+#ifndef PBRT_IS_GPU_CODE
+        if (splatBuffer)
+            splatBuffer->Clear();
+#endif
+        ClearPixelPlane(pSum);
+        ClearPixelPlane(dzSum);
+        ClearPixelPlane(nSum);
+        ClearPixelPlane(nsSum);
+        albedoSum.Reset();
+        ClearPixelPlane(varianceEstimators);
     }
 
     std::string ToString() const;
 
   private:
-    // GBufferFilm::Pixel Definition
-    struct Pixel {
-        Pixel() = default;
-        double rgbSum[3] = {0., 0., 0.};
-        double weightSum = 0.;
-        AtomicDouble splatRGB[3];
-        Point3f pSum;
-        Float dzdxSum = 0, dzdySum = 0;
-        Normal3f nSum, nsSum;
-        double albedoSum[3] = {0., 0., 0.};
-        VarianceEstimator<Float> varianceEstimator[3];
-    };
 
     // GBufferFilm Private Members
-    Array2D<Pixel> pixels;
+    RGBPixelSums pixels;
+    // The geometric AOVs are stored in separate planes so that the RGB
+    // sums that every sample updates stay densely packed.
+    Array2D<Point3f> pSum;
+    Array2D<Vector2f> dzSum;
+    Array2D<Normal3f> nSum, nsSum;
+    RGBSumPlane albedoSum;
+    Array2D<pstd::array<VarianceEstimator<Float>, 3>> varianceEstimators;
     const RGBColorSpace *colorSpace;
     Float maxComponentValue;
     bool writeFP16;
     Float filterIntegral;
     SquareMatrix<3> outputRGBFromSensorRGB;
+    SplatBuffer *splatBuffer = nullptr;
 };
 
 
@@ -454,20 +839,20 @@ class GBufferMitsubaFilm : public FilmBase {
 
     PBRT_CPU_GPU
     bool UsesVisibleSurface() const { return true; }
+    PBRT_CPU_GPU
+    VisibleSurfaceFields UsedVisibleSurfaceFields() const { return visibleSurfaceFields; }
 
     PBRT_CPU_GPU
     RGB GetPixelRGB(const Point2i &p, Float splatScale = 1) const {
-        const Pixel &pixel = pixels[p];
-        RGB rgb(pixel.rgbSum[0], pixel.rgbSum[1], pixel.rgbSum[2]);
+        RGB rgb = pixels.RGBSum(p);
 
         // Normalize pixel with weight sum
-        Float weightSum = pixel.weightSum;
+        Float weightSum = pixels.WeightSum(p);
         if (weightSum != 0)
             rgb /= weightSum;
 
         // Add splat value at pixel
-        for (int c = 0; c < 3; ++c)
-            rgb[c] += splatScale * pixel.splatRGB[c] / filterIntegral;
+        rgb += splatScale * pixels.SplatRGB(p) / filterIntegral;
 
         rgb = outputRGBFromSensorRGB * rgb;
 
@@ -476,56 +861,85 @@ class GBufferMitsubaFilm : public FilmBase {
 
     void WriteImage(ImageMetadata metadata, Float splatScale = 1);
     Image GetImage(ImageMetadata *metadata, Float splatScale = 1);
+    void FlushSplats() {
+        if (splatBuffer)
+            splatBuffer->Flush();
+        pixels.FoldPartialSums();
+    }
 
     PBRT_CPU_GPU
     void Reset() {
-        for(auto i = pixels.begin(); i!=pixels.end();++i) {
-            i->rgbSum[0] = i->rgbSum[1] = i->rgbSum[2] = 0;
-            i->weightSum = 0.;
-            i->splatRGB[0] = i->splatRGB[1] = i->splatRGB[2] = 0.;
-
-            i->pSum = Point3f();
-            i->pWorldSum = Point3f();
-            i->dzdxSum = i->dzdySum = 0.;
-            i->nSum = i->nsSum = Normal3f();
-            i->uvSum = Point2f();
-            i->roughnessSum = Point2f();
-            i->albedoSum[0] = i->albedoSum[1] = i->albedoSum[2] = 0.;
-            i->diffuseAlbedoSum[0] = i->diffuseAlbedoSum[1] =i->diffuseAlbedoSum[2] = 0.; 
-            i->varianceEstimator[0] = i->varianceEstimator[1] = i->varianceEstimator[2] =  VarianceEstimator<Float>();
-
-        }
+        pixels.Reset();
+#ifndef PBRT_IS_GPU_CODE
+        if (splatBuffer)
+            splatBuffer->Clear();
+#endif
+        // Planes for fields that weren't requested are empty
+        ClearPixelPlane(pSum);
+        ClearPixelPlane(pWorldSum);
+        ClearPixelPlane(dzSum);
+        ClearPixelPlane(nSum);
+        ClearPixelPlane(nsSum);
+        ClearPixelPlane(uvSum);
+        ClearPixelPlane(roughnessSum);
+        albedoSum.Reset();
+        diffuseAlbedoSum.Reset();
+        ClearPixelPlane(varianceEstimators);
     }
 
     std::string ToString() const;
 
   private:
-    // GBufferMitsubaFilm::Pixel Definition
-    struct Pixel {
-        Pixel() = default;
-        double rgbSum[3] = {0., 0., 0.};
-        double weightSum = 0.;
-        AtomicDouble splatRGB[3];
-        Point3f pSum;
-        Point3f pWorldSum;
-        Float dzdxSum = 0, dzdySum = 0;
-        Normal3f nSum, nsSum;
-        Point2f uvSum;
-        Point2f roughnessSum;
-        double albedoSum[3] = {0., 0., 0.};
-        double diffuseAlbedoSum[3] = {0., 0., 0.};
-        VarianceEstimator<Float> varianceEstimator[3];
+    // GBufferMitsubaFilm::Field Definition
+    // The AOVs that can be requested with the "field" parameter.
+    enum class Field : uint32_t {
+        Image = 1 << 0,
+        Albedo = 1 << 1,
+        Diffuse = 1 << 2,
+        Position = 1 << 3,
+        RelPosition = 1 << 4,
+        shNormal = 1 << 5,
+        Normal = 1 << 6,
+        Variance = 1 << 7,
+        RelativeVariance = 1 << 8,
+        Gradient = 1 << 9,
+        UV = 1 << 10,
+        Roughness = 1 << 11
     };
+    static pstd::optional<Field> FieldFromName(const std::string &name);
+
+
+    // GBufferMitsubaFilm Private Methods
+    PBRT_CPU_GPU
+    bool HasField(Field f) const { return fieldMask & uint32_t(f); }
+
+    Bounds2i PlaneBounds(std::initializer_list<Field> users) const {
+        for (Field f : users)
+            if (HasField(f))
+                return pixelBounds;
+        return Bounds2i(Point2i(0, 0), Point2i(0, 0));
+    }
 
     // GBufferMitsubaFilm Private Members
-    Array2D<Pixel> pixels;
+    std::vector<std::string> fields;
+    uint32_t fieldMask;
+    VisibleSurfaceFields visibleSurfaceFields = VisibleSurfaceFields::None;
+    // The RGB sums are always stored since they are also used for
+    // GetPixelRGB(); each AOV is stored in its own plane, which is only
+    // allocated and updated if a field that uses it was requested.
+    RGBPixelSums pixels;
+    Array2D<Point3f> pSum, pWorldSum;
+    Array2D<Vector2f> dzSum;
+    Array2D<Normal3f> nSum, nsSum;
+    Array2D<Point2f> uvSum, roughnessSum;
+    RGBSumPlane albedoSum, diffuseAlbedoSum;
+    Array2D<pstd::array<VarianceEstimator<Float>, 3>> varianceEstimators;
     const RGBColorSpace *colorSpace;
     Float maxComponentValue;
     bool writeFP16;
     Float filterIntegral;
     SquareMatrix<3> outputRGBFromSensorRGB;
-
-    std::vector<std::string> fields;
+    SplatBuffer *splatBuffer = nullptr;
 };
 
 PBRT_CPU_GPU
@@ -570,6 +984,12 @@ inline bool FilmHandle::UsesVisibleSurface() const {
     return Dispatch(uses);
 }
 
+PBRT_CPU_GPU
+inline VisibleSurfaceFields FilmHandle::UsedVisibleSurfaceFields() const {
+    auto used = [&](auto ptr) { return ptr->UsedVisibleSurfaceFields(); };
+    return Dispatch(used);
+}
+
 PBRT_CPU_GPU
 inline RGB FilmHandle::GetPixelRGB(const Point2i &p, Float splatScale) const {
     auto get = [&](auto ptr) { return ptr->GetPixelRGB(p, splatScale); };
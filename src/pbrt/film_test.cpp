@@ -0,0 +1,46 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <pbrt/film.h>
+#include <pbrt/pbrt.h>
+#include <pbrt/util/rng.h>
+
+#include <cmath>
+
+using namespace pbrt;
+
+TEST(RGBPixelSums, SinglePrecisionMatchesDouble) {
+    Bounds2i bounds(Point2i(0, 0), Point2i(2, 1));
+    RGBPixelSums floatSums(bounds, true), doubleSums(bounds, false);
+
+    // Pixel (0, 0) has all of its samples added in one wave, as when tiles
+    // are streamed; pixel (1, 0) is rendered in waves of 256 samples.
+    const int nSamples = 1000000;
+    RNG rng;
+    for (Point2i p : bounds) {
+        for (int i = 0; i < nSamples; ++i) {
+            RGB rgb(rng.Uniform<Float>(), rng.Uniform<Float>(), rng.Uniform<Float>());
+            Float weight = rng.Uniform<Float>();
+            floatSums.AddSample(p, rgb, weight);
+            doubleSums.AddSample(p, rgb, weight);
+            if (p.x == 1 && i % 256 == 255)
+                floatSums.FoldPartialSums();
+        }
+    }
+    floatSums.FoldPartialSums();
+
+    // Summing each sample directly into a float gives relative errors of
+    // about 1e-4 here.
+    for (Point2i p : bounds) {
+        RGB f = floatSums.RGBSum(p), d = doubleSums.RGBSum(p);
+        for (int c = 0; c < 3; ++c)
+            EXPECT_LT(std::abs(f[c] - d[c]) / d[c], 1e-5) << p << " channel " << c;
+        EXPECT_LT(std::abs(floatSums.WeightSum(p) - doubleSums.WeightSum(p)) /
+                      doubleSums.WeightSum(p),
+                  1e-5)
+            << p;
+    }
+}
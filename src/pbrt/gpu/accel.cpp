@@ -249,11 +249,20 @@ OptixTraversableHandle GPUAccel::createGASForTriangles(
                     ErrorExit(&shape.loc, "Vertex positions \"P\" not provided "
                                           "for LoopSubdiv shape.");
 
+                for (int vi : vertexIndices)
+                    if (vi < 0 || vi >= P.size())
+                        ErrorExit(&shape.loc,
+                                  "Vertex index %d out of range for LoopSubdiv "
+                                  "shape with %d vertices.",
+                                  vi, int(P.size()));
+
+                Float edgeLength = shape.parameters.GetOneFloat("edgelength", 0.f);
+
                 // don't actually use this for now...
                 std::string scheme = shape.parameters.GetOneString("scheme", "loop");
 
                 mesh = LoopSubdivide(shape.renderFromObject, shape.reverseOrientation,
-                                     nLevels, vertexIndices, P, alloc);
+                                     nLevels, edgeLength, vertexIndices, P, alloc);
                 CHECK(mesh != nullptr);
             } else {
                 CHECK_EQ(shape.name, "plymesh");
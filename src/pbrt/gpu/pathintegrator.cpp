@@ -88,6 +88,7 @@ GPUPathIntegrator::GPUPathIntegrator(Allocator alloc, const ParsedScene &scene)
     film = FilmHandle::Create(scene.film.name, scene.film.parameters, exposureTime,
                               filter, &scene.film.loc, alloc);
     initializeVisibleSurface = film.UsesVisibleSurface();
+    visibleSurfaceFields = film.UsedVisibleSurfaceFields();
 
     sampler = SamplerHandle::Create(scene.sampler.name, scene.sampler.parameters,
                                     film.FullResolution(), &scene.sampler.loc, alloc);
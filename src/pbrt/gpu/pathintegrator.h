@@ -84,6 +84,7 @@ class GPUPathIntegrator {
 
     // Various properties of the scene
     bool initializeVisibleSurface;
+    VisibleSurfaceFields visibleSurfaceFields;
     bool haveSubsurface;
     bool haveMedia;
     pstd::array<bool, MaterialHandle::NumTags()> haveBasicEvalMaterial;
@@ -90,31 +90,33 @@ void GPUPathIntegrator::EvaluateMaterialAndBSDF(TextureEvaluator texEval,
                 intr.uv = me.uv;
                 // TODO: intr.time
 
-                // Estimate BSDF's albedo
-                constexpr int nRhoSamples = 16;
-                SampledSpectrum rho(0.f);
-                for (int i = 0; i < nRhoSamples; ++i) {
-                    // Generate sample for hemispherical-directional reflectance
-                    Float uc = RadicalInverse(0, i + 1);
-                    Point2f u(RadicalInverse(1, i + 1), RadicalInverse(2, i + 1));
-
-                    // Estimate one term of $\rho_\roman{hd}$
-                    pstd::optional<BSDFSample> bs = bsdf.Sample_f(me.wo, uc, u);
-                    if (bs)
-                        rho += bs->f * AbsDot(bs->wi, ns) / bs->pdf;
-                }
-                SampledSpectrum albedo = rho / nRhoSamples;
-
-                
-                SampledSpectrum diffuse_albedo(0.f);
-                if(bsdf.IsDiffuse() && bsdf.HasReflection()) {
-                    diffuse_albedo = bxdf.getDiffuseReflectance();
-                }
-              
-                Point2f roughness = bxdf.getRoughness();
+                auto albedo = [&]() {
+                    // Estimate BSDF's albedo
+                    constexpr int nRhoSamples = 16;
+                    SampledSpectrum rho(0.f);
+                    for (int i = 0; i < nRhoSamples; ++i) {
+                        // Generate sample for hemispherical-directional reflectance
+                        Float uc = RadicalInverse(0, i + 1);
+                        Point2f u(RadicalInverse(1, i + 1), RadicalInverse(2, i + 1));
+
+                        // Estimate one term of $\rho_\roman{hd}$
+                        pstd::optional<BSDFSample> bs = bsdf.Sample_f(me.wo, uc, u);
+                        if (bs)
+                            rho += bs->f * AbsDot(bs->wi, ns) / bs->pdf;
+                    }
+                    return rho / nRhoSamples;
+                };
+                auto diffuseAlbedo = [&]() {
+                    if (bsdf.IsDiffuse() && bsdf.HasReflection())
+                        return bxdf.getDiffuseReflectance();
+                    return SampledSpectrum(0.f);
+                };
+                auto roughness = [&]() { return bxdf.getRoughness(); };
 
                 pixelSampleState.visibleSurface[me.pixelIndex] =
-                    VisibleSurface(intr, camera.GetCameraTransform(), albedo, diffuse_albedo, roughness, lambda);
+                    VisibleSurface::Create(visibleSurfaceFields, intr,
+                                           camera.GetCameraTransform(), albedo,
+                                           diffuseAlbedo, roughness);
             }
 
             Vector3f wo = me.wo;
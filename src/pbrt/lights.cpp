@@ -79,12 +79,12 @@ LightBounds Union(const LightBounds &a, const LightBounds &b) {
 
 // PointLight Method Definitions
 SampledSpectrum PointLight::Phi(const SampledWavelengths &lambda) const {
-    return 4 * Pi * scale * I.Sample(lambda);
+    return 4 * Pi * scale * I->Sample(lambda);
 }
 
 LightBounds PointLight::Bounds() const {
     Point3f p = renderFromLight(Point3f(0, 0, 0));
-    return LightBounds(p, Vector3f(0, 0, 1), 4 * Pi * scale * I.MaxValue(), Pi, Pi / 2,
+    return LightBounds(p, Vector3f(0, 0, 1), 4 * Pi * scale * I->MaxValue(), Pi, Pi / 2,
                        false);
 }
 
@@ -92,7 +92,7 @@ LightLeSample PointLight::SampleLe(const Point2f &u1, const Point2f &u2,
                                    SampledWavelengths &lambda, Float time) const {
     Point3f p = renderFromLight(Point3f(0, 0, 0));
     Ray ray(p, SampleUniformSphere(u1), time, mediumInterface.outside);
-    return LightLeSample(scale * I.Sample(lambda), ray, 1, UniformSpherePDF());
+    return LightLeSample(scale * I->Sample(lambda), ray, 1, UniformSpherePDF());
 }
 
 void PointLight::PDF_Le(const Ray &, Float *pdfPos, Float *pdfDir) const {
@@ -101,7 +101,7 @@ void PointLight::PDF_Le(const Ray &, Float *pdfPos, Float *pdfDir) const {
 }
 
 std::string PointLight::ToString() const {
-    return StringPrintf("[ PointLight %s I: %s scale: %f ]", BaseToString(), I, scale);
+    return StringPrintf("[ PointLight %s I: %s scale: %f ]", BaseToString(), *I, scale);
 }
 
 PointLight *PointLight::Create(const Transform &renderFromLight, MediumHandle medium,
@@ -129,7 +129,7 @@ PointLight *PointLight::Create(const Transform &renderFromLight, MediumHandle me
 
 // DistantLight Method Definitions
 SampledSpectrum DistantLight::Phi(const SampledWavelengths &lambda) const {
-    return scale * Lemit.Sample(lambda) * Pi * sceneRadius * sceneRadius;
+    return scale * Lemit->Sample(lambda) * Pi * sceneRadius * sceneRadius;
 }
 
 LightLeSample DistantLight::SampleLe(const Point2f &u1, const Point2f &u2,
@@ -143,7 +143,7 @@ LightLeSample DistantLight::SampleLe(const Point2f &u1, const Point2f &u2,
     // Compute _DistantLight_ light ray
     Ray ray(pDisk + sceneRadius * w, -w, time);
 
-    return LightLeSample(scale * Lemit.Sample(lambda), ray,
+    return LightLeSample(scale * Lemit->Sample(lambda), ray,
                          1 / (Pi * sceneRadius * sceneRadius), 1);
 }
 
@@ -153,7 +153,7 @@ void DistantLight::PDF_Le(const Ray &, Float *pdfPos, Float *pdfDir) const {
 }
 
 std::string DistantLight::ToString() const {
-    return StringPrintf("[ DistantLight %s Lemit: %s scale: %f ]", BaseToString(), Lemit,
+    return StringPrintf("[ DistantLight %s Lemit: %s scale: %f ]", BaseToString(), *Lemit,
                         scale);
 }
 
@@ -428,7 +428,7 @@ GoniometricLight::GoniometricLight(const Transform &renderFromLight,
                                    SpectrumHandle Iemit, Float scale, Image im,
                                    Allocator alloc)
     : LightBase(LightType::DeltaPosition, renderFromLight, mediumInterface),
-      Iemit(Iemit, alloc),
+      Iemit(LookupDenselySampledSpectrum(Iemit, alloc)),
       scale(scale),
       image(std::move(im)),
       distrib(alloc) {
@@ -462,7 +462,7 @@ SampledSpectrum GoniometricLight::Phi(const SampledWavelengths &lambda) const {
     for (int y = 0; y < image.Resolution().y; ++y)
         for (int x = 0; x < image.Resolution().x; ++x)
             sumY += image.GetChannel({x, y}, 0);
-    return scale * Iemit.Sample(lambda) * 4 * Pi * sumY /
+    return scale * Iemit->Sample(lambda) * 4 * Pi * sumY /
            (image.Resolution().x * image.Resolution().y);
 }
 
@@ -471,7 +471,7 @@ LightBounds GoniometricLight::Bounds() const {
     for (int y = 0; y < image.Resolution().y; ++y)
         for (int x = 0; x < image.Resolution().x; ++x)
             sumY += image.GetChannel({x, y}, 0);
-    Float phi = scale * Iemit.MaxValue() * 4 * Pi * sumY /
+    Float phi = scale * Iemit->MaxValue() * 4 * Pi * sumY /
                 (image.Resolution().x * image.Resolution().y);
 
     Point3f p = renderFromLight(Point3f(0, 0, 0));
@@ -500,7 +500,7 @@ void GoniometricLight::PDF_Le(const Ray &ray, Float *pdfPos, Float *pdfDir) cons
 
 std::string GoniometricLight::ToString() const {
     return StringPrintf("[ GoniometricLight %s Iemit: %s scale: %f ]", BaseToString(),
-                        Iemit, scale);
+                        *Iemit, scale);
 }
 
 GoniometricLight *GoniometricLight::Create(const Transform &renderFromLight,
@@ -583,7 +583,7 @@ DiffuseAreaLight::DiffuseAreaLight(const Transform &renderFromLight,
       shape(shape),
       area(shape.Area()),
       twoSided(twoSided),
-      Lemit(Le, alloc),
+      Lemit(LookupDenselySampledSpectrum(Le, alloc)),
       scale(scale),
       image(std::move(im)),
       imageColorSpace(imageColorSpace) {
@@ -651,7 +651,7 @@ SampledSpectrum DiffuseAreaLight::Phi(const SampledWavelengths &lambda) const {
         phi /= image.Resolution().x * image.Resolution().y;
 
     } else
-        phi = Lemit.Sample(lambda);
+        phi = Lemit->Sample(lambda);
     return phi * (twoSided ? 2 : 1) * scale * area * Pi;
 }
 
@@ -665,7 +665,7 @@ LightBounds DiffuseAreaLight::Bounds() const {
                     phi += image.GetChannel({x, y}, c);
         phi /= 3 * image.Resolution().x * image.Resolution().y;
     } else
-        phi = Lemit.MaxValue();
+        phi = Lemit->MaxValue();
 
     phi *= scale * (twoSided ? 2 : 1) * area * Pi;
 
@@ -727,7 +727,7 @@ void DiffuseAreaLight::PDF_Le(const Interaction &intr, Vector3f &w, Float *pdfPo
 std::string DiffuseAreaLight::ToString() const {
     return StringPrintf("[ DiffuseAreaLight %s Lemit: %s scale: %f shape: %s "
                         "twoSided: %s area: %f image: %s ]",
-                        BaseToString(), Lemit, scale, shape, twoSided ? "true" : "false",
+                        BaseToString(), *Lemit, scale, shape, twoSided ? "true" : "false",
                         area, image);
 }
 
@@ -805,12 +805,12 @@ UniformInfiniteLight::UniformInfiniteLight(const Transform &renderFromLight,
                                            SpectrumHandle Lemit, Float scale,
                                            Allocator alloc)
     : LightBase(LightType::Infinite, renderFromLight, MediumInterface()),
-      Lemit(Lemit, alloc),
+      Lemit(LookupDenselySampledSpectrum(Lemit, alloc)),
       scale(scale) {}
 
 SampledSpectrum UniformInfiniteLight::Le(const Ray &ray,
                                          const SampledWavelengths &lambda) const {
-    return scale * Lemit.Sample(lambda);
+    return scale * Lemit->Sample(lambda);
 }
 
 pstd::optional<LightLiSample> UniformInfiniteLight::SampleLi(
@@ -821,7 +821,7 @@ pstd::optional<LightLiSample> UniformInfiniteLight::SampleLi(
     // Return uniform spherical sample for uniform infinite light
     Vector3f wi = SampleUniformSphere(u);
     Float pdf = UniformSpherePDF();
-    return LightLiSample(scale * Lemit.Sample(lambda), wi, pdf,
+    return LightLiSample(scale * Lemit->Sample(lambda), wi, pdf,
                          Interaction(ctx.p() + wi * (2 * sceneRadius), &mediumInterface));
 }
 
@@ -833,7 +833,7 @@ Float UniformInfiniteLight::PDF_Li(LightSampleContext ctx, Vector3f w,
 }
 
 SampledSpectrum UniformInfiniteLight::Phi(const SampledWavelengths &lambda) const {
-    return 4 * Pi * Pi * Sqr(sceneRadius) * scale * Lemit.Sample(lambda);
+    return 4 * Pi * Pi * Sqr(sceneRadius) * scale * Lemit->Sample(lambda);
 }
 
 LightLeSample UniformInfiniteLight::SampleLe(const Point2f &u1, const Point2f &u2,
@@ -850,7 +850,7 @@ LightLeSample UniformInfiniteLight::SampleLe(const Point2f &u1, const Point2f &u
     Float pdfPos = 1 / (Pi * Sqr(sceneRadius));
     Float pdfDir = UniformSpherePDF();
 
-    return LightLeSample(scale * Lemit.Sample(lambda), ray, pdfPos, pdfDir);
+    return LightLeSample(scale * Lemit->Sample(lambda), ray, pdfPos, pdfDir);
 }
 
 void UniformInfiniteLight::PDF_Le(const Ray &ray, Float *pdfPos, Float *pdfDir) const {
@@ -859,7 +859,7 @@ void UniformInfiniteLight::PDF_Le(const Ray &ray, Float *pdfPos, Float *pdfDir)
 }
 
 std::string UniformInfiniteLight::ToString() const {
-    return StringPrintf("[ UniformInfiniteLight %s Lemit: %s ]", BaseToString(), Lemit);
+    return StringPrintf("[ UniformInfiniteLight %s Lemit: %s ]", BaseToString(), *Lemit);
 }
 
 // ImageInfiniteLight Method Definitions
@@ -1202,7 +1202,7 @@ SpotLight::SpotLight(const Transform &renderFromLight,
                      const MediumInterface &mediumInterface, SpectrumHandle Iemit,
                      Float scale, Float totalWidth, Float falloffStart, Allocator alloc)
     : LightBase(LightType::DeltaPosition, renderFromLight, mediumInterface),
-      Iemit(Iemit, alloc),
+      Iemit(LookupDenselySampledSpectrum(Iemit, alloc)),
       scale(scale),
       cosFalloffEnd(std::cos(Radians(totalWidth))),
       cosFalloffStart(std::cos(Radians(falloffStart))) {
@@ -1215,11 +1215,11 @@ Float SpotLight::PDF_Li(LightSampleContext, Vector3f, LightSamplingMode mode) co
 
 SampledSpectrum SpotLight::I(Vector3f wl, const SampledWavelengths &lambda) const {
     return SmoothStep(CosTheta(wl), cosFalloffEnd, cosFalloffStart) * scale *
-           Iemit.Sample(lambda);
+           Iemit->Sample(lambda);
 }
 
 SampledSpectrum SpotLight::Phi(const SampledWavelengths &lambda) const {
-    return scale * Iemit.Sample(lambda) * 2 * Pi *
+    return scale * Iemit->Sample(lambda) * 2 * Pi *
            ((1 - cosFalloffStart) + (cosFalloffStart - cosFalloffEnd) / 2);
 }
 
@@ -1237,7 +1237,7 @@ LightBounds SpotLight::Bounds() const {
     // light's cone, so inside the cone, it doesn't matter if the overall
     // power is low; it's more accurate to effectively treat it as a point
     // light source.
-    Float phi = scale * Iemit.MaxValue() * 4 * Pi;
+    Float phi = scale * Iemit->MaxValue() * 4 * Pi;
 #endif
 
     return LightBounds(p, w, phi, 0.f, std::acos(cosFalloffEnd), false);
@@ -1288,7 +1288,7 @@ void SpotLight::PDF_Le(const Ray &ray, Float *pdfPos, Float *pdfDir) const {
 std::string SpotLight::ToString() const {
     return StringPrintf(
         "[ SpotLight %s Iemit: %s cosFalloffStart: %f cosFalloffEnd: %f ]",
-        BaseToString(), Iemit, cosFalloffStart, cosFalloffEnd);
+        BaseToString(), *Iemit, cosFalloffStart, cosFalloffEnd);
 }
 
 SpotLight *SpotLight::Create(const Transform &renderFromLight, MediumHandle medium,
@@ -255,7 +255,7 @@ class PointLight : public LightBase {
     PointLight(Transform renderFromLight, MediumInterface mediumInterface,
                SpectrumHandle I, Float scale, Allocator alloc)
         : LightBase(LightType::DeltaPosition, renderFromLight, mediumInterface),
-          I(I, alloc),
+          I(LookupDenselySampledSpectrum(I, alloc)),
           scale(scale) {}
 
     static PointLight *Create(const Transform &renderFromLight, MediumHandle medium,
@@ -286,7 +286,7 @@ class PointLight : public LightBase {
                                            LightSamplingMode mode) const {
         Point3f p = renderFromLight(Point3f(0, 0, 0));
         Vector3f wi = Normalize(p - ctx.p());
-        SampledSpectrum Li = scale * I.Sample(lambda) / DistanceSquared(p, ctx.p());
+        SampledSpectrum Li = scale * I->Sample(lambda) / DistanceSquared(p, ctx.p());
         return LightLiSample(Li, wi, 1, Interaction(p, &mediumInterface));
     }
 
@@ -295,7 +295,7 @@ class PointLight : public LightBase {
 
   private:
     // PointLight Private Members
-    DenselySampledSpectrum I;
+    const DenselySampledSpectrum *I;
     Float scale;
 };
 
@@ -306,7 +306,7 @@ class DistantLight : public LightBase {
     DistantLight(const Transform &renderFromLight, SpectrumHandle Lemit, Float scale,
                  Allocator alloc)
         : LightBase(LightType::DeltaDirection, renderFromLight, MediumInterface()),
-          Lemit(Lemit, alloc),
+          Lemit(LookupDenselySampledSpectrum(Lemit, alloc)),
           scale(scale) {}
 
     static DistantLight *Create(const Transform &renderFromLight,
@@ -344,13 +344,13 @@ class DistantLight : public LightBase {
                                            LightSamplingMode mode) const {
         Vector3f wi = Normalize(renderFromLight(Vector3f(0, 0, 1)));
         Point3f pOutside = ctx.p() + wi * (2 * sceneRadius);
-        return LightLiSample(scale * Lemit.Sample(lambda), wi, 1,
+        return LightLiSample(scale * Lemit->Sample(lambda), wi, 1,
                              Interaction(pOutside, &mediumInterface));
     }
 
   private:
     // DistantLight Private Members
-    DenselySampledSpectrum Lemit;
+    const DenselySampledSpectrum *Lemit;
     Float scale;
     Point3f sceneCenter;
     Float sceneRadius;
@@ -452,12 +452,12 @@ class GoniometricLight : public LightBase {
     PBRT_CPU_GPU
     SampledSpectrum I(Vector3f wl, const SampledWavelengths &lambda) const {
         Point2f uv = EqualAreaSphereToSquare(wl);
-        return scale * Iemit.Sample(lambda) * image.LookupNearestChannel(uv, 0);
+        return scale * Iemit->Sample(lambda) * image.LookupNearestChannel(uv, 0);
     }
 
   private:
     // GoniometricLight Private Members
-    DenselySampledSpectrum Iemit;
+    const DenselySampledSpectrum *Iemit;
     Float scale;
     Image image;
     PiecewiseConstant2D distrib;
@@ -513,7 +513,7 @@ class DiffuseAreaLight : public LightBase {
                    RGBIlluminantSpectrum(*imageColorSpace, ClampZero(rgb)).Sample(lambda);
 
         } else
-            return scale * Lemit.Sample(lambda);
+            return scale * Lemit->Sample(lambda);
     }
 
     PBRT_CPU_GPU
@@ -529,7 +529,7 @@ class DiffuseAreaLight : public LightBase {
     ShapeHandle shape;
     Float area;
     bool twoSided;
-    DenselySampledSpectrum Lemit;
+    const DenselySampledSpectrum *Lemit;
     Float scale;
     Image image;
     const RGBColorSpace *imageColorSpace;
@@ -574,7 +574,7 @@ class UniformInfiniteLight : public LightBase {
 
   private:
     // UniformInfiniteLight Private Members
-    DenselySampledSpectrum Lemit;
+    const DenselySampledSpectrum *Lemit;
     Float scale;
     Point3f sceneCenter;
     Float sceneRadius;
@@ -819,7 +819,7 @@ class SpotLight : public LightBase {
 
   private:
     // SpotLight Private Members
-    DenselySampledSpectrum Iemit;
+    const DenselySampledSpectrum *Iemit;
     Float scale, cosFalloffStart, cosFalloffEnd;
 };
 
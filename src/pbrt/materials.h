@@ -173,7 +173,9 @@ class DielectricMaterial {
         }
 
         // Create microfacet distribution for dielectric material
-        Float urough = texEval(uRoughness, ctx), vrough = texEval(vRoughness, ctx);
+        Float rough[2];
+        texEval({uRoughness, vRoughness}, ctx, rough);
+        Float urough = rough[0], vrough = rough[1];
         if (remapRoughness) {
             urough = TrowbridgeReitzDistribution::RoughnessToAlpha(urough);
             vrough = TrowbridgeReitzDistribution::RoughnessToAlpha(vrough);
@@ -618,7 +620,9 @@ class ConductorMaterial {
     PBRT_CPU_GPU BSDF GetBSDF(TextureEvaluator texEval, MaterialEvalContext ctx,
                               SampledWavelengths &lambda, ConductorBxDF *bxdf) const {
         // Return BSDF for _ConductorMaterial_
-        Float uRough = texEval(uRoughness, ctx), vRough = texEval(vRoughness, ctx);
+        Float rough[2];
+        texEval({uRoughness, vRoughness}, ctx, rough);
+        Float uRough = rough[0], vRough = rough[1];
         if (remapRoughness) {
             uRough = TrowbridgeReitzDistribution::RoughnessToAlpha(uRough);
             vRough = TrowbridgeReitzDistribution::RoughnessToAlpha(vRough);
@@ -705,8 +709,9 @@ class CoatedDiffuseMaterial {
         SampledSpectrum r = Clamp(texEval(reflectance, ctx, lambda), 0, 1);
 
         // Create microfacet distribution _distrib_ for coated diffuse material
-        Float urough = texEval(uRoughness, ctx);
-        Float vrough = texEval(vRoughness, ctx);
+        Float rough[2];
+        texEval({uRoughness, vRoughness}, ctx, rough);
+        Float urough = rough[0], vrough = rough[1];
         if (remapRoughness) {
             urough = TrowbridgeReitzDistribution::RoughnessToAlpha(urough);
             vrough = TrowbridgeReitzDistribution::RoughnessToAlpha(vrough);
@@ -794,8 +799,12 @@ class CoatedConductorMaterial {
     PBRT_CPU_GPU BSDF GetBSDF(TextureEvaluator texEval, const MaterialEvalContext &ctx,
                               SampledWavelengths &lambda,
                               CoatedConductorBxDF *bxdf) const {
-        Float iurough = texEval(interfaceURoughness, ctx);
-        Float ivrough = texEval(interfaceVRoughness, ctx);
+        // Evaluate both layers' roughness textures together
+        Float rough[4];
+        texEval({interfaceURoughness, interfaceVRoughness, conductorURoughness,
+                 conductorVRoughness},
+                ctx, rough);
+        Float iurough = rough[0], ivrough = rough[1];
         if (remapRoughness) {
             iurough = TrowbridgeReitzDistribution::RoughnessToAlpha(iurough);
             ivrough = TrowbridgeReitzDistribution::RoughnessToAlpha(ivrough);
@@ -807,8 +816,7 @@ class CoatedConductorMaterial {
 
         SampledSpectrum ce = texEval(conductorEta, ctx, lambda);
         SampledSpectrum ck = texEval(k, ctx, lambda);
-        Float curough = texEval(conductorURoughness, ctx);
-        Float cvrough = texEval(conductorVRoughness, ctx);
+        Float curough = rough[2], cvrough = rough[3];
         if (remapRoughness) {
             curough = TrowbridgeReitzDistribution::RoughnessToAlpha(curough);
             cvrough = TrowbridgeReitzDistribution::RoughnessToAlpha(cvrough);
@@ -892,7 +900,9 @@ class SubsurfaceMaterial {
                               DielectricInterfaceBxDF *bxdf) const {
         // Initialize BSDF for _SubsurfaceMaterial_
 
-        Float urough = texEval(uRoughness, ctx), vrough = texEval(vRoughness, ctx);
+        Float rough[2];
+        texEval({uRoughness, vRoughness}, ctx, rough);
+        Float urough = rough[0], vrough = rough[1];
         if (remapRoughness) {
             urough = TrowbridgeReitzDistribution::RoughnessToAlpha(urough);
             vrough = TrowbridgeReitzDistribution::RoughnessToAlpha(vrough);
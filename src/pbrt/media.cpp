@@ -178,7 +178,7 @@ HomogeneousMedium *HomogeneousMedium::Create(const ParameterDictionary &paramete
 std::string HomogeneousMedium::ToString() const {
     return StringPrintf(
         "[ Homogeneous medium sigma_a_spec: %s sigma_s_spec: %s Le_spec: phase: %s ]",
-        sigma_a_spec, sigma_s_spec, Le_spec, phase);
+        *sigma_a_spec, *sigma_s_spec, *Le_spec, phase);
 }
 
 STAT_MEMORY_COUNTER("Memory/Volume grids", volumeGridBytes);
@@ -192,7 +192,7 @@ UniformGridMediumProvider::UniformGridMediumProvider(
       densityGrid(std::move(dgrid)),
       rgbDensityGrid(std::move(rgbgrid)),
       colorSpace(colorSpace),
-      Le_spec(Le, alloc),
+      Le_spec(LookupDenselySampledSpectrum(Le, alloc)),
       LeScaleGrid(std::move(Legrid)) {
     volumeGridBytes += LeScaleGrid.BytesAllocated();
     volumeGridBytes +=
@@ -254,7 +254,7 @@ UniformGridMediumProvider *UniformGridMediumProvider::Create(
 std::string UniformGridMediumProvider::ToString() const {
     return StringPrintf(
         "[ UniformGridMediumProvider Le_spec: %s colorSpace: %s (grids elided) ]",
-        Le_spec, *colorSpace);
+        *Le_spec, *colorSpace);
 }
 
 // CloudMediumProvider Method Definitions
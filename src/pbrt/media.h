@@ -86,16 +86,16 @@ class HomogeneousMedium {
     // HomogeneousMedium Public Methods
     HomogeneousMedium(SpectrumHandle sigma_a, SpectrumHandle sigma_s, Float sigScale,
                       SpectrumHandle Le, Float g, Allocator alloc)
-        : sigma_a_spec(sigma_a, alloc),
-          sigma_s_spec(sigma_s, alloc),
+        : sigma_a_spec(LookupDenselySampledSpectrum(sigma_a, alloc)),
+          sigma_s_spec(LookupDenselySampledSpectrum(sigma_s, alloc)),
           sigScale(sigScale),
-          Le_spec(Le, alloc),
+          Le_spec(LookupDenselySampledSpectrum(Le, alloc)),
           phase(g) {}
 
     static HomogeneousMedium *Create(const ParameterDictionary &parameters,
                                      const FileLoc *loc, Allocator alloc);
 
-    bool IsEmissive() const { return Le_spec.MaxValue() > 0; }
+    bool IsEmissive() const { return Le_spec->MaxValue() > 0; }
 
     template <typename F>
     PBRT_CPU_GPU void SampleTmaj(Ray ray, Float tMax, RNG &rng,
@@ -105,8 +105,8 @@ class HomogeneousMedium {
         ray.d = Normalize(ray.d);
 
         // Compute _SampledSpectrum_ scattering properties for medium
-        SampledSpectrum sigma_a = sigScale * sigma_a_spec.Sample(lambda);
-        SampledSpectrum sigma_s = sigScale * sigma_s_spec.Sample(lambda);
+        SampledSpectrum sigma_a = sigScale * sigma_a_spec->Sample(lambda);
+        SampledSpectrum sigma_s = sigScale * sigma_s_spec->Sample(lambda);
         SampledSpectrum sigma_t = sigma_a + sigma_s;
         SampledSpectrum sigma_maj = sigma_t;
 
@@ -123,7 +123,7 @@ class HomogeneousMedium {
         } else {
             // Report scattering event in homogeneous medium
             SampledSpectrum Tmaj = FastExp(-t * sigma_maj);
-            SampledSpectrum Le = Le_spec.Sample(lambda);
+            SampledSpectrum Le = Le_spec->Sample(lambda);
             MediumInteraction intr(ray(t), -ray.d, ray.time, sigma_a, sigma_s, sigma_maj,
                                    Le, this, &phase);
             callback(MediumSample(intr, Tmaj));
@@ -134,7 +134,7 @@ class HomogeneousMedium {
 
   private:
     // HomogeneousMedium Private Data
-    DenselySampledSpectrum sigma_a_spec, sigma_s_spec, Le_spec;
+    const DenselySampledSpectrum *sigma_a_spec, *sigma_s_spec, *Le_spec;
     Float sigScale;
     HGPhaseFunction phase;
 };
@@ -149,8 +149,8 @@ class CuboidMedium {
                  Allocator alloc)
         : provider(provider),
           mediumBounds(provider->Bounds()),
-          sigma_a_spec(sigma_a, alloc),
-          sigma_s_spec(sigma_s, alloc),
+          sigma_a_spec(LookupDenselySampledSpectrum(sigma_a, alloc)),
+          sigma_s_spec(LookupDenselySampledSpectrum(sigma_s, alloc)),
           sigScale(sigScale),
           phase(g),
           renderFromMedium(renderFromMedium),
@@ -163,8 +163,8 @@ class CuboidMedium {
         return StringPrintf("[ CuboidMedium provider: %s mediumBounds: %s "
                             "sigma_a_spec: %s sigma_s_spec: %s sigScale: %f phase: %s "
                             "maxDensityGrid: %s gridResolution: %s ]",
-                            *provider, mediumBounds, sigma_a_spec, sigma_s_spec, sigScale,
-                            phase, maxDensityGrid, gridResolution);
+                            *provider, mediumBounds, *sigma_a_spec, *sigma_s_spec,
+                            sigScale, phase, maxDensityGrid, gridResolution);
     }
 
     bool IsEmissive() const { return provider->IsEmissive(); }
@@ -182,8 +182,8 @@ class CuboidMedium {
         DCHECK_LE(tMax, raytMax);
 
         // Sample spectra for grid medium scattering
-        SampledSpectrum sigma_a = sigScale * sigma_a_spec.Sample(lambda);
-        SampledSpectrum sigma_s = sigScale * sigma_s_spec.Sample(lambda);
+        SampledSpectrum sigma_a = sigScale * sigma_a_spec->Sample(lambda);
+        SampledSpectrum sigma_s = sigScale * sigma_s_spec->Sample(lambda);
         SampledSpectrum sigma_t = sigma_a + sigma_s;
 
         // Set up 3D DDA for ray through grid
@@ -316,7 +316,7 @@ class CuboidMedium {
     // CuboidMedium Private Members
     const Provider *provider;
     Bounds3f mediumBounds;
-    DenselySampledSpectrum sigma_a_spec, sigma_s_spec;
+    const DenselySampledSpectrum *sigma_a_spec, *sigma_s_spec;
     Float sigScale;
     HGPhaseFunction phase;
     Transform renderFromMedium;
@@ -342,12 +342,12 @@ class UniformGridMediumProvider {
     PBRT_CPU_GPU
     const Bounds3f &Bounds() const { return bounds; }
 
-    bool IsEmissive() const { return Le_spec.MaxValue() > 0; }
+    bool IsEmissive() const { return Le_spec->MaxValue() > 0; }
 
     PBRT_CPU_GPU
     SampledSpectrum Le(Point3f p, const SampledWavelengths &lambda) const {
         Point3f pp = Point3f(bounds.Offset(p));
-        return Le_spec.Sample(lambda) * LeScaleGrid.Lookup(pp);
+        return Le_spec->Sample(lambda) * LeScaleGrid.Lookup(pp);
     }
 
     PBRT_CPU_GPU
@@ -423,7 +423,7 @@ class UniformGridMediumProvider {
     pstd::optional<SampledGrid<Float>> densityGrid;
     pstd::optional<SampledGrid<RGB>> rgbDensityGrid;
     const RGBColorSpace *colorSpace;
-    DenselySampledSpectrum Le_spec;
+    const DenselySampledSpectrum *Le_spec;
     SampledGrid<Float> LeScaleGrid;
 };
 
@@ -16,15 +16,18 @@ __constant__ BasicPBRTOptions OptionsGPU;
 
 std::string PBRTOptions::ToString() const {
     return StringPrintf(
-        "[ PBRTOptions nThreads: %d seed: %d quickRender: %s quiet: %s "
-        "recordPixelStatistics: %s upgrade: %s disablePixelJitter: %s "
-        "disableWavelengthJitter: %s forceDiffuse: %s useGPU: %s "
-        "imageFile: %s mseReferenceImage: %s mseReferenceOutput: %s "
-        "debugStart: %s displayServer: %s cropWindow: %s pixelBounds: %s ]",
-        nThreads, seed, quickRender, quiet, recordPixelStatistics, upgrade,
-        disablePixelJitter, disableWavelengthJitter, forceDiffuse, useGPU, imageFile,
-        mseReferenceImage, mseReferenceOutput, debugStart, displayServer, cropWindow,
-        pixelBounds);
+        "[ PBRTOptions nThreads: %d textureCacheMB: %d "
+        "compressTextures: %s seed: %d quickRender: %s "
+        "quiet: %s recordPixelStatistics: %s recordPixelCost: %s renderPreview: %s "
+        "waveSeconds: %f writeIntervalSeconds: %f upgrade: %s disablePixelJitter: %s "
+        "disableWavelengthJitter: %s forceDiffuse: %s useGPU: %s imageFile: %s "
+        "mseReferenceImage: %s mseReferenceOutput: %s debugStart: %s "
+        "displayServer: %s displaySharedMemory: %s cropWindow: %s pixelBounds: %s ]",
+        nThreads, textureCacheMB, compressTextures, seed, quickRender, quiet,
+        recordPixelStatistics, recordPixelCost, renderPreview, waveSeconds,
+        writeIntervalSeconds, upgrade, disablePixelJitter, disableWavelengthJitter,
+        forceDiffuse, useGPU, imageFile, mseReferenceImage, mseReferenceOutput,
+        debugStart, displayServer, displaySharedMemory, cropWindow, pixelBounds);
 }
 
 }  // namespace pbrt
@@ -29,9 +29,16 @@ struct BasicPBRTOptions {
 // PBRTOptions Definiton
 struct PBRTOptions : BasicPBRTOptions {
     int nThreads = 0;
+    int textureCacheMB = 0;
+    bool compressTextures = false;
     LogLevel logLevel = LogLevel::Error;
     bool useGPU = false;
     bool recordPixelStatistics = false;
+    bool recordPixelCost = false;
+    bool renderPreview = false;
+    // Image tile integrators size each wave of samples to take about
+    // _waveSeconds_ and write the image at most every _writeIntervalSeconds_.
+    Float waveSeconds = 1, writeIntervalSeconds = 60;
     pstd::optional<int> pixelSamples;
     pstd::optional<int> gpuDevice;
     bool quickRender = false;
@@ -40,6 +47,7 @@ struct PBRTOptions : BasicPBRTOptions {
     std::string mseReferenceImage, mseReferenceOutput;
     std::string debugStart;
     std::string displayServer;
+    bool displaySharedMemory = false;
     pstd::optional<Bounds2f> cropWindow;
     pstd::optional<Bounds2i> pixelBounds;
 
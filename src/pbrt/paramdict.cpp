@@ -11,11 +11,16 @@
 #include <pbrt/util/colorspace.h>
 #include <pbrt/util/error.h>
 #include <pbrt/util/file.h>
+#include <pbrt/util/float.h>
 #include <pbrt/util/memory.h>
 #include <pbrt/util/print.h>
 #include <pbrt/util/spectrum.h>
+#include <pbrt/util/stats.h>
 
 #include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <utility>
 
 namespace pbrt {
@@ -154,6 +159,20 @@ constexpr char ParameterTypeTraits<ParameterType::String>::typeName[];
 ///////////////////////////////////////////////////////////////////////////
 // ParameterDictionary
 
+// Atoms for the parameter types that don't have a _ParameterTypeTraits_
+static const ParameterAtom textureTypeAtom = InternParameterString("texture");
+static const ParameterAtom rgbTypeAtom = InternParameterString("rgb");
+static const ParameterAtom colorTypeAtom = InternParameterString("color");
+static const ParameterAtom spectrumTypeAtom = InternParameterString("spectrum");
+static const ParameterAtom blackbodyTypeAtom = InternParameterString("blackbody");
+
+template <ParameterType PT>
+static ParameterAtom TypeAtom() {
+    static const ParameterAtom atom =
+        InternParameterString(ParameterTypeTraits<PT>::typeName);
+    return atom;
+}
+
 ParameterDictionary::ParameterDictionary(ParsedParameterVector p,
                                          const RGBColorSpace *colorSpace)
     : params(std::move(p)), colorSpace(colorSpace) {
@@ -173,19 +192,23 @@ ParameterDictionary::ParameterDictionary(ParsedParameterVector p0,
 }
 
 void ParameterDictionary::checkParameterTypes() {
-    for (const ParsedParameter *p : params)
-        if (p->type != ParameterTypeTraits<ParameterType::Boolean>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::Float>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::Integer>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::Point2f>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::Vector2f>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::Point3f>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::Vector3f>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::Normal3f>::typeName &&
-            p->type != ParameterTypeTraits<ParameterType::String>::typeName &&
-            p->type != "texture" && p->type != "rgb" && p->type != "spectrum" &&
-            p->type != "blackbody")
+    static const ParameterAtom validTypes[] = {
+        TypeAtom<ParameterType::Boolean>(),  TypeAtom<ParameterType::Float>(),
+        TypeAtom<ParameterType::Integer>(),  TypeAtom<ParameterType::Point2f>(),
+        TypeAtom<ParameterType::Vector2f>(), TypeAtom<ParameterType::Point3f>(),
+        TypeAtom<ParameterType::Vector3f>(), TypeAtom<ParameterType::Normal3f>(),
+        TypeAtom<ParameterType::String>(),   textureTypeAtom,
+        rgbTypeAtom,                         spectrumTypeAtom,
+        blackbodyTypeAtom};
+    for (const ParsedParameter *p : params) {
+        // Catch parameters whose name or type was changed without
+        // ParsedParameter::SetName() or SetType()
+        DCHECK_EQ(p->typeAtom, InternParameterString(p->type));
+        DCHECK_EQ(p->nameAtom, InternParameterString(p->name));
+        if (std::find(std::begin(validTypes), std::end(validTypes), p->typeAtom) ==
+            std::end(validTypes))
             ErrorExit(&p->loc, "%s: unknown parameter type", p->type);
+    }
 }
 
 // ParameterDictionary Method Definitions
@@ -200,8 +223,9 @@ typename ParameterTypeTraits<PT>::ReturnType ParameterDictionary::lookupSingle(
     typename ParameterTypeTraits<PT>::ReturnType defaultValue) const {
     // Search _params_ for parameter _name_
     using traits = ParameterTypeTraits<PT>;
+    ParameterAtom nameAtom = InternParameterString(name), typeAtom = TypeAtom<PT>();
     for (const ParsedParameter *p : params) {
-        if (p->name != name || p->type != traits::typeName)
+        if (p->nameAtom != nameAtom || p->typeAtom != typeAtom)
             continue;
         // Extract parameter values from _p_
         const auto &values = traits::GetValues(*p);
@@ -257,8 +281,9 @@ SpectrumHandle ParameterDictionary::GetOneSpectrum(const std::string &name,
                                                    SpectrumHandle defaultValue,
                                                    SpectrumType spectrumType,
                                                    Allocator alloc) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params) {
-        if (p->name != name)
+        if (p->nameAtom != nameAtom)
             continue;
 
         std::vector<SpectrumHandle> s = extractSpectrumArray(*p, spectrumType, alloc);
@@ -299,11 +324,12 @@ static std::vector<ReturnType> returnArray(const ValuesType &values,
 template <typename ReturnType, typename G, typename C>
 std::vector<ReturnType> ParameterDictionary::lookupArray(const std::string &name,
                                                          ParameterType type,
-                                                         const char *typeName,
+                                                         ParameterAtom typeAtom,
                                                          int nPerItem, G getValues,
                                                          C convert) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params)
-        if (p->name == name && p->type == typeName)
+        if (p->nameAtom == nameAtom && p->typeAtom == typeAtom)
             return returnArray<ReturnType>(getValues(*p), *p, nPerItem, convert);
 
     return {};
@@ -314,7 +340,7 @@ std::vector<typename ParameterTypeTraits<PT>::ReturnType>
 ParameterDictionary::lookupArray(const std::string &name) const {
     using traits = ParameterTypeTraits<PT>;
     return lookupArray<typename traits::ReturnType>(
-        name, PT, traits::typeName, traits::nPerItem, traits::GetValues, traits::Convert);
+        name, PT, TypeAtom<PT>(), traits::nPerItem, traits::GetValues, traits::Convert);
 }
 
 std::vector<Float> ParameterDictionary::GetFloatArray(const std::string &name) const {
@@ -352,11 +378,14 @@ std::vector<Normal3f> ParameterDictionary::GetNormal3fArray(
     return lookupArray<ParameterType::Normal3f>(name);
 }
 
+static std::mutex cachedSpectraMutex;
 static std::map<std::string, SpectrumHandle> cachedSpectra;
 
 // TODO: move this functionality (but not the caching?) to a Spectrum method.
 static SpectrumHandle readSpectrumFromFile(const std::string &filename, Allocator alloc) {
     std::string fn = ResolveFilename(filename);
+    // Textures and materials may be created in parallel
+    std::lock_guard<std::mutex> lock(cachedSpectraMutex);
     if (cachedSpectra.find(fn) != cachedSpectra.end())
         return cachedSpectra[fn];
 
@@ -368,9 +397,50 @@ static SpectrumHandle readSpectrumFromFile(const std::string &filename, Allocato
     return *pls;
 }
 
+STAT_COUNTER("Scene/RGB spectra shared", nSharedRGBSpectra);
+
+// The components are compared by their bits so that NaNs, which don't have
+// a strict weak ordering as floating-point values, are handled.
+using RGBSpectrumBits = decltype(FloatToBits(Float(0)));
+using RGBSpectrumKey =
+    std::tuple<const RGBColorSpace *, RGBSpectrumBits, RGBSpectrumBits, RGBSpectrumBits,
+               SpectrumType, pstd::pmr::memory_resource *>;
+static std::mutex rgbSpectrumMutex;
+static std::map<RGBSpectrumKey, SpectrumHandle> rgbSpectrumCache;
+
+// Scenes often use the same RGB value for many materials and lights; each
+// unique RGB constant is converted to sigmoid polynomial coefficients once
+// and the resulting spectrum is shared.
+static SpectrumHandle LookupRGBSpectrum(const RGBColorSpace &cs, RGB rgb,
+                                        SpectrumType spectrumType, Allocator alloc) {
+    RGBSpectrumKey key(&cs, FloatToBits(rgb.r), FloatToBits(rgb.g), FloatToBits(rgb.b),
+                       spectrumType, alloc.resource());
+    std::lock_guard<std::mutex> lock(rgbSpectrumMutex);
+    if (auto iter = rgbSpectrumCache.find(key); iter != rgbSpectrumCache.end()) {
+        ++nSharedRGBSpectra;
+        return iter->second;
+    }
+
+    SpectrumHandle s;
+    if (spectrumType == SpectrumType::Illuminant)
+        s = alloc.new_object<RGBIlluminantSpectrum>(cs, rgb);
+    else {
+        CHECK(spectrumType == SpectrumType::General);
+        s = alloc.new_object<RGBSpectrum>(cs, rgb);
+    }
+    rgbSpectrumCache[key] = s;
+    return s;
+}
+
+void ClearRGBSpectrumCache() {
+    std::lock_guard<std::mutex> lock(rgbSpectrumMutex);
+    rgbSpectrumCache.clear();
+}
+
 std::vector<SpectrumHandle> ParameterDictionary::extractSpectrumArray(
     const ParsedParameter &param, SpectrumType spectrumType, Allocator alloc) const {
-    if (param.type == "rgb" || (Options->upgrade && param.type == "color"))
+    if (param.typeAtom == rgbTypeAtom ||
+        (Options->upgrade && param.typeAtom == colorTypeAtom))
         return returnArray<SpectrumHandle>(
             param.numbers, param, 3,
             [this, spectrumType, &alloc, &param](const double *v,
@@ -378,30 +448,27 @@ std::vector<SpectrumHandle> ParameterDictionary::extractSpectrumArray(
                 RGB rgb(v[0], v[1], v[2]);
                 const RGBColorSpace &cs =
                     param.colorSpace ? *param.colorSpace : *colorSpace;
-                if (spectrumType == SpectrumType::General)
-                    return alloc.new_object<RGBSpectrum>(cs, rgb);
-                else {
-                    CHECK(spectrumType == SpectrumType::Illuminant);
-                    if (std::min({v[0], v[1], v[2]}) < 0)
-                        ErrorExit(&param.loc,
-                                  "RGB parameter \"%s\" has negative component value.");
-                    return alloc.new_object<RGBIlluminantSpectrum>(cs, rgb);
-                }
+                if (spectrumType == SpectrumType::Illuminant &&
+                    std::min({v[0], v[1], v[2]}) < 0)
+                    ErrorExit(&param.loc,
+                              "RGB parameter \"%s\" has negative component value.",
+                              param.name);
+                return LookupRGBSpectrum(cs, rgb, spectrumType, alloc);
             });
-    else if (param.type == "blackbody")
+    else if (param.typeAtom == blackbodyTypeAtom)
         return returnArray<SpectrumHandle>(
             param.numbers, param, 1,
             [this, &alloc](const double *v, const FileLoc *loc) -> SpectrumHandle {
                 return alloc.new_object<BlackbodySpectrum>(v[0]);
             });
-    else if (param.type == "spectrum" && !param.numbers.empty()) {
+    else if (param.typeAtom == spectrumTypeAtom && !param.numbers.empty()) {
         if (param.numbers.size() % 2 != 0)
             ErrorExit(&param.loc, "Found odd number of values for \"%s\"", param.name);
 
         int nSamples = param.numbers.size() / 2;
         return returnArray<SpectrumHandle>(
             param.numbers, param, param.numbers.size(),
-            [this, nSamples, &alloc, param](const double *v,
+            [this, nSamples, &alloc, &param](const double *v,
                                             const FileLoc *Loc) -> SpectrumHandle {
                 std::vector<Float> lambda(nSamples), value(nSamples);
                 for (int i = 0; i < nSamples; ++i) {
@@ -415,10 +482,10 @@ std::vector<SpectrumHandle> ParameterDictionary::extractSpectrumArray(
                 }
                 return alloc.new_object<PiecewiseLinearSpectrum>(lambda, value, alloc);
             });
-    } else if (param.type == "spectrum" && !param.strings.empty())
+    } else if (param.typeAtom == spectrumTypeAtom && !param.strings.empty())
         return returnArray<SpectrumHandle>(
             param.strings, param, 1,
-            [param, &alloc](const std::string *s, const FileLoc *loc) -> SpectrumHandle {
+            [&param, &alloc](const std::string *s, const FileLoc *loc) -> SpectrumHandle {
                 SpectrumHandle spd = GetNamedSpectrum(*s);
                 if (spd)
                     return spd;
@@ -434,8 +501,9 @@ std::vector<SpectrumHandle> ParameterDictionary::extractSpectrumArray(
 
 std::vector<SpectrumHandle> ParameterDictionary::GetSpectrumArray(
     const std::string &name, SpectrumType spectrumType, Allocator alloc) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params) {
-        if (p->name != name)
+        if (p->nameAtom != nameAtom)
             continue;
 
         std::vector<SpectrumHandle> s = extractSpectrumArray(*p, spectrumType, alloc);
@@ -451,8 +519,9 @@ std::vector<std::string> ParameterDictionary::GetStringArray(
 }
 
 std::string ParameterDictionary::GetTexture(const std::string &name) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params) {
-        if (p->name != name || p->type != "texture")
+        if (p->nameAtom != nameAtom || p->typeAtom != textureTypeAtom)
             continue;
 
         if (p->strings.empty())
@@ -468,8 +537,9 @@ std::string ParameterDictionary::GetTexture(const std::string &name) const {
 }
 
 std::vector<RGB> ParameterDictionary::GetRGBArray(const std::string &name) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params) {
-        if (p->name == name && p->type == "rgb") {
+        if (p->nameAtom == nameAtom && p->typeAtom == rgbTypeAtom) {
             if (p->numbers.size() % 3)
                 ErrorExit(&p->loc, "Number of values given for \"rgb\" parameter %d "
                                    "\"name\" isn't a multiple of 3.");
@@ -487,8 +557,9 @@ std::vector<RGB> ParameterDictionary::GetRGBArray(const std::string &name) const
 }
 
 pstd::optional<RGB> ParameterDictionary::GetOneRGB(const std::string &name) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params) {
-        if (p->name == name && p->type == "rgb") {
+        if (p->nameAtom == nameAtom && p->typeAtom == rgbTypeAtom) {
             if (p->numbers.size() < 3)
                 ErrorExit(&p->loc, "Insufficient values for \"rgb\" parameter \"%s\".",
                           p->name);
@@ -500,8 +571,9 @@ pstd::optional<RGB> ParameterDictionary::GetOneRGB(const std::string &name) cons
 
 Float ParameterDictionary::UpgradeBlackbody(const std::string &name) {
     Float scale = 1;
+    ParameterAtom nameAtom = InternParameterString(name);
     for (ParsedParameter *p : params) {
-        if (p->name == name && p->type == "blackbody") {
+        if (p->nameAtom == nameAtom && p->typeAtom == blackbodyTypeAtom) {
             if (p->numbers.size() != 2)
                 ErrorExit(&p->loc,
                           "Expected two values for legacy \"blackbody\" parameter.");
@@ -513,8 +585,10 @@ Float ParameterDictionary::UpgradeBlackbody(const std::string &name) {
 }
 
 void ParameterDictionary::remove(const std::string &name, const char *typeName) {
+    ParameterAtom nameAtom = InternParameterString(name);
+    ParameterAtom typeAtom = InternParameterString(typeName);
     for (auto iter = params.begin(); iter != params.end(); ++iter)
-        if ((*iter)->name == name && (*iter)->type == typeName) {
+        if ((*iter)->nameAtom == nameAtom && (*iter)->typeAtom == typeAtom) {
             params.erase(iter);
             return;
         }
@@ -568,15 +642,16 @@ void ParameterDictionary::RemoveSpectrum(const std::string &name) {
 
 void ParameterDictionary::RenameParameter(const std::string &before,
                                           const std::string &after) {
+    ParameterAtom beforeAtom = InternParameterString(before);
     for (ParsedParameter *p : params)
-        if (p->name == before)
-            p->name = after;
+        if (p->nameAtom == beforeAtom)
+            p->SetName(after);
 }
 
 void ParameterDictionary::RenameUsedTextures(
     const std::map<std::string, std::string> &m) {
     for (ParsedParameter *p : params) {
-        if (p->type != "texture")
+        if (p->typeAtom != textureTypeAtom)
             continue;
 
         CHECK_EQ(1, p->strings.size());
@@ -586,25 +661,32 @@ void ParameterDictionary::RenameUsedTextures(
     }
 }
 
+std::vector<std::string> ParameterDictionary::GetUsedTextures() const {
+    std::vector<std::string> names;
+    for (const ParsedParameter *p : params)
+        if (p->typeAtom == textureTypeAtom) {
+            CHECK_EQ(1, p->strings.size());
+            names.push_back(p->strings[0]);
+        }
+    return names;
+}
+
 void ParameterDictionary::ReportUnused() const {
     // type / name
-    InlinedVector<std::pair<const std::string *, const std::string *>, 16> seen;
+    InlinedVector<std::pair<ParameterAtom, ParameterAtom>, 16> seen;
 
     for (const ParsedParameter *p : params) {
         if (p->mayBeUnused)
             continue;
 
-        bool haveSeen =
-            std::find_if(seen.begin(), seen.end(),
-                         [&p](std::pair<const std::string *, const std::string *> p2) {
-                             return *p2.first == p->type && *p2.second == p->name;
-                         }) != seen.end();
+        bool haveSeen = std::find(seen.begin(), seen.end(),
+                                  std::make_pair(p->typeAtom, p->nameAtom)) != seen.end();
         if (p->lookedUp) {
             // A parameter may be used when creating an initial Material, say,
             // but then an override from a Shape may shadow it such that its
             // name is already in the seen array.
             if (!haveSeen)
-                seen.push_back(std::make_pair(&p->type, &p->name));
+                seen.push_back(std::make_pair(p->typeAtom, p->nameAtom));
         } else if (haveSeen) {
             // It's shadowed by another parameter; that's fine.
         } else
@@ -628,7 +710,7 @@ std::string ParameterDictionary::ToParameterDefinition(const ParsedParameter *p,
     };
 
     for (double v : p->numbers)
-        if (p->type == ParameterTypeTraits<ParameterType::Integer>::typeName)
+        if (p->typeAtom == TypeAtom<ParameterType::Integer>())
             printOne(StringPrintf("%d ", int(v)));
         else
             printOne(StringPrintf("%f ", Float(v)));
@@ -653,8 +735,9 @@ std::string ParameterDictionary::ToParameterList(int indentCount) const {
 }
 
 std::string ParameterDictionary::ToParameterDefinition(const std::string &name) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params)
-        if (p->name == name)
+        if (p->nameAtom == nameAtom)
             return ToParameterDefinition(p, 0);
     return "";
 }
@@ -671,8 +754,9 @@ std::string ParameterDictionary::ToString() const {
 }
 
 const FileLoc *ParameterDictionary::loc(const std::string &name) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : params)
-        if (p->name == name)
+        if (p->nameAtom == nameAtom)
             return &p->loc;
     return nullptr;
 }
@@ -798,11 +882,12 @@ SpectrumTextureHandle TextureParameterDictionary::GetSpectrumTextureOrNull(
                                        ? textures->generalSpectrumTextures
                                        : textures->illuminantSpectrumTextures;
 
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : dict->params) {
-        if (p->name != name)
+        if (p->nameAtom != nameAtom)
             continue;
 
-        if (p->type == "texture") {
+        if (p->typeAtom == textureTypeAtom) {
             if (p->strings.empty())
                 ErrorExit(&p->loc, "No texture name provided for parameter \"%s\".",
                           name);
@@ -819,7 +904,7 @@ SpectrumTextureHandle TextureParameterDictionary::GetSpectrumTextureOrNull(
             ErrorExit(&p->loc,
                       R"(Couldn't find spectrum texture named "%s" for parameter "%s")",
                       p->strings[0], p->name);
-        } else if (p->type == "rgb") {
+        } else if (p->typeAtom == rgbTypeAtom) {
             if (p->numbers.size() != 3)
                 ErrorExit(&p->loc,
                           "Didn't find three values for \"rgb\" parameter \"%s\".",
@@ -831,15 +916,10 @@ SpectrumTextureHandle TextureParameterDictionary::GetSpectrumTextureOrNull(
                 Warning(&p->loc,
                           "Negative value provided for \"rgb\" parameter \"%s\".",
                           p->name);
-            SpectrumHandle s;
-            if (spectrumType == SpectrumType::Illuminant)
-                s = alloc.new_object<RGBIlluminantSpectrum>(*dict->ColorSpace(), rgb);
-            else {
-                CHECK(spectrumType == SpectrumType::General);
-                s = alloc.new_object<RGBSpectrum>(*dict->ColorSpace(), rgb);
-            }
+            SpectrumHandle s =
+                LookupRGBSpectrum(*dict->ColorSpace(), rgb, spectrumType, alloc);
             return alloc.new_object<SpectrumConstantTexture>(s);
-        } else if (p->type == "spectrum" || p->type == "blackbody") {
+        } else if (p->typeAtom == spectrumTypeAtom || p->typeAtom == blackbodyTypeAtom) {
             SpectrumHandle s = GetOneSpectrum(name, nullptr, spectrumType, alloc);
             CHECK(s != nullptr);
             return alloc.new_object<SpectrumConstantTexture>(s);
@@ -858,11 +938,12 @@ FloatTextureHandle TextureParameterDictionary::GetFloatTexture(const std::string
 
 FloatTextureHandle TextureParameterDictionary::GetFloatTextureOrNull(
     const std::string &name, Allocator alloc) const {
+    ParameterAtom nameAtom = InternParameterString(name);
     for (const ParsedParameter *p : dict->params) {
-        if (p->name != name)
+        if (p->nameAtom != nameAtom)
             continue;
 
-        if (p->type == "texture") {
+        if (p->typeAtom == textureTypeAtom) {
             if (p->strings.empty())
                 ErrorExit(&p->loc, "No texture name provided for parameter \"%s\".",
                           name);
@@ -879,7 +960,7 @@ FloatTextureHandle TextureParameterDictionary::GetFloatTextureOrNull(
             ErrorExit(&p->loc,
                       R"(Couldn't find float texture named "%s" for parameter "%s")",
                       p->strings[0], p->name);
-        } else if (p->type == "float") {
+        } else if (p->typeAtom == TypeAtom<ParameterType::Float>()) {
             Float v = GetOneFloat(name, 0.f);  // we know this will be found
             return alloc.new_object<FloatConstantTexture>(v);
         }
@@ -52,6 +52,11 @@ struct NamedTextures {
 template <ParameterType PT>
 struct ParameterTypeTraits {};
 
+// Forgets the RGB spectra that parameter lookups have shared. As with
+// _ClearDenselySampledSpectrumCache()_, this must be called before the
+// memory resources that they were allocated from are released.
+void ClearRGBSpectrumCache();
+
 // ParameterDictionary Definition
 class ParameterDictionary {
   public:
@@ -85,6 +90,8 @@ class ParameterDictionary {
 
     void RenameParameter(const std::string &before, const std::string &after);
     void RenameUsedTextures(const std::map<std::string, std::string> &m);
+    // Returns the names of all textures that parameters refer to.
+    std::vector<std::string> GetUsedTextures() const;
 
     const RGBColorSpace *ColorSpace() const { return colorSpace; }
 
@@ -138,8 +145,8 @@ class ParameterDictionary {
 
     template <typename ReturnType, typename G, typename C>
     std::vector<ReturnType> lookupArray(const std::string &name, ParameterType type,
-                                        const char *typeName, int nPerItem, G getValues,
-                                        C convert) const;
+                                        ParameterAtom typeAtom, int nPerItem,
+                                        G getValues, C convert) const;
 
     std::vector<SpectrumHandle> extractSpectrumArray(const ParsedParameter &param,
                                                      SpectrumType spectrumType,
@@ -17,9 +17,12 @@
 #include <pbrt/util/mesh.h>
 #include <pbrt/util/parallel.h>
 #include <pbrt/util/print.h>
+#include <pbrt/util/progressreporter.h>
 #include <pbrt/util/spectrum.h>
+#include <pbrt/util/stats.h>
 #include <pbrt/util/transform.h>
 
+#include <algorithm>
 #include <iostream>
 #include <mutex>
 
@@ -426,6 +429,14 @@ void ParsedScene::Option(const std::string &name, const std::string &value, File
         else
             ErrorExitDeferred(&loc, "%s: expected \"true\" or \"false\" for option value",
                               value);
+    } else if (nName == "pixelcost") {
+        if (value == "true")
+            Options->recordPixelCost = true;
+        else if (value == "false")
+            Options->recordPixelCost = false;
+        else
+            ErrorExitDeferred(&loc, "%s: expected \"true\" or \"false\" for option value",
+                              value);
     } else if (nName == "pixelstats") {
         if (value == "true")
             Options->recordPixelStatistics = true;
@@ -611,173 +622,231 @@ void ParsedScene::AreaLightSource(const std::string &name, ParsedParameterVector
     graphicsState.areaLightLoc = loc;
 }
 
+STAT_TIMER("Scene/Material creation time", materialCreationTime);
+STAT_TIMER("Scene/Texture creation time", textureCreationTime);
+
 void ParsedScene::CreateMaterials(
     /*const*/ NamedTextures &textures, Allocator alloc,
     std::map<std::string, MaterialHandle> *namedMaterialsOut,
     std::vector<MaterialHandle> *materialsOut) const {
-    // Named materials
-    for (const auto &nm : namedMaterials) {
-        const std::string &name = nm.first;
-        const SceneEntity &mtl = nm.second;
-        if (namedMaterialsOut->find(name) != namedMaterialsOut->end()) {
+    Timer timer;
+
+    // Check named materials and find the ones that mix materials refer to
+    std::map<std::string, size_t> namedMaterialIndex;
+    std::vector<std::string> types(namedMaterials.size());
+    std::vector<size_t> toCreate;
+    for (size_t i = 0; i < namedMaterials.size(); ++i) {
+        const std::string &name = namedMaterials[i].first;
+        const SceneEntity &mtl = namedMaterials[i].second;
+        if (namedMaterialIndex.find(name) != namedMaterialIndex.end() ||
+            namedMaterialsOut->find(name) != namedMaterialsOut->end()) {
             ErrorExitDeferred(&mtl.loc, "%s: trying to redefine named material.", name);
             continue;
         }
 
-        std::string type = mtl.parameters.GetOneString("type", "");
-        if (type.empty()) {
+        types[i] = mtl.parameters.GetOneString("type", "");
+        if (types[i].empty()) {
             ErrorExitDeferred(&mtl.loc,
                               "%s: \"string type\" not provided in named material's "
                               "parameters.",
                               name);
             continue;
         }
-        TextureParameterDictionary texDict(&mtl.parameters, &textures);
-        MaterialHandle m =
-            MaterialHandle::Create(type, texDict, *namedMaterialsOut, &mtl.loc, alloc);
-        (*namedMaterialsOut)[name] = m;
+        namedMaterialIndex[name] = i;
+        toCreate.push_back(i);
+    }
+    std::vector<std::vector<size_t>> dependencies(namedMaterials.size());
+    for (size_t i : toCreate) {
+        if (types[i] != "mix")
+            continue;
+        for (const std::string &name :
+             namedMaterials[i].second.parameters.GetStringArray("materials"))
+            if (auto iter = namedMaterialIndex.find(name);
+                iter != namedMaterialIndex.end() && iter->second != i)
+                dependencies[i].push_back(iter->second);
+    }
+
+    // Named materials: create all of the ones whose dependencies have been
+    // created in parallel, until all are done
+    std::vector<bool> created(namedMaterials.size(), false);
+    while (!toCreate.empty()) {
+        std::vector<size_t> ready, waiting;
+        for (size_t i : toCreate)
+            if (std::all_of(dependencies[i].begin(), dependencies[i].end(),
+                            [&](size_t d) { return created[d]; }))
+                ready.push_back(i);
+            else
+                waiting.push_back(i);
+        // With a cycle of mix materials, nothing is ready; create them
+        // anyway and let MaterialHandle::Create() report the error.
+        if (ready.empty())
+            std::swap(ready, waiting);
+
+        std::vector<MaterialHandle> levelMaterials(ready.size());
+        ParallelFor(0, ready.size(), [&](int64_t j) {
+            const SceneEntity &mtl = namedMaterials[ready[j]].second;
+            TextureParameterDictionary texDict(&mtl.parameters, &textures);
+            levelMaterials[j] = MaterialHandle::Create(
+                types[ready[j]], texDict, *namedMaterialsOut, &mtl.loc, alloc);
+        });
+        for (size_t j = 0; j < ready.size(); ++j) {
+            (*namedMaterialsOut)[namedMaterials[ready[j]].first] = levelMaterials[j];
+            created[ready[j]] = true;
+        }
+        toCreate = std::move(waiting);
     }
 
     // Regular materials
-    materialsOut->reserve(materials.size());
-    for (const auto &mtl : materials) {
+    size_t firstMaterial = materialsOut->size();
+    materialsOut->resize(firstMaterial + materials.size());
+    ParallelFor(0, materials.size(), [&](int64_t i) {
+        const SceneEntity &mtl = materials[i];
         TextureParameterDictionary texDict(&mtl.parameters, &textures);
-        MaterialHandle m = MaterialHandle::Create(mtl.name, texDict, *namedMaterialsOut,
-                                                  &mtl.loc, alloc);
-        materialsOut->push_back(m);
-    }
+        (*materialsOut)[firstMaterial + i] = MaterialHandle::Create(
+            mtl.name, texDict, *namedMaterialsOut, &mtl.loc, alloc);
+    });
+
+    materialCreationTime += timer.ElapsedSeconds();
 }
 
 NamedTextures ParsedScene::CreateTextures(Allocator alloc, bool gpu) const {
+    Timer timer;
     NamedTextures textures;
 
-    std::set<std::string> seenFloatTextureFilenames, seenSpectrumTextureFilenames;
-    std::vector<size_t> parallelFloatTextures, serialFloatTextures;
-    std::vector<size_t> parallelSpectrumTextures, serialSpectrumTextures;
-
-    // Figure out which textures to load in parallel
-    // Need to be careful since two textures can use the same image file;
-    // we only want to load it once in that case...
-    for (size_t i = 0; i < floatTextures.size(); ++i) {
-        const auto &tex = floatTextures[i];
-
-        if (tex.second.renderFromObject.IsAnimated())
-            Warning(&tex.second.loc,
-                    "Animated world to texture transforms are not supported. "
-                    "Using start transform.");
+    // Textures are numbered with the float textures first, followed by the
+    // spectrum textures.
+    size_t nTextures = floatTextures.size() + spectrumTextures.size();
+    using NamedTexture = std::pair<std::string, TextureSceneEntity>;
+    auto getTexture = [&](size_t i) -> const NamedTexture & {
+        return i < floatTextures.size() ? floatTextures[i]
+                                        : spectrumTextures[i - floatTextures.size()];
+    };
 
-        if (tex.second.texName != "imagemap") {
-            serialFloatTextures.push_back(i);
-            continue;
+    // Find the dependencies between textures. A texture that refers to
+    // other textures by name can only be created after them. Image
+    // textures that use the same file, or a file with the same contents,
+    // are created after the first one so that they find its MIPMap in the
+    // texture caches rather than loading the file again.
+    std::map<std::string, std::vector<size_t>> textureIndices;
+    std::vector<std::string> imageFilenames(nTextures);
+    std::map<std::string, std::pair<uint64_t, int64_t>> fileContents;
+    for (size_t i = 0; i < nTextures; ++i) {
+        const auto &tex = getTexture(i);
+        textureIndices[tex.first].push_back(i);
+        if (tex.second.texName == "imagemap") {
+            imageFilenames[i] =
+                ResolveFilename(tex.second.parameters.GetOneString("filename", ""));
+            if (!imageFilenames[i].empty())
+                fileContents[imageFilenames[i]] = {0, -1};
         }
-
-        std::string filename =
-            ResolveFilename(tex.second.parameters.GetOneString("filename", ""));
-        if (filename.empty())
-            continue;
-
-        if (seenFloatTextureFilenames.find(filename) == seenFloatTextureFilenames.end()) {
-            seenFloatTextureFilenames.insert(filename);
-            parallelFloatTextures.push_back(i);
-        } else
-            serialFloatTextures.push_back(i);
     }
-    for (size_t i = 0; i < spectrumTextures.size(); ++i) {
-        const auto &tex = spectrumTextures[i];
 
+    // Hash the image files in parallel; files that can't be read keep a
+    // size of -1 and are left for the texture to report.
+    std::vector<std::string> files;
+    for (const auto &file : fileContents)
+        files.push_back(file.first);
+    std::vector<std::pair<uint64_t, int64_t>> hashes(files.size(), {0, -1});
+    ParallelFor(0, files.size(), [&](int64_t j) {
+        if (!ImageTextureBase::HashFileContents(files[j], &hashes[j].first,
+                                                &hashes[j].second))
+            hashes[j] = {0, -1};
+    });
+    for (size_t j = 0; j < files.size(); ++j)
+        fileContents[files[j]] = hashes[j];
+
+    std::vector<std::vector<size_t>> dependencies(nTextures);
+    std::map<std::string, size_t> firstImageTexture;
+    std::map<std::pair<uint64_t, int64_t>, size_t> firstImageContents;
+    std::vector<size_t> toCreate;
+    for (size_t i = 0; i < nTextures; ++i) {
+        const auto &tex = getTexture(i);
         if (tex.second.renderFromObject.IsAnimated())
             Warning(&tex.second.loc,
                     "Animated world to texture transforms are not supported. "
                     "Using start transform.");
 
-        if (tex.second.texName != "imagemap") {
-            serialSpectrumTextures.push_back(i);
-            continue;
+        if (const std::string &filename = imageFilenames[i]; !filename.empty()) {
+            std::pair<uint64_t, int64_t> contents = fileContents[filename];
+            if (auto iter = firstImageTexture.find(filename);
+                iter != firstImageTexture.end())
+                dependencies[i].push_back(iter->second);
+            else if (auto citer = firstImageContents.find(contents);
+                     contents.second != -1 && citer != firstImageContents.end()) {
+                dependencies[i].push_back(citer->second);
+                firstImageTexture[filename] = i;
+            } else {
+                firstImageTexture[filename] = i;
+                if (contents.second != -1)
+                    firstImageContents[contents] = i;
+            }
         }
 
-        std::string filename =
-            ResolveFilename(tex.second.parameters.GetOneString("filename", ""));
-        if (filename.empty())
-            continue;
-
-        if (seenSpectrumTextureFilenames.find(filename) ==
-            seenSpectrumTextureFilenames.end()) {
-            seenSpectrumTextureFilenames.insert(filename);
-            parallelSpectrumTextures.push_back(i);
-        } else
-            serialSpectrumTextures.push_back(i);
+        // Float and spectrum textures may share a name, so depend on both
+        for (const std::string &name : tex.second.parameters.GetUsedTextures())
+            if (auto iter = textureIndices.find(name); iter != textureIndices.end())
+                for (size_t d : iter->second)
+                    if (d != i)
+                        dependencies[i].push_back(d);
+        toCreate.push_back(i);
     }
 
-    LOG_VERBOSE("Loading %d,%d textures in parallel, %d,%d serially",
-                parallelFloatTextures.size(), parallelSpectrumTextures.size(),
-                serialFloatTextures.size(), serialSpectrumTextures.size());
-
-    // Load textures in parallel
-    std::mutex mutex;
-
-    ParallelFor(0, parallelFloatTextures.size(), [&](int64_t i) {
-        const auto &tex = floatTextures[parallelFloatTextures[i]];
-
-        pbrt::Transform renderFromTexture = tex.second.renderFromObject.startTransform;
-        // Pass nullptr for the textures, since they shouldn't be accessed
-        // anyway.
-        TextureParameterDictionary texDict(&tex.second.parameters, nullptr);
-        FloatTextureHandle t = FloatTextureHandle::Create(
-            tex.second.texName, renderFromTexture, texDict, &tex.second.loc, alloc, gpu);
-        std::lock_guard<std::mutex> lock(mutex);
-        textures.floatTextures[tex.first] = t;
-    });
-
-    ParallelFor(0, parallelSpectrumTextures.size(), [&](int64_t i) {
-        const auto &tex = spectrumTextures[parallelSpectrumTextures[i]];
-
-        pbrt::Transform renderFromTexture = tex.second.renderFromObject.startTransform;
-        // nullptr for the textures, as above.
-        TextureParameterDictionary texDict(&tex.second.parameters, nullptr);
-        SpectrumTextureHandle reflectanceTex = SpectrumTextureHandle::Create(
-            tex.second.texName, renderFromTexture, texDict, SpectrumType::General,
-            &tex.second.loc, alloc, gpu);
-        // This one should be fast since it should hit the texture cache
-        SpectrumTextureHandle generalTex = SpectrumTextureHandle::Create(
-            tex.second.texName, renderFromTexture, texDict, SpectrumType::Illuminant,
-            &tex.second.loc, alloc, gpu);
-
-        std::lock_guard<std::mutex> lock(mutex);
-        textures.generalSpectrumTextures[tex.first] = reflectanceTex;
-        textures.illuminantSpectrumTextures[tex.first] = generalTex;
-    });
-
-    LOG_VERBOSE("Loading serial textures");
-    // And do the rest serially
-    for (size_t index : serialFloatTextures) {
-        const auto &tex = floatTextures[index];
-
-        pbrt::Transform renderFromTexture = tex.second.renderFromObject.startTransform;
-        TextureParameterDictionary texDict(&tex.second.parameters, &textures);
-        FloatTextureHandle t = FloatTextureHandle::Create(
-            tex.second.texName, renderFromTexture, texDict, &tex.second.loc, alloc, gpu);
-        textures.floatTextures[tex.first] = t;
-    }
-    for (size_t index : serialSpectrumTextures) {
-        const auto &tex = spectrumTextures[index];
+    // Create all of the textures whose dependencies have been created in
+    // parallel, until all are done
+    std::vector<bool> created(nTextures, false);
+    int nLevels = 0;
+    while (!toCreate.empty()) {
+        std::vector<size_t> ready, waiting;
+        for (size_t i : toCreate)
+            if (std::all_of(dependencies[i].begin(), dependencies[i].end(),
+                            [&](size_t d) { return created[d]; }))
+                ready.push_back(i);
+            else
+                waiting.push_back(i);
+        // Nothing is ready if textures refer to each other; create them
+        // anyway and let the texture lookups report the error.
+        if (ready.empty())
+            std::swap(ready, waiting);
+        ++nLevels;
+
+        std::vector<FloatTextureHandle> levelFloatTextures(ready.size());
+        std::vector<SpectrumTextureHandle> levelGeneralTextures(ready.size());
+        std::vector<SpectrumTextureHandle> levelIlluminantTextures(ready.size());
+        ParallelFor(0, ready.size(), [&](int64_t j) {
+            const auto &tex = getTexture(ready[j]);
+            const pbrt::Transform &renderFromTexture =
+                tex.second.renderFromObject.startTransform;
+            TextureParameterDictionary texDict(&tex.second.parameters, &textures);
+            if (ready[j] < floatTextures.size())
+                levelFloatTextures[j] =
+                    FloatTextureHandle::Create(tex.second.texName, renderFromTexture,
+                                               texDict, &tex.second.loc, alloc, gpu);
+            else {
+                levelGeneralTextures[j] = SpectrumTextureHandle::Create(
+                    tex.second.texName, renderFromTexture, texDict, SpectrumType::General,
+                    &tex.second.loc, alloc, gpu);
+                // This one should be fast since it should hit the texture cache
+                levelIlluminantTextures[j] = SpectrumTextureHandle::Create(
+                    tex.second.texName, renderFromTexture, texDict,
+                    SpectrumType::Illuminant, &tex.second.loc, alloc, gpu);
+            }
+        });
 
-        if (tex.second.renderFromObject.IsAnimated())
-            Warning(&tex.second.loc, "Animated world to texture transform not supported. "
-                                     "Using start transform.");
-
-        pbrt::Transform renderFromTexture = tex.second.renderFromObject.startTransform;
-        TextureParameterDictionary texDict(&tex.second.parameters, &textures);
-        SpectrumTextureHandle reflectanceTex = SpectrumTextureHandle::Create(
-            tex.second.texName, renderFromTexture, texDict, SpectrumType::General,
-            &tex.second.loc, alloc, gpu);
-        SpectrumTextureHandle generalTex = SpectrumTextureHandle::Create(
-            tex.second.texName, renderFromTexture, texDict, SpectrumType::Illuminant,
-            &tex.second.loc, alloc, gpu);
-        textures.generalSpectrumTextures[tex.first] = reflectanceTex;
-        textures.illuminantSpectrumTextures[tex.first] = generalTex;
+        for (size_t j = 0; j < ready.size(); ++j) {
+            const std::string &name = getTexture(ready[j]).first;
+            if (ready[j] < floatTextures.size())
+                textures.floatTextures[name] = levelFloatTextures[j];
+            else {
+                textures.generalSpectrumTextures[name] = levelGeneralTextures[j];
+                textures.illuminantSpectrumTextures[name] = levelIlluminantTextures[j];
+            }
+            created[ready[j]] = true;
+        }
+        toCreate = std::move(waiting);
     }
 
-    LOG_VERBOSE("Done creating textures");
+    LOG_VERBOSE("Created %d textures in %d parallel steps", nTextures, nLevels);
+    textureCreationTime += timer.ElapsedSeconds();
     return textures;
 }
 
@@ -1078,9 +1147,9 @@ void FormattingScene::Texture(const std::string &name, const std::string &type,
         if (type == "float") {
             for (ParsedParameter *p : params) {
                 if (p->name == "tex1")
-                    p->name = "tex";
+                    p->SetName("tex");
                 if (p->name == "tex2")
-                    p->name = "scale";
+                    p->SetName("scale");
             }
         } else {
             // more subtle: rename one of them as float, but need one of them
@@ -1117,8 +1186,8 @@ void FormattingScene::Texture(const std::string &name, const std::string &type,
                     }
 
                     foundRGB = true;
-                    p->type = "float";
-                    p->name = "scale";
+                    p->SetType("float");
+                    p->SetName("scale");
                     p->numbers.resize(1);
                 } else {
                     if (foundTexture) {
@@ -1130,7 +1199,7 @@ void FormattingScene::Texture(const std::string &name, const std::string &type,
                             name);
                         return;
                     }
-                    p->name = "tex";
+                    p->SetName("tex");
                     foundTexture = true;
                 }
             }
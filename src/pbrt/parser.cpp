@@ -10,6 +10,7 @@
 #include <pbrt/util/check.h>
 #include <pbrt/util/error.h>
 #include <pbrt/util/file.h>
+#include <pbrt/util/float.h>
 #include <pbrt/util/memory.h>
 #include <pbrt/util/print.h>
 #include <pbrt/util/stats.h>
@@ -19,6 +20,7 @@
 #include <cctype>
 #include <cstdio>
 #include <cstring>
+#include <deque>
 #ifdef PBRT_HAVE_MMAP
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -31,12 +33,61 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace pbrt {
 
+///////////////////////////////////////////////////////////////////////////
+// ParameterAtom
+
+STAT_COUNTER("Scene/Interned parameter strings", nParameterAtoms);
+
+// The atom table is created on first use, since parameter type atoms are
+// interned from static initializers in other files.
+struct ParameterAtomTable {
+    std::mutex mutex;
+    // Strings are stored in a deque so that the string_view keys stay valid.
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, ParameterAtom> atoms;
+};
+
+static ParameterAtomTable &GetParameterAtomTable() {
+    static ParameterAtomTable table;
+    return table;
+}
+
+ParameterAtom InternParameterString(std::string_view str) {
+    // Atoms never change once assigned, so each thread keeps a copy of the
+    // entries it has used and only takes the lock for new strings.
+    thread_local std::unordered_map<std::string_view, ParameterAtom> threadAtoms;
+    if (auto iter = threadAtoms.find(str); iter != threadAtoms.end())
+        return iter->second;
+
+    ParameterAtomTable &table = GetParameterAtomTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto iter = table.atoms.find(str);
+    if (iter == table.atoms.end()) {
+        table.strings.push_back(std::string(str));
+        ParameterAtom atom = table.strings.size() - 1;
+        iter = table.atoms.insert({table.strings.back(), atom}).first;
+        ++nParameterAtoms;
+    }
+    threadAtoms.insert(*iter);
+    return iter->second;
+}
+
+const std::string &ParameterAtomString(ParameterAtom atom) {
+    ParameterAtomTable &table = GetParameterAtomTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    CHECK(atom >= 0 && size_t(atom) < table.strings.size());
+    return table.strings[atom];
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // ParsedParameter
 
@@ -360,6 +411,146 @@ static double parseNumber(const Token &t) {
     return val;
 }
 
+// Fast number parsing for long arrays of numbers. Eight digits at a time
+// are checked and converted using 64-bit integer arithmetic; see "Number
+// Parsing at a Gigabyte per Second" by Daniel Lemire.
+static inline bool isEightDigits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0) |
+            (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+           0x3333333333333333;
+}
+
+static inline uint32_t parseEightDigits(uint64_t v) {
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 0x000F424000000064;  // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001;  // 1 + (10000 << 32)
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return uint32_t(v);
+}
+
+static inline bool isDigit(char ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+static inline const char *parseDigits(const char *p, const char *end,
+                                      uint64_t *mantissa) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || \
+    defined(_MSC_VER)
+    while (end - p >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        if (!isEightDigits(v))
+            break;
+        // This may overflow for long runs of digits, but then the caller
+        // returns to parseNumber() anyway.
+        *mantissa = *mantissa * 100000000 + parseEightDigits(v);
+        p += 8;
+    }
+#endif
+    while (p < end && isDigit(*p))
+        *mantissa = *mantissa * 10 + (*p++ - '0');
+    return p;
+}
+
+// Parses a number of the form -?[0-9]*(.[0-9]*)?([eE][-+]?[0-9]+)? that
+// ends at a token delimiter, returning a pointer to the character after it.
+// nullptr is returned if the token isn't of that form or if its value
+// can't be computed exactly with a single floating-point operation; in
+// either case, parseNumber() should be used instead. Its results match
+// parseNumber()'s.
+static const char *parseNumberFast(const char *p, const char *end, double *value) {
+    bool negative = (*p == '-');
+    if (negative)
+        ++p;
+    // Integer and fractional digits
+    uint64_t mantissa = 0;
+    const char *intStart = p;
+    p = parseDigits(p, end, &mantissa);
+    int nDigits = p - intStart;
+    int exponent = 0;
+    bool isInteger = !negative;
+    if (p < end && *p == '.') {
+        isInteger = false;
+        const char *fracStart = ++p;
+        p = parseDigits(p, end, &mantissa);
+        nDigits += p - fracStart;
+        exponent = -int(p - fracStart);
+    }
+    if (nDigits == 0 || nDigits > 19)
+        return nullptr;
+
+    // Exponent
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        isInteger = false;
+        ++p;
+        bool negativeExponent = (p < end && *p == '-');
+        if (p < end && (*p == '-' || *p == '+'))
+            ++p;
+        if (p == end || !isDigit(*p))
+            return nullptr;
+        int e = 0;
+        for (; p < end && isDigit(*p); ++p)
+            if (e < 10000)
+                e = 10 * e + (*p - '0');
+        exponent += negativeExponent ? -e : e;
+    }
+    if (p < end && !(*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r' ||
+                     *p == '"' || *p == '[' || *p == ']'))
+        return nullptr;
+
+    if (isInteger) {
+        // parseNumber() uses strtol() for these
+        if (nDigits > 18)
+            return nullptr;
+        *value = double(mantissa);
+        return p;
+    }
+
+    // Both the mantissa and the power of ten are exactly representable, so
+    // a single multiply or divide gives the correctly-rounded result.
+    static const double powersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+        return nullptr;
+    double v = double(mantissa);
+    v = (exponent < 0) ? v / powersOfTen[-exponent] : v * powersOfTen[exponent];
+    if (sizeof(Float) == sizeof(float)) {
+        // Rounding to double and then to float gives the correctly-rounded
+        // float unless the double is exactly halfway between two floats.
+        if ((FloatToBits(v) & ((uint64_t(1) << 29) - 1)) == (uint64_t(1) << 28))
+            return nullptr;
+        v = float(v);
+    }
+    *value = negative ? -v : v;
+    return p;
+}
+
+size_t Tokenizer::ParseNumbers(pstd::vector<double> *values) {
+    size_t n = 0;
+    while (true) {
+        // Skip whitespace, keeping track of the current line
+        for (; pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\t' || *pos == '\r');
+             ++pos)
+            if (*pos == '\n') {
+                ++loc.line;
+                loc.column = 0;
+            } else
+                ++loc.column;
+
+        double v;
+        const char *next = (pos < end) ? parseNumberFast(pos, end, &v) : nullptr;
+        if (!next)
+            return n;
+        loc.column += next - pos;
+        pos = next;
+        values->push_back(v);
+        ++n;
+    }
+}
+
 inline bool isQuotedString(std::string_view str) {
     return str.size() >= 2 && str[0] == '"' && str.back() == '"';
 }
@@ -377,9 +568,10 @@ static std::string_view dequoteString(const Token &t) {
 constexpr int TokenOptional = 0;
 constexpr int TokenRequired = 1;
 
-template <typename Next, typename Unget>
+template <typename Next, typename Unget, typename ParseNumbers>
 static ParsedParameterVector parseParameters(
-    Next nextToken, Unget ungetToken, Allocator alloc, bool formatting,
+    Next nextToken, Unget ungetToken, ParseNumbers parseNumbers, Allocator alloc,
+    bool formatting,
     const std::function<void(const Token &token, const char *)> &errorCallback) {
     ParsedParameterVector parameterVector;
 
@@ -416,14 +608,14 @@ static ParsedParameterVector parseParameters(
 
         // Find end of type declaration
         auto typeEnd = skipToSpace(typeBegin);
-        param->type.assign(typeBegin, typeEnd);
-
+        std::string_view type(&*typeBegin, size_t(typeEnd - typeBegin));
         if (formatting) {  // close enough: upgrade...
-            if (param->type == "point")
-                param->type = "point3";
-            if (param->type == "color")
-                param->type = "rgb";
+            if (type == "point")
+                type = "point3";
+            if (type == "color")
+                type = "rgb";
         }
+        param->SetType(type);
 
         auto nameBegin = skipSpace(typeEnd);
         if (nameBegin == decl.end())
@@ -431,7 +623,7 @@ static ParsedParameterVector parseParameters(
                       std::string(decl.begin(), decl.end()));
 
         auto nameEnd = skipToSpace(nameBegin);
-        param->name.assign(nameBegin, nameEnd);
+        param->SetName(std::string_view(&*nameBegin, size_t(nameEnd - nameBegin)));
 
         enum ValType { Unknown, String, Bool, Number } valType = Unknown;
 
@@ -499,6 +691,12 @@ static ParsedParameterVector parseParameters(
 
         if (val.token == "[") {
             while (true) {
+                // Large arrays of numbers are parsed directly by the
+                // Tokenizer, without going through Token objects.
+                if ((valType == Unknown || valType == Number) &&
+                    parseNumbers(&param->numbers) > 0)
+                    valType = Number;
+
                 val = *nextToken(TokenRequired);
                 if (val.token == "]")
                     break;
@@ -585,6 +783,12 @@ static void parse(SceneRepresentation *scene, std::unique_ptr<Tokenizer> t) {
         ungetToken = t;
     };
 
+    auto parseNumbers = [&](pstd::vector<double> *values) -> size_t {
+        if (ungetToken.has_value() || fileStack.empty())
+            return 0;
+        return fileStack.back()->ParseNumbers(values);
+    };
+
     // Helper function for pbrt API entrypoints that take a single string
     // parameter and a ParameterVector (e.g. pbrtShape()).
     // using BasicEntrypoint = void (ParsedScene::*)(const std::string &,
@@ -597,7 +801,8 @@ static void parse(SceneRepresentation *scene, std::unique_ptr<Tokenizer> t) {
         std::string_view dequoted = dequoteString(t);
         std::string n = toString(dequoted);
         ParsedParameterVector parameterVector = parseParameters(
-            nextToken, unget, alloc, formatting, [&](const Token &t, const char *msg) {
+            nextToken, unget, parseNumbers, alloc, formatting,
+            [&](const Token &t, const char *msg) {
                 std::string token = toString(t.token);
                 std::string str = StringPrintf("%s: %s", token, msg);
                 parseError(str.c_str(), &t.loc);
@@ -850,7 +1055,7 @@ static void parse(SceneRepresentation *scene, std::unique_ptr<Tokenizer> t) {
                 std::string_view dequoted = dequoteString(t);
                 std::string texName = toString(dequoted);
                 ParsedParameterVector params = parseParameters(
-                    nextToken, unget, alloc, formatting,
+                    nextToken, unget, parseNumbers, alloc, formatting,
                     [&](const Token &t, const char *msg) {
                         std::string token = toString(t.token);
                         std::string str = StringPrintf("%s: %s", token, msg);
@@ -19,6 +19,15 @@
 
 namespace pbrt {
 
+// ParameterAtom Definition
+// Parameter names and types are interned as integer atoms so that
+// _ParameterDictionary_ lookups compare integers rather than strings. The
+// same string always maps to the same atom.
+using ParameterAtom = int;
+
+ParameterAtom InternParameterString(std::string_view str);
+const std::string &ParameterAtomString(ParameterAtom atom);
+
 // ParsedParameter Definition
 class ParsedParameter {
   public:
@@ -30,10 +39,22 @@ class ParsedParameter {
     void AddString(std::string_view str);
     void AddBool(bool v);
 
+    // _type_ and _name_ should only be changed via these so that their
+    // atoms stay in sync.
+    void SetType(std::string_view t) {
+        type = t;
+        typeAtom = InternParameterString(t);
+    }
+    void SetName(std::string_view n) {
+        name = n;
+        nameAtom = InternParameterString(n);
+    }
+
     std::string ToString() const;
 
     // ParsedParameter Public Members
     std::string type, name;
+    ParameterAtom typeAtom = -1, nameAtom = -1;
     FileLoc loc;
     pstd::vector<double> numbers;
     pstd::vector<std::string> strings;
@@ -166,6 +187,12 @@ class Tokenizer {
 
     pstd::optional<Token> Next();
 
+    // Parses the run of plain decimal numbers that starts at the current
+    // position (after any whitespace), appending their values to
+    // _values_. It stops at the first token that isn't one so that
+    // _Next()_ can handle it and returns the number of values parsed.
+    size_t ParseNumbers(pstd::vector<double> *values);
+
     // Just for parse().
     // TODO? Have a method to set this?
     FileLoc loc;
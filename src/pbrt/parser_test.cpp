@@ -11,6 +11,7 @@
 #include <fstream>
 #include <initializer_list>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace pbrt;
@@ -144,3 +145,51 @@ Integrator "deep" "float density" [ 2 2.66612 -5e-51]
 
     EXPECT_EQ(0, remove(filename.c_str()));
 }
+
+TEST(Parser, TokenizerParseNumbers) {
+    auto err = [](const char *err, const FileLoc *) {
+        EXPECT_TRUE(false) << "Unexpected error: " << err;
+    };
+    auto t = Tokenizer::CreateFromString(
+        "1 -2.5\n 3e2\t.25 123456789 0x10 4 ]", err);
+
+    // Parsing should stop at the hex value, which Next() returns
+    pstd::vector<double> values;
+    EXPECT_EQ(5, t->ParseNumbers(&values));
+    ASSERT_EQ(5, values.size());
+    EXPECT_EQ(1, values[0]);
+    EXPECT_EQ(-2.5, values[1]);
+    EXPECT_EQ(300, values[2]);
+    EXPECT_EQ(0.25, values[3]);
+    EXPECT_EQ(123456789, values[4]);
+    EXPECT_EQ(2, t->loc.line);
+    checkTokens(t.get(), {"0x10", "4", "]"});
+
+    // Values should match the ones from the regular parsing path
+    t = Tokenizer::CreateFromString("0.1 0.70710677 -16777217 16777217 1e-30 ]", err);
+    values.clear();
+    EXPECT_EQ(4, t->ParseNumbers(&values));
+    EXPECT_EQ(Float(0.1), values[0]);
+    EXPECT_EQ(Float(0.70710677), values[1]);
+    EXPECT_EQ(Float(-16777217), values[2]);
+    EXPECT_EQ(16777217, values[3]);
+    checkTokens(t.get(), {"1e-30", "]"});
+}
+
+TEST(Parser, ParameterAtoms) {
+    ParameterAtom radius = InternParameterString("radius");
+    EXPECT_EQ(radius, InternParameterString(std::string("rad") + "ius"));
+    EXPECT_NE(radius, InternParameterString("radius2"));
+    EXPECT_NE(radius, InternParameterString("r"));
+    EXPECT_EQ("radius", ParameterAtomString(radius));
+
+    // Atoms are shared across threads
+    ParameterAtom fromThread[2];
+    std::thread t([&]() {
+        fromThread[0] = InternParameterString("radius");
+        fromThread[1] = InternParameterString("zmax-from-thread");
+    });
+    t.join();
+    EXPECT_EQ(radius, fromThread[0]);
+    EXPECT_EQ(fromThread[1], InternParameterString("zmax-from-thread"));
+}
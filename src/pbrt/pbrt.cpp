@@ -17,6 +17,7 @@
 #include <pbrt/util/print.h>
 #include <pbrt/util/spectrum.h>
 #include <pbrt/util/stats.h>
+#include <pbrt/util/texcache.h>
 
 #include <stdlib.h>
 
@@ -78,10 +79,13 @@ void InitPBRT(const PBRTOptions &opt) {
         InitBufferCaches({});
         Triangle::Init({});
         BilinearPatch::Init({});
+
+        if (Options->textureCacheMB > 0)
+            InitTextureTileCache(size_t(Options->textureCacheMB) << 20);
     }
 
     if (!Options->displayServer.empty())
-        ConnectToDisplayServer(Options->displayServer);
+        ConnectToDisplayServer(Options->displayServer, Options->displaySharedMemory);
 }
 
 void CleanupPBRT() {
@@ -139,6 +139,7 @@ enum class SpectrumType;
 class BSDF;
 class CameraTransform;
 class Image;
+class TiledEXRWriter;
 class ParameterDictionary;
 class TextureParameterDictionary;
 struct ImageMetadata;
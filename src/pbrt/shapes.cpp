@@ -434,6 +434,7 @@ STAT_MEMORY_COUNTER("Memory/Curves", curveBytes);
 STAT_PERCENT("Intersections/Ray-curve intersection tests", nCurveHits, nCurveTests);
 STAT_COUNTER("Geometry/Curves", nCurves);
 STAT_COUNTER("Geometry/Split curves", nSplitCurves);
+STAT_COUNTER("Geometry/Tessellated curve patches", nTessellatedCurvePatches);
 
 std::string ToString(CurveType type) {
     switch (type) {
@@ -484,22 +485,87 @@ std::string CurveCommon::ToString() const {
         reverseOrientation, transformSwapsHandedness);
 }
 
+// Compute refinement depth for cubic B\'ezier segment with control points _cp_
+static int CurveRefinementDepth(pstd::span<const Point3f> cp, Float maxWidth) {
+    // The ray--curve test projects the control points into a rigid frame
+    // aligned with the ray; the length of each second difference bounds
+    // its components in any such frame, so the depth computed here is
+    // never less than the one the intersection test would find per ray.
+    Float L0 = 0;
+    for (int i = 0; i < 2; ++i)
+        L0 = std::max(L0, Length(Vector3f(cp[i]) - 2 * Vector3f(cp[i + 1]) +
+                                   Vector3f(cp[i + 2])));
+    if (L0 == 0)
+        return 0;
+    Float eps = maxWidth * .05f;  // width / 20
+    // Compute log base 4 by dividing log2 in half.
+    int r0 = Log2Int(1.41421356237f * 6.f * L0 / (8.f * eps)) / 2;
+    return Clamp(r0, 0, 10);
+}
+
+// Append bilinear patches that approximate a ribbon B\'ezier segment
+static void TessellateRibbon(pstd::span<const Point3f> cp, Float w0, Float w1,
+                             pstd::span<const Normal3f> norm, std::vector<int> *indices,
+                             std::vector<Point3f> *P, std::vector<Point2f> *uv) {
+    // Use the same flatness criterion as the ray--curve intersection test
+    int nQuads = 1 << CurveRefinementDepth(cp, std::max(w0, w1));
+
+    Normal3f n0 = Normalize(norm[0]), n1 = Normalize(norm[1]);
+    Float normalAngle = AngleBetween(n0, n1);
+    Float invSinNormalAngle = 1 / std::sin(normalAngle);
+
+    int vOffset = int(P->size());
+    for (int i = 0; i <= nQuads; ++i) {
+        // Compute ribbon cross section at $u$ and add its two vertices
+        Float u = Float(i) / Float(nQuads);
+        Vector3f dpdu;
+        Point3f p = EvaluateCubicBezier(cp, u, &dpdu);
+        Normal3f nu = n0;
+        if (normalAngle != 0) {
+            Float sin0 = std::sin((1 - u) * normalAngle) * invSinNormalAngle;
+            Float sin1 = std::sin(u * normalAngle) * invSinNormalAngle;
+            nu = sin0 * n0 + sin1 * n1;
+        }
+        // Offset along the same $\dpdv$ direction that _Curve_ uses for ribbons
+        Vector3f dpdv = Normalize(Cross(nu, dpdu)) * (Lerp(u, w0, w1) * 0.5f);
+        P->push_back(p - dpdv);
+        P->push_back(p + dpdv);
+        uv->push_back(Point2f(u, 0));
+        uv->push_back(Point2f(u, 1));
+    }
+
+    for (int i = 0; i < nQuads; ++i) {
+        int v0 = vOffset + 2 * i;
+        indices->insert(indices->end(), {v0, v0 + 2, v0 + 1, v0 + 3});
+    }
+}
+
 pstd::vector<ShapeHandle> CreateCurve(const Transform *renderFromObject,
                                       const Transform *objectFromRender,
                                       bool reverseOrientation,
                                       pstd::span<const Point3f> c, Float w0, Float w1,
                                       CurveType type, pstd::span<const Normal3f> norm,
-                                      int splitDepth, Allocator alloc) {
+                                      int splitDepth, bool adaptiveSplit,
+                                      Allocator alloc) {
     CurveCommon *common = alloc.new_object<CurveCommon>(
         c, w0, w1, type, norm, renderFromObject, objectFromRender, reverseOrientation);
 
+    // Choose split depth, possibly based on the segment's refinement depth
+    Float maxWidth = std::max(w0, w1);
+    if (adaptiveSplit)
+        splitDepth = std::min(splitDepth, CurveRefinementDepth(c, maxWidth));
+
     const int nSegments = 1 << splitDepth;
     pstd::vector<ShapeHandle> segments(nSegments, alloc);
     Curve *curves = alloc.allocate_object<Curve>(nSegments);
     for (int i = 0; i < nSegments; ++i) {
         Float uMin = i / (Float)nSegments;
         Float uMax = (i + 1) / (Float)nSegments;
-        alloc.construct(&curves[i], common, uMin, uMax);
+        // Precompute refinement depth for the split curve's control points
+        pstd::array<Point3f, 4> cpSeg = CubicBezierControlPoints(c, uMin, uMax);
+        int maxDepth = CurveRefinementDepth(cpSeg, maxWidth);
+
+        alloc.construct(&curves[i], common, uMin, uMax, maxDepth);
         segments[i] = &curves[i];
         ++nSplitCurves;
     }
@@ -573,22 +639,7 @@ bool Curve::IntersectRay(const Ray &r, Float tMax,
     if (!Overlaps(rayBounds, curveBounds))
         return false;
 
-    // Compute refinement depth for curve, _maxDepth_
-    Float L0 = 0;
-    for (int i = 0; i < 2; ++i)
-        L0 = std::max(
-            L0, std::max(std::max(std::abs(cp[i].x - 2 * cp[i + 1].x + cp[i + 2].x),
-                                  std::abs(cp[i].y - 2 * cp[i + 1].y + cp[i + 2].y)),
-                         std::abs(cp[i].z - 2 * cp[i + 1].z + cp[i + 2].z)));
-    int maxDepth = 0;
-    if (L0 > 0) {
-        Float eps = std::max(common->width[0], common->width[1]) * .05f;  // width / 20
-        // Compute log base 4 by dividing log2 in half.
-        int r0 = Log2Int(1.41421356237f * 6.f * L0 / (8.f * eps)) / 2;
-        maxDepth = Clamp(r0, 0, 10);
-    }
-
-    // Recursively test for ray--curve intersection
+    // Recursively test for ray--curve intersection to precomputed _maxDepth_
     pstd::span<const Point3f> cpSpan(cp);
     return RecursiveIntersect(ray, tMax, cpSpan, Inverse(rayFromObject), uMin, uMax,
                               maxDepth, si);
@@ -747,7 +798,8 @@ Float Curve::PDF(const ShapeSampleContext &ctx, const Vector3f &wi) const {
 }
 
 std::string Curve::ToString() const {
-    return StringPrintf("[ Curve common: %s uMin: %f uMax: %f ]", *common, uMin, uMax);
+    return StringPrintf("[ Curve common: %s uMin: %f uMax: %f maxDepth: %d ]", *common,
+                        uMin, uMax, maxDepth);
 }
 
 pstd::vector<ShapeHandle> Curve::Create(const Transform *renderFromObject,
@@ -833,6 +885,12 @@ pstd::vector<ShapeHandle> Curve::Create(const Transform *renderFromObject,
     }
 
     int sd = parameters.GetOneInt("splitdepth", 3);
+    bool adaptiveSplit = parameters.GetOneBool("adaptivesplit", false);
+    bool tessellate = parameters.GetOneBool("tessellate", false);
+    if (tessellate && type != CurveType::Ribbon) {
+        Warning(loc, "\"tessellate\" is only supported for \"ribbon\" curves.");
+        tessellate = false;
+    }
 
     if (type == CurveType::Ribbon && n.empty()) {
         Error(loc, "Must provide normals \"N\" at curve endpoints with ribbon "
@@ -841,6 +899,10 @@ pstd::vector<ShapeHandle> Curve::Create(const Transform *renderFromObject,
     }
 
     pstd::vector<ShapeHandle> curves(alloc);
+    // Vertex data for tessellated ribbons, which become a single bilinear mesh
+    std::vector<int> blpIndices;
+    std::vector<Point3f> blpP;
+    std::vector<Point2f> blpUV;
     // Pointer to the first control point for the current segment. This is
     // updated after each loop iteration depending on the current basis.
     int cpOffset = 0;
@@ -879,13 +941,27 @@ pstd::vector<ShapeHandle> Curve::Create(const Transform *renderFromObject,
         pstd::span<const Normal3f> nspan;
         if (!n.empty())
             nspan = pstd::MakeSpan(&n[seg], 2);
-        auto c =
-            CreateCurve(renderFromObject, objectFromRender, reverseOrientation,
-                        segCpBezier, Lerp(Float(seg) / Float(nSegments), width0, width1),
-                        Lerp(Float(seg + 1) / Float(nSegments), width0, width1), type,
-                        nspan, sd, alloc);
+        Float segWidth0 = Lerp(Float(seg) / Float(nSegments), width0, width1);
+        Float segWidth1 = Lerp(Float(seg + 1) / Float(nSegments), width0, width1);
+        if (tessellate) {
+            TessellateRibbon(segCpBezier, segWidth0, segWidth1, nspan, &blpIndices,
+                             &blpP, &blpUV);
+            continue;
+        }
+        auto c = CreateCurve(renderFromObject, objectFromRender, reverseOrientation,
+                             segCpBezier, segWidth0, segWidth1, type, nspan, sd,
+                             adaptiveSplit, alloc);
         curves.insert(curves.end(), c.begin(), c.end());
     }
+
+    if (tessellate) {
+        BilinearPatchMesh *mesh = alloc.new_object<BilinearPatchMesh>(
+            *renderFromObject, reverseOrientation, std::move(blpIndices),
+            std::move(blpP), std::vector<Normal3f>(), std::move(blpUV),
+            std::vector<int>(), nullptr /* image dist */);
+        nTessellatedCurvePatches += mesh->nPatches;
+        curves = BilinearPatch::CreatePatches(mesh, alloc);
+    }
     return curves;
 }
 
@@ -1393,11 +1469,20 @@ pstd::vector<ShapeHandle> ShapeHandle::Create(const std::string &name,
         if (P.empty())
             ErrorExit(loc, "Vertex positions \"P\" not provided for LoopSubdiv shape.");
 
+        for (int vi : vertexIndices)
+            if (vi < 0 || vi >= P.size())
+                ErrorExit(loc, "Vertex index %d out of range for LoopSubdiv shape with "
+                               "%d vertices.",
+                          vi, int(P.size()));
+
+        // Refine adaptively until edges are shorter than _edgeLength_, if given
+        Float edgeLength = parameters.GetOneFloat("edgelength", 0.f);
+
         // don't actually use this for now...
         std::string scheme = parameters.GetOneString("scheme", "loop");
 
         TriangleMesh *mesh = LoopSubdivide(renderFromObject, reverseOrientation, nLevels,
-                                           vertexIndices, P, alloc);
+                                           edgeLength, vertexIndices, P, alloc);
 
         shapes = Triangle::CreateTriangles(mesh, alloc);
     } else
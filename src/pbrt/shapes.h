@@ -1234,8 +1234,8 @@ class Curve {
 
     std::string ToString() const;
 
-    Curve(const CurveCommon *common, Float uMin, Float uMax)
-        : common(common), uMin(uMin), uMax(uMax) {}
+    Curve(const CurveCommon *common, Float uMin, Float uMax, int maxDepth)
+        : common(common), uMin(uMin), uMax(uMax), maxDepth(maxDepth) {}
 
     PBRT_CPU_GPU
     DirectionCone NormalBounds() const { return DirectionCone::EntireSphere(); }
@@ -1251,6 +1251,7 @@ class Curve {
     // Curve Private Members
     const CurveCommon *common;
     Float uMin, uMax;
+    int maxDepth;
 };
 
 // BilinearPatch Declarations
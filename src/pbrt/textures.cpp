@@ -11,10 +11,14 @@
 #include <pbrt/util/error.h>
 #include <pbrt/util/file.h>
 #include <pbrt/util/float.h>
+#include <pbrt/util/hash.h>
 #include <pbrt/util/splines.h>
 #include <pbrt/util/stats.h>
 
+#include <cstdio>
+#include <cstring>
 #include <mutex>
+#include <vector>
 
 #include <Ptexture.h>
 
@@ -377,8 +381,137 @@ std::string TexInfo::ToString() const {
         filterOptions, wrapMode, encoding);
 }
 
+std::string TexContentInfo::ToString() const {
+    return StringPrintf("[ TexContentInfo hash: %d size: %d filterOptions: %s "
+                        "wrapMode: %s encoding: %s ]",
+                        hash, size, filterOptions, wrapMode, encoding);
+}
+
+STAT_COUNTER("Texture/Image textures shared with identical files", nSharedImageTextures);
+STAT_MEMORY_COUNTER("Memory/Image maps saved by sharing identical files",
+                    sharedImageTextureBytes);
+
 std::mutex ImageTextureBase::textureCacheMutex;
 std::map<TexInfo, MIPMap *> ImageTextureBase::textureCache;
+std::multimap<TexContentInfo, std::pair<std::string, MIPMap *>>
+    ImageTextureBase::contentCache;
+
+// Hashes the start of the file and records its size. This is only used to
+// find candidates for sharing, so there's no need to read all of a large
+// file here. Tiled MIP files are skipped since their tiles are read on
+// demand.
+bool ImageTextureBase::HashFileContents(const std::string &filename, uint64_t *hash,
+                                        int64_t *size) {
+    if (TiledImagePyramid::IsTiledFile(filename))
+        return false;
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+    std::vector<uint8_t> buf(64 * 1024);
+    size_t n = fread(buf.data(), 1, buf.size(), f);
+    bool ok = !ferror(f) && fseek(f, 0, SEEK_END) == 0;
+    *size = ok ? ftell(f) : -1;
+    fclose(f);
+    *hash = HashBuffer(buf.data(), n);
+    return ok && *size >= 0;
+}
+
+// Returns true if both files can be read and have the same contents.
+static bool FileContentsEqual(const std::string &a, const std::string &b) {
+    FILE *fa = fopen(a.c_str(), "rb");
+    FILE *fb = fopen(b.c_str(), "rb");
+    bool equal = fa && fb;
+    std::vector<uint8_t> bufa(1024 * 1024), bufb(1024 * 1024);
+    while (equal) {
+        size_t na = fread(bufa.data(), 1, bufa.size(), fa);
+        size_t nb = fread(bufb.data(), 1, bufb.size(), fb);
+        equal = na == nb && !ferror(fa) && !ferror(fb) &&
+                std::memcmp(bufa.data(), bufb.data(), na) == 0;
+        if (na < bufa.size())
+            break;
+    }
+    if (fa)
+        fclose(fa);
+    if (fb)
+        fclose(fb);
+    return equal;
+}
+
+MIPMap *ImageTextureBase::FindOrCreateMIPMap(const TexInfo &texInfo, Allocator alloc) {
+    auto create = [&]() {
+        return MIPMap::CreateFromFile(texInfo.filename, texInfo.filterOptions,
+                                      texInfo.wrapMode, texInfo.encoding, alloc);
+    };
+    TexContentInfo contentInfo{0, 0, texInfo.filterOptions, texInfo.wrapMode,
+                               texInfo.encoding};
+    if (!HashFileContents(texInfo.filename, &contentInfo.hash, &contentInfo.size))
+        // Tiled files aren't shared; let _MIPMap::CreateFromFile()_ report
+        // any errors
+        return create();
+
+    // Return the _MIPMap_ for a file with the same contents if there is one
+    std::unique_lock<std::mutex> lock(textureCacheMutex);
+    std::vector<std::pair<std::string, MIPMap *>> candidates;
+    auto range = contentCache.equal_range(contentInfo);
+    for (auto iter = range.first; iter != range.second; ++iter)
+        candidates.push_back(iter->second);
+    lock.unlock();
+
+    // Compare the files without holding the lock
+    for (const auto &candidate : candidates)
+        if (FileContentsEqual(texInfo.filename, candidate.first)) {
+            LOG_VERBOSE("%s: sharing MIPMap with identical file %s", texInfo.filename,
+                        candidate.first);
+            ++nSharedImageTextures;
+            sharedImageTextureBytes += candidate.second->BytesUsed();
+            return candidate.second;
+        }
+
+    // Load the file without holding the lock. _CreateTextures()_ orders
+    // textures with identical files so that this is normally the only
+    // thread loading it; if another one got there first anyway, just use
+    // this copy rather than waiting for it, which could deadlock when
+    // called from a thread pool task.
+    MIPMap *mipmap = create();
+    lock.lock();
+    contentCache.insert({contentInfo, {texInfo.filename, mipmap}});
+    return mipmap;
+}
+
+void FloatImageTexture::Evaluate(pstd::span<const FloatImageTexture *const> textures,
+                                 TextureEvalContext ctx, pstd::span<Float> result) {
+    CHECK_EQ(textures.size(), result.size());
+    CHECK_LE(textures.size(), MaxBatchSize);
+    // Compute the texture-space footprint of each texture
+    Point2f st[MaxBatchSize];
+    Vector2f dstdx[MaxBatchSize], dstdy[MaxBatchSize];
+    for (size_t i = 0; i < textures.size(); ++i) {
+        st[i] = textures[i]->mapping.Map(ctx, &dstdx[i], &dstdy[i]);
+        st[i][1] = 1 - st[i][1];
+    }
+
+    // Filter the MIPMaps of the textures with each distinct footprint together
+    bool filtered[MaxBatchSize] = {};
+    for (size_t i = 0; i < textures.size(); ++i) {
+        if (filtered[i])
+            continue;
+        const MIPMap *mipmaps[MaxBatchSize];
+        size_t index[MaxBatchSize];
+        size_t n = 0;
+        for (size_t j = i; j < textures.size(); ++j)
+            if (!filtered[j] && st[j] == st[i] && dstdx[j] == dstdx[i] &&
+                dstdy[j] == dstdy[i]) {
+                mipmaps[n] = textures[j]->mipmap;
+                index[n++] = j;
+                filtered[j] = true;
+            }
+
+        Float values[MaxBatchSize];
+        MIPMap::Filter<Float>({mipmaps, n}, st[i], dstdx[i], dstdy[i], {values, n});
+        for (size_t k = 0; k < n; ++k)
+            result[index[k]] = textures[index[k]]->scale * values[k];
+    }
+}
 
 FloatImageTexture *FloatImageTexture::Create(const Transform &renderFromTexture,
                                              const TextureParameterDictionary &parameters,
@@ -536,7 +669,10 @@ struct : public PtexErrorHandler {
 PtexTextureBase::PtexTextureBase(const std::string &filename,
                                  ColorEncodingHandle encoding)
     : filename(filename), encoding(encoding) {
-    if (cache == nullptr) {
+    // Textures may be created in parallel, so make sure the cache is only
+    // created once.
+    static std::once_flag cacheCreated;
+    std::call_once(cacheCreated, []() {
         int maxFiles = 100;
         size_t maxMem = 1ull << 32;  // 4GB
         bool premultiply = true;
@@ -544,7 +680,7 @@ PtexTextureBase::PtexTextureBase(const std::string &filename,
         cache = Ptex::PtexCache::create(maxFiles, maxMem, premultiply, nullptr,
                                         &errorHandler);
         // TODO? cache->setSearchPath(...);
-    }
+    });
 
     // Issue an error if the texture doesn't exist or has an unsupported
     // number of channels.
@@ -1255,6 +1391,29 @@ Float UniversalTextureEvaluator::operator()(FloatTextureHandle tex,
     return tex.Evaluate(ctx);
 }
 
+void UniversalTextureEvaluator::operator()(pstd::span<const FloatTextureHandle> tex,
+                                           TextureEvalContext ctx,
+                                           pstd::span<Float> result) {
+    CHECK_EQ(tex.size(), result.size());
+    CHECK_LE(tex.size(), FloatImageTexture::MaxBatchSize);
+    // Evaluate the image textures together and the others one at a time
+    const FloatImageTexture *images[FloatImageTexture::MaxBatchSize];
+    size_t imageIndex[FloatImageTexture::MaxBatchSize];
+    int nImages = 0;
+    for (size_t i = 0; i < tex.size(); ++i)
+        if (const FloatImageTexture *image = tex[i].CastOrNullptr<FloatImageTexture>()) {
+            images[nImages] = image;
+            imageIndex[nImages++] = i;
+        } else
+            result[i] = tex[i].Evaluate(ctx);
+
+    Float values[FloatImageTexture::MaxBatchSize];
+    FloatImageTexture::Evaluate({images, size_t(nImages)}, ctx,
+                                {values, size_t(nImages)});
+    for (int i = 0; i < nImages; ++i)
+        result[imageIndex[i]] = values[i];
+}
+
 SampledSpectrum UniversalTextureEvaluator::operator()(SpectrumTextureHandle tex,
                                                       TextureEvalContext ctx,
                                                       SampledWavelengths lambda) {
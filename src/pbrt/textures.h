@@ -520,6 +520,26 @@ struct TexInfo {
     ColorEncodingHandle encoding;
 };
 
+// TexContentInfo Definition
+// Identifies an image texture by its file's size and a hash of the start of
+// the file. Files with the same _TexContentInfo_ are compared in full
+// before different filenames share a _MIPMap_.
+struct TexContentInfo {
+    // TexContentInfo Public Methods
+    bool operator<(const TexContentInfo &t) const {
+        return std::tie(hash, size, filterOptions, encoding, wrapMode) <
+               std::tie(t.hash, t.size, t.filterOptions, t.encoding, t.wrapMode);
+    }
+
+    std::string ToString() const;
+
+    uint64_t hash;
+    int64_t size;
+    MIPMapFilterOptions filterOptions;
+    WrapMode wrapMode;
+    ColorEncodingHandle encoding;
+};
+
 // ImageTextureBase Definition
 class ImageTextureBase {
   public:
@@ -538,8 +558,7 @@ class ImageTextureBase {
         lock.unlock();
 
         // Create _MIPMap_ for _filename_ and add to texture cache
-        mipmap =
-            MIPMap::CreateFromFile(filename, filterOptions, wrapMode, encoding, alloc);
+        mipmap = FindOrCreateMIPMap(texInfo, alloc);
         lock.lock();
         // This is actually ok, but if it hits, it means we've wastefully
         // loaded this texture. (Note that in that case, should just return
@@ -548,7 +567,13 @@ class ImageTextureBase {
         textureCache[texInfo] = mipmap;
     }
 
-    static void ClearCache() { textureCache.clear(); }
+    static void ClearCache() {
+        textureCache.clear();
+        contentCache.clear();
+    }
+
+    static bool HashFileContents(const std::string &filename, uint64_t *hash,
+                                 int64_t *size);
 
     void MultiplyScale(Float s) { scale *= s; }
 
@@ -559,9 +584,13 @@ class ImageTextureBase {
     MIPMap *mipmap;
 
   private:
+    // ImageTextureBase Private Methods
+    static MIPMap *FindOrCreateMIPMap(const TexInfo &texInfo, Allocator alloc);
+
     // ImageTextureBase Private Members
     static std::mutex textureCacheMutex;
     static std::map<TexInfo, MIPMap *> textureCache;
+    static std::multimap<TexContentInfo, std::pair<std::string, MIPMap *>> contentCache;
 };
 
 // FloatImageTexture Definition
@@ -586,6 +615,13 @@ class FloatImageTexture : public ImageTextureBase {
 #endif
     }
 
+    // Evaluates up to _MaxBatchSize_ textures at once; the MIPMaps of
+    // textures whose mappings give the same footprint are filtered together
+    // so that they can share EWA filter weights.
+    static constexpr int MaxBatchSize = 8;
+    static void Evaluate(pstd::span<const FloatImageTexture *const> textures,
+                         TextureEvalContext ctx, pstd::span<Float> result);
+
     static FloatImageTexture *Create(const Transform &renderFromTexture,
                                      const TextureParameterDictionary &parameters,
                                      const FileLoc *loc, Allocator alloc);
@@ -1012,6 +1048,11 @@ class UniversalTextureEvaluator {
 
     PBRT_CPU_GPU
     Float operator()(FloatTextureHandle tex, TextureEvalContext ctx);
+    // Evaluates several float textures at the same point, e.g. a material's
+    // roughness textures, filtering image textures together.
+    PBRT_CPU_GPU
+    void operator()(pstd::span<const FloatTextureHandle> tex, TextureEvalContext ctx,
+                    pstd::span<Float> result);
 
     PBRT_CPU_GPU
     SampledSpectrum operator()(SpectrumTextureHandle tex, TextureEvalContext ctx,
@@ -1045,6 +1086,13 @@ class BasicTextureEvaluator {
             return 0.f;
     }
 
+    PBRT_CPU_GPU
+    void operator()(pstd::span<const FloatTextureHandle> tex, TextureEvalContext ctx,
+                    pstd::span<Float> result) {
+        for (size_t i = 0; i < tex.size(); ++i)
+            result[i] = (*this)(tex[i], ctx);
+    }
+
     PBRT_CPU_GPU
     SampledSpectrum operator()(SpectrumTextureHandle tex, TextureEvalContext ctx,
                                SampledWavelengths lambda) {
@@ -0,0 +1,448 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <pbrt/util/blockcompress.h>
+
+#include <pbrt/util/check.h>
+#include <pbrt/util/float.h>
+#include <pbrt/util/log.h>
+#include <pbrt/util/math.h>
+#include <pbrt/util/parallel.h>
+#include <pbrt/util/print.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace pbrt {
+
+std::string ToString(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+        return "BC1";
+    case BlockFormat::BC3:
+        return "BC3";
+    case BlockFormat::BC4:
+        return "BC4";
+    case BlockFormat::HDR:
+        return "HDR";
+    default:
+        LOG_FATAL("Unhandled BlockFormat");
+        return "";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Block Decoding Functions
+
+static uint16_t ReadU16(const uint8_t *p) {
+    return uint16_t(p[0]) | (uint16_t(p[1]) << 8);
+}
+
+static void WriteU16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void Unpack565(uint16_t c, int rgb[3]) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void BC1Palette(uint16_t c0, uint16_t c1, bool fourColor, int palette[4][3]) {
+    Unpack565(c0, palette[0]);
+    Unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        if (fourColor || c0 > c1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+static void BC4Palette(int r0, int r1, int palette[8]) {
+    palette[0] = r0;
+    palette[1] = r1;
+    if (r0 > r1) {
+        for (int i = 2; i < 8; ++i)
+            palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+    } else {
+        for (int i = 2; i < 6; ++i)
+            palette[i] = ((6 - i) * r0 + (i - 1) * r1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static void HDRPalette(const uint8_t *block, Float palette[4][3]) {
+    for (int c = 0; c < 3; ++c) {
+        palette[0][c] = Float(Half::FromBits(ReadU16(block + 2 * c)));
+        palette[1][c] = Float(Half::FromBits(ReadU16(block + 6 + 2 * c)));
+        // As with BC6H, interpolated values are also half-precision
+        palette[2][c] = Float(Half((2 * palette[0][c] + palette[1][c]) / 3));
+        palette[3][c] = Float(Half((palette[0][c] + 2 * palette[1][c]) / 3));
+    }
+}
+
+// Returns the _i_th texel's value from an 8-byte BC1 block.
+static void DecodeBC1(const uint8_t *block, int i, bool fourColor, uint8_t rgb[3]) {
+    int palette[4][3];
+    BC1Palette(ReadU16(block), ReadU16(block + 2), fourColor, palette);
+    uint32_t indices;
+    std::memcpy(&indices, block + 4, sizeof(indices));
+    int index = (indices >> (2 * i)) & 3;
+    for (int c = 0; c < 3; ++c)
+        rgb[c] = palette[index][c];
+}
+
+// Returns the _i_th texel's value from an 8-byte BC4 block.
+static uint8_t DecodeBC4(const uint8_t *block, int i) {
+    int palette[8];
+    BC4Palette(block[0], block[1], palette);
+    uint64_t indices = 0;
+    for (int j = 0; j < 6; ++j)
+        indices |= uint64_t(block[2 + j]) << (8 * j);
+    return palette[(indices >> (3 * i)) & 7];
+}
+
+// Returns the _i_th texel's value from a 16-byte HDR block.
+static void DecodeHDR(const uint8_t *block, int i, Float rgb[3]) {
+    Float palette[4][3];
+    HDRPalette(block, palette);
+    uint32_t indices;
+    std::memcpy(&indices, block + 12, sizeof(indices));
+    int index = (indices >> (2 * i)) & 3;
+    for (int c = 0; c < 3; ++c)
+        rgb[c] = palette[index][c];
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Block Encoding Functions
+
+// Returns the unit-length principal axis of the given colors using power
+// iteration on their covariance matrix.
+static void PrincipalAxis(const Float colors[16][3], const Float mean[3], Float axis[3]) {
+    Float cov[3][3] = {};
+    for (int i = 0; i < 16; ++i)
+        for (int a = 0; a < 3; ++a)
+            for (int b = 0; b < 3; ++b)
+                cov[a][b] += (colors[i][a] - mean[a]) * (colors[i][b] - mean[b]);
+
+    Float v[3] = {1, 1, 1};
+    for (int iter = 0; iter < 8; ++iter) {
+        Float w[3];
+        for (int a = 0; a < 3; ++a)
+            w[a] = cov[a][0] * v[0] + cov[a][1] * v[1] + cov[a][2] * v[2];
+        Float len = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+        if (len == 0)
+            break;
+        for (int a = 0; a < 3; ++a)
+            v[a] = w[a] / len;
+    }
+    Float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (int a = 0; a < 3; ++a)
+        axis[a] = v[a] / len;
+}
+
+// Finds the extremes of the given colors along their principal axis.
+static void ColorEndpoints(const Float colors[16][3], Float e0[3], Float e1[3]) {
+    Float mean[3] = {};
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c)
+            mean[c] += colors[i][c] / 16;
+    Float axis[3];
+    PrincipalAxis(colors, mean, axis);
+
+    Float tMin = Infinity, tMax = -Infinity;
+    for (int i = 0; i < 16; ++i) {
+        Float t = 0;
+        for (int c = 0; c < 3; ++c)
+            t += (colors[i][c] - mean[c]) * axis[c];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    for (int c = 0; c < 3; ++c) {
+        e0[c] = mean[c] + tMax * axis[c];
+        e1[c] = mean[c] + tMin * axis[c];
+    }
+}
+
+template <typename P>
+static int NearestPaletteEntry(const Float color[3], const P palette[][3], int n) {
+    int best = 0;
+    Float bestDist = Infinity;
+    for (int j = 0; j < n; ++j) {
+        Float dist = Sqr(color[0] - palette[j][0]) + Sqr(color[1] - palette[j][1]) +
+                     Sqr(color[2] - palette[j][2]);
+        if (dist < bestDist) {
+            best = j;
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+static uint16_t Pack565(const Float rgb[3]) {
+    auto q = [](Float v, int max) { return int(Clamp(v, 0, 255) * max / 255 + 0.5f); };
+    return (q(rgb[0], 31) << 11) | (q(rgb[1], 63) << 5) | q(rgb[2], 31);
+}
+
+// Encodes sixteen 8-bit RGB texels as an 8-byte BC1 block with the
+// four-color palette.
+static void EncodeBC1(const uint8_t texels[16][3], uint8_t *block) {
+    Float colors[16][3];
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c)
+            colors[i][c] = texels[i][c];
+    Float e0[3], e1[3];
+    ColorEndpoints(colors, e0, e1);
+    uint16_t c0 = Pack565(e0), c1 = Pack565(e1);
+    if (c0 < c1)
+        pstd::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        BC1Palette(c0, c1, true, palette);
+        for (int i = 0; i < 16; ++i)
+            indices |= uint32_t(NearestPaletteEntry(colors[i], palette, 4)) << (2 * i);
+    }
+    WriteU16(block, c0);
+    WriteU16(block + 2, c1);
+    std::memcpy(block + 4, &indices, sizeof(indices));
+}
+
+// Encodes sixteen 8-bit values as an 8-byte BC4 block with the
+// eight-value palette.
+static void EncodeBC4(const uint8_t values[16], uint8_t *block) {
+    uint8_t r0 = *std::max_element(values, values + 16);
+    uint8_t r1 = *std::min_element(values, values + 16);
+    uint64_t indices = 0;
+    if (r0 != r1) {
+        int palette[8];
+        BC4Palette(r0, r1, palette);
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            for (int j = 1; j < 8; ++j)
+                if (std::abs(values[i] - palette[j]) <
+                    std::abs(values[i] - palette[best]))
+                    best = j;
+            indices |= uint64_t(best) << (3 * i);
+        }
+    }
+    block[0] = r0;
+    block[1] = r1;
+    for (int j = 0; j < 6; ++j)
+        block[2 + j] = (indices >> (8 * j)) & 0xff;
+}
+
+// Encodes sixteen RGB texels as a 16-byte HDR block.
+static void EncodeHDR(const Float colors[16][3], uint8_t *block) {
+    Float e0[3], e1[3];
+    ColorEndpoints(colors, e0, e1);
+    for (int c = 0; c < 3; ++c) {
+        WriteU16(block + 2 * c, Half(float(e0[c])).Bits());
+        WriteU16(block + 6 + 2 * c, Half(float(e1[c])).Bits());
+    }
+    Float palette[4][3];
+    HDRPalette(block, palette);
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; ++i)
+        indices |= uint32_t(NearestPaletteEntry(colors[i], palette, 4)) << (2 * i);
+    std::memcpy(block + 12, &indices, sizeof(indices));
+}
+
+///////////////////////////////////////////////////////////////////////////
+// BlockCompressedImage Method Definitions
+
+pstd::optional<BlockFormat> BlockCompressedImage::GetBlockFormat(PixelFormat format,
+                                                                int nChannels) {
+    if (Is8Bit(format)) {
+        if (nChannels == 1)
+            return BlockFormat::BC4;
+        else if (nChannels == 3)
+            return BlockFormat::BC1;
+        else if (nChannels == 4)
+            return BlockFormat::BC3;
+    } else if (nChannels == 3)
+        return BlockFormat::HDR;
+    return {};
+}
+
+pstd::optional<BlockFormat> BlockCompressedImage::GetBlockFormat(const Image &image) {
+    pstd::optional<BlockFormat> format =
+        GetBlockFormat(image.Format(), image.NChannels());
+    if (format && *format == BlockFormat::HDR && Is32Bit(image.Format())) {
+        // Values beyond the largest half float would give infinite endpoints
+        constexpr Float MaxHalf = 65504;
+        Point2i res = image.Resolution();
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+                for (int c = 0; c < image.NChannels(); ++c)
+                    if (!(std::abs(image.GetChannel({x, y}, c)) <= MaxHalf))
+                        return {};
+    }
+    return format;
+}
+
+BlockCompressedImage::BlockCompressedImage(const Image &image, Allocator alloc)
+    : pixelFormat(image.Format()),
+      resolution(image.Resolution()),
+      nChannels(image.NChannels()),
+      nBlocksX((resolution.x + 3) / 4),
+      channelNames(image.ChannelNames()),
+      encoding(image.Encoding()),
+      blocks(alloc) {
+    pstd::optional<BlockFormat> bf = GetBlockFormat(image);
+    CHECK(bf.has_value());
+    format = *bf;
+    int nBlocksY = (resolution.y + 3) / 4;
+    int blockBytes = BlockBytes(format);
+    blocks.resize(size_t(nBlocksX) * nBlocksY * blockBytes);
+
+    // Compress rows of blocks in parallel
+    ParallelFor(0, nBlocksY, [&](int64_t by) {
+        for (int bx = 0; bx < nBlocksX; ++bx) {
+            uint8_t *block = &blocks[(by * nBlocksX + bx) * blockBytes];
+            // Gather the block's texels, replicating edge texels for blocks
+            // that extend past the image
+            uint8_t texels8[16][4];
+            Float texels[16][3];
+            for (int i = 0; i < 16; ++i) {
+                Point2i p(std::min(4 * bx + i % 4, resolution.x - 1),
+                          std::min(4 * int(by) + i / 4, resolution.y - 1));
+                if (Is8Bit(pixelFormat))
+                    std::memcpy(texels8[i], image.RawPointer(p), nChannels);
+                else
+                    for (int c = 0; c < 3; ++c)
+                        texels[i][c] = image.GetChannel(p, c);
+            }
+
+            switch (format) {
+            case BlockFormat::BC1: {
+                uint8_t rgb[16][3];
+                for (int i = 0; i < 16; ++i)
+                    std::memcpy(rgb[i], texels8[i], 3);
+                EncodeBC1(rgb, block);
+                break;
+            }
+            case BlockFormat::BC3: {
+                uint8_t alpha[16], rgb[16][3];
+                for (int i = 0; i < 16; ++i) {
+                    alpha[i] = texels8[i][3];
+                    std::memcpy(rgb[i], texels8[i], 3);
+                }
+                EncodeBC4(alpha, block);
+                EncodeBC1(rgb, block + 8);
+                break;
+            }
+            case BlockFormat::BC4: {
+                uint8_t values[16];
+                for (int i = 0; i < 16; ++i)
+                    values[i] = texels8[i][0];
+                EncodeBC4(values, block);
+                break;
+            }
+            case BlockFormat::HDR:
+                EncodeHDR(texels, block);
+                break;
+            }
+        }
+    });
+}
+
+void BlockCompressedImage::DecodeTexel(Point2i p, Float *values) const {
+    const uint8_t *block =
+        &blocks[((p.y / 4) * nBlocksX + p.x / 4) * BlockBytes(format)];
+    int i = 4 * (p.y % 4) + p.x % 4;
+    uint8_t texel[4];
+    switch (format) {
+    case BlockFormat::BC1:
+        DecodeBC1(block, i, false, texel);
+        encoding.ToLinear({texel, 3}, {values, 3});
+        break;
+    case BlockFormat::BC3:
+        texel[3] = DecodeBC4(block, i);
+        DecodeBC1(block + 8, i, true, texel);
+        encoding.ToLinear({texel, 4}, {values, 4});
+        break;
+    case BlockFormat::BC4:
+        texel[0] = DecodeBC4(block, i);
+        encoding.ToLinear({texel, 1}, {values, 1});
+        break;
+    case BlockFormat::HDR:
+        DecodeHDR(block, i, values);
+        break;
+    }
+}
+
+void BlockCompressedImage::GetTexel(Point2i p, WrapMode2D wrapMode, Float *values) const {
+    if (!RemapPixelCoords(&p, resolution, wrapMode)) {
+        std::fill(values, values + nChannels, Float(0));
+        return;
+    }
+    DecodeTexel(p, values);
+}
+
+void BlockCompressedImage::Bilerp(Point2f st, WrapMode2D wrapMode, Float *values) const {
+    // Compute discrete texel coordinates and offsets for _st_
+    Float x = st[0] * resolution.x - 0.5f, y = st[1] * resolution.y - 0.5f;
+    int xi = std::floor(x), yi = std::floor(y);
+    Float dx = x - xi, dy = y - yi;
+
+    // Decode texels and return bilinearly interpolated channel values
+    Float v[4][4];
+    GetTexel({xi, yi}, wrapMode, v[0]);
+    GetTexel({xi + 1, yi}, wrapMode, v[1]);
+    GetTexel({xi, yi + 1}, wrapMode, v[2]);
+    GetTexel({xi + 1, yi + 1}, wrapMode, v[3]);
+    for (int c = 0; c < nChannels; ++c)
+        values[c] = ((1 - dx) * (1 - dy) * v[0][c] + dx * (1 - dy) * v[1][c] +
+                     (1 - dx) * dy * v[2][c] + dx * dy * v[3][c]);
+}
+
+Image BlockCompressedImage::Decompress(Allocator alloc) const {
+    Image image(pixelFormat, resolution, channelNames, encoding, alloc);
+    for (int y = 0; y < resolution.y; ++y)
+        for (int x = 0; x < resolution.x; ++x) {
+            const uint8_t *block =
+                &blocks[((y / 4) * nBlocksX + x / 4) * BlockBytes(format)];
+            int i = 4 * (y % 4) + x % 4;
+            uint8_t *texel = (uint8_t *)image.RawPointer({x, y});
+            switch (format) {
+            case BlockFormat::BC1:
+                DecodeBC1(block, i, false, texel);
+                break;
+            case BlockFormat::BC3:
+                texel[3] = DecodeBC4(block, i);
+                DecodeBC1(block + 8, i, true, texel);
+                break;
+            case BlockFormat::BC4:
+                texel[0] = DecodeBC4(block, i);
+                break;
+            case BlockFormat::HDR: {
+                Float rgb[3];
+                DecodeHDR(block, i, rgb);
+                for (int c = 0; c < 3; ++c)
+                    image.SetChannel({x, y}, c, rgb[c]);
+                break;
+            }
+            }
+        }
+    return image;
+}
+
+std::string BlockCompressedImage::ToString() const {
+    return StringPrintf("[ BlockCompressedImage format: %s pixelFormat: %s "
+                        "resolution: %s nChannels: %d encoding: %s bytes: %d ]",
+                        format, pixelFormat, resolution, nChannels, encoding,
+                        blocks.size());
+}
+
+}  // namespace pbrt
@@ -0,0 +1,74 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#ifndef PBRT_UTIL_BLOCKCOMPRESS_H
+#define PBRT_UTIL_BLOCKCOMPRESS_H
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/color.h>
+#include <pbrt/util/image.h>
+#include <pbrt/util/pstd.h>
+#include <pbrt/util/vecmath.h>
+
+#include <string>
+#include <vector>
+
+namespace pbrt {
+
+// BlockFormat Definition
+// Formats for images stored as 4x4 texel blocks. BC1, BC3, and BC4 follow
+// the layouts of the corresponding GPU formats and store 8-bit texels;
+// HDR is a simplified variant of BC6H for 16- and 32-bit RGB texels that
+// stores a pair of half-precision endpoints and a 2-bit index per texel.
+enum class BlockFormat { BC1, BC3, BC4, HDR };
+
+std::string ToString(BlockFormat format);
+
+// BlockCompressedImage Definition
+class BlockCompressedImage {
+  public:
+    // BlockCompressedImage Public Methods
+    static pstd::optional<BlockFormat> GetBlockFormat(PixelFormat format, int nChannels);
+    // Also checks the image's values: 32-bit images with values that half
+    // floats can't represent have no block format.
+    static pstd::optional<BlockFormat> GetBlockFormat(const Image &image);
+
+    BlockCompressedImage(const Image &image, Allocator alloc = {});
+
+    Point2i Resolution() const { return resolution; }
+    int NChannels() const { return nChannels; }
+    BlockFormat Format() const { return format; }
+
+    // Returns the texel's channel values in _values_, which must have
+    // room for _NChannels()_ values.
+    void GetTexel(Point2i p, WrapMode2D wrapMode, Float *values) const;
+    void Bilerp(Point2f p, WrapMode2D wrapMode, Float *values) const;
+
+    Image Decompress(Allocator alloc = {}) const;
+
+    size_t BytesUsed() const { return blocks.size(); }
+    std::string ToString() const;
+
+    static int BlockBytes(BlockFormat format) {
+        return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+    }
+
+  private:
+    // BlockCompressedImage Private Methods
+    void DecodeTexel(Point2i p, Float *values) const;
+
+    // BlockCompressedImage Private Members
+    BlockFormat format;
+    PixelFormat pixelFormat;
+    Point2i resolution;
+    int nChannels, nBlocksX;
+    std::vector<std::string> channelNames;
+    ColorEncodingHandle encoding;
+    pstd::vector<uint8_t> blocks;
+};
+
+}  // namespace pbrt
+
+#endif  // PBRT_UTIL_BLOCKCOMPRESS_H
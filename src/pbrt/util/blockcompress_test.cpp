@@ -0,0 +1,126 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/blockcompress.h>
+#include <pbrt/util/color.h>
+#include <pbrt/util/image.h>
+#include <pbrt/util/rng.h>
+#include <pbrt/util/testimages.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace pbrt;
+
+TEST(BlockCompressedImage, Formats) {
+    auto format = [](PixelFormat pf, int nc) {
+        return BlockCompressedImage::GetBlockFormat(pf, nc);
+    };
+    EXPECT_EQ(BlockFormat::BC4, *format(PixelFormat::U256, 1));
+    EXPECT_EQ(BlockFormat::BC1, *format(PixelFormat::U256, 3));
+    EXPECT_EQ(BlockFormat::BC3, *format(PixelFormat::U256, 4));
+    EXPECT_EQ(BlockFormat::HDR, *format(PixelFormat::Half, 3));
+    EXPECT_EQ(BlockFormat::HDR, *format(PixelFormat::Float, 3));
+    EXPECT_FALSE(format(PixelFormat::Half, 1).has_value());
+    EXPECT_FALSE(format(PixelFormat::U256, 2).has_value());
+
+    // Float images with values outside the half float range aren't compressed
+    Image image(PixelFormat::Float, {5, 5}, RGBAChannelNames(3));
+    image.SetChannel({4, 4}, 1, 65504.f);
+    EXPECT_EQ(BlockFormat::HDR, *BlockCompressedImage::GetBlockFormat(image));
+    image.SetChannel({4, 4}, 1, 1e5f);
+    EXPECT_FALSE(BlockCompressedImage::GetBlockFormat(image).has_value());
+}
+
+TEST(BlockCompressedImage, Constant) {
+    // Colors that are exactly representable with 565 endpoints and half
+    // floats should be reproduced exactly.
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half})
+        for (int nc : {1, 3, 4}) {
+            if (!BlockCompressedImage::GetBlockFormat(format, nc))
+                continue;
+            Image image(format, {13, 6}, RGBAChannelNames(nc), ColorEncodingHandle::Linear);
+            Float values[4] = {8.f / 255.f, 1.f, 132.f / 255.f, 0.5f};
+            for (int y = 0; y < 6; ++y)
+                for (int x = 0; x < 13; ++x)
+                    for (int c = 0; c < nc; ++c)
+                        image.SetChannel({x, y}, c, values[c]);
+
+            BlockCompressedImage bc(image);
+            EXPECT_EQ(4 * 2 * BlockCompressedImage::BlockBytes(bc.Format()),
+                      bc.BytesUsed());
+            for (int y = 0; y < 6; ++y)
+                for (int x = 0; x < 13; ++x) {
+                    Float v[4];
+                    bc.GetTexel({x, y}, WrapMode::Clamp, v);
+                    for (int c = 0; c < nc; ++c)
+                        EXPECT_EQ(image.GetChannel({x, y}, c), v[c]);
+                }
+        }
+}
+
+TEST(BlockCompressedImage, Gradient) {
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float})
+        for (int nc : {1, 3, 4}) {
+            if (!BlockCompressedImage::GetBlockFormat(format, nc))
+                continue;
+            // Smooth gradients should be closely approximated
+            Point2i res(64, 37);
+            Image image(format, res, RGBAChannelNames(nc), ColorEncodingHandle::Linear);
+            Float scale = Is8Bit(format) ? 1 : 10;
+            for (int y = 0; y < res.y; ++y)
+                for (int x = 0; x < res.x; ++x)
+                    for (int c = 0; c < nc; ++c) {
+                        Float v = Float(c + 1) * (x + y) / (4 * (res.x + res.y));
+                        image.SetChannel({x, y}, c, scale * v);
+                    }
+
+            BlockCompressedImage bc(image);
+            Float maxError = 0;
+            for (int y = 0; y < res.y; ++y)
+                for (int x = 0; x < res.x; ++x) {
+                    Float v[4];
+                    bc.GetTexel({x, y}, WrapMode::Clamp, v);
+                    for (int c = 0; c < nc; ++c) {
+                        Float error = std::abs(v[c] - image.GetChannel({x, y}, c));
+                        maxError = std::max(maxError, error / scale);
+                    }
+                }
+            EXPECT_LT(maxError, 0.02f) << ToString(bc.Format());
+        }
+}
+
+TEST(BlockCompressedImage, Decompress) {
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half})
+        for (int nc : {1, 3, 4}) {
+            if (!BlockCompressedImage::GetBlockFormat(format, nc))
+                continue;
+            Point2i res(31, 18);
+            Image image = RandomImage(format, res, nc);
+
+            BlockCompressedImage bc(image);
+            Image decompressed = bc.Decompress();
+            ASSERT_EQ(res, decompressed.Resolution());
+            WrapMode2D wrapMode(WrapMode::Repeat);
+            for (int y = -res.y; y < 2 * res.y; ++y)
+                for (int x = -res.x; x < 2 * res.x; ++x) {
+                    Float v[4];
+                    bc.GetTexel({x, y}, wrapMode, v);
+                    for (int c = 0; c < nc; ++c)
+                        EXPECT_EQ(decompressed.GetChannel({x, y}, c, wrapMode), v[c]);
+                }
+
+            RNG rng;
+            Point2f st(rng.Uniform<Float>(), rng.Uniform<Float>());
+            Float v[4];
+            bc.Bilerp(st, wrapMode, v);
+            for (int c = 0; c < nc; ++c)
+                EXPECT_FLOAT_EQ(decompressed.BilerpChannel(st, c, wrapMode), v[c]);
+        }
+}
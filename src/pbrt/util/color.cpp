@@ -18,6 +18,8 @@
 #include <algorithm>
 #include <cstdlib>
 #include <iterator>
+#include <map>
+#include <mutex>
 #include <vector>
 
 namespace pbrt {
@@ -239,6 +241,7 @@ const ColorEncodingHandle ColorEncodingHandle::Get(const std::string &name) {
     else if (name == "sRGB")
         return sRGB;
     else {
+        static std::mutex mutex;
         static std::map<float, ColorEncodingHandle> cache;
 
         std::vector<std::string> params = SplitStringsFromWhitespace(name);
@@ -248,6 +251,7 @@ const ColorEncodingHandle ColorEncodingHandle::Get(const std::string &name) {
         if (gamma == 0)
             ErrorExit("%s: unable to parse gamma value", params[1]);
 
+        std::lock_guard<std::mutex> lock(mutex);
         auto iter = cache.find(gamma);
         if (iter != cache.end())
             return iter->second;
@@ -12,6 +12,8 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -28,9 +30,12 @@ using socket_t = int;
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netdb.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <signal.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #define SOCKET_ERROR (-1)
 #define INVALID_SOCKET (-1)
@@ -71,6 +76,7 @@ class IPCChannel {
     bool Send(pstd::span<const uint8_t> message);
 
     bool Connected() const { return socketFd != INVALID_SOCKET; }
+    bool ServerIsLocal() const;
 
   private:
     void Connect();
@@ -167,6 +173,27 @@ void IPCChannel::Disconnect() {
     socketFd = INVALID_SOCKET;
 }
 
+bool IPCChannel::ServerIsLocal() const {
+    if (!Connected())
+        return false;
+    // The display server is on this host if both ends of the connection
+    // have the same address; this covers loopback connections as well.
+    sockaddr_storage local, peer;
+    socklen_t localLength = sizeof(local), peerLength = sizeof(peer);
+    if (getsockname(socketFd, (sockaddr *)&local, &localLength) == SOCKET_ERROR ||
+        getpeername(socketFd, (sockaddr *)&peer, &peerLength) == SOCKET_ERROR ||
+        local.ss_family != peer.ss_family)
+        return false;
+
+    if (local.ss_family == AF_INET)
+        return memcmp(&((sockaddr_in *)&local)->sin_addr,
+                      &((sockaddr_in *)&peer)->sin_addr, sizeof(in_addr)) == 0;
+    if (local.ss_family == AF_INET6)
+        return memcmp(&((sockaddr_in6 *)&local)->sin6_addr,
+                      &((sockaddr_in6 *)&peer)->sin6_addr, sizeof(in6_addr)) == 0;
+    return false;
+}
+
 bool IPCChannel::Send(pstd::span<const uint8_t> message) {
     if (!Connected()) {
         Connect();
@@ -196,6 +223,11 @@ enum DisplayDirective : uint8_t {
     CloseImage = 2,
     UpdateImage = 3,
     CreateImage = 4,
+    // Used with display servers on the same host: the image's pixels are
+    // stored in a shared framebuffer file and only the regions that have
+    // changed are sent over the socket.
+    CreateSharedImage = 32,
+    UpdateSharedImage = 33,
 };
 
 void Serialize(uint8_t **ptr, const std::string &s) {
@@ -213,21 +245,102 @@ void Serialize(uint8_t **ptr, T value) {
 
 constexpr int tileSize = 128;
 
+// Set if shared framebuffers were requested when connecting to the
+// display server.
+bool sharedFramebuffersEnabled = false;
+
+// Set if a display server dropped the connection after being sent a
+// shared framebuffer, in which case it presumably doesn't support them.
+std::atomic<bool> sharedFramebuffersUnsupported{false};
+
 }  // namespace
 
+// SharedFramebuffer Definition
+// A memory-mapped file, preferably in /dev/shm, holding an image's channel
+// values as one row-major plane of floats per channel. The display server
+// maps the file using the name given in the CreateSharedImage message.
+class SharedFramebuffer {
+  public:
+    static std::unique_ptr<SharedFramebuffer> Create(Point2i resolution, int nChannels);
+    ~SharedFramebuffer();
+
+    SharedFramebuffer(const SharedFramebuffer &) = delete;
+    SharedFramebuffer &operator=(const SharedFramebuffer &) = delete;
+
+    const std::string &Filename() const { return filename; }
+    float *Plane(int c) { return data + size_t(c) * resolution.x * resolution.y; }
+
+  private:
+    SharedFramebuffer(std::string filename, float *data, size_t size, Point2i resolution)
+        : filename(std::move(filename)), data(data), size(size), resolution(resolution) {}
+
+    std::string filename;
+    float *data;
+    size_t size;
+    Point2i resolution;
+};
+
+std::unique_ptr<SharedFramebuffer> SharedFramebuffer::Create(Point2i resolution,
+                                                             int nChannels) {
+#ifdef PBRT_IS_WINDOWS
+    return {};
+#else
+    struct stat st;
+    std::string dir = (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode)) ? "/dev/shm"
+                                                                           : "/tmp";
+    static std::atomic<int> counter{0};
+    std::string filename =
+        StringPrintf("%s/pbrt-display-%d-%d", dir, getpid(), counter++);
+
+    size_t size = size_t(nChannels) * resolution.x * resolution.y * sizeof(float);
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        LOG_VERBOSE("%s: open: %s", filename, ErrorString());
+        return {};
+    }
+    // The file is zero-filled, which matches the server's initial image.
+    void *data = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        LOG_VERBOSE("%s: unable to map shared framebuffer: %s", filename,
+                    ErrorString());
+        close(fd);
+        unlink(filename.c_str());
+        return {};
+    }
+    close(fd);
+
+    return std::unique_ptr<SharedFramebuffer>(
+        new SharedFramebuffer(filename, (float *)data, size, resolution));
+#endif
+}
+
+SharedFramebuffer::~SharedFramebuffer() {
+#ifndef PBRT_IS_WINDOWS
+    munmap(data, size);
+    unlink(filename.c_str());
+#endif
+}
+
 class DisplayItem {
   public:
     DisplayItem(
         const std::string &title, Point2i resolution,
         std::vector<std::string> channelNames,
-        std::function<void(Bounds2i b, pstd::span<pstd::span<Float>>)> getTileValues);
+        std::function<void(Bounds2i b, pstd::span<pstd::span<Float>>)> getTileValues,
+        bool allowSharedFramebuffer = false);
 
     bool Display(IPCChannel &channel);
 
   private:
     bool SendOpenImage(IPCChannel &channel);
+    bool SendCreateSharedImage(IPCChannel &channel);
+    bool SendUpdateSharedImage(IPCChannel &channel, pstd::span<const Bounds2i> regions);
 
     bool openedImage = false;
+    bool allowSharedFramebuffer;
+    std::unique_ptr<SharedFramebuffer> sharedFramebuffer;
     std::string title;
     Point2i resolution;
     std::function<void(Bounds2i b, pstd::span<pstd::span<Float>>)> getTileValues;
@@ -239,10 +352,14 @@ class DisplayItem {
 
         void SetTileBounds(int x, int y, int width, int height);
         bool SendIfChanged(IPCChannel &channel, int tileIndex);
+        bool CopyIfChanged(float *plane, int xResolution, int tileIndex);
+        void ResetTileHashes() { tileHashes.assign(tileHashes.size(), zeroHash); }
 
         std::vector<uint8_t> buffer;
         int tileBoundsOffset = 0, channelValuesOffset = 0;
         std::vector<uint64_t> tileHashes;
+        uint64_t zeroHash;
+        Bounds2i tileBounds;
 
         int setCount, tileIndex;
     };
@@ -252,8 +369,12 @@ class DisplayItem {
 DisplayItem::DisplayItem(
     const std::string &baseTitle, Point2i resolution,
     std::vector<std::string> channelNames,
-    std::function<void(Bounds2i b, pstd::span<pstd::span<Float>>)> getTileValues)
-    : resolution(resolution), getTileValues(getTileValues), channelNames(channelNames) {
+    std::function<void(Bounds2i b, pstd::span<pstd::span<Float>>)> getTileValues,
+    bool allowSharedFramebuffer)
+    : allowSharedFramebuffer(allowSharedFramebuffer),
+      resolution(resolution),
+      getTileValues(getTileValues),
+      channelNames(channelNames) {
 #ifdef PBRT_IS_WINDOWS
     title = StringPrintf("%s (%d)", baseTitle, GetCurrentThreadId());
 #else
@@ -292,7 +413,7 @@ DisplayItem::ImageChannelBuffer::ImageChannelBuffer(const std::string &channelNa
     // for a fully-zero tile (which corresponds to the initial state on the
     // viewer side.)
     memset(buffer.data() + channelValuesOffset, 0, tileSize * tileSize * sizeof(float));
-    uint64_t zeroHash = HashBuffer(buffer.data() + channelValuesOffset,
+    zeroHash = HashBuffer(buffer.data() + channelValuesOffset,
                                    tileSize * tileSize * sizeof(float));
     tileHashes.assign(nTiles, zeroHash);
 }
@@ -306,6 +427,7 @@ void DisplayItem::ImageChannelBuffer::SetTileBounds(int x, int y, int width, int
     Serialize(&ptr, height);
 
     setCount = width * height;
+    tileBounds = Bounds2i(Point2i(x, y), Point2i(x + width, y + height));
 }
 
 bool DisplayItem::ImageChannelBuffer::SendIfChanged(IPCChannel &ipcChannel,
@@ -328,9 +450,37 @@ bool DisplayItem::ImageChannelBuffer::SendIfChanged(IPCChannel &ipcChannel,
     return true;
 }
 
+bool DisplayItem::ImageChannelBuffer::CopyIfChanged(float *plane, int xResolution,
+                                                    int tileIndex) {
+    uint64_t hash = HashBuffer(buffer.data() + channelValuesOffset,
+                               tileSize * tileSize * sizeof(float));
+    if (hash == tileHashes[tileIndex])
+        return false;
+
+    const Float *values = (const Float *)(buffer.data() + channelValuesOffset);
+    int width = tileBounds.pMax.x - tileBounds.pMin.x;
+    for (int y = tileBounds.pMin.y; y < tileBounds.pMax.y; ++y) {
+        float *row = plane + size_t(y) * xResolution + tileBounds.pMin.x;
+        for (int x = 0; x < width; ++x)
+            row[x] = *values++;
+    }
+
+    tileHashes[tileIndex] = hash;
+    return true;
+}
+
 bool DisplayItem::Display(IPCChannel &ipcChannel) {
     if (!openedImage) {
-        if (!SendOpenImage(ipcChannel))
+        // Use a shared framebuffer rather than sending the pixel values
+        // over the socket if they were requested and the display server is
+        // on this host.
+        if (sharedFramebuffersEnabled && allowSharedFramebuffer && !sharedFramebuffer &&
+            !sharedFramebuffersUnsupported && ipcChannel.ServerIsLocal())
+            sharedFramebuffer =
+                SharedFramebuffer::Create(resolution, channelNames.size());
+
+        if (!(sharedFramebuffer ? SendCreateSharedImage(ipcChannel)
+                                : SendOpenImage(ipcChannel)))
             // maybe next time
             return false;
         openedImage = true;
@@ -343,6 +493,7 @@ bool DisplayItem::Display(IPCChannel &ipcChannel) {
         displayValues[c] = pstd::MakeSpan(ptr, tileSize * tileSize);
     }
 
+    std::vector<Bounds2i> dirtyRegions;
     int tileIndex = 0;
     for (int y = 0; y < resolution.y; y += tileSize)
         for (int x = 0; x < resolution.x; x += tileSize, ++tileIndex) {
@@ -355,6 +506,18 @@ bool DisplayItem::Display(IPCChannel &ipcChannel) {
             Bounds2i b(Point2i(x, y), Point2i(x + width, y + height));
             getTileValues(b, pstd::MakeSpan(displayValues));
 
+            if (sharedFramebuffer) {
+                // Copy changed tiles to the framebuffer; the server is
+                // told about them all at once below.
+                bool changed = false;
+                for (int c = 0; c < channelBuffers.size(); ++c)
+                    changed |= channelBuffers[c].CopyIfChanged(
+                        sharedFramebuffer->Plane(c), resolution.x, tileIndex);
+                if (changed)
+                    dirtyRegions.push_back(b);
+                continue;
+            }
+
             // Send the RGB buffers only if they're different than
             // the last version sent.
             for (int c = 0; c < channelBuffers.size(); ++c)
@@ -365,6 +528,19 @@ bool DisplayItem::Display(IPCChannel &ipcChannel) {
                 }
         }
 
+    if (sharedFramebuffer && !dirtyRegions.empty() &&
+        !SendUpdateSharedImage(ipcChannel, dirtyRegions)) {
+        // Assume that the server closed the connection because it doesn't
+        // handle shared framebuffers and go back to sending pixel values.
+        LOG_VERBOSE("Display server doesn't accept shared framebuffers");
+        sharedFramebuffersUnsupported = true;
+        sharedFramebuffer.reset();
+        for (ImageChannelBuffer &channelBuffer : channelBuffers)
+            channelBuffer.ResetTileHashes();
+        openedImage = false;
+        return false;
+    }
+
     return true;
 }
 
@@ -389,6 +565,46 @@ bool DisplayItem::SendOpenImage(IPCChannel &ipcChannel) {
     return ipcChannel.Send(pstd::MakeSpan(buffer, ptr - buffer));
 }
 
+bool DisplayItem::SendCreateSharedImage(IPCChannel &ipcChannel) {
+    uint8_t buffer[1024];
+    uint8_t *ptr = buffer;
+
+    Serialize(&ptr, int(0));  // reserve space for message length
+    Serialize(&ptr, DisplayDirective::CreateSharedImage);
+    uint8_t grabFocus = 1;
+    Serialize(&ptr, grabFocus);
+    Serialize(&ptr, title);
+    Serialize(&ptr, sharedFramebuffer->Filename());
+
+    int nChannels = channelNames.size();
+    Serialize(&ptr, resolution.x);
+    Serialize(&ptr, resolution.y);
+    Serialize(&ptr, nChannels);
+    for (int c = 0; c < nChannels; ++c)
+        Serialize(&ptr, channelNames[c]);
+
+    return ipcChannel.Send(pstd::MakeSpan(buffer, ptr - buffer));
+}
+
+bool DisplayItem::SendUpdateSharedImage(IPCChannel &ipcChannel,
+                                        pstd::span<const Bounds2i> regions) {
+    std::vector<uint8_t> buffer(title.size() + 16 + regions.size() * 4 * sizeof(int));
+    uint8_t *ptr = buffer.data();
+
+    Serialize(&ptr, int(0));  // reserve space for message length
+    Serialize(&ptr, DisplayDirective::UpdateSharedImage);
+    Serialize(&ptr, title);
+    Serialize(&ptr, int(regions.size()));
+    for (const Bounds2i &b : regions) {
+        Serialize(&ptr, b.pMin.x);
+        Serialize(&ptr, b.pMin.y);
+        Serialize(&ptr, b.pMax.x - b.pMin.x);
+        Serialize(&ptr, b.pMax.y - b.pMin.y);
+    }
+
+    return ipcChannel.Send(pstd::MakeSpan(buffer.data(), ptr - buffer.data()));
+}
+
 static std::atomic<bool> exitThread{false};
 static std::mutex mutex;
 static std::thread updateThread;
@@ -415,9 +631,10 @@ static void updateDynamicItems() {
     channel = nullptr;
 }
 
-void ConnectToDisplayServer(const std::string &host) {
+void ConnectToDisplayServer(const std::string &host, bool sharedFramebuffers) {
     CHECK(channel == nullptr);
     channel = new IPCChannel(host);
+    sharedFramebuffersEnabled = sharedFramebuffers;
 
     updateThread = std::thread(updateDynamicItems);
 }
@@ -432,7 +649,8 @@ void DisconnectFromDisplayServer() {
 }
 
 static DisplayItem GetImageDisplayItem(const std::string &title, const Image &image,
-                                       pstd::optional<ImageChannelDesc> channelDesc) {
+                                       pstd::optional<ImageChannelDesc> channelDesc,
+                                       bool allowSharedFramebuffer) {
     auto getValues = [=](Bounds2i b, pstd::span<pstd::span<Float>> displayValues) {
         int offset = 0;
         for (Point2i p : b) {
@@ -455,12 +673,13 @@ static DisplayItem GetImageDisplayItem(const std::string &title, const Image &im
                 channelNames.push_back(StringPrintf("channel %d", i));
     }
 
-    return DisplayItem(title, image.Resolution(), channelNames, getValues);
+    return DisplayItem(title, image.Resolution(), channelNames, getValues,
+                       allowSharedFramebuffer);
 }
 
 void DisplayStatic(const std::string &title, const Image &image,
                    pstd::optional<ImageChannelDesc> channelDesc) {
-    DisplayItem item = GetImageDisplayItem(title, image, channelDesc);
+    DisplayItem item = GetImageDisplayItem(title, image, channelDesc, false);
 
     std::lock_guard<std::mutex> lock(mutex);
     if (!item.Display(*channel))
@@ -470,7 +689,7 @@ void DisplayStatic(const std::string &title, const Image &image,
 void DisplayDynamic(const std::string &title, const Image &image,
                     pstd::optional<ImageChannelDesc> channelDesc) {
     std::lock_guard<std::mutex> lock(mutex);
-    dynamicItems.push_back(GetImageDisplayItem(title, image, channelDesc));
+    dynamicItems.push_back(GetImageDisplayItem(title, image, channelDesc, true));
 }
 
 void DisplayStatic(
@@ -489,7 +708,8 @@ void DisplayDynamic(
     std::vector<std::string> channelNames,
     std::function<void(Bounds2i b, pstd::span<pstd::span<Float>>)> getTileValues) {
     std::lock_guard<std::mutex> lock(mutex);
-    dynamicItems.push_back(DisplayItem(title, resolution, channelNames, getTileValues));
+    dynamicItems.push_back(
+        DisplayItem(title, resolution, channelNames, getTileValues, true));
 }
 
 }  // namespace pbrt
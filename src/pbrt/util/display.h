@@ -20,7 +20,10 @@
 namespace pbrt {
 
 // DisplayServer Function Declarations
-void ConnectToDisplayServer(const std::string &host);
+// Shared framebuffers are only used with display servers on the same host
+// if _sharedFramebuffers_ is true, since they require a server that
+// understands pbrt's messages for them.
+void ConnectToDisplayServer(const std::string &host, bool sharedFramebuffers = false);
 void DisconnectFromDisplayServer();
 
 void DisplayStatic(
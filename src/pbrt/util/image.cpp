@@ -27,8 +27,11 @@
 #include <ImfMatrixAttribute.h>
 #include <ImfOutputFile.h>
 #include <ImfStringVectorAttribute.h>
+#include <ImfTileDescription.h>
+#include <ImfTiledOutputFile.h>
 #endif
 
+#include <algorithm>
 #include <cmath>
 #include <numeric>
 
@@ -120,6 +123,74 @@ void ForExtent(const Bounds2i &extent, WrapMode2D wrapMode, const Image &image,
     }
 }
 
+// Image Kernel Definitions
+// These are specialized for common channel counts so that the compiler can
+// unroll the loops over channels and vectorize across pixels.
+template <int NC>
+static void DownsampleScanline(const float *r0, const float *r1, float *out, int nOut,
+                               int nc) {
+    // Box filter $2 \times 2$ pixel blocks from scanlines _r0_ and _r1_
+    if (NC > 0)
+        nc = NC;
+    for (int x = 0; x < nOut; ++x)
+        for (int c = 0; c < nc; ++c)
+            out[x * nc + c] = (r0[2 * x * nc + c] + r0[(2 * x + 1) * nc + c] +
+                               r1[2 * x * nc + c] + r1[(2 * x + 1) * nc + c]) /
+                              4;
+}
+
+static void DownsampleScanline(const float *r0, const float *r1, float *out, int nOut,
+                               int nc) {
+    switch (nc) {
+    case 1:
+        DownsampleScanline<1>(r0, r1, out, nOut, nc);
+        break;
+    case 3:
+        DownsampleScanline<3>(r0, r1, out, nOut, nc);
+        break;
+    case 4:
+        DownsampleScanline<4>(r0, r1, out, nOut, nc);
+        break;
+    default:
+        DownsampleScanline<0>(r0, r1, out, nOut, nc);
+    }
+}
+
+template <int NC>
+static void ResampleScanlineX(const float *in, float *out,
+                              const ResampleWeight *weights, int firstPixel, int nOut,
+                              int nc) {
+    // Apply the four-tap resampling filter for each output pixel
+    if (NC > 0)
+        nc = NC;
+    for (int x = 0; x < nOut; ++x) {
+        const ResampleWeight &rsw = weights[x];
+        const float *p = in + nc * (rsw.firstPixel - firstPixel);
+        for (int c = 0; c < nc; ++c)
+            out[x * nc + c] = rsw.weight[0] * p[c] + rsw.weight[1] * p[c + nc] +
+                              rsw.weight[2] * p[c + 2 * nc] +
+                              rsw.weight[3] * p[c + 3 * nc];
+    }
+}
+
+static void ResampleScanlineX(const float *in, float *out,
+                              const ResampleWeight *weights, int firstPixel, int nOut,
+                              int nc) {
+    switch (nc) {
+    case 1:
+        ResampleScanlineX<1>(in, out, weights, firstPixel, nOut, nc);
+        break;
+    case 3:
+        ResampleScanlineX<3>(in, out, weights, firstPixel, nOut, nc);
+        break;
+    case 4:
+        ResampleScanlineX<4>(in, out, weights, firstPixel, nOut, nc);
+        break;
+    default:
+        ResampleScanlineX<0>(in, out, weights, firstPixel, nOut, nc);
+    }
+}
+
 // Image Method Definitions
 pstd::vector<Image> Image::GeneratePyramid(Image image, WrapMode2D wrapMode,
                                            Allocator alloc) {
@@ -148,30 +219,19 @@ pstd::vector<Image> Image::GeneratePyramid(Image image, WrapMode2D wrapMode,
                                std::max(1, image.resolution[1] / 2));
         Image nextImage(image.format, nextResolution, image.channelNames, origEncoding);
 
-        // Compute offsets from pixel to the 4 neighbors used for down filtering
-        int srcDeltas[4] = {0, nChannels, nChannels * image.resolution[0],
-                            nChannels * (image.resolution[0] + 1)};
-        if (image.resolution[0] == 1) {
-            srcDeltas[1] = 0;
-            srcDeltas[3] -= nChannels;
-        }
-        if (image.resolution[1] == 1) {
-            srcDeltas[2] = 0;
-            srcDeltas[3] -= nChannels * image.resolution[0];
-        }
-
         // Downsample _image_ to create next level and update _pyramid_
         ParallelFor(0, nextResolution[1], [&](int64_t y) {
-            // Loop over pixels in scanline $y$ and downfilter for the next pyramid level
-            int srcOffset = image.PixelOffset({0, 2 * int(y)});
-            int nextOffset = nextImage.PixelOffset({0, int(y)});
-            for (int x = 0; x < nextResolution[0]; ++x, srcOffset += nChannels)
-                for (int c = 0; c < nChannels; ++c, ++srcOffset, ++nextOffset)
-                    nextImage.p32[nextOffset] =
-                        (image.p32[srcOffset] + image.p32[srcOffset + srcDeltas[1]] +
-                         image.p32[srcOffset + srcDeltas[2]] +
-                         image.p32[srcOffset + srcDeltas[3]]) /
-                        4;
+            // Downfilter scanlines $2y$ and $2y+1$ for the next pyramid level
+            const float *r0 = &image.p32[image.PixelOffset({0, 2 * int(y)})];
+            const float *r1 =
+                image.resolution[1] == 1 ? r0 : r0 + nChannels * image.resolution[0];
+            float *next = &nextImage.p32[nextImage.PixelOffset({0, int(y)})];
+            if (image.resolution[0] == 1) {
+                // Handle single-pixel-wide level
+                for (int c = 0; c < nChannels; ++c)
+                    next[c] = (r0[c] + r0[c] + r1[c] + r1[c]) / 4;
+            } else
+                DownsampleScanline(r0, r1, next, nextResolution[0], nChannels);
 
             // Copy 2 scalines from _image_ out to its pyramid level
             int yStart = 2 * y;
@@ -288,55 +348,35 @@ Image Image::FloatResizeUp(Point2i newRes, WrapMode2D wrapMode) const {
         int nyOut = outExtent.pMax.y - outExtent.pMin.y;
         int nxIn = inExtent.pMax.x - inExtent.pMin.x;
         int nyIn = inExtent.pMax.y - inExtent.pMin.y;
-        std::vector<float> xBuf(NChannels() * nyIn * nxOut);
-
-        int xBufOffset = 0;
-        for (int yOut = inExtent.pMin.y; yOut < inExtent.pMax.y; ++yOut) {
-            for (int xOut = outExtent.pMin.x; xOut < outExtent.pMax.x; ++xOut) {
-                // Resample image pixel _(xOut, yOut)_
-                DCHECK(xOut >= 0 && xOut < xWeights.size());
-                const ResampleWeight &rsw = xWeights[xOut];
-                // Compute _inOffset_ into _inBuf_ for _(xOut, yOut)_
-                // w.r.t. inBuf
-                int xIn = rsw.firstPixel - inExtent.pMin.x;
-                DCHECK_GE(xIn, 0);
-                DCHECK_LT(xIn + 3, nxIn);
-                int yIn = yOut - inExtent.pMin.y;
-                int inOffset = NChannels() * (xIn + yIn * nxIn);
-                DCHECK_GE(inOffset, 0);
-                DCHECK_LT(inOffset + 3 * NChannels(), inBuf.size());
-
-                for (int c = 0; c < NChannels(); ++c, ++xBufOffset, ++inOffset)
-                    xBuf[xBufOffset] = rsw.weight[0] * inBuf[inOffset] +
-                                       rsw.weight[1] * inBuf[inOffset + NChannels()] +
-                                       rsw.weight[2] * inBuf[inOffset + 2 * NChannels()] +
-                                       rsw.weight[3] * inBuf[inOffset + 3 * NChannels()];
-            }
-        }
+        int nc = NChannels();
+        std::vector<float> xBuf(nc * nyIn * nxOut);
+
+        DCHECK_GE(xWeights[outExtent.pMin.x].firstPixel, inExtent.pMin.x);
+        DCHECK_LE(xWeights[outExtent.pMax.x - 1].firstPixel + 4, inExtent.pMax.x);
+        for (int yIn = 0; yIn < nyIn; ++yIn)
+            ResampleScanlineX(&inBuf[nc * yIn * nxIn], &xBuf[nc * yIn * nxOut],
+                              &xWeights[outExtent.pMin.x], inExtent.pMin.x, nxOut, nc);
 
         // Resize image in the $y$ dimension
-        std::vector<float> outBuf(NChannels() * nxOut * nyOut);
-        for (int x = 0; x < nxOut; ++x) {
-            for (int y = 0; y < nyOut; ++y) {
-                int yOut = y + outExtent[0][1];
-                DCHECK(yOut >= 0 && yOut < yWeights.size());
-                const ResampleWeight &rsw = yWeights[yOut];
-
-                DCHECK_GE(rsw.firstPixel - inExtent[0][1], 0);
-                int xBufOffset =
-                    NChannels() * (x + nxOut * (rsw.firstPixel - inExtent[0][1]));
-                DCHECK_GE(xBufOffset, 0);
-                int step = NChannels() * nxOut;
-                DCHECK_LT(xBufOffset + 3 * step, xBuf.size());
-
-                int outOffset = NChannels() * (x + y * nxOut);
-                for (int c = 0; c < NChannels(); ++c, ++outOffset, ++xBufOffset)
-                    outBuf[outOffset] =
-                        std::max<Float>(0, (rsw.weight[0] * xBuf[xBufOffset] +
-                                            rsw.weight[1] * xBuf[xBufOffset + step] +
-                                            rsw.weight[2] * xBuf[xBufOffset + 2 * step] +
-                                            rsw.weight[3] * xBuf[xBufOffset + 3 * step]));
-            }
+        // Each output scanline is a weighted sum of four consecutive
+        // scanlines in _xBuf_, so all channels can be processed together.
+        std::vector<float> outBuf(nc * nxOut * nyOut);
+        int n = nc * nxOut;
+        for (int y = 0; y < nyOut; ++y) {
+            int yOut = y + outExtent[0][1];
+            DCHECK(yOut >= 0 && yOut < yWeights.size());
+            const ResampleWeight &rsw = yWeights[yOut];
+
+            DCHECK_GE(rsw.firstPixel - inExtent[0][1], 0);
+            DCHECK_LE(rsw.firstPixel - inExtent[0][1] + 4, nyIn);
+            const float *x0 = &xBuf[n * (rsw.firstPixel - inExtent[0][1])];
+            const float *x1 = x0 + n, *x2 = x1 + n, *x3 = x2 + n;
+            float *out = &outBuf[n * y];
+            Float w0 = rsw.weight[0], w1 = rsw.weight[1];
+            Float w2 = rsw.weight[2], w3 = rsw.weight[3];
+            for (int i = 0; i < n; ++i)
+                out[i] = std::max<Float>(
+                    0, (w0 * x0[i] + w1 * x1[i] + w2 * x2[i] + w3 * x3[i]));
         }
 
         // Copy resampled image pixels out into _resampledImage_
@@ -457,10 +497,15 @@ Image Image::ConvertToFormat(PixelFormat newFormat, ColorEncodingHandle encoding
         return *this;
 
     Image newImage(newFormat, resolution, channelNames, encoding);
-    for (int y = 0; y < resolution.y; ++y)
-        for (int x = 0; x < resolution.x; ++x)
-            for (int c = 0; c < NChannels(); ++c)
-                newImage.SetChannel({x, y}, c, GetChannel({x, y}, c));
+    // Convert scanlines in parallel through a _float_ buffer
+    ParallelFor(0, resolution.y, [&](int64_t y0, int64_t y1) {
+        std::vector<float> buf(NChannels() * resolution.x);
+        for (int y = y0; y < y1; ++y) {
+            Bounds2i extent({0, y}, {resolution.x, y + 1});
+            CopyRectOut(extent, pstd::span<float>(buf));
+            newImage.CopyRectIn(extent, buf);
+        }
+    });
     return newImage;
 }
 
@@ -657,13 +702,30 @@ void Image::CopyRectOut(const Bounds2i &extent, pstd::span<float> buf,
         break;
 
     case PixelFormat::Half:
-        ForExtent(extent, wrapMode, *this,
-                  [&bufIter, this](int offset) { *bufIter++ = Float(p16[offset]); });
+        if (Intersect(extent, Bounds2i({0, 0}, resolution)) == extent) {
+            // All in bounds; convert scanlines directly
+            size_t count = NChannels() * (extent.pMax.x - extent.pMin.x);
+            for (int y = extent.pMin.y; y < extent.pMax.y; ++y) {
+                const Half *src = &p16[PixelOffset({extent.pMin.x, y})];
+                for (size_t i = 0; i < count; ++i)
+                    *bufIter++ = float(src[i]);
+            }
+        } else
+            ForExtent(extent, wrapMode, *this,
+                      [&bufIter, this](int offset) { *bufIter++ = Float(p16[offset]); });
         break;
 
     case PixelFormat::Float:
-        ForExtent(extent, wrapMode, *this,
-                  [&bufIter, this](int offset) { *bufIter++ = Float(p32[offset]); });
+        if (Intersect(extent, Bounds2i({0, 0}, resolution)) == extent) {
+            // All in bounds; copy scanlines directly
+            size_t count = NChannels() * (extent.pMax.x - extent.pMin.x);
+            for (int y = extent.pMin.y; y < extent.pMax.y; ++y) {
+                std::copy_n(&p32[PixelOffset({extent.pMin.x, y})], count, bufIter);
+                bufIter += count;
+            }
+        } else
+            ForExtent(extent, wrapMode, *this,
+                      [&bufIter, this](int offset) { *bufIter++ = Float(p32[offset]); });
         break;
 
     default:
@@ -701,13 +763,30 @@ void Image::CopyRectIn(const Bounds2i &extent, pstd::span<const float> buf) {
         break;
 
     case PixelFormat::Half:
-        ForExtent(extent, WrapMode::Clamp, *this,
-                  [&bufIter, this](int offset) { p16[offset] = Half(*bufIter++); });
+        if (Intersect(extent, Bounds2i({0, 0}, resolution)) == extent) {
+            // All in bounds; convert scanlines directly
+            size_t count = NChannels() * (extent.pMax.x - extent.pMin.x);
+            for (int y = extent.pMin.y; y < extent.pMax.y; ++y) {
+                Half *dst = &p16[PixelOffset({extent.pMin.x, y})];
+                for (size_t i = 0; i < count; ++i)
+                    dst[i] = Half(*bufIter++);
+            }
+        } else
+            ForExtent(extent, WrapMode::Clamp, *this,
+                      [&bufIter, this](int offset) { p16[offset] = Half(*bufIter++); });
         break;
 
     case PixelFormat::Float:
-        ForExtent(extent, WrapMode::Clamp, *this,
-                  [&bufIter, this](int offset) { p32[offset] = *bufIter++; });
+        if (Intersect(extent, Bounds2i({0, 0}, resolution)) == extent) {
+            // All in bounds; copy scanlines directly
+            size_t count = NChannels() * (extent.pMax.x - extent.pMin.x);
+            for (int y = extent.pMin.y; y < extent.pMax.y; ++y) {
+                std::copy_n(bufIter, count, &p32[PixelOffset({extent.pMin.x, y})]);
+                bufIter += count;
+            }
+        } else
+            ForExtent(extent, WrapMode::Clamp, *this,
+                      [&bufIter, this](int offset) { p32[offset] = *bufIter++; });
         break;
 
     default:
@@ -800,22 +879,20 @@ Image Image::JointBilateralFilter(const ImageChannelDesc &toFilterDesc, int half
                     if (y + dy < 0 || y + dy >= resolution.y)
                         continue;
                     for (int dx = -halfWidth + 1; dx < halfWidth; ++dx) {
-                        for (int dx = -halfWidth + 1; dx < halfWidth; ++dx) {
-                            if (x + dx < 0 || x + dx >= resolution.x)
-                                continue;
-                            ImageChannelValues jointOtherChannels =
-                                GetChannels({x + dx, y + dy}, jointDesc);
-                            Float weight = fx[std::abs(dx)] * fy[std::abs(dy)];
-                            for (int c = 0; c < jointDesc.size(); ++c)
-                                weight *= Gaussian(jointPixelChannels[c],
-                                                   jointOtherChannels[c], jointSigma[c]);
-                            weightSum += weight;
-
-                            ImageChannelValues filterChannels =
-                                GetChannels({x + dx, y + dy}, toFilterDesc);
-                            for (int c = 0; c < filterChannels.size(); ++c)
-                                filteredSum[c] += weight * filterChannels[c];
-                        }
+                        if (x + dx < 0 || x + dx >= resolution.x)
+                            continue;
+                        ImageChannelValues jointOtherChannels =
+                            GetChannels({x + dx, y + dy}, jointDesc);
+                        Float weight = fx[std::abs(dx)] * fy[std::abs(dy)];
+                        for (int c = 0; c < jointDesc.size(); ++c)
+                            weight *= Gaussian(jointPixelChannels[c],
+                                               jointOtherChannels[c], jointSigma[c]);
+                        weightSum += weight;
+
+                        ImageChannelValues filterChannels =
+                            GetChannels({x + dx, y + dy}, toFilterDesc);
+                        for (int c = 0; c < filterChannels.size(); ++c)
+                            filteredSum[c] += weight * filterChannels[c];
                     }
                 }
                 if (weightSum > 0)
@@ -1107,77 +1184,85 @@ static ImageAndMetadata ReadEXR(const std::string &name, Allocator alloc) {
     return {};
 }
 
+// Returns an EXR header with the image windows and attributes given by
+// _metadata_ for an image of the given resolution; channels are added by
+// the caller.
+static Imf::Header exrHeader(const ImageMetadata &metadata, Point2i resolution) {
+    Imath::Box2i displayWindow, dataWindow;
+    if (metadata.fullResolution)
+        // Agan, -1 offsets to handle inclusive indexing in OpenEXR...
+        displayWindow = {Imath::V2i(0, 0),
+                         Imath::V2i(metadata.fullResolution->x - 1,
+                                    metadata.fullResolution->y - 1)};
+    else
+        displayWindow = {Imath::V2i(0, 0),
+                         Imath::V2i(resolution.x - 1, resolution.y - 1)};
+
+    if (metadata.pixelBounds)
+        dataWindow = {
+            Imath::V2i(metadata.pixelBounds->pMin.x, metadata.pixelBounds->pMin.y),
+            Imath::V2i(metadata.pixelBounds->pMax.x - 1,
+                       metadata.pixelBounds->pMax.y - 1)};
+    else
+        dataWindow = {Imath::V2i(0, 0),
+                      Imath::V2i(resolution.x - 1, resolution.y - 1)};
+
+    Imf::Header header(displayWindow, dataWindow);
+
+    if (metadata.renderTimeSeconds)
+        header.insert("renderTimeSeconds",
+                      Imf::FloatAttribute(*metadata.renderTimeSeconds));
+    if (metadata.cameraFromWorld) {
+        float m[4][4];
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                m[i][j] = (*metadata.cameraFromWorld)[i][j];
+        header.insert("worldToCamera", Imf::M44fAttribute(m));
+    }
+    if (metadata.NDCFromWorld) {
+        float m[4][4];
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                m[i][j] = (*metadata.NDCFromWorld)[i][j];
+        header.insert("worldToNDC", Imf::M44fAttribute(m));
+    }
+    if (metadata.samplesPerPixel)
+        header.insert("samplesPerPixel",
+                      Imf::IntAttribute(*metadata.samplesPerPixel));
+    if (metadata.MSE)
+        header.insert("MSE", Imf::FloatAttribute(*metadata.MSE));
+    for (const auto &iter : metadata.stringVectors)
+        header.insert(iter.first, Imf::StringVectorAttribute(iter.second));
+
+    // The OpenEXR spec says that the default is sRGB if no
+    // chromaticities are provided.  It should be innocuous to write
+    // the sRGB primaries anyway, but for completely indecipherable
+    // reasons, OSX's Preview.app decides to gamma correct the pixels
+    // in EXR files if it finds primaries.  So, we don't write them in
+    // that case in the interests of nicer looking images on the
+    // screen.
+    if (*metadata.GetColorSpace() != *RGBColorSpace::sRGB) {
+        const RGBColorSpace &cs = *metadata.GetColorSpace();
+        Imf::Chromaticities chromaticities(
+            Imath::V2f(cs.r.x, cs.r.y), Imath::V2f(cs.g.x, cs.g.y),
+            Imath::V2f(cs.b.x, cs.b.y), Imath::V2f(cs.w.x, cs.w.y));
+        header.insert("chromaticities", Imf::ChromaticitiesAttribute(chromaticities));
+    }
+    return header;
+}
+
 bool Image::WriteEXR(const std::string &name, const ImageMetadata &metadata) const {
     if (Is8Bit(format))
         return ConvertToFormat(PixelFormat::Half).WriteEXR(name, metadata);
     CHECK(Is16Bit(format) || Is32Bit(format));
 
     try {
-        Imath::Box2i displayWindow, dataWindow;
-        if (metadata.fullResolution)
-            // Agan, -1 offsets to handle inclusive indexing in OpenEXR...
-            displayWindow = {Imath::V2i(0, 0),
-                             Imath::V2i(metadata.fullResolution->x - 1,
-                                        metadata.fullResolution->y - 1)};
-        else
-            displayWindow = {Imath::V2i(0, 0),
-                             Imath::V2i(resolution.x - 1, resolution.y - 1)};
-
-        if (metadata.pixelBounds)
-            dataWindow = {
-                Imath::V2i(metadata.pixelBounds->pMin.x, metadata.pixelBounds->pMin.y),
-                Imath::V2i(metadata.pixelBounds->pMax.x - 1,
-                           metadata.pixelBounds->pMax.y - 1)};
-        else
-            dataWindow = {Imath::V2i(0, 0),
-                          Imath::V2i(resolution.x - 1, resolution.y - 1)};
-
-        Imf::FrameBuffer fb = imageToFrameBuffer(*this, AllChannelsDesc(), dataWindow);
-
-        Imf::Header header(displayWindow, dataWindow);
+        Imf::Header header = exrHeader(metadata, resolution);
+        Imf::FrameBuffer fb =
+            imageToFrameBuffer(*this, AllChannelsDesc(), header.dataWindow());
         for (auto iter = fb.begin(); iter != fb.end(); ++iter)
             header.channels().insert(iter.name(), iter.slice().type);
 
-        if (metadata.renderTimeSeconds)
-            header.insert("renderTimeSeconds",
-                          Imf::FloatAttribute(*metadata.renderTimeSeconds));
-        if (metadata.cameraFromWorld) {
-            float m[4][4];
-            for (int i = 0; i < 4; ++i)
-                for (int j = 0; j < 4; ++j)
-                    m[i][j] = (*metadata.cameraFromWorld)[i][j];
-            header.insert("worldToCamera", Imf::M44fAttribute(m));
-        }
-        if (metadata.NDCFromWorld) {
-            float m[4][4];
-            for (int i = 0; i < 4; ++i)
-                for (int j = 0; j < 4; ++j)
-                    m[i][j] = (*metadata.NDCFromWorld)[i][j];
-            header.insert("worldToNDC", Imf::M44fAttribute(m));
-        }
-        if (metadata.samplesPerPixel)
-            header.insert("samplesPerPixel",
-                          Imf::IntAttribute(*metadata.samplesPerPixel));
-        if (metadata.MSE)
-            header.insert("MSE", Imf::FloatAttribute(*metadata.MSE));
-        for (const auto &iter : metadata.stringVectors)
-            header.insert(iter.first, Imf::StringVectorAttribute(iter.second));
-
-        // The OpenEXR spec says that the default is sRGB if no
-        // chromaticities are provided.  It should be innocuous to write
-        // the sRGB primaries anyway, but for completely indecipherable
-        // reasons, OSX's Preview.app decides to gamma correct the pixels
-        // in EXR files if it finds primaries.  So, we don't write them in
-        // that case in the interests of nicer looking images on the
-        // screen.
-        if (*metadata.GetColorSpace() != *RGBColorSpace::sRGB) {
-            const RGBColorSpace &cs = *metadata.GetColorSpace();
-            Imf::Chromaticities chromaticities(
-                Imath::V2f(cs.r.x, cs.r.y), Imath::V2f(cs.g.x, cs.g.y),
-                Imath::V2f(cs.b.x, cs.b.y), Imath::V2f(cs.w.x, cs.w.y));
-            header.insert("chromaticities", Imf::ChromaticitiesAttribute(chromaticities));
-        }
-
         Imf::OutputFile file(name.c_str(), header);
         file.setFrameBuffer(fb);
         file.writePixels(resolution.y);
@@ -1189,6 +1274,65 @@ bool Image::WriteEXR(const std::string &name, const ImageMetadata &metadata) con
     return true;
 }
 
+// TiledEXRWriter Method Definitions
+struct TiledEXRWriter::File {
+    File(const std::string &filename, const Imf::Header &header)
+        : exr(filename.c_str(), header) {}
+    Imf::TiledOutputFile exr;
+};
+
+TiledEXRWriter::TiledEXRWriter(const std::string &filename,
+                               const ImageMetadata &metadata, Point2i resolution,
+                               PixelFormat format,
+                               pstd::span<const std::string> channelNames, int tileSize)
+    : filename(filename),
+      pixelBounds(metadata.pixelBounds ? *metadata.pixelBounds
+                                       : Bounds2i(Point2i(0, 0), resolution)),
+      format(format),
+      nChannels(channelNames.size()),
+      tileSize(tileSize) {
+    CHECK(format == PixelFormat::Half || format == PixelFormat::Float);
+    CHECK_EQ(pixelBounds.Area(), resolution.x * resolution.y);
+    try {
+        Imf::Header header = exrHeader(metadata, resolution);
+        for (const std::string &name : channelNames)
+            header.channels().insert(
+                name, Imf::Channel(format == PixelFormat::Half ? Imf::HALF : Imf::FLOAT));
+        header.setTileDescription(
+            Imf::TileDescription(tileSize, tileSize, Imf::ONE_LEVEL));
+        // Let tiles be stored in the order in which they are finished
+        header.lineOrder() = Imf::RANDOM_Y;
+        file = std::make_unique<File>(filename, header);
+    } catch (const std::exception &exc) {
+        ErrorExit("%s: error creating EXR: %s", filename, exc.what());
+    }
+}
+
+TiledEXRWriter::~TiledEXRWriter() = default;
+
+void TiledEXRWriter::WriteTile(Point2i pMin, const Image &image) {
+    CHECK_EQ(image.NChannels(), nChannels);
+    CHECK_EQ((pMin.x - pixelBounds.pMin.x) % tileSize, 0);
+    CHECK_EQ((pMin.y - pixelBounds.pMin.y) % tileSize, 0);
+    Bounds2i tileBounds =
+        Intersect(Bounds2i(pMin, pMin + Vector2i(tileSize, tileSize)), pixelBounds);
+    CHECK_EQ(Point2i(tileBounds.Diagonal()), image.Resolution());
+    if (image.Format() != format)
+        return WriteTile(pMin, image.ConvertToFormat(format));
+
+    Imath::Box2i tileWindow(Imath::V2i(pMin.x, pMin.y),
+                            Imath::V2i(tileBounds.pMax.x - 1, tileBounds.pMax.y - 1));
+    Imf::FrameBuffer fb = imageToFrameBuffer(image, image.AllChannelsDesc(), tileWindow);
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        file->exr.setFrameBuffer(fb);
+        file->exr.writeTile((pMin.x - pixelBounds.pMin.x) / tileSize,
+                            (pMin.y - pixelBounds.pMin.y) / tileSize);
+    } catch (const std::exception &exc) {
+        ErrorExit("%s: error writing EXR tile: %s", filename, exc.what());
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // PNG Function Definitions
 
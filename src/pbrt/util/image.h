@@ -19,6 +19,8 @@
 #include <cstring>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace pbrt {
@@ -441,6 +443,38 @@ struct ImageAndMetadata {
     ImageMetadata metadata;
 };
 
+// TiledEXRWriter Definition
+// Writes a tiled OpenEXR file one tile at a time, so that the full image
+// never needs to be in memory. The tiles partition the metadata's pixel
+// bounds into _tileSize_ square regions starting at its upper-left corner.
+// They may be written in any order and concurrently by multiple threads;
+// the file is complete once the writer is destroyed.
+class TiledEXRWriter {
+  public:
+    // TiledEXRWriter Public Methods
+    TiledEXRWriter(const std::string &filename, const ImageMetadata &metadata,
+                   Point2i resolution, PixelFormat format,
+                   pstd::span<const std::string> channelNames, int tileSize);
+    ~TiledEXRWriter();
+
+    TiledEXRWriter(const TiledEXRWriter &) = delete;
+    TiledEXRWriter &operator=(const TiledEXRWriter &) = delete;
+
+    // _image_ holds the pixels of the tile whose upper-left corner is at
+    // _pMin_, using the same coordinates as the pixel bounds.
+    void WriteTile(Point2i pMin, const Image &image);
+
+  private:
+    // TiledEXRWriter Private Members
+    struct File;
+    std::string filename;
+    Bounds2i pixelBounds;
+    PixelFormat format;
+    int nChannels, tileSize;
+    std::mutex mutex;
+    std::unique_ptr<File> file;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_UTIL_IMAGE_H
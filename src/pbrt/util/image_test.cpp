@@ -457,6 +457,48 @@ TEST(Image, ExrMetadata) {
     EXPECT_EQ(0, remove(filename.c_str()));
 }
 
+TEST(Image, ExrTiledWriter) {
+    // Neither dimension is a multiple of the tile size
+    Point2i res(37, 21);
+    pstd::vector<float> rgbPixels = GetFloatPixels(res, 3);
+    Image image(rgbPixels, res, {"R", "G", "B"});
+
+    std::string filename = "tiled.exr";
+    ImageMetadata metadata;
+    Bounds2i pb(Point2i(3, 5), Point2i(3 + res.x, 5 + res.y));
+    metadata.pixelBounds = pb;
+    metadata.fullResolution = Point2i(64, 64);
+    std::vector<std::string> channelNames = {"R", "G", "B"};
+    {
+        int tileSize = 16;
+        TiledEXRWriter writer(filename, metadata, res, PixelFormat::Float,
+                              channelNames, tileSize);
+        // Write the tiles in reverse order
+        for (int y = (res.y - 1) / tileSize; y >= 0; --y)
+            for (int x = (res.x - 1) / tileSize; x >= 0; --x) {
+                Bounds2i tile(Point2i(x * tileSize, y * tileSize),
+                              Point2i((x + 1) * tileSize, (y + 1) * tileSize));
+                tile = Intersect(tile, Bounds2i(Point2i(0, 0), res));
+                writer.WriteTile(pb.pMin + Vector2i(tile.pMin), image.Crop(tile));
+            }
+    }
+
+    ImageAndMetadata read = Image::Read(filename);
+    EXPECT_EQ(res, read.image.Resolution());
+    EXPECT_EQ(pb, *read.metadata.pixelBounds);
+    ImageChannelDesc rgbDesc = read.image.GetChannelDesc({"R", "G", "B"});
+    ASSERT_TRUE(bool(rgbDesc));
+    for (int y = 0; y < res.y; ++y)
+        for (int x = 0; x < res.x; ++x) {
+            ImageChannelValues v = read.image.GetChannels({x, y}, rgbDesc);
+            for (int c = 0; c < 3; ++c)
+                EXPECT_EQ(image.GetChannel({x, y}, c), v[c])
+                    << " @ (" << x << ", " << y << ", ch " << c << ")";
+        }
+
+    EXPECT_EQ(0, remove(filename.c_str()));
+}
+
 TEST(Image, PngRgbIO) {
     Point2i res(11, 50);
     pstd::vector<float> rgbPixels = GetFloatPixels(res, 3);
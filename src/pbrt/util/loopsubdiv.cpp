@@ -8,116 +8,76 @@
 #include <pbrt/util/error.h>
 #include <pbrt/util/memory.h>
 #include <pbrt/util/mesh.h>
+#include <pbrt/util/parallel.h>
 #include <pbrt/util/pstd.h>
+#include <pbrt/util/stats.h>
 #include <pbrt/util/transform.h>
 #include <pbrt/util/vecmath.h>
 
-#include <map>
-#include <set>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 namespace pbrt {
 
-struct SDFace;
-struct SDVertex;
+STAT_COUNTER("Geometry/Loop subdivision faces refined", nLoopFacesRefined);
+STAT_COUNTER("Geometry/Loop subdivision faces kept", nLoopFacesKept);
 
 // LoopSubdiv Macros
 #define NEXT(i) (((i) + 1) % 3)
 #define PREV(i) (((i) + 2) % 3)
 
 // LoopSubdiv Local Structures
-struct SDVertex {
-    // SDVertex Constructor
-    SDVertex(const Point3f &p = Point3f(0, 0, 0)) : p(p) {}
-
-    // SDVertex Methods
-    int valence();
-    void oneRing(Point3f *p);
-    Point3f p;
-    SDFace *startFace = nullptr;
-    SDVertex *child = nullptr;
-    bool regular = false, boundary = false;
-};
-
-struct SDFace {
-    // SDFace Constructor
-    SDFace() {
-        for (int i = 0; i < 3; ++i) {
-            v[i] = nullptr;
-            f[i] = nullptr;
-        }
-        for (int i = 0; i < 4; ++i)
-            children[i] = nullptr;
-    }
-
-    // SDFace Methods
-    int vnum(SDVertex *vert) const {
+// SDMesh stores the subdivision mesh's connectivity in flat arrays indexed
+// by vertex and face so that each refinement level can be computed in
+// parallel. Edge _k_ of face _f_ runs from _v[3f+k]_ to _v[3f+NEXT(k)]_ and
+// _f[3f+k]_ is the face across it, or -1 at a boundary.
+struct SDMesh {
+    // SDMesh Public Methods
+    int nFaces() const { return int(v.size() / 3); }
+    int nVertices() const { return int(p.size()); }
+
+    int vnum(int face, int vert) const {
         for (int i = 0; i < 3; ++i)
-            if (v[i] == vert)
+            if (v[3 * face + i] == vert)
                 return i;
-        LOG_FATAL("Basic logic error in SDFace::vnum()");
+        LOG_FATAL("Basic logic error in SDMesh::vnum()");
         return -1;
     }
-    SDFace *nextFace(SDVertex *vert) { return f[vnum(vert)]; }
-    SDFace *prevFace(SDVertex *vert) { return f[PREV(vnum(vert))]; }
-    SDVertex *nextVert(SDVertex *vert) { return v[NEXT(vnum(vert))]; }
-    SDVertex *prevVert(SDVertex *vert) { return v[PREV(vnum(vert))]; }
-    SDVertex *otherVert(SDVertex *v0, SDVertex *v1) {
+    int nextFace(int face, int vert) const { return f[3 * face + vnum(face, vert)]; }
+    int prevFace(int face, int vert) const {
+        return f[3 * face + PREV(vnum(face, vert))];
+    }
+    int nextVert(int face, int vert) const {
+        return v[3 * face + NEXT(vnum(face, vert))];
+    }
+    int prevVert(int face, int vert) const {
+        return v[3 * face + PREV(vnum(face, vert))];
+    }
+    int otherVert(int face, int v0, int v1) const {
         for (int i = 0; i < 3; ++i)
-            if (v[i] != v0 && v[i] != v1)
-                return v[i];
-        LOG_FATAL("Basic logic error in SDVertex::otherVert()");
-        return nullptr;
+            if (v[3 * face + i] != v0 && v[3 * face + i] != v1)
+                return v[3 * face + i];
+        LOG_FATAL("Basic logic error in SDMesh::otherVert()");
+        return -1;
     }
-    SDVertex *v[3];
-    SDFace *f[3];
-    SDFace *children[4];
-};
 
-struct SDEdge {
-    // SDEdge Constructor
-    SDEdge(SDVertex *v0 = nullptr, SDVertex *v1 = nullptr) {
-        v[0] = std::min(v0, v1);
-        v[1] = std::max(v0, v1);
-        f[0] = f[1] = nullptr;
-        f0edgeNum = -1;
-    }
+    void ComputeFaceNeighbors();
+    void ComputeVertexInfo();
 
-    // SDEdge Comparison Function
-    bool operator<(const SDEdge &e2) const {
-        if (v[0] == e2.v[0])
-            return v[1] < e2.v[1];
-        return v[0] < e2.v[0];
-    }
-    SDVertex *v[2];
-    SDFace *f[2];
-    int f0edgeNum;
-};
+    int valence(int vert) const;
+    void oneRing(int vert, Point3f *pRing) const;
+    Point3f weightOneRing(int vert, Float beta) const;
+    Point3f weightBoundary(int vert, Float beta) const;
 
-// LoopSubdiv Local Declarations
-static Point3f weightOneRing(SDVertex *vert, Float beta);
-static Point3f weightBoundary(SDVertex *vert, Float beta);
+    // SDMesh Public Members
+    std::vector<Point3f> p;
+    std::vector<int> startFace;
+    std::vector<uint8_t> boundary;
+    std::vector<int> v, f;
+};
 
 // LoopSubdiv Inline Functions
-inline int SDVertex::valence() {
-    SDFace *f = startFace;
-    if (!boundary) {
-        // Compute valence of interior vertex
-        int nf = 1;
-        while ((f = f->nextFace(this)) != startFace)
-            ++nf;
-        return nf;
-    } else {
-        // Compute valence of boundary vertex
-        int nf = 1;
-        while ((f = f->nextFace(this)) != nullptr)
-            ++nf;
-        f = startFace;
-        while ((f = f->prevFace(this)) != nullptr)
-            ++nf;
-        return nf + 1;
-    }
-}
-
 inline Float beta(int valence) {
     if (valence == 3)
         return 3.f / 16.f;
@@ -129,211 +89,407 @@ inline Float loopGamma(int valence) {
     return 1.f / (valence + 3.f / (8.f * beta(valence)));
 }
 
-// LoopSubdiv Function Definitions
-TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrientation,
-                            int nLevels, pstd::span<const int> vertexIndices,
-                            pstd::span<const Point3f> p, Allocator alloc) {
-    std::vector<SDVertex *> vertices;
-    std::vector<SDFace *> faces;
-    // Allocate _LoopSubdiv_ vertices and faces
-    std::unique_ptr<SDVertex[]> verts = std::make_unique<SDVertex[]>(p.size());
-    for (int i = 0; i < p.size(); ++i) {
-        verts[i] = SDVertex(p[i]);
-        vertices.push_back(&verts[i]);
-    }
-    size_t nFaces = vertexIndices.size() / 3;
-    std::unique_ptr<SDFace[]> fs = std::make_unique<SDFace[]>(nFaces);
-    for (int i = 0; i < nFaces; ++i)
-        faces.push_back(&fs[i]);
-
-    // Set face to vertex pointers
-    const int *vp = vertexIndices.data();
-    for (size_t i = 0; i < nFaces; ++i, vp += 3) {
-        SDFace *f = faces[i];
-        for (int j = 0; j < 3; ++j) {
-            SDVertex *v = vertices[vp[j]];
-            f->v[j] = v;
-            v->startFace = f;
+// SDMesh Method Definitions
+void SDMesh::ComputeFaceNeighbors() {
+    // Sort face edges by their vertices so that shared edges are adjacent
+    struct FaceEdge {
+        int v0, v1;
+        int faceEdge;
+        bool operator<(const FaceEdge &e) const {
+            if (v0 != e.v0)
+                return v0 < e.v0;
+            if (v1 != e.v1)
+                return v1 < e.v1;
+            return faceEdge < e.faceEdge;
+        }
+    };
+    std::vector<FaceEdge> edges(v.size());
+    ParallelFor(0, nFaces(), [&](int64_t face) {
+        for (int k = 0; k < 3; ++k) {
+            int v0 = v[3 * face + k], v1 = v[3 * face + NEXT(k)];
+            edges[3 * face + k] = FaceEdge{std::min(v0, v1), std::max(v0, v1),
+                                           int(3 * face + k)};
+        }
+    });
+    std::sort(edges.begin(), edges.end());
+
+    // Pair up faces that share each edge
+    f.assign(v.size(), -1);
+    for (size_t i = 0; i + 1 < edges.size(); ++i) {
+        const FaceEdge &e0 = edges[i], &e1 = edges[i + 1];
+        if (e0.v0 == e1.v0 && e0.v1 == e1.v1) {
+            f[e0.faceEdge] = e1.faceEdge / 3;
+            f[e1.faceEdge] = e0.faceEdge / 3;
+            ++i;
         }
     }
+}
 
-    // Set neighbor pointers in _faces_
-    std::set<SDEdge> edges;
-    for (int i = 0; i < nFaces; ++i) {
-        SDFace *f = faces[i];
-        for (int edgeNum = 0; edgeNum < 3; ++edgeNum) {
-            // Update neighbor pointer for _edgeNum_
-            int v0 = edgeNum, v1 = NEXT(edgeNum);
-            SDEdge e(f->v[v0], f->v[v1]);
-            if (edges.find(e) == edges.end()) {
-                // Handle new edge
-                e.f[0] = f;
-                e.f0edgeNum = edgeNum;
-                edges.insert(e);
-            } else {
-                // Handle previously seen edge
-                e = *edges.find(e);
-                e.f[0]->f[e.f0edgeNum] = f;
-                f->f[edgeNum] = e.f[0];
-                edges.erase(e);
-            }
+void SDMesh::ComputeVertexInfo() {
+    // Set each vertex's starting face to the first face that uses it
+    startFace.assign(p.size(), -1);
+    for (int face = nFaces() - 1; face >= 0; --face)
+        for (int k = 0; k < 3; ++k)
+            startFace[v[3 * face + k]] = face;
+
+    // Classify vertices as boundary or interior
+    boundary.resize(p.size());
+    ParallelFor(0, nVertices(), [&](int64_t vert) {
+        int face = startFace[vert];
+        if (face == -1) {
+            // Unused vertices are never visited; leave them alone
+            boundary[vert] = false;
+            return;
         }
+        do {
+            face = nextFace(face, vert);
+        } while (face != -1 && face != startFace[vert]);
+        boundary[vert] = (face == -1);
+    });
+}
+
+int SDMesh::valence(int vert) const {
+    int face = startFace[vert];
+    if (!boundary[vert]) {
+        // Compute valence of interior vertex
+        int nf = 1;
+        while ((face = nextFace(face, vert)) != startFace[vert])
+            ++nf;
+        return nf;
+    } else {
+        // Compute valence of boundary vertex
+        int nf = 1;
+        while ((face = nextFace(face, vert)) != -1)
+            ++nf;
+        face = startFace[vert];
+        while ((face = prevFace(face, vert)) != -1)
+            ++nf;
+        return nf + 1;
     }
+}
 
-    // Finish vertex initialization
-    for (size_t i = 0; i < p.size(); ++i) {
-        SDVertex *v = vertices[i];
-        SDFace *f = v->startFace;
+void SDMesh::oneRing(int vert, Point3f *pRing) const {
+    if (!boundary[vert]) {
+        // Get one-ring vertices for interior vertex
+        int face = startFace[vert];
         do {
-            f = f->nextFace(v);
-        } while ((f != nullptr) && f != v->startFace);
-        v->boundary = (f == nullptr);
-        if (!v->boundary && v->valence() == 6)
-            v->regular = true;
-        else if (v->boundary && v->valence() == 4)
-            v->regular = true;
-        else
-            v->regular = false;
+            *pRing++ = p[nextVert(face, vert)];
+            face = nextFace(face, vert);
+        } while (face != startFace[vert]);
+    } else {
+        // Get one-ring vertices for boundary vertex
+        int face = startFace[vert], f2;
+        while ((f2 = nextFace(face, vert)) != -1)
+            face = f2;
+        *pRing++ = p[nextVert(face, vert)];
+        do {
+            *pRing++ = p[prevVert(face, vert)];
+            face = prevFace(face, vert);
+        } while (face != -1);
     }
+}
 
-    // Refine _LoopSubdiv_ into triangles
-    std::vector<SDFace *> f = faces;
-    std::vector<SDVertex *> v = vertices;
-    pstd::pmr::monotonic_buffer_resource resource;
-    Allocator vertexFaceAllocator(&resource);
+Point3f SDMesh::weightOneRing(int vert, Float beta) const {
+    // Put _vert_ one-ring in _pRing_
+    int valence = this->valence(vert);
+    InlinedVector<Point3f, 16> pRing(valence);
 
-    for (int i = 0; i < nLevels; ++i) {
-        // Update _f_ and _v_ for next level of subdivision
-        std::vector<SDFace *> newFaces;
-        std::vector<SDVertex *> newVertices;
-
-        // Allocate next level of children in mesh tree
-        for (SDVertex *vertex : v) {
-            vertex->child = vertexFaceAllocator.new_object<SDVertex>();
-            vertex->child->regular = vertex->regular;
-            vertex->child->boundary = vertex->boundary;
-            newVertices.push_back(vertex->child);
-        }
-        for (SDFace *face : f) {
-            for (int k = 0; k < 4; ++k) {
-                face->children[k] = vertexFaceAllocator.new_object<SDFace>();
-                newFaces.push_back(face->children[k]);
-            }
-        }
+    oneRing(vert, pRing.data());
+    Point3f pw = (1 - valence * beta) * p[vert];
+    for (int i = 0; i < valence; ++i)
+        pw += beta * pRing[i];
+    return pw;
+}
+
+Point3f SDMesh::weightBoundary(int vert, Float beta) const {
+    // Put _vert_ one-ring in _pRing_
+    int valence = this->valence(vert);
+    InlinedVector<Point3f, 16> pRing(valence);
 
-        // Update vertex positions and create new edge vertices
+    oneRing(vert, pRing.data());
+    Point3f pw = (1 - 2 * beta) * p[vert];
+    pw += beta * pRing[0];
+    pw += beta * pRing[valence - 1];
+    return pw;
+}
 
-        // Update vertex positions for even vertices
-        for (SDVertex *vertex : v) {
-            if (!vertex->boundary) {
-                // Apply one-ring rule for even vertex
-                if (vertex->regular)
-                    vertex->child->p = weightOneRing(vertex, 1.f / 16.f);
-                else
-                    vertex->child->p = weightOneRing(vertex, beta(vertex->valence()));
-            } else {
-                // Apply boundary rule for even vertex
-                vertex->child->p = weightBoundary(vertex, 1.f / 8.f);
+// LoopSubdiv Local Functions
+static SDMesh RefineLoopMesh(const SDMesh &mesh, const Transform &renderFromObject,
+                             Float maxEdgeLength) {
+    int nFaces = mesh.nFaces(), nVertices = mesh.nVertices();
+    // Choose which faces to refine at this level
+    std::vector<uint8_t> refine(nFaces, true);
+    if (maxEdgeLength > 0) {
+        ParallelFor(0, nFaces, [&](int64_t face) {
+            Float maxLength = 0;
+            for (int k = 0; k < 3; ++k) {
+                const Point3f &p0 = mesh.p[mesh.v[3 * face + k]];
+                const Point3f &p1 = mesh.p[mesh.v[3 * face + NEXT(k)]];
+                maxLength = std::max(maxLength, Length(renderFromObject(p1 - p0)));
             }
+            refine[face] = maxLength > maxEdgeLength;
+        });
+
+        // Refine faces that would otherwise have more than one split edge
+        std::vector<uint8_t> newRefine(nFaces);
+        std::atomic<bool> changed{true};
+        while (changed) {
+            changed = false;
+            ParallelFor(0, nFaces, [&](int64_t face) {
+                newRefine[face] = refine[face];
+                if (refine[face])
+                    return;
+                int nSplit = 0;
+                for (int k = 0; k < 3; ++k) {
+                    int nbr = mesh.f[3 * face + k];
+                    nSplit += (nbr != -1 && refine[nbr]);
+                }
+                if (nSplit > 1) {
+                    newRefine[face] = true;
+                    changed = true;
+                }
+            });
+            std::swap(refine, newRefine);
         }
+    }
 
-        // Compute new odd edge vertices
-        std::map<SDEdge, SDVertex *> edgeVerts;
-        for (SDFace *face : f) {
-            for (int k = 0; k < 3; ++k) {
-                // Compute odd vertex on _k_th edge
-                SDEdge edge(face->v[k], face->v[NEXT(k)]);
-                SDVertex *vert = edgeVerts[edge];
-                if (vert == nullptr) {
-                    // Create and initialize new odd vertex
-                    vert = vertexFaceAllocator.new_object<SDVertex>();
-                    newVertices.push_back(vert);
-                    vert->regular = true;
-                    vert->boundary = (face->f[k] == nullptr);
-                    vert->startFace = face->children[3];
-
-                    // Apply edge rules to compute new vertex position
-                    if (vert->boundary) {
-                        vert->p = 0.5f * edge.v[0]->p;
-                        vert->p += 0.5f * edge.v[1]->p;
-                    } else {
-                        vert->p = 3.f / 8.f * edge.v[0]->p;
-                        vert->p += 3.f / 8.f * edge.v[1]->p;
-                        vert->p += 1.f / 8.f * face->otherVert(edge.v[0], edge.v[1])->p;
-                        vert->p +=
-                            1.f / 8.f * face->f[k]->otherVert(edge.v[0], edge.v[1])->p;
-                    }
-                    edgeVerts[edge] = vert;
+    // Determine which edges are split and which face creates each edge vertex
+    auto isSplit = [&](int face, int k) {
+        int nbr = mesh.f[3 * face + k];
+        return refine[face] || (nbr != -1 && refine[nbr]);
+    };
+    auto ownsEdge = [&](int face, int k) {
+        int nbr = mesh.f[3 * face + k];
+        return nbr == -1 || face < nbr;
+    };
+
+    // Compute offsets for new edge vertices and child faces
+    std::vector<int> edgeVertOffset(nFaces + 1), childOffset(nFaces + 1);
+    ParallelFor(0, nFaces, [&](int64_t face) {
+        int nEdgeVerts = 0, nSplit = 0;
+        for (int k = 0; k < 3; ++k)
+            if (isSplit(face, k)) {
+                ++nSplit;
+                nEdgeVerts += ownsEdge(face, k);
+            }
+        edgeVertOffset[face + 1] = nEdgeVerts;
+        childOffset[face + 1] = (nSplit == 3) ? 4 : (nSplit == 1 ? 2 : 1);
+    });
+    edgeVertOffset[0] = nVertices;
+    for (int face = 0; face < nFaces; ++face) {
+        edgeVertOffset[face + 1] += edgeVertOffset[face];
+        childOffset[face + 1] += childOffset[face];
+    }
+
+    // Assign indices of edge vertices to face edges
+    std::vector<int> edgeVert(3 * nFaces, -1);
+    ParallelFor(0, nFaces, [&](int64_t face) {
+        int offset = edgeVertOffset[face];
+        for (int k = 0; k < 3; ++k)
+            if (isSplit(face, k) && ownsEdge(face, k))
+                edgeVert[3 * face + k] = offset++;
+    });
+    ParallelFor(0, nFaces, [&](int64_t face) {
+        for (int k = 0; k < 3; ++k) {
+            if (!isSplit(face, k) || ownsEdge(face, k))
+                continue;
+            // Find edge vertex created by the neighboring face
+            int nbr = mesh.f[3 * face + k];
+            int v0 = mesh.v[3 * face + k], v1 = mesh.v[3 * face + NEXT(k)];
+            for (int j = 0; j < 3; ++j) {
+                int n0 = mesh.v[3 * nbr + j], n1 = mesh.v[3 * nbr + NEXT(j)];
+                if (mesh.f[3 * nbr + j] == face &&
+                    ((n0 == v0 && n1 == v1) || (n0 == v1 && n1 == v0))) {
+                    edgeVert[3 * face + k] = edgeVert[3 * nbr + j];
+                    break;
                 }
             }
+            CHECK_NE(edgeVert[3 * face + k], -1);
         }
+    });
 
-        // Update new mesh topology
+    SDMesh child;
+    int nNewVertices = edgeVertOffset[nFaces];
+    child.p.resize(nNewVertices);
 
-        // Update even vertex face pointers
-        for (SDVertex *vertex : v) {
-            int vertNum = vertex->startFace->vnum(vertex);
-            vertex->child->startFace = vertex->startFace->children[vertNum];
+    // Update vertex positions and create new edge vertices
+
+    // Update vertex positions for even vertices
+    ParallelFor(0, nVertices, [&](int64_t vert) {
+        if (mesh.startFace[vert] == -1) {
+            child.p[vert] = mesh.p[vert];
+            return;
+        }
+        // Only apply the even vertex rules if all adjacent faces are refined
+        bool allRefined = true;
+        int face = mesh.startFace[vert];
+        do {
+            allRefined &= bool(refine[face]);
+            face = mesh.nextFace(face, vert);
+        } while (face != -1 && face != mesh.startFace[vert]);
+        if (mesh.boundary[vert]) {
+            face = mesh.startFace[vert];
+            while ((face = mesh.prevFace(face, vert)) != -1)
+                allRefined &= bool(refine[face]);
         }
 
-        // Update face neighbor pointers
-        for (SDFace *face : f) {
+        if (!allRefined)
+            child.p[vert] = mesh.p[vert];
+        else if (!mesh.boundary[vert])
+            // Apply one-ring rule for even vertex
+            child.p[vert] = mesh.weightOneRing(vert, beta(mesh.valence(vert)));
+        else
+            // Apply boundary rule for even vertex
+            child.p[vert] = mesh.weightBoundary(vert, 1.f / 8.f);
+    });
+
+    // Compute new odd edge vertices
+    ParallelFor(0, nFaces, [&](int64_t face) {
+        for (int k = 0; k < 3; ++k) {
+            if (!isSplit(face, k) || !ownsEdge(face, k))
+                continue;
+            // Apply edge rules to compute new vertex position
+            int v0 = mesh.v[3 * face + k], v1 = mesh.v[3 * face + NEXT(k)];
+            int nbr = mesh.f[3 * face + k];
+            Point3f &pe = child.p[edgeVert[3 * face + k]];
+            if (nbr == -1) {
+                pe = 0.5f * mesh.p[v0];
+                pe += 0.5f * mesh.p[v1];
+            } else {
+                pe = 3.f / 8.f * mesh.p[v0];
+                pe += 3.f / 8.f * mesh.p[v1];
+                pe += 1.f / 8.f * mesh.p[mesh.otherVert(face, v0, v1)];
+                pe += 1.f / 8.f * mesh.p[mesh.otherVert(nbr, v0, v1)];
+            }
+        }
+    });
+
+    // Update new mesh topology
+
+    // Set child face vertices
+    int nNewFaces = childOffset[nFaces];
+    child.v.resize(3 * nNewFaces);
+    ParallelFor(0, nFaces, [&](int64_t face) {
+        int *cv = &child.v[3 * childOffset[face]];
+        const int *v = &mesh.v[3 * face];
+        const int *ev = &edgeVert[3 * face];
+        int nChildren = childOffset[face + 1] - childOffset[face];
+        if (nChildren == 4) {
+            // Split face into three corner faces and a center face
             for (int j = 0; j < 3; ++j) {
-                // Update children _f_ pointers for siblings
-                face->children[3]->f[j] = face->children[NEXT(j)];
-                face->children[j]->f[NEXT(j)] = face->children[3];
-
-                // Update children _f_ pointers for neighbor children
-                SDFace *f2 = face->f[j];
-                face->children[j]->f[j] =
-                    f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
-                f2 = face->f[PREV(j)];
-                face->children[j]->f[PREV(j)] =
-                    f2 != nullptr ? f2->children[f2->vnum(face->v[j])] : nullptr;
+                cv[3 * j + j] = v[j];
+                cv[3 * j + NEXT(j)] = ev[j];
+                cv[3 * j + PREV(j)] = ev[PREV(j)];
+                cv[9 + j] = ev[j];
             }
+        } else if (nChildren == 2) {
+            // Bisect face from its single split edge to the opposite vertex
+            int k = (ev[0] != -1) ? 0 : ((ev[1] != -1) ? 1 : 2);
+            cv[0] = v[k];
+            cv[1] = ev[k];
+            cv[2] = v[PREV(k)];
+            cv[3] = ev[k];
+            cv[4] = v[NEXT(k)];
+            cv[5] = v[PREV(k)];
+        } else
+            for (int j = 0; j < 3; ++j)
+                cv[j] = v[j];
+    });
+
+    // Update child face neighbor pointers
+    child.f.resize(3 * nNewFaces);
+    // Returns the child of _face_ that contains the edge between _v0_ and _v1_
+    auto findChild = [&](int face, int v0, int v1, int skip) {
+        for (int c = childOffset[face]; c < childOffset[face + 1]; ++c) {
+            if (c == skip)
+                continue;
+            const int *cv = &child.v[3 * c];
+            bool has0 = cv[0] == v0 || cv[1] == v0 || cv[2] == v0;
+            bool has1 = cv[0] == v1 || cv[1] == v1 || cv[2] == v1;
+            if (has0 && has1)
+                return c;
         }
-
-        // Update face vertex pointers
-        for (SDFace *face : f) {
+        return -1;
+    };
+    ParallelFor(0, nFaces, [&](int64_t face) {
+        const int *v = &mesh.v[3 * face];
+        const int *ev = &edgeVert[3 * face];
+        for (int c = childOffset[face]; c < childOffset[face + 1]; ++c) {
             for (int j = 0; j < 3; ++j) {
-                // Update child vertex pointer to new even vertex
-                face->children[j]->v[j] = face->v[j]->child;
-
-                // Update child vertex pointer to new odd vertex
-                SDVertex *vert = edgeVerts[SDEdge(face->v[j], face->v[NEXT(j)])];
-                face->children[j]->v[NEXT(j)] = vert;
-                face->children[NEXT(j)]->v[j] = vert;
-                face->children[3]->v[j] = vert;
+                int v0 = child.v[3 * c + j], v1 = child.v[3 * c + NEXT(j)];
+                // Look for neighbor among sibling faces
+                int nbr = findChild(face, v0, v1, c);
+                if (nbr == -1) {
+                    // Find neighbor among children of face across parent edge
+                    for (int k = 0; k < 3; ++k) {
+                        auto onEdge = [&](int vert) {
+                            return vert == v[k] || vert == v[NEXT(k)] ||
+                                   (ev[k] != -1 && vert == ev[k]);
+                        };
+                        if (onEdge(v0) && onEdge(v1)) {
+                            int parentNbr = mesh.f[3 * face + k];
+                            if (parentNbr != -1)
+                                nbr = findChild(parentNbr, v0, v1, -1);
+                            break;
+                        }
+                    }
+                }
+                child.f[3 * c + j] = nbr;
             }
         }
+    });
+
+    nLoopFacesRefined += std::count(refine.begin(), refine.end(), true);
+    child.ComputeVertexInfo();
+    return child;
+}
 
-        // Prepare for next level of subdivision
-        f = newFaces;
-        v = newVertices;
+// LoopSubdiv Function Definitions
+TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrientation,
+                            int nLevels, Float maxEdgeLength,
+                            pstd::span<const int> vertexIndices,
+                            pstd::span<const Point3f> p, Allocator alloc) {
+    // Initialize _SDMesh_ from the provided vertices and faces
+    SDMesh mesh;
+    mesh.p = std::vector<Point3f>(p.begin(), p.end());
+    mesh.v = std::vector<int>(vertexIndices.begin(), vertexIndices.end());
+    mesh.ComputeFaceNeighbors();
+    mesh.ComputeVertexInfo();
+
+    // Refine _LoopSubdiv_ into triangles
+    for (int i = 0; i < nLevels; ++i) {
+        SDMesh refined = RefineLoopMesh(mesh, *renderFromObject, maxEdgeLength);
+        bool done = refined.nFaces() == mesh.nFaces();
+        mesh = std::move(refined);
+        if (done)
+            // No face exceeded the edge length threshold at this level
+            break;
     }
+    nLoopFacesKept += mesh.nFaces();
 
     // Push vertices to limit surface
-    std::vector<Point3f> pLimit(v.size());
-    for (size_t i = 0; i < v.size(); ++i) {
-        if (v[i]->boundary)
-            pLimit[i] = weightBoundary(v[i], 1.f / 5.f);
+    std::vector<Point3f> pLimit(mesh.nVertices());
+    ParallelFor(0, mesh.nVertices(), [&](int64_t vert) {
+        if (mesh.startFace[vert] == -1)
+            pLimit[vert] = mesh.p[vert];
+        else if (mesh.boundary[vert])
+            pLimit[vert] = mesh.weightBoundary(vert, 1.f / 5.f);
         else
-            pLimit[i] = weightOneRing(v[i], loopGamma(v[i]->valence()));
-    }
-    for (size_t i = 0; i < v.size(); ++i)
-        v[i]->p = pLimit[i];
+            pLimit[vert] = mesh.weightOneRing(vert, loopGamma(mesh.valence(vert)));
+    });
+    mesh.p = pLimit;
 
     // Compute vertex tangents on limit surface
-    std::vector<Normal3f> Ns;
-    Ns.reserve(v.size());
-    std::vector<Point3f> pRing(16, Point3f());
-    for (SDVertex *vertex : v) {
+    std::vector<Normal3f> Ns(mesh.nVertices());
+    ParallelFor(0, mesh.nVertices(), [&](int64_t vert) {
+        if (mesh.startFace[vert] == -1)
+            return;
         Vector3f S(0, 0, 0), T(0, 0, 0);
-        int valence = vertex->valence();
-        if (valence > (int)pRing.size())
-            pRing.resize(valence);
-        vertex->oneRing(&pRing[0]);
-        if (!vertex->boundary) {
+        int valence = mesh.valence(vert);
+        InlinedVector<Point3f, 16> pRing(valence);
+        mesh.oneRing(vert, pRing.data());
+        const Point3f &pv = mesh.p[vert];
+        if (!mesh.boundary[vert]) {
             // Compute tangents of interior face
             for (int j = 0; j < valence; ++j) {
                 S += std::cos(2 * Pi * j / valence) * Vector3f(pRing[j]);
@@ -343,12 +499,12 @@ TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrien
             // Compute tangents of boundary face
             S = pRing[valence - 1] - pRing[0];
             if (valence == 2)
-                T = Vector3f(pRing[0] + pRing[1] - 2 * vertex->p);
+                T = Vector3f(pRing[0] + pRing[1] - 2 * pv);
             else if (valence == 3)
-                T = pRing[1] - vertex->p;
+                T = pRing[1] - pv;
             else if (valence == 4)  // regular
                 T = Vector3f(-1 * pRing[0] + 2 * pRing[1] + 2 * pRing[2] + -1 * pRing[3] +
-                             -2 * vertex->p);
+                             -2 * pv);
             else {
                 Float theta = Pi / float(valence - 1);
                 T = Vector3f(std::sin(theta) * (pRing[0] + pRing[valence - 1]));
@@ -359,73 +515,14 @@ TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrien
                 T = -T;
             }
         }
-        Ns.push_back(Normal3f(Cross(S, T)));
-    }
+        Ns[vert] = Normal3f(Cross(S, T));
+    });
 
     // Create triangle mesh from subdivision mesh
-    {
-        size_t ntris = f.size();
-        std::vector<int> verts(3 * ntris);
-        int *vp = verts.data();
-        size_t totVerts = v.size();
-        std::map<SDVertex *, int> usedVerts;
-        for (size_t i = 0; i < totVerts; ++i)
-            usedVerts[v[i]] = i;
-        for (size_t i = 0; i < ntris; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                *vp = usedVerts[f[i]->v[j]];
-                ++vp;
-            }
-        }
-        return alloc.new_object<TriangleMesh>(*renderFromObject, reverseOrientation,
-                                              verts, pLimit, std::vector<Vector3f>(), Ns,
-                                              std::vector<Point2f>(), std::vector<int>());
-    }
-}
-
-static Point3f weightOneRing(SDVertex *vert, Float beta) {
-    // Put _vert_ one-ring in _pRing_
-    int valence = vert->valence();
-    InlinedVector<Point3f, 16> pRing(valence);
-
-    vert->oneRing(pRing.data());
-    Point3f p = (1 - valence * beta) * vert->p;
-    for (int i = 0; i < valence; ++i)
-        p += beta * pRing[i];
-    return p;
-}
-
-void SDVertex::oneRing(Point3f *p) {
-    if (!boundary) {
-        // Get one-ring vertices for interior vertex
-        SDFace *face = startFace;
-        do {
-            *p++ = face->nextVert(this)->p;
-            face = face->nextFace(this);
-        } while (face != startFace);
-    } else {
-        // Get one-ring vertices for boundary vertex
-        SDFace *face = startFace, *f2;
-        while ((f2 = face->nextFace(this)) != nullptr)
-            face = f2;
-        *p++ = face->nextVert(this)->p;
-        do {
-            *p++ = face->prevVert(this)->p;
-            face = face->prevFace(this);
-        } while (face != nullptr);
-    }
-}
-
-static Point3f weightBoundary(SDVertex *vert, Float beta) {
-    // Put _vert_ one-ring in _pRing_
-    int valence = vert->valence();
-    InlinedVector<Point3f, 16> pRing(valence);
-
-    vert->oneRing(pRing.data());
-    Point3f p = (1 - 2 * beta) * vert->p;
-    p += beta * pRing[0];
-    p += beta * pRing[valence - 1];
-    return p;
+    return alloc.new_object<TriangleMesh>(*renderFromObject, reverseOrientation,
+                                          std::move(mesh.v), std::move(mesh.p),
+                                          std::vector<Vector3f>(), std::move(Ns),
+                                          std::vector<Point2f>(), std::vector<int>());
 }
 
 }  // namespace pbrt
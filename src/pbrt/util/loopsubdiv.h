@@ -13,7 +13,8 @@ namespace pbrt {
 
 // LoopSubdiv Declarations
 TriangleMesh *LoopSubdivide(const Transform *renderFromObject, bool reverseOrientation,
-                            int nLevels, pstd::span<const int> vertexIndices,
+                            int nLevels, Float maxEdgeLength,
+                            pstd::span<const int> vertexIndices,
                             pstd::span<const Point3f> p, Allocator alloc);
 
 }  // namespace pbrt
@@ -97,55 +97,75 @@ static void PlyErrorCallback(p_ply, const char *message) {
 }
 
 bool TriangleMesh::WritePLY(const std::string &filename) const {
+    if (s != nullptr)
+        Warning(R"(%s: PLY mesh will be missing tangent vectors "S".)", filename);
+
+    return WritePLY(
+        filename, pstd::span<const int>(vertexIndices, 3 * nTriangles),
+        pstd::span<const Point3f>(p, nVertices),
+        n ? pstd::span<const Normal3f>(n, nVertices) : pstd::span<const Normal3f>(),
+        uv ? pstd::span<const Point2f>(uv, nVertices) : pstd::span<const Point2f>(),
+        faceIndices ? pstd::span<const int>(faceIndices, nTriangles)
+                    : pstd::span<const int>());
+}
+
+bool TriangleMesh::WritePLY(const std::string &filename, pstd::span<const int> indices,
+                            pstd::span<const Point3f> p, pstd::span<const Normal3f> n,
+                            pstd::span<const Point2f> uv,
+                            pstd::span<const int> faceIndices) {
+    CHECK_EQ(indices.size() % 3, 0);
+    CHECK(n.empty() || n.size() == p.size());
+    CHECK(uv.empty() || uv.size() == p.size());
+    size_t nTriangles = indices.size() / 3;
+    CHECK(faceIndices.empty() || faceIndices.size() == nTriangles);
+
     p_ply plyFile =
         ply_create(filename.c_str(), PLY_DEFAULT, PlyErrorCallback, 0, nullptr);
     if (plyFile == nullptr)
         return false;
 
-    ply_add_element(plyFile, "vertex", nVertices);
+    ply_add_element(plyFile, "vertex", p.size());
     ply_add_scalar_property(plyFile, "x", PLY_FLOAT);
     ply_add_scalar_property(plyFile, "y", PLY_FLOAT);
     ply_add_scalar_property(plyFile, "z", PLY_FLOAT);
-    if (n != nullptr) {
+    if (!n.empty()) {
         ply_add_scalar_property(plyFile, "nx", PLY_FLOAT);
         ply_add_scalar_property(plyFile, "ny", PLY_FLOAT);
         ply_add_scalar_property(plyFile, "nz", PLY_FLOAT);
     }
-    if (uv != nullptr) {
+    if (!uv.empty()) {
         ply_add_scalar_property(plyFile, "u", PLY_FLOAT);
         ply_add_scalar_property(plyFile, "v", PLY_FLOAT);
     }
-    if (s != nullptr)
-        Warning(R"(%s: PLY mesh will be missing tangent vectors "S".)", filename);
 
     ply_add_element(plyFile, "face", nTriangles);
     ply_add_list_property(plyFile, "vertex_indices", PLY_UINT8, PLY_INT);
-    if (faceIndices != nullptr)
+    if (!faceIndices.empty())
         ply_add_scalar_property(plyFile, "face_indices", PLY_INT);
 
     ply_write_header(plyFile);
 
-    for (int i = 0; i < nVertices; ++i) {
+    for (size_t i = 0; i < p.size(); ++i) {
         ply_write(plyFile, p[i].x);
         ply_write(plyFile, p[i].y);
         ply_write(plyFile, p[i].z);
-        if (n != nullptr) {
+        if (!n.empty()) {
             ply_write(plyFile, n[i].x);
             ply_write(plyFile, n[i].y);
             ply_write(plyFile, n[i].z);
         }
-        if (uv != nullptr) {
+        if (!uv.empty()) {
             ply_write(plyFile, uv[i].x);
             ply_write(plyFile, uv[i].y);
         }
     }
 
-    for (int i = 0; i < nTriangles; ++i) {
+    for (size_t i = 0; i < nTriangles; ++i) {
         ply_write(plyFile, 3);
-        ply_write(plyFile, vertexIndices[3 * i]);
-        ply_write(plyFile, vertexIndices[3 * i + 1]);
-        ply_write(plyFile, vertexIndices[3 * i + 2]);
-        if (faceIndices != nullptr)
+        ply_write(plyFile, indices[3 * i]);
+        ply_write(plyFile, indices[3 * i + 1]);
+        ply_write(plyFile, indices[3 * i + 2]);
+        if (!faceIndices.empty())
             ply_write(plyFile, faceIndices[i]);
     }
 
@@ -27,6 +27,9 @@ class TriangleMesh {
     std::string ToString() const;
 
     bool WritePLY(const std::string &filename) const;
+    static bool WritePLY(const std::string &filename, pstd::span<const int> indices,
+                         pstd::span<const Point3f> p, pstd::span<const Normal3f> n,
+                         pstd::span<const Point2f> uv, pstd::span<const int> faceIndices);
 
     static void Init(Allocator alloc);
 
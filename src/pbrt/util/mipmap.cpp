@@ -4,6 +4,7 @@
 
 #include <pbrt/util/mipmap.h>
 
+#include <pbrt/options.h>
 #include <pbrt/util/check.h>
 #include <pbrt/util/color.h>
 #include <pbrt/util/colorspace.h>
@@ -16,10 +17,13 @@
 
 #include <algorithm>
 #include <cmath>
+#include <type_traits>
 
 namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/Image maps", imageMapBytes);
+STAT_MEMORY_COUNTER("Memory/Image maps (saved by block compression)",
+                    compressedImageMapBytesSaved);
 
 ///////////////////////////////////////////////////////////////////////////
 // MIPMap Helper Declarations
@@ -192,21 +196,96 @@ static PBRT_CONST Float MIPFilterLUT[MIPFilterLUTSize] = {
 // MIPMap Method Definitions
 MIPMap::MIPMap(Image image, const RGBColorSpace *colorSpace, WrapMode wrapMode,
                Allocator alloc, const MIPMapFilterOptions &options)
-    : colorSpace(colorSpace), wrapMode(wrapMode), options(options) {
+    : compressedPyramid(alloc), colorSpace(colorSpace), wrapMode(wrapMode),
+      options(options) {
     CHECK(colorSpace != nullptr);
     pyramid = Image::GeneratePyramid(std::move(image), wrapMode, alloc);
-    std::for_each(pyramid.begin(), pyramid.end(),
-                  [](const Image &im) { imageMapBytes += im.BytesUsed(); });
+    if (textureTileCache) {
+        // Move the pyramid's levels into tiles managed by the texture cache
+        tiledPyramid = TiledImagePyramid::Create(std::move(pyramid), textureTileCache,
+                                                 alloc);
+        imageMapBytes += tiledPyramid->BytesUsed();
+    } else
+        CompressPyramid(alloc);
+}
+
+MIPMap::MIPMap(TiledImagePyramid *tp, const RGBColorSpace *colorSpace,
+               WrapMode wrapMode, Allocator alloc, const MIPMapFilterOptions &options)
+    : pyramid(alloc),
+      compressedPyramid(alloc),
+      colorSpace(colorSpace),
+      wrapMode(wrapMode),
+      options(options) {
+    CHECK(colorSpace != nullptr);
+    if (tp->HasCache()) {
+        tiledPyramid = tp;
+        imageMapBytes += tiledPyramid->BytesUsed();
+    } else {
+        // Read all of the pyramid's levels into memory
+        for (int level = 0; level < tp->Levels(); ++level)
+            pyramid.push_back(tp->GetLevel(level, alloc));
+        alloc.delete_object(tp);
+        CompressPyramid(alloc);
+    }
+}
+
+void MIPMap::CompressPyramid(Allocator alloc) {
+    if (!Options->compressTextures ||
+        !std::all_of(pyramid.begin(), pyramid.end(), [](const Image &im) {
+            return BlockCompressedImage::GetBlockFormat(im).has_value();
+        })) {
+        std::for_each(pyramid.begin(), pyramid.end(),
+                      [](const Image &im) { imageMapBytes += im.BytesUsed(); });
+        return;
+    }
+    // Replace the pyramid's levels with block-compressed versions of them
+    for (const Image &im : pyramid) {
+        compressedPyramid.push_back(BlockCompressedImage(im, alloc));
+        imageMapBytes += compressedPyramid.back().BytesUsed();
+        compressedImageMapBytesSaved +=
+            int64_t(im.BytesUsed()) - int64_t(compressedPyramid.back().BytesUsed());
+    }
+    pyramid.clear();
+}
+
+int MIPMap::TexelValues(int level, Point2i st, Float *values) const {
+    if (tiledPyramid) {
+        tiledPyramid->GetTexel(level, st, wrapMode, values);
+        return tiledPyramid->NChannels();
+    }
+    CHECK(level >= 0 && level < compressedPyramid.size());
+    compressedPyramid[level].GetTexel(st, wrapMode, values);
+    return compressedPyramid[level].NChannels();
+}
+
+int MIPMap::BilerpValues(int level, Point2f st, Float *values) const {
+    if (tiledPyramid) {
+        tiledPyramid->Bilerp(level, st, wrapMode, values);
+        return tiledPyramid->NChannels();
+    }
+    CHECK(level >= 0 && level < compressedPyramid.size());
+    compressedPyramid[level].Bilerp(st, wrapMode, values);
+    return compressedPyramid[level].NChannels();
 }
 
 template <>
 Float MIPMap::Texel(int level, Point2i st) const {
+    if (tiledPyramid || !compressedPyramid.empty()) {
+        Float v[4];
+        TexelValues(level, st, v);
+        return v[0];
+    }
     CHECK(level >= 0 && level < pyramid.size());
     return pyramid[level].GetChannel(st, 0, wrapMode);
 }
 
 template <>
 RGB MIPMap::Texel(int level, Point2i st) const {
+    if (tiledPyramid || !compressedPyramid.empty()) {
+        Float v[4];
+        int nc = TexelValues(level, st, v);
+        return nc == 1 ? RGB(v[0], v[0], v[0]) : RGB(v[0], v[1], v[2]);
+    }
     CHECK(level >= 0 && level < pyramid.size());
     if (pyramid[level].NChannels() == 3 || pyramid[level].NChannels() == 4) {
         RGB rgb;
@@ -256,6 +335,47 @@ T MIPMap::Filter(Point2f st, Vector2f dst0, Vector2f dst1) const {
             }
         }
     }
+    // Compute EWA filter weights and filter the two nearest levels
+    Float lod;
+    EWAWeights weights[2];
+    if (!ComputeEWAFootprint(st, dst0, dst1, &lod, weights))
+        return Bilerp<T>(0, st);
+    Float delta = lod - weights[0].level;
+    return (1 - delta) * EWA<T>(weights[0]) + delta * EWA<T>(weights[1]);
+}
+
+template <typename T>
+void MIPMap::Filter(pstd::span<const MIPMap *const> mipmaps, Point2f st,
+                    Vector2f dstdx, Vector2f dstdy, pstd::span<T> result) {
+    CHECK_EQ(mipmaps.size(), result.size());
+    // EWA filter footprint for _prev_, reused for subsequent MIPMaps that match it
+    const MIPMap *prev = nullptr;
+    Float lod;
+    EWAWeights weights[2];
+    bool isEWA = false;
+
+    for (size_t i = 0; i < mipmaps.size(); ++i) {
+        const MIPMap *mipmap = mipmaps[i];
+        if (mipmap->options.filter != FilterFunction::EWA) {
+            result[i] = mipmap->Filter<T>(st, dstdx, dstdy);
+            continue;
+        }
+        if (!prev || !mipmap->SameEWAFootprint(*prev, weights)) {
+            isEWA = mipmap->ComputeEWAFootprint(st, dstdx, dstdy, &lod, weights);
+            prev = mipmap;
+        }
+        if (!isEWA)
+            result[i] = mipmap->Bilerp<T>(0, st);
+        else {
+            Float delta = lod - weights[0].level;
+            result[i] = (1 - delta) * mipmap->EWA<T>(weights[0]) +
+                        delta * mipmap->EWA<T>(weights[1]);
+        }
+    }
+}
+
+bool MIPMap::ComputeEWAFootprint(Point2f st, Vector2f dst0, Vector2f dst1, Float *lod,
+                                 EWAWeights weights[2]) const {
     // Compute ellipse minor and major axes
     if (LengthSquared(dst0) < LengthSquared(dst1))
         pstd::swap(dst0, dst1);
@@ -267,18 +387,40 @@ T MIPMap::Filter(Point2f st, Vector2f dst0, Vector2f dst1) const {
         dst1 *= scale;
         minorLength *= scale;
     }
-    if (minorLength == 0)
-        return Bilerp<T>(0, st);
+    if (minorLength == 0) {
+        weights[0].level = weights[1].level = 0;
+        return false;
+    }
+
+    // Choose level of detail for EWA lookup and compute filter weights
+    *lod = std::max<Float>(0, Levels() - 1 + Log2(minorLength));
+    int ilod = std::floor(*lod);
+    ComputeEWAWeights(ilod, st, dst0, dst1, &weights[0]);
+    ComputeEWAWeights(ilod + 1, st, dst0, dst1, &weights[1]);
+    return true;
+}
 
-    // Choose level of detail for EWA lookup and perform EWA filtering
-    Float lod = std::max<Float>(0, Levels() - 1 + Log2(minorLength));
-    int ilod = std::floor(lod);
-    return ((1 - (lod - ilod)) * EWA<T>(ilod, st, dst0, dst1) +
-            (lod - ilod) * EWA<T>(ilod + 1, st, dst0, dst1));
+bool MIPMap::SameEWAFootprint(const MIPMap &mipmap,
+                              const EWAWeights weights[2]) const {
+    // Footprints match if both the level selection and the resolutions of
+    // the filtered levels are the same
+    if (Levels() != mipmap.Levels() || options < mipmap.options ||
+        mipmap.options < options)
+        return false;
+    for (int i = 0; i < 2; ++i)
+        if (weights[i].level < Levels() &&
+            LevelResolution(weights[i].level) != mipmap.LevelResolution(weights[i].level))
+            return false;
+    return true;
 }
 
 template <>
 RGB MIPMap::Bilerp(int level, Point2f st) const {
+    if (tiledPyramid || !compressedPyramid.empty()) {
+        Float v[4];
+        int nc = BilerpValues(level, st, v);
+        return nc == 1 ? RGB(v[0], v[0], v[0]) : RGB(v[0], v[1], v[2]);
+    }
     CHECK(level >= 0 && level < pyramid.size());
     if (pyramid[level].NChannels() == 3 || pyramid[level].NChannels() == 4) {
         RGB rgb;
@@ -292,10 +434,11 @@ RGB MIPMap::Bilerp(int level, Point2f st) const {
     }
 }
 
-template <typename T>
-T MIPMap::EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const {
+void MIPMap::ComputeEWAWeights(int level, Point2f st, Vector2f dst0, Vector2f dst1,
+                               EWAWeights *weights) const {
+    weights->level = level;
     if (level >= Levels())
-        return Texel<T>(Levels() - 1, {0, 0});
+        return;
     // Convert EWA coordinates to appropriate scale for level
     Point2i levelRes = LevelResolution(level);
     st[0] = st[0] * levelRes[0] - 0.5f;
@@ -318,34 +461,167 @@ T MIPMap::EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const {
     Float det = -B * B + 4 * A * C;
     Float invDet = 1 / det;
     Float uSqrt = SafeSqrt(det * C), vSqrt = SafeSqrt(A * det);
-    int s0 = std::ceil(st[0] - 2 * invDet * uSqrt);
-    int s1 = std::floor(st[0] + 2 * invDet * uSqrt);
-    int t0 = std::ceil(st[1] - 2 * invDet * vSqrt);
-    int t1 = std::floor(st[1] + 2 * invDet * vSqrt);
-
-    // Scan over ellipse bound and evaluate quadratic equation to filter image
-    T sum{};
-    Float sumWts = 0;
-    for (int it = t0; it <= t1; ++it) {
-        Float tt = it - st[1];
-        for (int is = s0; is <= s1; ++is) {
-            Float ss = is - st[0];
-            // Compute squared radius and filter texel if it is inside the ellipse
+    weights->s0 = std::ceil(st[0] - 2 * invDet * uSqrt);
+    weights->s1 = std::floor(st[0] + 2 * invDet * uSqrt);
+    weights->t0 = std::ceil(st[1] - 2 * invDet * vSqrt);
+    weights->t1 = std::floor(st[1] + 2 * invDet * vSqrt);
+    weights->s = st[0];
+    weights->t = st[1];
+    weights->A = A;
+    weights->B = B;
+    weights->C = C;
+
+    // Evaluate the quadratic equation for each texel to find its weight,
+    // unless there are too many texels to store
+    int width = std::max(0, weights->s1 - weights->s0 + 1);
+    int height = std::max(0, weights->t1 - weights->t0 + 1);
+    weights->stored = int64_t(width) * int64_t(height) <= EWAWeights::MaxTexels;
+    if (!weights->stored)
+        return;
+    weights->sumWts = 0;
+    for (int y = 0; y < height; ++y) {
+        Float tt = weights->t0 + y - st[1];
+        Float *wts = &weights->wts[y * width];
+        // This loop is branch-free so that it can be vectorized
+        for (int x = 0; x < width; ++x) {
+            Float ss = weights->s0 + x - st[0];
             Float r2 = A * ss * ss + B * ss * tt + C * tt * tt;
-            if (r2 < 1) {
-                int index = std::min<int>(r2 * MIPFilterLUTSize, MIPFilterLUTSize - 1);
-                Float weight = MIPFilterLUT[index];
-                sum += weight * Texel<T>(level, {is, it});
-                sumWts += weight;
+            int index =
+                std::min<int>((r2 < 1 ? r2 : 1) * MIPFilterLUTSize, MIPFilterLUTSize - 1);
+            wts[x] = r2 < 1 ? MIPFilterLUT[index] : 0;
+        }
+        for (int x = 0; x < width; ++x)
+            weights->sumWts += wts[x];
+    }
+}
+
+// Adds the texels in a row of an image, weighted by _wts_, to _sum_. The
+// texels' values are taken from channel 0 if _NOut_ is 1 and otherwise
+// from the first three channels, as in _MIPMap::Texel()_. Each channel is
+// accumulated in _Lanes_ independent partial sums that the compiler can map
+// to vector registers.
+template <int NOut, typename TexelType, typename F>
+static void SumTexelRow(const TexelType *row, int nChannels, int n, const Float *wts,
+                        F toFloat, Float *sum) {
+    constexpr int Lanes = 8;
+    for (int c = 0; c < NOut; ++c) {
+        const TexelType *p = row + (nChannels == 1 ? 0 : c);
+        Float acc[Lanes] = {};
+        int i = 0;
+        for (; i + Lanes <= n; i += Lanes)
+            for (int j = 0; j < Lanes; ++j) {
+                // Skip zero-weighted texels so that infinite values outside
+                // the ellipse don't turn the result into a NaN
+                Float v = toFloat(p[(i + j) * nChannels]);
+                acc[j] += wts[i + j] != 0 ? wts[i + j] * v : 0;
+            }
+        for (; i < n; ++i)
+            if (wts[i] != 0)
+                acc[0] += wts[i] * toFloat(p[i * nChannels]);
+        Float s = 0;
+        for (int j = 0; j < Lanes; ++j)
+            s += acc[j];
+        sum[c] += s;
+    }
+}
+
+template <int NOut>
+static void SumTexelRow(const Image &image, Point2i p, int n, const Float *wts,
+                        Float *sum) {
+    int nc = image.NChannels();
+    const void *row = image.RawPointer(p);
+    switch (image.Format()) {
+    case PixelFormat::U256: {
+        ColorEncodingHandle encoding = image.Encoding();
+        if (encoding.Is<sRGBColorEncoding>())
+            SumTexelRow<NOut>((const uint8_t *)row, nc, n, wts,
+                              [](uint8_t v) { return SRGB8ToLinear(v); }, sum);
+        else if (encoding.Is<LinearColorEncoding>())
+            SumTexelRow<NOut>((const uint8_t *)row, nc, n, wts,
+                              [](uint8_t v) { return v / 255.f; }, sum);
+        else
+            SumTexelRow<NOut>((const uint8_t *)row, nc, n, wts,
+                              [&](uint8_t v) {
+                                  Float f;
+                                  encoding.ToLinear({&v, 1}, {&f, 1});
+                                  return f;
+                              },
+                              sum);
+        break;
+    }
+    case PixelFormat::Half:
+        SumTexelRow<NOut>((const Half *)row, nc, n, wts,
+                          [](Half v) { return Float(v); }, sum);
+        break;
+    case PixelFormat::Float:
+        SumTexelRow<NOut>((const float *)row, nc, n, wts, [](float v) { return v; },
+                          sum);
+        break;
+    default:
+        LOG_FATAL("Unhandled PixelFormat");
+    }
+}
+
+template <typename T>
+T MIPMap::EWA(const EWAWeights &weights) const {
+    if (weights.level >= Levels())
+        return Texel<T>(Levels() - 1, {0, 0});
+    if (!weights.stored) {
+        // Scan over the ellipse bound, computing each texel's weight
+        T sum{};
+        Float sumWts = 0;
+        for (int it = weights.t0; it <= weights.t1; ++it) {
+            Float tt = it - weights.t;
+            for (int is = weights.s0; is <= weights.s1; ++is) {
+                Float ss = is - weights.s;
+                // Compute squared radius and filter texel if it is inside the ellipse
+                Float r2 =
+                    weights.A * ss * ss + weights.B * ss * tt + weights.C * tt * tt;
+                if (r2 < 1) {
+                    int index =
+                        std::min<int>(r2 * MIPFilterLUTSize, MIPFilterLUTSize - 1);
+                    Float weight = MIPFilterLUT[index];
+                    sum += weight * Texel<T>(weights.level, {is, it});
+                    sumWts += weight;
+                }
             }
         }
+        return sum / sumWts;
     }
-    return sum / sumWts;
+
+    constexpr int NOut = std::is_same_v<T, Float> ? 1 : 3;
+    Float sum[NOut] = {};
+    Point2i levelRes = LevelResolution(weights.level);
+    int width = std::max(0, weights.s1 - weights.s0 + 1);
+    for (int it = weights.t0; it <= weights.t1; ++it) {
+        const Float *wts = &weights.wts[(it - weights.t0) * width];
+        if (!pyramid.empty() && it >= 0 && it < levelRes.y && weights.s0 >= 0 &&
+            weights.s1 < levelRes.x) {
+            // Filter a row of texels that are all inside the image directly
+            SumTexelRow<NOut>(pyramid[weights.level], {weights.s0, it}, width, wts,
+                              sum);
+            continue;
+        }
+        // Filter texels using _Texel()_ to handle wrapping and other storage
+        for (int i = 0; i < width; ++i) {
+            if (wts[i] == 0)
+                continue;
+            T v = Texel<T>(weights.level, {weights.s0 + i, it});
+            if constexpr (NOut == 1)
+                sum[0] += wts[i] * v;
+            else
+                for (int c = 0; c < 3; ++c)
+                    sum[c] += wts[i] * v[c];
+        }
+    }
+    if constexpr (NOut == 1)
+        return sum[0] / weights.sumWts;
+    else
+        return RGB(sum[0], sum[1], sum[2]) / weights.sumWts;
 }
 
-MIPMap *MIPMap::CreateFromFile(const std::string &filename,
-                               const MIPMapFilterOptions &options, WrapMode wrapMode,
-                               ColorEncodingHandle encoding, Allocator alloc) {
+static Image ReadMIPMapImage(const std::string &filename, ColorEncodingHandle encoding,
+                             Allocator alloc, const RGBColorSpace **colorSpace) {
     ImageAndMetadata imageAndMetadata = Image::Read(filename, alloc, encoding);
 
     Image &image = imageAndMetadata.image;
@@ -372,11 +648,40 @@ MIPMap *MIPMap::CreateFromFile(const std::string &filename,
         }
     }
 
-    const RGBColorSpace *colorSpace = imageAndMetadata.metadata.GetColorSpace();
+    *colorSpace = imageAndMetadata.metadata.GetColorSpace();
+    return std::move(image);
+}
+
+MIPMap *MIPMap::CreateFromFile(const std::string &filename,
+                               const MIPMapFilterOptions &options, WrapMode wrapMode,
+                               ColorEncodingHandle encoding, Allocator alloc) {
+    const RGBColorSpace *colorSpace;
+    if (TiledImagePyramid::IsTiledFile(filename)) {
+        // Use the pyramid stored in the tiled MIP file; its levels were
+        // computed using the color encoding given when it was created.
+        WrapMode fileWrapMode;
+        TiledImagePyramid *tp = TiledImagePyramid::Read(filename, textureTileCache, alloc,
+                                                        &colorSpace, &fileWrapMode);
+        if (fileWrapMode != wrapMode)
+            Warning("%s: MIP levels were filtered using \"%s\" wrap mode, not \"%s\".",
+                    filename, fileWrapMode, wrapMode);
+        return alloc.new_object<MIPMap>(tp, colorSpace, wrapMode, alloc, options);
+    }
+
+    Image image = ReadMIPMapImage(filename, encoding, alloc, &colorSpace);
     return alloc.new_object<MIPMap>(std::move(image), colorSpace, wrapMode, alloc,
                                     options);
 }
 
+void MIPMap::WriteTiledFile(const std::string &filename, const std::string &outFilename,
+                            WrapMode wrapMode, const std::string &encoding) {
+    const RGBColorSpace *colorSpace;
+    Image image =
+        ReadMIPMapImage(filename, ColorEncodingHandle::Get(encoding), {}, &colorSpace);
+    pstd::vector<Image> pyramid = Image::GeneratePyramid(std::move(image), wrapMode);
+    TiledImagePyramid::WriteFile(outFilename, pyramid, encoding, colorSpace, wrapMode);
+}
+
 template <typename T>
 T MIPMap::Texel(int level, Point2i st) const {
     T::unimplemented_function;
@@ -389,6 +694,21 @@ T MIPMap::Bilerp(int level, Point2f st) const {
 
 template <>
 Float MIPMap::Bilerp(int level, Point2f st) const {
+    if (tiledPyramid || !compressedPyramid.empty()) {
+        Float v[4];
+        int nc = BilerpValues(level, st, v);
+        switch (nc) {
+        case 1:
+            return v[0];
+        case 3:
+            return (v[0] + v[1] + v[2]) / 3;
+        case 4:
+            // Return alpha
+            return v[3];
+        default:
+            LOG_FATAL("Unexpected number of image channels: %d", nc);
+        }
+    }
     CHECK(level >= 0 && level < pyramid.size());
     switch (pyramid[level].NChannels()) {
     case 1:
@@ -403,14 +723,30 @@ Float MIPMap::Bilerp(int level, Point2f st) const {
     }
 }
 
+size_t MIPMap::BytesUsed() const {
+    if (tiledPyramid)
+        return tiledPyramid->BytesUsed();
+    size_t bytes = 0;
+    for (const BlockCompressedImage &im : compressedPyramid)
+        bytes += im.BytesUsed();
+    for (const Image &im : pyramid)
+        bytes += im.BytesUsed();
+    return bytes;
+}
+
 std::string MIPMap::ToString() const {
-    return StringPrintf("[ MIPMap pyramid: %s colorSpace: %s wrapMode: %s "
-                        "options: %s ]",
-                        pyramid, colorSpace->ToString(), wrapMode, options);
+    return StringPrintf("[ MIPMap pyramid: %s tiledPyramid: %s compressedPyramid: %s "
+                        "colorSpace: %s wrapMode: %s options: %s ]",
+                        pyramid, tiledPyramid ? tiledPyramid->ToString() : "(nullptr)",
+                        compressedPyramid, colorSpace->ToString(), wrapMode, options);
 }
 
 // Explicit template instantiation..
 template Float MIPMap::Filter(Point2f st, Vector2f, Vector2f) const;
 template RGB MIPMap::Filter(Point2f st, Vector2f, Vector2f) const;
+template void MIPMap::Filter(pstd::span<const MIPMap *const>, Point2f, Vector2f,
+                             Vector2f, pstd::span<Float>);
+template void MIPMap::Filter(pstd::span<const MIPMap *const>, Point2f, Vector2f,
+                             Vector2f, pstd::span<RGB>);
 
 }  // namespace pbrt
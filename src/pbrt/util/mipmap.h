@@ -7,8 +7,11 @@
 
 #include <pbrt/pbrt.h>
 
+#include <pbrt/util/blockcompress.h>
+#include <pbrt/util/containers.h>
 #include <pbrt/util/image.h>
 #include <pbrt/util/pstd.h>
+#include <pbrt/util/texcache.h>
 #include <pbrt/util/vecmath.h>
 
 #include <memory>
@@ -51,33 +54,90 @@ class MIPMap {
     // MIPMap Public Methods
     MIPMap(Image image, const RGBColorSpace *colorSpace, WrapMode wrapMode,
            Allocator alloc, const MIPMapFilterOptions &options);
+    MIPMap(TiledImagePyramid *tiledPyramid, const RGBColorSpace *colorSpace,
+           WrapMode wrapMode, Allocator alloc, const MIPMapFilterOptions &options);
     static MIPMap *CreateFromFile(const std::string &filename,
                                   const MIPMapFilterOptions &options, WrapMode wrapMode,
                                   ColorEncodingHandle encoding, Allocator alloc);
+    // Writes a tiled MIP file that _CreateFromFile()_ can use directly.
+    static void WriteTiledFile(const std::string &filename,
+                               const std::string &outFilename, WrapMode wrapMode,
+                               const std::string &encoding);
 
     template <typename T>
     T Filter(Point2f st, Vector2f dstdx, Vector2f dstdy) const;
+    // Filters each of the given MIPMaps with the same texture-space footprint
+    // (e.g., for all of a material's image textures); EWA filter weights are
+    // shared across MIPMaps that have the same resolution and filter options.
+    template <typename T>
+    static void Filter(pstd::span<const MIPMap *const> mipmaps, Point2f st,
+                       Vector2f dstdx, Vector2f dstdy, pstd::span<T> result);
 
     std::string ToString() const;
 
     Point2i LevelResolution(int level) const {
+        if (tiledPyramid)
+            return tiledPyramid->LevelResolution(level);
+        if (!compressedPyramid.empty()) {
+            CHECK(level >= 0 && level < compressedPyramid.size());
+            return compressedPyramid[level].Resolution();
+        }
         CHECK(level >= 0 && level < pyramid.size());
         return pyramid[level].Resolution();
     }
-    int Levels() const { return int(pyramid.size()); }
+    int Levels() const {
+        if (tiledPyramid)
+            return tiledPyramid->Levels();
+        return compressedPyramid.empty() ? int(pyramid.size())
+                                         : int(compressedPyramid.size());
+    }
     const RGBColorSpace *GetRGBColorSpace() const { return colorSpace; }
+    size_t BytesUsed() const;
 
   private:
+    // MIPMap::EWAWeights Definition
+    // EWA filter weights for the texels in the bounding box of a filter
+    // ellipse at a single MIP level, stored in scanline order. Texels outside
+    // the ellipse have zero weight. The bounding box of a footprint with the
+    // default maximum anisotropy of 8 always fits in _wts_; for larger ones,
+    // _wts_ is left empty and _EWA()_ evaluates the ellipse's coefficients
+    // for each texel as it filters them.
+    struct EWAWeights {
+        static constexpr int MaxTexels = 576;
+        int level;
+        int s0, s1, t0, t1;
+        // Ellipse center and coefficients in the level's texel coordinates
+        Float s, t, A, B, C;
+        bool stored;
+        Float sumWts;
+        Float wts[MaxTexels];
+    };
+
     // MIPMap Private Methods
     template <typename T>
     T Texel(int level, Point2i st) const;
     template <typename T>
     T Bilerp(int level, Point2f st) const;
+    // Returns false if the footprint is degenerate and the lookup should be
+    // a bilinear lookup at the finest level.
+    bool ComputeEWAFootprint(Point2f st, Vector2f dst0, Vector2f dst1, Float *lod,
+                             EWAWeights weights[2]) const;
+    void ComputeEWAWeights(int level, Point2f st, Vector2f dst0, Vector2f dst1,
+                           EWAWeights *weights) const;
     template <typename T>
-    T EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const;
+    T EWA(const EWAWeights &weights) const;
+    bool SameEWAFootprint(const MIPMap &mipmap, const EWAWeights weights[2]) const;
+
+    void CompressPyramid(Allocator alloc);
+    // Return the channel values of a level stored in _tiledPyramid_ or
+    // _compressedPyramid_, along with the number of channels.
+    int TexelValues(int level, Point2i st, Float *values) const;
+    int BilerpValues(int level, Point2f st, Float *values) const;
 
     // MIPMap Private Members
     pstd::vector<Image> pyramid;
+    TiledImagePyramid *tiledPyramid = nullptr;
+    pstd::vector<BlockCompressedImage> compressedPyramid;
     const RGBColorSpace *colorSpace;
     WrapMode wrapMode;
     MIPMapFilterOptions options;
@@ -0,0 +1,124 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/color.h>
+#include <pbrt/util/colorspace.h>
+#include <pbrt/util/image.h>
+#include <pbrt/util/mipmap.h>
+#include <pbrt/util/rng.h>
+#include <pbrt/util/testimages.h>
+#include <pbrt/util/texcache.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace pbrt;
+
+// Returns a random filter footprint, covering both isotropic and highly
+// anisotropic ellipses.
+static void RandomFootprint(RNG &rng, Point2f *st, Vector2f *dstdx, Vector2f *dstdy) {
+    *st = Point2f(2 * rng.Uniform<Float>() - 0.5f, 2 * rng.Uniform<Float>() - 0.5f);
+    Float scale = std::pow(2.f, -10 * rng.Uniform<Float>());
+    *dstdx = scale * Vector2f(rng.Uniform<Float>() - 0.5f, rng.Uniform<Float>() - 0.5f);
+    *dstdy = scale * Vector2f(rng.Uniform<Float>() - 0.5f, rng.Uniform<Float>() - 0.5f);
+}
+
+TEST(MIPMap, EWAMatchesTiled) {
+    // Lookups in an in-memory pyramid use optimized paths for texel rows
+    // inside the image; lookups in a tiled pyramid always go through
+    // MIPMap::Texel(). Both should give the same results.
+    TextureTileCache cache(0);
+    Allocator alloc;
+    MIPMapFilterOptions options;
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float})
+        for (int nc : {1, 3, 4}) {
+            for (WrapMode wrapMode : {WrapMode::Repeat, WrapMode::Clamp}) {
+                Image image = RandomImage(format, {317, 200}, nc, nc);
+                MIPMap mipmap(image, RGBColorSpace::sRGB, wrapMode, alloc, options);
+                TiledImagePyramid *tp = TiledImagePyramid::Create(
+                    Image::GeneratePyramid(image, wrapMode), &cache, alloc);
+                MIPMap tiled(tp, RGBColorSpace::sRGB, wrapMode, alloc, options);
+
+                RNG rng;
+                for (int i = 0; i < 200; ++i) {
+                    Point2f st;
+                    Vector2f dstdx, dstdy;
+                    RandomFootprint(rng, &st, &dstdx, &dstdy);
+                    RGB rgb = mipmap.Filter<RGB>(st, dstdx, dstdy);
+                    RGB rgbTiled = tiled.Filter<RGB>(st, dstdx, dstdy);
+                    for (int c = 0; c < 3; ++c)
+                        EXPECT_NEAR(rgbTiled[c], rgb[c], 1e-5f);
+                    EXPECT_NEAR(tiled.Filter<Float>(st, dstdx, dstdy),
+                                mipmap.Filter<Float>(st, dstdx, dstdy), 1e-5f);
+                }
+            }
+        }
+}
+
+TEST(MIPMap, EWAConstant) {
+    Allocator alloc;
+    Image image(PixelFormat::Half, {64, 48}, {"R", "G", "B"});
+    for (int y = 0; y < 48; ++y)
+        for (int x = 0; x < 64; ++x)
+            for (int c = 0; c < 3; ++c)
+                image.SetChannel({x, y}, c, 0.25f * (c + 1));
+
+    // Footprints with high anisotropy are too large for _EWAWeights_ and
+    // are filtered at coarser levels.
+    for (Float maxAnisotropy : {8.f, 64.f}) {
+        MIPMapFilterOptions options;
+        options.maxAnisotropy = maxAnisotropy;
+        MIPMap mipmap(image, RGBColorSpace::sRGB, WrapMode::Repeat, alloc, options);
+
+        RNG rng;
+        for (int i = 0; i < 100; ++i) {
+            Point2f st;
+            Vector2f dstdx, dstdy;
+            RandomFootprint(rng, &st, &dstdx, &dstdy);
+            RGB rgb = mipmap.Filter<RGB>(st, dstdx, dstdy);
+            for (int c = 0; c < 3; ++c)
+                EXPECT_NEAR(0.25f * (c + 1), rgb[c], 1e-5f);
+        }
+    }
+}
+
+TEST(MIPMap, Batch) {
+    Allocator alloc;
+    MIPMapFilterOptions ewa, bilinear;
+    bilinear.filter = FilterFunction::Bilinear;
+    // A mix of MIPMaps with the same resolution, different resolutions, and
+    // different filters.
+    MIPMap a(RandomImage(PixelFormat::U256, {256, 256}, 3, 1), RGBColorSpace::sRGB,
+             WrapMode::Repeat, alloc, ewa);
+    MIPMap b(RandomImage(PixelFormat::Half, {256, 256}, 1, 2), RGBColorSpace::sRGB,
+             WrapMode::Repeat, alloc, ewa);
+    MIPMap c(RandomImage(PixelFormat::Float, {100, 300}, 3, 3), RGBColorSpace::sRGB,
+             WrapMode::Clamp, alloc, ewa);
+    MIPMap d(RandomImage(PixelFormat::U256, {256, 256}, 4, 4), RGBColorSpace::sRGB,
+             WrapMode::Repeat, alloc, bilinear);
+    std::vector<const MIPMap *> mipmaps = {&a, &b, &c, &a, &d, &b};
+
+    RNG rng;
+    for (int i = 0; i < 100; ++i) {
+        Point2f st;
+        Vector2f dstdx, dstdy;
+        RandomFootprint(rng, &st, &dstdx, &dstdy);
+        if (i == 0)
+            dstdx = dstdy = Vector2f(0, 0);
+
+        std::vector<RGB> rgb(mipmaps.size());
+        MIPMap::Filter<RGB>(mipmaps, st, dstdx, dstdy, pstd::span<RGB>(rgb));
+        std::vector<Float> v(mipmaps.size());
+        MIPMap::Filter<Float>(mipmaps, st, dstdx, dstdy, pstd::span<Float>(v));
+        for (size_t j = 0; j < mipmaps.size(); ++j) {
+            EXPECT_EQ(mipmaps[j]->Filter<RGB>(st, dstdx, dstdy), rgb[j]);
+            EXPECT_EQ(mipmaps[j]->Filter<Float>(st, dstdx, dstdy), v[j]);
+        }
+    }
+}
@@ -0,0 +1,364 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#ifndef PBRT_UTIL_SIMD_H
+#define PBRT_UTIL_SIMD_H
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/float.h>
+
+// PBRT_HAVE_SIMD is defined when CPU code is being compiled for a target
+// with 4- or 8-wide single-precision vector registers; _FloatVec_ then
+// provides the operations that _SampledSpectrum_ needs on them. GPU code
+// and 64-bit _Float_ builds use plain loops instead. 8-wide AVX vectors
+// are only used if they evenly divide the number of spectral samples.
+#if !defined(PBRT_IS_GPU_CODE) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#if defined(__AVX2__) && defined(PBRT_SPECTRUM_SAMPLES) && PBRT_SPECTRUM_SAMPLES >= 8
+#define PBRT_HAVE_SIMD
+#define PBRT_SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PBRT_HAVE_SIMD
+#define PBRT_SIMD_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define PBRT_HAVE_SIMD
+#define PBRT_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#ifdef PBRT_HAVE_SIMD
+
+namespace pbrt {
+
+// FloatVec Definition
+// Comparisons return masks with all bits set in lanes where the comparison
+// is true, which can be combined with the bitwise operators and passed to
+// _Select()_ and _Any()_.
+class FloatVec {
+  public:
+#if defined(PBRT_SIMD_AVX)
+    using Native = __m256;
+    static constexpr int Width = 8;
+#elif defined(PBRT_SIMD_SSE)
+    using Native = __m128;
+    static constexpr int Width = 4;
+#else
+    using Native = float32x4_t;
+    static constexpr int Width = 4;
+#endif
+
+    // FloatVec Public Methods
+    FloatVec(Native v) : v(v) {}
+    explicit FloatVec(float f) {
+#if defined(PBRT_SIMD_AVX)
+        v = _mm256_set1_ps(f);
+#elif defined(PBRT_SIMD_SSE)
+        v = _mm_set1_ps(f);
+#else
+        v = vdupq_n_f32(f);
+#endif
+    }
+
+    // _Load()_ and _Store()_ take pointers aligned to at least 16 bytes.
+    static FloatVec Load(const float *p) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_loadu_ps(p);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_load_ps(p);
+#else
+        return vld1q_f32(p);
+#endif
+    }
+    void Store(float *p) const {
+#if defined(PBRT_SIMD_AVX)
+        _mm256_storeu_ps(p, v);
+#elif defined(PBRT_SIMD_SSE)
+        _mm_store_ps(p, v);
+#else
+        vst1q_f32(p, v);
+#endif
+    }
+    static FloatVec LoadUnaligned(const float *p) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_loadu_ps(p);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_loadu_ps(p);
+#else
+        return vld1q_f32(p);
+#endif
+    }
+    void StoreUnaligned(float *p) const {
+#if defined(PBRT_SIMD_AVX)
+        _mm256_storeu_ps(p, v);
+#elif defined(PBRT_SIMD_SSE)
+        _mm_storeu_ps(p, v);
+#else
+        vst1q_f32(p, v);
+#endif
+    }
+
+    friend FloatVec operator+(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_add_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_add_ps(a.v, b.v);
+#else
+        return vaddq_f32(a.v, b.v);
+#endif
+    }
+    friend FloatVec operator-(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_sub_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_sub_ps(a.v, b.v);
+#else
+        return vsubq_f32(a.v, b.v);
+#endif
+    }
+    friend FloatVec operator*(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_mul_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_mul_ps(a.v, b.v);
+#else
+        return vmulq_f32(a.v, b.v);
+#endif
+    }
+    friend FloatVec operator/(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_div_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_div_ps(a.v, b.v);
+#else
+        return vdivq_f32(a.v, b.v);
+#endif
+    }
+
+    friend FloatVec operator&(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_and_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_and_ps(a.v, b.v);
+#else
+        return vreinterpretq_f32_u32(
+            vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)));
+#endif
+    }
+    friend FloatVec operator|(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_or_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_or_ps(a.v, b.v);
+#else
+        return vreinterpretq_f32_u32(
+            vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)));
+#endif
+    }
+
+    friend FloatVec NotEqual(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_cmpneq_ps(a.v, b.v);
+#else
+        return vreinterpretq_f32_u32(vmvnq_u32(vceqq_f32(a.v, b.v)));
+#endif
+    }
+    friend FloatVec IsNaN(FloatVec a) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_cmp_ps(a.v, a.v, _CMP_UNORD_Q);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_cmpunord_ps(a.v, a.v);
+#else
+        return vreinterpretq_f32_u32(vmvnq_u32(vceqq_f32(a.v, a.v)));
+#endif
+    }
+    // Returns true if any lane of the mask _m_ is set.
+    friend bool Any(FloatVec m) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_movemask_ps(m.v) != 0;
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_movemask_ps(m.v) != 0;
+#else
+        return vmaxvq_u32(vreinterpretq_u32_f32(m.v)) != 0;
+#endif
+    }
+    // Returns _a_ in lanes where _m_ is set and _b_ elsewhere.
+    friend FloatVec Select(FloatVec m, FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_blendv_ps(b.v, a.v, m.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+#else
+        return vbslq_f32(vreinterpretq_u32_f32(m.v), a.v, b.v);
+#endif
+    }
+
+    // _Min()_ and _Max()_ return _b_ where either value is NaN.
+    friend FloatVec Min(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_min_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_min_ps(a.v, b.v);
+#else
+        return vbslq_f32(vcltq_f32(a.v, b.v), a.v, b.v);
+#endif
+    }
+    friend FloatVec Max(FloatVec a, FloatVec b) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_max_ps(a.v, b.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_max_ps(a.v, b.v);
+#else
+        return vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v);
+#endif
+    }
+    friend FloatVec Sqrt(FloatVec a) {
+#if defined(PBRT_SIMD_AVX)
+        return _mm256_sqrt_ps(a.v);
+#elif defined(PBRT_SIMD_SSE)
+        return _mm_sqrt_ps(a.v);
+#else
+        return vsqrtq_f32(a.v);
+#endif
+    }
+
+    // Horizontal reductions, which combine the two halves of the vector
+    // until a single value remains.
+    friend float ReduceAdd(FloatVec a) {
+#if defined(PBRT_SIMD_AVX)
+        __m128 r = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+#elif defined(PBRT_SIMD_SSE)
+        __m128 r = a.v;
+#endif
+#if defined(PBRT_SIMD_AVX) || defined(PBRT_SIMD_SSE)
+        r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+        r = _mm_add_ss(r, _mm_shuffle_ps(r, r, 1));
+        return _mm_cvtss_f32(r);
+#else
+        float32x2_t r = vadd_f32(vget_low_f32(a.v), vget_high_f32(a.v));
+        return vget_lane_f32(vpadd_f32(r, r), 0);
+#endif
+    }
+    friend float ReduceMin(FloatVec a) {
+#if defined(PBRT_SIMD_AVX)
+        __m128 r = _mm_min_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+#elif defined(PBRT_SIMD_SSE)
+        __m128 r = a.v;
+#endif
+#if defined(PBRT_SIMD_AVX) || defined(PBRT_SIMD_SSE)
+        r = _mm_min_ps(r, _mm_movehl_ps(r, r));
+        r = _mm_min_ss(r, _mm_shuffle_ps(r, r, 1));
+        return _mm_cvtss_f32(r);
+#else
+        return vminvq_f32(a.v);
+#endif
+    }
+    friend float ReduceMax(FloatVec a) {
+#if defined(PBRT_SIMD_AVX)
+        __m128 r = _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+#elif defined(PBRT_SIMD_SSE)
+        __m128 r = a.v;
+#endif
+#if defined(PBRT_SIMD_AVX) || defined(PBRT_SIMD_SSE)
+        r = _mm_max_ps(r, _mm_movehl_ps(r, r));
+        r = _mm_max_ss(r, _mm_shuffle_ps(r, r, 1));
+        return _mm_cvtss_f32(r);
+#else
+        return vmaxvq_f32(a.v);
+#endif
+    }
+
+    // Vector version of the scalar _FastExp()_ in util/math.h.
+    friend FloatVec FastExp(FloatVec x);
+
+    // FloatVec Public Members
+    Native v;
+};
+
+// FloatVec Inline Functions
+inline FloatVec FastExp(FloatVec x) {
+    // Compute $x'$ such that $\roman{e}^x = 2^{x'}$; arguments outside of
+    // $[-200,200]$ give 0 or infinity either way (as do NaNs, which are
+    // mapped to -200 by _Max()_), and clamping keeps the conversion to
+    // integers in range.
+    FloatVec xp = Min(Max(x * FloatVec(1.442695041f), FloatVec(-200.f)), FloatVec(200.f));
+
+    // Find integer and fractional components of $x'$ and evaluate
+    // polynomial approximation of $2^f$
+#if defined(PBRT_SIMD_AVX)
+    __m256 fxp = _mm256_floor_ps(xp.v);
+    __m256 f = _mm256_sub_ps(xp.v, fxp);
+    __m256 twoToF = _mm256_set1_ps(0.0790209f);
+#ifdef __FMA__
+    twoToF = _mm256_fmadd_ps(twoToF, f, _mm256_set1_ps(0.224131f));
+    twoToF = _mm256_fmadd_ps(twoToF, f, _mm256_set1_ps(0.696834f));
+    twoToF = _mm256_fmadd_ps(twoToF, f, _mm256_set1_ps(0.999813f));
+#else
+    twoToF = _mm256_add_ps(_mm256_mul_ps(twoToF, f), _mm256_set1_ps(0.224131f));
+    twoToF = _mm256_add_ps(_mm256_mul_ps(twoToF, f), _mm256_set1_ps(0.696834f));
+    twoToF = _mm256_add_ps(_mm256_mul_ps(twoToF, f), _mm256_set1_ps(0.999813f));
+#endif
+    // Scale $2^f$ by $2^i$, handling exponent underflow and overflow
+    __m256i bits = _mm256_castps_si256(twoToF);
+    __m256i exponent =
+        _mm256_add_epi32(_mm256_srli_epi32(bits, 23), _mm256_cvttps_epi32(fxp));
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x807fffff)),
+                           _mm256_slli_epi32(exponent, 23));
+    __m256 underflow = _mm256_castsi256_ps(
+        _mm256_cmpgt_epi32(_mm256_set1_epi32(-126 + 127), exponent));
+    __m256 overflow =
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(exponent, _mm256_set1_epi32(127 + 127)));
+    __m256 r = _mm256_andnot_ps(underflow, _mm256_castsi256_ps(bits));
+    return _mm256_blendv_ps(r, _mm256_set1_ps(Infinity), overflow);
+#elif defined(PBRT_SIMD_SSE)
+    // SSE2 has no floor instruction; truncate and correct negative values
+    __m128i i = _mm_cvttps_epi32(xp.v);
+    __m128 fxp = _mm_cvtepi32_ps(i);
+    __m128 adjust = _mm_cmpgt_ps(fxp, xp.v);
+    i = _mm_add_epi32(i, _mm_castps_si128(adjust));
+    fxp = _mm_sub_ps(fxp, _mm_and_ps(adjust, _mm_set1_ps(1.f)));
+    __m128 f = _mm_sub_ps(xp.v, fxp);
+    __m128 twoToF = _mm_set1_ps(0.0790209f);
+    twoToF = _mm_add_ps(_mm_mul_ps(twoToF, f), _mm_set1_ps(0.224131f));
+    twoToF = _mm_add_ps(_mm_mul_ps(twoToF, f), _mm_set1_ps(0.696834f));
+    twoToF = _mm_add_ps(_mm_mul_ps(twoToF, f), _mm_set1_ps(0.999813f));
+    // Scale $2^f$ by $2^i$, handling exponent underflow and overflow
+    __m128i bits = _mm_castps_si128(twoToF);
+    __m128i exponent = _mm_add_epi32(_mm_srli_epi32(bits, 23), i);
+    bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x807fffff)),
+                        _mm_slli_epi32(exponent, 23));
+    __m128 underflow =
+        _mm_castsi128_ps(_mm_cmplt_epi32(exponent, _mm_set1_epi32(-126 + 127)));
+    __m128 overflow =
+        _mm_castsi128_ps(_mm_cmpgt_epi32(exponent, _mm_set1_epi32(127 + 127)));
+    __m128 r = _mm_andnot_ps(underflow, _mm_castsi128_ps(bits));
+    return Select(overflow, FloatVec(Infinity), r);
+#else
+    float32x4_t fxp = vrndmq_f32(xp.v);
+    float32x4_t f = vsubq_f32(xp.v, fxp);
+    float32x4_t twoToF = vdupq_n_f32(0.0790209f);
+    twoToF = vfmaq_f32(vdupq_n_f32(0.224131f), twoToF, f);
+    twoToF = vfmaq_f32(vdupq_n_f32(0.696834f), twoToF, f);
+    twoToF = vfmaq_f32(vdupq_n_f32(0.999813f), twoToF, f);
+    // Scale $2^f$ by $2^i$, handling exponent underflow and overflow
+    int32x4_t bits = vreinterpretq_s32_f32(twoToF);
+    int32x4_t exponent = vaddq_s32(vshrq_n_s32(bits, 23), vcvtq_s32_f32(fxp));
+    bits = vorrq_s32(vandq_s32(bits, vdupq_n_s32(0x807fffff)), vshlq_n_s32(exponent, 23));
+    uint32x4_t underflow = vcltq_s32(exponent, vdupq_n_s32(-126 + 127));
+    uint32x4_t overflow = vcgtq_s32(exponent, vdupq_n_s32(127 + 127));
+    float32x4_t r = vreinterpretq_f32_u32(
+        vbicq_u32(vreinterpretq_u32_s32(bits), underflow));
+    return vbslq_f32(overflow, vdupq_n_f32(Infinity), r);
+#endif
+}
+
+}  // namespace pbrt
+
+#endif  // PBRT_HAVE_SIMD
+
+#endif  // PBRT_UTIL_SIMD_H
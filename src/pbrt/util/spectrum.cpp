@@ -21,6 +21,8 @@
 #include <algorithm>
 #include <cmath>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 // I don't know how this is happening (somehow via wingdi.h?), but not cool,
 // Windows, not cool...
@@ -173,6 +175,46 @@ std::string DenselySampledSpectrum::ToString() const {
     return s;
 }
 
+STAT_MEMORY_COUNTER("Memory/Redundant densely sampled spectra", redundantSpectrumBytes);
+STAT_PERCENT("Spectrum/Densely sampled spectrum cache hits", nSpectrumCacheHits,
+             nSpectrumCacheLookups);
+
+// Lights and media often end up with identical emission and scattering
+// spectra (the same blackbody temperature or named spectrum, say); densely
+// sampled spectra are stored once per allocator and shared.
+static std::mutex denselySampledSpectrumMutex;
+using DenselySampledSpectrumEntry =
+    std::pair<pstd::pmr::memory_resource *, const DenselySampledSpectrum *>;
+static std::unordered_multimap<uint64_t, DenselySampledSpectrumEntry>
+    denselySampledSpectrumCache;
+
+const DenselySampledSpectrum *LookupDenselySampledSpectrum(SpectrumHandle spec,
+                                                           Allocator alloc) {
+    DenselySampledSpectrum s(spec);
+    uint64_t hash = s.Hash();
+    ++nSpectrumCacheLookups;
+    std::lock_guard<std::mutex> lock(denselySampledSpectrumMutex);
+    auto &cache = denselySampledSpectrumCache;
+    auto range = cache.equal_range(hash);
+    for (auto iter = range.first; iter != range.second; ++iter)
+        if (iter->second.first == alloc.resource() && *iter->second.second == s) {
+            ++nSpectrumCacheHits;
+            redundantSpectrumBytes += sizeof(DenselySampledSpectrum) +
+                                      (Lambda_max - Lambda_min + 1) * sizeof(Float);
+            return iter->second.second;
+        }
+
+    const DenselySampledSpectrum *d =
+        alloc.new_object<DenselySampledSpectrum>(SpectrumHandle(&s), alloc);
+    cache.emplace(hash, DenselySampledSpectrumEntry(alloc.resource(), d));
+    return d;
+}
+
+void ClearDenselySampledSpectrumCache() {
+    std::lock_guard<std::mutex> lock(denselySampledSpectrumMutex);
+    denselySampledSpectrumCache.clear();
+}
+
 std::string SampledWavelengths::ToString() const {
     std::string r = "[";
     for (size_t i = 0; i < lambda.size(); ++i)
@@ -14,9 +14,11 @@
 #include <pbrt/util/check.h>
 #include <pbrt/util/color.h>
 #include <pbrt/util/float.h>
+#include <pbrt/util/hash.h>
 #include <pbrt/util/math.h>
 #include <pbrt/util/pstd.h>
 #include <pbrt/util/sampling.h>
+#include <pbrt/util/simd.h>
 #include <pbrt/util/taggedptr.h>
 
 #include <cmath>
@@ -30,7 +32,20 @@ namespace pbrt {
 // Spectrum Constants
 constexpr Float Lambda_min = 360, Lambda_max = 830;
 
+// The number of wavelengths carried by each camera path can be set at
+// build time via PBRT_SPECTRUM_SAMPLES; more wavelengths reduce color
+// noise, especially in scenes with dispersion.
+#ifdef PBRT_SPECTRUM_SAMPLES
+static constexpr int NSpectrumSamples = PBRT_SPECTRUM_SAMPLES;
+#else
 static constexpr int NSpectrumSamples = 4;
+#endif
+static_assert(NSpectrumSamples == 4 || NSpectrumSamples == 8 || NSpectrumSamples == 16,
+              "NSpectrumSamples must be 4, 8, or 16");
+#ifdef PBRT_HAVE_SIMD
+static_assert(NSpectrumSamples % FloatVec::Width == 0,
+              "NSpectrumSamples must be a multiple of the SIMD width");
+#endif
 
 static constexpr Float CIE_Y_integral = 106.856895;
 static constexpr Float K_m = 683;
@@ -96,8 +111,13 @@ class SampledSpectrum {
 
     PBRT_CPU_GPU
     SampledSpectrum &operator-=(const SampledSpectrum &s) {
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (Lanes(i) - s.Lanes(i)).Store(&values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             values[i] -= s.values[i];
+#endif
         return *this;
     }
     PBRT_CPU_GPU
@@ -109,15 +129,25 @@ class SampledSpectrum {
     friend SampledSpectrum operator-(Float a, const SampledSpectrum &s) {
         DCHECK(!IsNaN(a));
         SampledSpectrum ret;
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (FloatVec(a) - s.Lanes(i)).Store(&ret.values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             ret.values[i] = a - s.values[i];
+#endif
         return ret;
     }
 
     PBRT_CPU_GPU
     SampledSpectrum &operator*=(const SampledSpectrum &s) {
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (Lanes(i) * s.Lanes(i)).Store(&values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             values[i] *= s.values[i];
+#endif
         return *this;
     }
     PBRT_CPU_GPU
@@ -127,17 +157,19 @@ class SampledSpectrum {
     }
     PBRT_CPU_GPU
     SampledSpectrum operator*(Float a) const {
-        DCHECK(!IsNaN(a));
         SampledSpectrum ret = *this;
-        for (int i = 0; i < NSpectrumSamples; ++i)
-            ret.values[i] *= a;
-        return ret;
+        return ret *= a;
     }
     PBRT_CPU_GPU
     SampledSpectrum &operator*=(Float a) {
         DCHECK(!IsNaN(a));
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (Lanes(i) * FloatVec(a)).Store(&values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             values[i] *= a;
+#endif
         return *this;
     }
     PBRT_CPU_GPU
@@ -145,10 +177,17 @@ class SampledSpectrum {
 
     PBRT_CPU_GPU
     SampledSpectrum &operator/=(const SampledSpectrum &s) {
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; ++i)
+            DCHECK_NE(0, s.values[i]);
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (Lanes(i) / s.Lanes(i)).Store(&values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i) {
             DCHECK_NE(0, s.values[i]);
             values[i] /= s.values[i];
         }
+#endif
         return *this;
     }
     PBRT_CPU_GPU
@@ -160,8 +199,13 @@ class SampledSpectrum {
     SampledSpectrum &operator/=(Float a) {
         DCHECK_NE(a, 0);
         DCHECK(!IsNaN(a));
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (Lanes(i) / FloatVec(a)).Store(&values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             values[i] /= a;
+#endif
         return *this;
     }
     PBRT_CPU_GPU
@@ -173,8 +217,13 @@ class SampledSpectrum {
     PBRT_CPU_GPU
     SampledSpectrum operator-() const {
         SampledSpectrum ret;
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (FloatVec(-0.f) - Lanes(i)).Store(&ret.values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             ret.values[i] = -values[i];
+#endif
         return ret;
     }
     PBRT_CPU_GPU
@@ -186,10 +235,17 @@ class SampledSpectrum {
 
     PBRT_CPU_GPU
     bool HasNaNs() const {
+#ifdef PBRT_HAVE_SIMD
+        FloatVec nan = IsNaN(Lanes(0));
+        for (int i = FloatVec::Width; i < NSpectrumSamples; i += FloatVec::Width)
+            nan = nan | IsNaN(Lanes(i));
+        return Any(nan);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             if (IsNaN(values[i]))
                 return true;
         return false;
+#endif
     }
 
     PBRT_CPU_GPU
@@ -222,45 +278,83 @@ class SampledSpectrum {
 
     PBRT_CPU_GPU
     explicit operator bool() const {
+#ifdef PBRT_HAVE_SIMD
+        FloatVec nonZero = NotEqual(Lanes(0), FloatVec(0.f));
+        for (int i = FloatVec::Width; i < NSpectrumSamples; i += FloatVec::Width)
+            nonZero = nonZero | NotEqual(Lanes(i), FloatVec(0.f));
+        return Any(nonZero);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             if (values[i] != 0)
                 return true;
         return false;
+#endif
     }
 
     PBRT_CPU_GPU
     SampledSpectrum &operator+=(const SampledSpectrum &s) {
+#ifdef PBRT_HAVE_SIMD
+        for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+            (Lanes(i) + s.Lanes(i)).Store(&values[i]);
+#else
         for (int i = 0; i < NSpectrumSamples; ++i)
             values[i] += s.values[i];
+#endif
         return *this;
     }
 
     PBRT_CPU_GPU
     Float MinComponentValue() const {
+#ifdef PBRT_HAVE_SIMD
+        FloatVec m = Lanes(0);
+        for (int i = FloatVec::Width; i < NSpectrumSamples; i += FloatVec::Width)
+            m = Min(m, Lanes(i));
+        return ReduceMin(m);
+#else
         Float m = values[0];
         for (int i = 1; i < NSpectrumSamples; ++i)
             m = std::min(m, values[i]);
         return m;
+#endif
     }
     PBRT_CPU_GPU
     Float MaxComponentValue() const {
+#ifdef PBRT_HAVE_SIMD
+        FloatVec m = Lanes(0);
+        for (int i = FloatVec::Width; i < NSpectrumSamples; i += FloatVec::Width)
+            m = Max(m, Lanes(i));
+        return ReduceMax(m);
+#else
         Float m = values[0];
         for (int i = 1; i < NSpectrumSamples; ++i)
             m = std::max(m, values[i]);
         return m;
+#endif
     }
     PBRT_CPU_GPU
     Float Average() const {
+#ifdef PBRT_HAVE_SIMD
+        FloatVec sum = Lanes(0);
+        for (int i = FloatVec::Width; i < NSpectrumSamples; i += FloatVec::Width)
+            sum = sum + Lanes(i);
+        return ReduceAdd(sum) / NSpectrumSamples;
+#else
         Float sum = values[0];
         for (int i = 1; i < NSpectrumSamples; ++i)
             sum += values[i];
         return sum / NSpectrumSamples;
+#endif
     }
 
+#ifdef PBRT_HAVE_SIMD
+    // Returns the _FloatVec::Width_ samples starting at the _i_th one.
+    FloatVec Lanes(int i) const { return FloatVec::Load(&values[i]); }
+#endif
+
   private:
     friend class SOA<SampledSpectrum>;
     // SampledSpectrum Private Members
-    pstd::array<Float, NSpectrumSamples> values;
+    alignas(16) pstd::array<Float, NSpectrumSamples> values;
 };
 
 // SampledWavelengths Definitions
@@ -428,12 +522,29 @@ class DenselySampledSpectrum {
         return values[offset];
     }
 
+    bool operator==(const DenselySampledSpectrum &d) const {
+        return lambda_min == d.lambda_min && lambda_max == d.lambda_max &&
+               std::equal(values.begin(), values.end(), d.values.begin());
+    }
+    uint64_t Hash() const {
+        return HashBuffer(values.data(), values.size() * sizeof(Float), lambda_min);
+    }
+
   private:
     // DenselySampledSpectrum Private Members
     int lambda_min, lambda_max;
     pstd::vector<Float> values;
 };
 
+// Returns a _DenselySampledSpectrum_ with the values of _spec_ that is
+// shared with all other callers that pass spectra with the same values.
+const DenselySampledSpectrum *LookupDenselySampledSpectrum(SpectrumHandle spec,
+                                                           Allocator alloc);
+// Forgets the spectra returned by _LookupDenselySampledSpectrum()_. This
+// must be called before the memory resources that they were allocated from
+// are released, since a later one may be allocated at the same address.
+void ClearDenselySampledSpectrumCache();
+
 class PiecewiseLinearSpectrum {
   public:
     // PiecewiseLinearSpectrum Public Methods
@@ -573,8 +684,17 @@ class RGBIlluminantSpectrum {
 PBRT_CPU_GPU
 inline SampledSpectrum SafeDiv(const SampledSpectrum &s1, const SampledSpectrum &s2) {
     SampledSpectrum r;
+#ifdef PBRT_HAVE_SIMD
+    // Divide by one where _s2_ is zero and then mask those samples to zero
+    for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width) {
+        FloatVec nonZero = NotEqual(s2.Lanes(i), FloatVec(0.f));
+        FloatVec d = Select(nonZero, s2.Lanes(i), FloatVec(1.f));
+        ((s1.Lanes(i) / d) & nonZero).Store(&r[i]);
+    }
+#else
     for (int i = 0; i < NSpectrumSamples; ++i)
         r[i] = (s2[i] != 0) ? s1[i] / s2[i] : 0.;
+#endif
     return r;
 }
 
@@ -590,8 +710,13 @@ PBRT_CPU_GPU inline SampledSpectrum Clamp(const SampledSpectrum &s, U low, V hig
 PBRT_CPU_GPU
 inline SampledSpectrum ClampZero(const SampledSpectrum &s) {
     SampledSpectrum ret;
+#ifdef PBRT_HAVE_SIMD
+    for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+        Max(s.Lanes(i), FloatVec(0.f)).Store(&ret[i]);
+#else
     for (int i = 0; i < NSpectrumSamples; ++i)
         ret[i] = std::max<Float>(0, s[i]);
+#endif
     DCHECK(!ret.HasNaNs());
     return ret;
 }
@@ -599,8 +724,13 @@ inline SampledSpectrum ClampZero(const SampledSpectrum &s) {
 PBRT_CPU_GPU
 inline SampledSpectrum Sqrt(const SampledSpectrum &s) {
     SampledSpectrum ret;
+#ifdef PBRT_HAVE_SIMD
+    for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+        Sqrt(s.Lanes(i)).Store(&ret[i]);
+#else
     for (int i = 0; i < NSpectrumSamples; ++i)
         ret[i] = std::sqrt(s[i]);
+#endif
     DCHECK(!ret.HasNaNs());
     return ret;
 }
@@ -634,8 +764,13 @@ inline SampledSpectrum Exp(const SampledSpectrum &s) {
 PBRT_CPU_GPU
 inline SampledSpectrum FastExp(const SampledSpectrum &s) {
     SampledSpectrum ret;
+#ifdef PBRT_HAVE_SIMD
+    for (int i = 0; i < NSpectrumSamples; i += FloatVec::Width)
+        FastExp(s.Lanes(i)).Store(&ret[i]);
+#else
     for (int i = 0; i < NSpectrumSamples; ++i)
         ret[i] = FastExp(s[i]);
+#endif
     DCHECK(!ret.HasNaNs());
     return ret;
 }
@@ -13,6 +13,7 @@
 #include <pbrt/util/spectrum.h>
 
 #include <array>
+#include <limits>
 
 using namespace pbrt;
 
@@ -115,6 +116,67 @@ TEST(Spectrum, MaxValue) {
     }
 }
 
+TEST(Spectrum, DenselySampledLookup) {
+    Allocator alloc;
+    BlackbodySpectrum bb1(5000), bb2(5000), bb3(6500);
+    const DenselySampledSpectrum *d1 = LookupDenselySampledSpectrum(&bb1, alloc);
+    const DenselySampledSpectrum *d2 = LookupDenselySampledSpectrum(&bb2, alloc);
+    const DenselySampledSpectrum *d3 = LookupDenselySampledSpectrum(&bb3, alloc);
+    EXPECT_EQ(d1, d2);
+    EXPECT_NE(d1, d3);
+    for (Float lambda = 360; lambda < 830; lambda += 1.5)
+        EXPECT_EQ(DenselySampledSpectrum(&bb3)(lambda), (*d3)(lambda));
+
+    // A distinct but equal spectrum should also be shared.
+    ConstantSpectrum c(1.5);
+    DenselySampledSpectrum dc(&c);
+    EXPECT_EQ(LookupDenselySampledSpectrum(&c, alloc),
+              LookupDenselySampledSpectrum(&dc, alloc));
+
+    // Spectra looked up before the cache is cleared are no longer returned.
+    ClearDenselySampledSpectrumCache();
+    EXPECT_NE(d1, LookupDenselySampledSpectrum(&bb1, alloc));
+}
+
+TEST(SampledSpectrum, Operations) {
+    // Check the (possibly SIMD) SampledSpectrum operations against
+    // per-sample computations.
+    RNG rng;
+    for (int iter = 0; iter < 100; ++iter) {
+        SampledSpectrum a, b;
+        for (int i = 0; i < NSpectrumSamples; ++i) {
+            a[i] = -5 + 10 * rng.Uniform<Float>();
+            b[i] = (i == iter % NSpectrumSamples) ? 0 : rng.Uniform<Float>();
+        }
+
+        SampledSpectrum sum = a + b, diff = 2 - a, prod = a * b * 3, neg = -a;
+        SampledSpectrum div = SafeDiv(a, b), clamped = ClampZero(a), e = FastExp(a);
+        Float minValue = a[0], maxValue = a[0], avg = 0;
+        for (int i = 0; i < NSpectrumSamples; ++i) {
+            EXPECT_EQ(a[i] + b[i], sum[i]);
+            EXPECT_EQ(2 - a[i], diff[i]);
+            EXPECT_EQ(a[i] * b[i] * 3, prod[i]);
+            EXPECT_EQ(-a[i], neg[i]);
+            EXPECT_EQ(b[i] != 0 ? a[i] / b[i] : 0, div[i]);
+            EXPECT_EQ(std::max<Float>(0, a[i]), clamped[i]);
+            EXPECT_LE(std::abs(e[i] - FastExp(a[i])), 1e-6f * FastExp(a[i]));
+            minValue = std::min(minValue, a[i]);
+            maxValue = std::max(maxValue, a[i]);
+            avg += a[i] / NSpectrumSamples;
+        }
+        EXPECT_EQ(minValue, a.MinComponentValue());
+        EXPECT_EQ(maxValue, a.MaxComponentValue());
+        EXPECT_NEAR(avg, a.Average(), 1e-5f);
+
+        EXPECT_TRUE(bool(a));
+        EXPECT_FALSE(a.HasNaNs());
+        SampledSpectrum z(0.f);
+        EXPECT_FALSE(bool(z));
+        z[iter % NSpectrumSamples] = std::numeric_limits<Float>::quiet_NaN();
+        EXPECT_TRUE(z.HasNaNs());
+    }
+}
+
 TEST(Spectrum, SamplingPdfY) {
     // Make sure we can integrate the y matching curve correctly
     Float ysum = 0;
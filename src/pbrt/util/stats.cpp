@@ -44,6 +44,8 @@ static StatsAccumulator statsAccumulator;
 static Bounds2i imageBounds;
 std::string pixelStatsBaseName;
 
+thread_local PixelCostCounters threadPixelCost;
+
 // Statistics Function Definitions
 void ReportThreadStats() {
     static std::mutex mutex;
@@ -189,6 +191,7 @@ struct StatsAccumulator::Stats {
     std::map<std::string, Distribution<double>> floatDistributions;
     std::map<std::string, std::pair<int64_t, int64_t>> percentages;
     std::map<std::string, std::pair<int64_t, int64_t>> ratios;
+    std::map<std::string, double> timers;
     struct RareCheck {
         RareCheck(Float f = 0) : maxFrequency(f) {}
         Float maxFrequency;
@@ -226,6 +229,10 @@ void StatsAccumulator::ReportRatio(const char *name, int64_t num, int64_t denom)
     stats->ratios[name].second += denom;
 }
 
+void StatsAccumulator::ReportTimer(const char *name, double seconds) {
+    stats->timers[name] += seconds;
+}
+
 void StatsAccumulator::ReportRareCheck(const char *condition, Float maxFrequency,
                                        int64_t numTrue, int64_t total) {
     if (stats->rareChecks.find(condition) == stats->rareChecks.end())
@@ -432,6 +439,14 @@ void StatsAccumulator::Print(FILE *dest) {
             StringPrintf("%-42s%12" PRIu64 " / %12" PRIu64 " (%.2fx)", title, num, denom,
                          (double)num / (double)denom));
     }
+    for (auto &timer : stats->timers) {
+        if (timer.second == 0)
+            continue;
+        std::string category, title;
+        getCategoryAndTitle(timer.first, &category, &title);
+        toPrint[category].push_back(
+            StringPrintf("%-42s                  %9.3f s", title, timer.second));
+    }
 
     for (auto &categories : toPrint) {
         fprintf(dest, "  %s\n", categories.first.c_str());
@@ -508,6 +523,7 @@ void StatsAccumulator::Clear() {
     stats->floatDistributions.clear();
     stats->percentages.clear();
     stats->ratios.clear();
+    stats->timers.clear();
 }
 
 }  // namespace pbrt
@@ -32,6 +32,16 @@ void StatsEnablePixelStats(const Bounds2i &b, const std::string &baseName);
 void StatsReportPixelStart(const Point2i &p);
 void StatsReportPixelEnd(const Point2i &p);
 
+// PixelCostCounters Definition
+// Running per-thread totals of work done while rendering. They are cheap
+// enough to update unconditionally; --pixelcost reads them before and after
+// each pixel is rendered to find its cost.
+struct PixelCostCounters {
+    int64_t closestHitRays = 0, shadowRays = 0, bvhNodesVisited = 0;
+};
+
+extern thread_local PixelCostCounters threadPixelCost;
+
 void PrintStats(FILE *dest);
 void StatsWritePixelImages();
 bool PrintCheckRare(FILE *dest);
@@ -48,6 +58,7 @@ class StatsAccumulator {
     void ReportMemoryCounter(const char *name, int64_t val);
     void ReportPercentage(const char *name, int64_t num, int64_t denom);
     void ReportRatio(const char *name, int64_t num, int64_t denom);
+    void ReportTimer(const char *name, double seconds);
     void ReportRareCheck(const char *condition, float maxFrequency, int64_t numTrue,
                          int64_t total);
 
@@ -159,6 +170,14 @@ class PixelStatsAccumulator {
         denomVar = 0;                                                     \
     });
 
+// Accumulates wall-clock time in seconds, e.g. from a _Timer_.
+#define STAT_TIMER(title, var)                                         \
+    static thread_local double var;                                    \
+    static StatRegisterer STATS_REG##var([](StatsAccumulator &accum) { \
+        accum.ReportTimer(title, var);                                 \
+        var = 0;                                                       \
+    });
+
 #define STAT_PIXEL_RATIO(title, numVar, denomVar)                                     \
     static thread_local int64_t numVar, numVar##Sum, denomVar, denomVar##Sum;         \
     static StatRegisterer STATS_REG##numVar##denomVar(                                \
@@ -0,0 +1,42 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#ifndef PBRT_UTIL_TESTIMAGES_H
+#define PBRT_UTIL_TESTIMAGES_H
+
+// Images used by the unit tests of the texture and image utilities.
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/color.h>
+#include <pbrt/util/image.h>
+#include <pbrt/util/rng.h>
+
+#include <string>
+#include <vector>
+
+namespace pbrt {
+
+// Returns the names of the first _nChannels_ of R, G, B, and A.
+inline std::vector<std::string> RGBAChannelNames(int nChannels) {
+    std::vector<std::string> names = {"R", "G", "B", "A"};
+    names.resize(nChannels);
+    return names;
+}
+
+// Returns an sRGB-encoded image with uniformly distributed channel values.
+inline Image RandomImage(PixelFormat format, Point2i res, int nChannels,
+                         uint64_t seed = 0) {
+    Image image(format, res, RGBAChannelNames(nChannels), ColorEncodingHandle::sRGB);
+    RNG rng(seed);
+    for (int y = 0; y < res.y; ++y)
+        for (int x = 0; x < res.x; ++x)
+            for (int c = 0; c < nChannels; ++c)
+                image.SetChannel({x, y}, c, rng.Uniform<Float>());
+    return image;
+}
+
+}  // namespace pbrt
+
+#endif  // PBRT_UTIL_TESTIMAGES_H
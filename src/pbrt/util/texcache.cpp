@@ -0,0 +1,563 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <pbrt/util/texcache.h>
+
+#include <pbrt/util/color.h>
+#include <pbrt/util/colorspace.h>
+#include <pbrt/util/error.h>
+#include <pbrt/util/float.h>
+#include <pbrt/util/math.h>
+#include <pbrt/util/parallel.h>
+#include <pbrt/util/print.h>
+#include <pbrt/util/stats.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#ifdef PBRT_HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+namespace pbrt {
+
+STAT_PERCENT("Texture/Tile cache hits", nTileCacheHits, nTileCacheLookups);
+STAT_COUNTER("Texture/Tile cache misses", nTileCacheMisses);
+STAT_COUNTER("Texture/Tile cache evictions", nTileCacheEvictions);
+STAT_MEMORY_COUNTER("Memory/Texture tile cache", tileCacheBytes);
+
+// TextureTileCache Global Definitions
+TextureTileCache *textureTileCache;
+
+void InitTextureTileCache(size_t maxBytes) {
+    CHECK(textureTileCache == nullptr);
+    textureTileCache = new TextureTileCache(maxBytes);
+}
+
+// TextureTileCache Method Definitions
+TextureTileCache::TextureTileCache(size_t maxBytes) {
+    // Allow enough slots so that every thread can be loading a tile while
+    // there are still resident tiles available for reclamation.
+    nSlots = std::max<size_t>(maxBytes / SlotBytes, 4 * RunningThreads() + 16);
+    slots = std::make_unique<Slot[]>(nSlots);
+}
+
+TextureTileCache::~TextureTileCache() {
+    for (size_t i = 0; i < nSlotsAllocated; ++i)
+        delete[] slots[i].data;
+}
+
+void TextureTileCache::Load(std::atomic<int> *entry, uint64_t tileId,
+                            const std::function<void(uint8_t *)> &loadTile) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Return if another thread has loaded the tile or is loading it
+    if (int slotIndex = entry->load(std::memory_order_relaxed);
+        slotIndex != NotResident) {
+        lock.unlock();
+        if (slotIndex == Loading)
+            std::this_thread::yield();
+        return;
+    }
+    ++nTileCacheMisses;
+
+    // Claim a slot for the tile, evicting its current tile if necessary
+    int slotIndex;
+    if (nSlotsAllocated < nSlots) {
+        slotIndex = nSlotsAllocated++;
+        slots[slotIndex].data = new uint8_t[SlotBytes];
+        tileCacheBytes += SlotBytes;
+    } else
+        slotIndex = ReclaimSlot();
+    Slot &slot = slots[slotIndex];
+    if (slot.entry)
+        slot.entry->store(NotResident, std::memory_order_relaxed);
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.tileId.store(tileId, std::memory_order_relaxed);
+    slot.referenced.store(true, std::memory_order_relaxed);
+    slot.entry = entry;
+    entry->store(Loading, std::memory_order_relaxed);
+    lock.unlock();
+
+    // Read the tile's contents and make it available to lookups
+    loadTile(slot.data);
+    slot.seq.store(seq + 2, std::memory_order_release);
+    entry->store(slotIndex, std::memory_order_release);
+}
+
+void TextureTileCache::Release(std::atomic<int> *entries, size_t n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < nSlotsAllocated; ++i)
+        if (slots[i].entry >= entries && slots[i].entry < entries + n)
+            slots[i].entry = nullptr;
+}
+
+int TextureTileCache::ReclaimSlot() {
+    // Advance the clock hand until reaching a slot that hasn't been used
+    // since it was last passed over and isn't currently being loaded
+    while (true) {
+        int slotIndex = clockHand;
+        clockHand = (clockHand + 1) % nSlots;
+        Slot &slot = slots[slotIndex];
+        if (slot.seq.load(std::memory_order_relaxed) & 1)
+            continue;
+        if (slot.referenced.exchange(false, std::memory_order_relaxed))
+            continue;
+        ++nTileCacheEvictions;
+        return slotIndex;
+    }
+}
+
+std::string TextureTileCache::ToString() const {
+    return StringPrintf("[ TextureTileCache nSlots: %d nSlotsAllocated: %d ]", nSlots,
+                        nSlotsAllocated);
+}
+
+// TiledImagePyramid File Definitions
+// Tiled MIP files start with a _TiledFileHeader_; the tiles of the levels
+// that are larger than a tile follow, starting at a page-aligned offset,
+// and then the remaining levels are stored as consecutive scanlines.
+static constexpr char TiledFileMagic[8] = {'p', 'b', 'r', 't', 'M', 'I', 'P', '\n'};
+static constexpr int TiledFileVersion = 1;
+static constexpr int MaxTiledFileLevels = 32;
+
+struct TiledFileHeader {
+    char magic[8];
+    int32_t version;
+    int32_t format, nChannels;
+    int32_t tileResolution[2];
+    int32_t wrapMode;
+    float colorSpacePrimaries[8];
+    char encoding[32];
+    char channelNames[4][32];
+    int32_t nLevels;
+    int32_t levelResolution[MaxTiledFileLevels][2];
+    int64_t tileDataOffset;
+};
+
+// Writes the tiles of _image_ to _file_ in scanline order, padding partial
+// tiles at the image's edges with zeros.
+static int64_t WriteTiles(const Image &image, Point2i tileRes, FILE *file) {
+    Point2i res = image.Resolution();
+    int texelBytes = image.NChannels() * TexelBytes(image.Format());
+    int nTilesX = (res.x + tileRes.x - 1) / tileRes.x;
+    int nTilesY = (res.y + tileRes.y - 1) / tileRes.y;
+    std::vector<uint8_t> tileData(size_t(tileRes.x) * tileRes.y * texelBytes);
+    for (int ty = 0; ty < nTilesY; ++ty)
+        for (int tx = 0; tx < nTilesX; ++tx) {
+            std::fill(tileData.begin(), tileData.end(), 0);
+            int x0 = tx * tileRes.x, x1 = std::min(x0 + tileRes.x, res.x);
+            int y0 = ty * tileRes.y, y1 = std::min(y0 + tileRes.y, res.y);
+            for (int y = y0; y < y1; ++y)
+                std::memcpy(&tileData[size_t(y - y0) * tileRes.x * texelBytes],
+                            image.RawPointer({x0, y}), size_t(x1 - x0) * texelBytes);
+            if (fwrite(tileData.data(), 1, tileData.size(), file) != tileData.size())
+                return -1;
+        }
+    return int64_t(nTilesX) * nTilesY;
+}
+
+static bool IsTiledLevel(Point2i res, Point2i tileRes) {
+    return res.x > tileRes.x || res.y > tileRes.y;
+}
+
+// TiledImagePyramid Method Definitions
+TiledImagePyramid::TiledImagePyramid(PixelFormat format,
+                                     std::vector<std::string> channelNames,
+                                     ColorEncodingHandle encoding,
+                                     TextureTileCache *cache, Allocator alloc)
+    : format(format),
+      channelNames(std::move(channelNames)),
+      nChannels(this->channelNames.size()),
+      texelBytes(nChannels * TexelBytes(format)),
+      encoding(encoding),
+      tileResolution(TileResolution(format, nChannels)),
+      tileBytes(size_t(tileResolution.x) * tileResolution.y * texelBytes),
+      levels(alloc),
+      tail(alloc),
+      cache(cache) {
+    CHECK(nChannels >= 1 && nChannels <= 4);
+    CHECK_LE(tileBytes, TextureTileCache::SlotBytes);
+}
+
+TiledImagePyramid::~TiledImagePyramid() {
+    if (tileSlots)
+        cache->Release(tileSlots.get(), nTiles);
+    if (file)
+        fclose(file);
+#ifdef PBRT_HAVE_MMAP
+    if (mappedFile)
+        munmap((void *)mappedFile, mappedFileLength);
+#endif
+}
+
+Point2i TiledImagePyramid::TileResolution(PixelFormat format, int nChannels) {
+    // Use the largest power-of-two number of texels that fits in a cache
+    // slot, with tiles no more than twice as wide as they are tall
+    int log2Texels =
+        Log2Int(uint64_t(TextureTileCache::SlotBytes / (nChannels * TexelBytes(format))));
+    return Point2i(1 << ((log2Texels + 1) / 2), 1 << (log2Texels / 2));
+}
+
+TiledImagePyramid *TiledImagePyramid::Create(pstd::vector<Image> pyramid,
+                                             TextureTileCache *cache,
+                                             Allocator alloc) {
+    CHECK(!pyramid.empty());
+    TiledImagePyramid *tp = alloc.new_object<TiledImagePyramid>(
+        pyramid[0].Format(), pyramid[0].ChannelNames(), pyramid[0].Encoding(), cache,
+        alloc);
+    Point2i tileRes = tp->tileResolution;
+
+    for (Image &image : pyramid) {
+        Point2i res = image.Resolution();
+        if (!IsTiledLevel(res, tileRes)) {
+            // Keep levels that fit in a single tile in memory
+            tp->tail.push_back(std::move(image));
+            continue;
+        }
+        CHECK(tp->tail.empty());
+
+        // Write tiles for the level to the backing file
+        if (!tp->file && !(tp->file = tmpfile()))
+            ErrorExit("Unable to create texture tile file: %s", ErrorString());
+        tp->levels.push_back(Level{res, (res.x + tileRes.x - 1) / tileRes.x, tp->nTiles});
+        int64_t nLevelTiles = WriteTiles(image, tileRes, tp->file);
+        if (nLevelTiles < 0)
+            ErrorExit("Unable to write texture tile file: %s", ErrorString());
+        tp->nTiles += nLevelTiles;
+        image = Image();
+    }
+    tp->nTiledLevels = tp->levels.size();
+    if (tp->file && fflush(tp->file) != 0)
+        ErrorExit("Unable to write texture tile file: %s", ErrorString());
+
+    tp->AllocateTileTable();
+    return tp;
+}
+
+void TiledImagePyramid::AllocateTileTable() {
+    if (!cache)
+        return;
+    firstTileId = cache->AllocateTileIds(nTiles);
+    tileSlots = std::make_unique<std::atomic<int>[]>(nTiles);
+    for (int64_t i = 0; i < nTiles; ++i)
+        tileSlots[i].store(TextureTileCache::NotResident, std::memory_order_relaxed);
+}
+
+bool TiledImagePyramid::IsTiledFile(const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+    char magic[sizeof(TiledFileMagic)];
+    bool isTiled = fread(magic, sizeof(magic), 1, f) == 1 &&
+                   std::memcmp(magic, TiledFileMagic, sizeof(magic)) == 0;
+    fclose(f);
+    return isTiled;
+}
+
+void TiledImagePyramid::WriteFile(const std::string &filename,
+                                  const pstd::vector<Image> &pyramid,
+                                  const std::string &encoding,
+                                  const RGBColorSpace *colorSpace, WrapMode wrapMode) {
+    CHECK(!pyramid.empty());
+    const Image &image = pyramid[0];
+    std::vector<std::string> channelNames = image.ChannelNames();
+    if (image.NChannels() > 4)
+        ErrorExit("%s: tiled MIP files support at most four channels.", filename);
+    if (pyramid.size() > MaxTiledFileLevels)
+        ErrorExit("%s: too many MIP levels for tiled MIP file.", filename);
+    if (encoding.size() >= sizeof(TiledFileHeader::encoding))
+        ErrorExit("%s: color encoding name too long.", encoding);
+
+    // Initialize _TiledFileHeader_ for _pyramid_
+    TiledFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TiledFileMagic, sizeof(header.magic));
+    header.version = TiledFileVersion;
+    header.format = int32_t(image.Format());
+    header.nChannels = image.NChannels();
+    Point2i tileRes = TileResolution(image.Format(), image.NChannels());
+    header.tileResolution[0] = tileRes.x;
+    header.tileResolution[1] = tileRes.y;
+    header.wrapMode = int32_t(wrapMode);
+    Point2f primaries[4] = {colorSpace->r, colorSpace->g, colorSpace->b, colorSpace->w};
+    for (int i = 0; i < 4; ++i) {
+        header.colorSpacePrimaries[2 * i] = primaries[i].x;
+        header.colorSpacePrimaries[2 * i + 1] = primaries[i].y;
+    }
+    std::strncpy(header.encoding, encoding.c_str(), sizeof(header.encoding) - 1);
+    for (int c = 0; c < image.NChannels(); ++c)
+        std::strncpy(header.channelNames[c], channelNames[c].c_str(),
+                     sizeof(header.channelNames[c]) - 1);
+    header.nLevels = pyramid.size();
+    for (size_t i = 0; i < pyramid.size(); ++i) {
+        header.levelResolution[i][0] = pyramid[i].Resolution().x;
+        header.levelResolution[i][1] = pyramid[i].Resolution().y;
+    }
+    header.tileDataOffset = std::max<int64_t>(4096, RoundUpPow2(int64_t(sizeof(header))));
+
+    // Write header, tiled levels, and then the remaining levels
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+        ErrorExit("%s: %s", filename, ErrorString());
+    std::vector<uint8_t> padding(header.tileDataOffset - sizeof(header), 0);
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(padding.data(), 1, padding.size(), f) == padding.size();
+    for (const Image &level : pyramid)
+        if (ok && IsTiledLevel(level.Resolution(), tileRes))
+            ok = WriteTiles(level, tileRes, f) >= 0;
+    for (const Image &level : pyramid)
+        if (ok && !IsTiledLevel(level.Resolution(), tileRes)) {
+            size_t levelBytes = level.BytesUsed();
+            ok = fwrite(level.RawPointer({0, 0}), 1, levelBytes, f) == levelBytes;
+        }
+    if (fclose(f) != 0 || !ok)
+        ErrorExit("%s: %s", filename, ErrorString());
+}
+
+TiledImagePyramid *TiledImagePyramid::Read(const std::string &filename,
+                                           TextureTileCache *cache, Allocator alloc,
+                                           const RGBColorSpace **colorSpace,
+                                           WrapMode *wrapMode) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        ErrorExit("%s: %s", filename, ErrorString());
+
+    // Read and validate _TiledFileHeader_
+    TiledFileHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        std::memcmp(header.magic, TiledFileMagic, sizeof(header.magic)) != 0)
+        ErrorExit("%s: not a tiled MIP file.", filename);
+    if (header.version != TiledFileVersion)
+        ErrorExit("%s: tiled MIP file version %d is not supported. Please recreate it "
+                  "with \"imgtool makemip\".",
+                  filename, header.version);
+    PixelFormat format = PixelFormat(header.format);
+    if (!Is8Bit(format) && !Is16Bit(format) && !Is32Bit(format))
+        ErrorExit("%s: invalid pixel format in tiled MIP file.", filename);
+    if (header.nChannels < 1 || header.nChannels > 4 || header.nLevels < 1 ||
+        header.nLevels > MaxTiledFileLevels)
+        ErrorExit("%s: corrupt tiled MIP file.", filename);
+    if (Point2i(header.tileResolution[0], header.tileResolution[1]) !=
+        TileResolution(format, header.nChannels))
+        ErrorExit("%s: tiled MIP file has incompatible tile size. Please recreate it "
+                  "with \"imgtool makemip\".",
+                  filename);
+    header.encoding[sizeof(header.encoding) - 1] = '\0';
+    std::vector<std::string> channelNames;
+    for (int c = 0; c < header.nChannels; ++c) {
+        header.channelNames[c][sizeof(header.channelNames[c]) - 1] = '\0';
+        channelNames.push_back(header.channelNames[c]);
+    }
+
+    // Return color space and wrap mode used to create the file
+    const float *p = header.colorSpacePrimaries;
+    *colorSpace = RGBColorSpace::Lookup(Point2f(p[0], p[1]), Point2f(p[2], p[3]),
+                                        Point2f(p[4], p[5]), Point2f(p[6], p[7]));
+    if (!*colorSpace) {
+        Warning("%s: unknown color space in tiled MIP file. Using sRGB.", filename);
+        *colorSpace = RGBColorSpace::sRGB;
+    }
+    *wrapMode = WrapMode(header.wrapMode);
+
+    // Initialize _TiledImagePyramid_ levels from the header
+    TiledImagePyramid *tp = alloc.new_object<TiledImagePyramid>(
+        format, std::move(channelNames), ColorEncodingHandle::Get(header.encoding),
+        cache, alloc);
+    tp->file = f;
+    tp->tileDataOffset = header.tileDataOffset;
+    Point2i tileRes = tp->tileResolution;
+    for (int i = 0; i < header.nLevels; ++i) {
+        Point2i res(header.levelResolution[i][0], header.levelResolution[i][1]);
+        if (res.x < 1 || res.y < 1)
+            ErrorExit("%s: corrupt tiled MIP file.", filename);
+        if (!IsTiledLevel(res, tileRes))
+            break;
+        int nTilesX = (res.x + tileRes.x - 1) / tileRes.x;
+        int nTilesY = (res.y + tileRes.y - 1) / tileRes.y;
+        tp->levels.push_back(Level{res, nTilesX, tp->nTiles});
+        tp->nTiles += int64_t(nTilesX) * nTilesY;
+    }
+    tp->nTiledLevels = tp->levels.size();
+
+    // Read the levels that aren't tiled
+    int64_t offset = tp->tileDataOffset + tp->nTiles * int64_t(tp->tileBytes);
+#ifdef PBRT_IS_WINDOWS
+    bool seekOk = _fseeki64(f, offset, SEEK_SET) == 0;
+#else
+    bool seekOk = fseeko(f, offset, SEEK_SET) == 0;
+#endif
+    if (!seekOk)
+        ErrorExit("%s: %s", filename, ErrorString());
+    for (int i = tp->nTiledLevels; i < header.nLevels; ++i) {
+        Point2i res(header.levelResolution[i][0], header.levelResolution[i][1]);
+        if (IsTiledLevel(res, tileRes))
+            ErrorExit("%s: corrupt tiled MIP file.", filename);
+        Image image(format, res, tp->channelNames, tp->encoding, alloc);
+        if (fread(image.RawPointer({0, 0}), 1, image.BytesUsed(), f) !=
+            image.BytesUsed())
+            ErrorExit("%s: premature end of file.", filename);
+        tp->tail.push_back(std::move(image));
+    }
+
+#ifdef PBRT_HAVE_MMAP
+    // Map the file's tiles into memory
+    size_t length = tp->tileDataOffset + tp->nTiles * tp->tileBytes;
+    if (tp->nTiles > 0) {
+        void *ptr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fileno(f), 0);
+        if (ptr != MAP_FAILED) {
+            tp->mappedFile = (const uint8_t *)ptr;
+            tp->mappedFileLength = length;
+            fclose(f);
+            tp->file = nullptr;
+        }
+    }
+#endif
+
+    tp->AllocateTileTable();
+    return tp;
+}
+
+void TiledImagePyramid::GetTexel(int level, Point2i p, WrapMode2D wrapMode,
+                                 Float *values) const {
+    if (level >= nTiledLevels) {
+        // Return texel from in-memory level
+        const Image &image = tail[level - nTiledLevels];
+        for (int c = 0; c < nChannels; ++c)
+            values[c] = image.GetChannel(p, c, wrapMode);
+        return;
+    }
+
+    // Find the tile and offset within it for the texel
+    const Level &l = levels[level];
+    if (!RemapPixelCoords(&p, l.resolution, wrapMode)) {
+        std::fill(values, values + nChannels, Float(0));
+        return;
+    }
+    int tx = p.x / tileResolution.x, ty = p.y / tileResolution.y;
+    int64_t tile = l.firstTile + int64_t(ty) * l.nTilesX + tx;
+    size_t offset = (size_t(p.y - ty * tileResolution.y) * tileResolution.x +
+                     (p.x - tx * tileResolution.x)) *
+                    texelBytes;
+
+    // Copy the texel out of the cache, loading its tile if necessary
+    CHECK(cache != nullptr);
+    ++nTileCacheLookups;
+    uint8_t texel[16];
+    std::atomic<int> &entry = tileSlots[tile];
+    uint64_t tileId = firstTileId + tile;
+    int slot = entry.load(std::memory_order_acquire);
+    if (slot >= 0 && cache->Read(slot, tileId, offset, texelBytes, texel))
+        ++nTileCacheHits;
+    else
+        while (true) {
+            cache->Load(&entry, tileId,
+                        [&](uint8_t *data) { ReadTile(tile, data); });
+            slot = entry.load(std::memory_order_acquire);
+            if (slot >= 0 && cache->Read(slot, tileId, offset, texelBytes, texel))
+                break;
+        }
+
+    // Convert texel to _Float_ channel values
+    switch (format) {
+    case PixelFormat::U256:
+        encoding.ToLinear({texel, size_t(nChannels)}, {values, size_t(nChannels)});
+        break;
+    case PixelFormat::Half:
+        for (int c = 0; c < nChannels; ++c) {
+            uint16_t bits;
+            std::memcpy(&bits, texel + 2 * c, sizeof(bits));
+            values[c] = Float(Half::FromBits(bits));
+        }
+        break;
+    case PixelFormat::Float:
+        for (int c = 0; c < nChannels; ++c) {
+            float v;
+            std::memcpy(&v, texel + 4 * c, sizeof(v));
+            values[c] = v;
+        }
+        break;
+    default:
+        LOG_FATAL("Unhandled PixelFormat");
+    }
+}
+
+void TiledImagePyramid::Bilerp(int level, Point2f st, WrapMode2D wrapMode,
+                               Float *values) const {
+    // Compute discrete texel coordinates and offsets for _st_
+    Point2i res = LevelResolution(level);
+    Float x = st[0] * res.x - 0.5f, y = st[1] * res.y - 0.5f;
+    int xi = std::floor(x), yi = std::floor(y);
+    Float dx = x - xi, dy = y - yi;
+
+    // Load texels and return bilinearly interpolated channel values
+    Float v[4][4];
+    GetTexel(level, {xi, yi}, wrapMode, v[0]);
+    GetTexel(level, {xi + 1, yi}, wrapMode, v[1]);
+    GetTexel(level, {xi, yi + 1}, wrapMode, v[2]);
+    GetTexel(level, {xi + 1, yi + 1}, wrapMode, v[3]);
+    for (int c = 0; c < nChannels; ++c)
+        values[c] = ((1 - dx) * (1 - dy) * v[0][c] + dx * (1 - dy) * v[1][c] +
+                     (1 - dx) * dy * v[2][c] + dx * dy * v[3][c]);
+}
+
+Image TiledImagePyramid::GetLevel(int level, Allocator alloc) const {
+    Point2i res = LevelResolution(level);
+    Image image(format, res, channelNames, encoding, alloc);
+    if (level >= nTiledLevels) {
+        const Image &tailImage = tail[level - nTiledLevels];
+        std::memcpy(image.RawPointer({0, 0}), tailImage.RawPointer({0, 0}),
+                    image.BytesUsed());
+        return image;
+    }
+
+    // Copy the level's tiles into _image_
+    const Level &l = levels[level];
+    std::vector<uint8_t> tileData(tileBytes);
+    for (int y0 = 0, ty = 0; y0 < res.y; y0 += tileResolution.y, ++ty)
+        for (int x0 = 0, tx = 0; x0 < res.x; x0 += tileResolution.x, ++tx) {
+            ReadTile(l.firstTile + int64_t(ty) * l.nTilesX + tx, tileData.data());
+            int x1 = std::min(x0 + tileResolution.x, res.x);
+            int y1 = std::min(y0 + tileResolution.y, res.y);
+            for (int y = y0; y < y1; ++y)
+                std::memcpy(image.RawPointer({x0, y}),
+                            &tileData[size_t(y - y0) * tileResolution.x * texelBytes],
+                            size_t(x1 - x0) * texelBytes);
+        }
+    return image;
+}
+
+void TiledImagePyramid::ReadTile(int64_t tile, uint8_t *data) const {
+    int64_t offset = tileDataOffset + tile * int64_t(tileBytes);
+    if (mappedFile) {
+        std::memcpy(data, mappedFile + offset, tileBytes);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+#ifdef PBRT_IS_WINDOWS
+    bool seekOk = _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    bool seekOk = fseeko(file, offset, SEEK_SET) == 0;
+#endif
+    if (!seekOk || fread(data, 1, tileBytes, file) != tileBytes)
+        ErrorExit("Unable to read texture tile: %s", ErrorString());
+}
+
+size_t TiledImagePyramid::BytesUsed() const {
+    size_t bytes = nTiles * sizeof(std::atomic<int>);
+    for (const Image &image : tail)
+        bytes += image.BytesUsed();
+    return bytes;
+}
+
+std::string TiledImagePyramid::ToString() const {
+    return StringPrintf("[ TiledImagePyramid format: %s nChannels: %d "
+                        "tileResolution: %s nTiledLevels: %d nTiles: %d tail: %s ]",
+                        format, nChannels, tileResolution, nTiledLevels, nTiles, tail);
+}
+
+}  // namespace pbrt
@@ -0,0 +1,200 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#ifndef PBRT_UTIL_TEXCACHE_H
+#define PBRT_UTIL_TEXCACHE_H
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/check.h>
+#include <pbrt/util/image.h>
+#include <pbrt/util/pstd.h>
+#include <pbrt/util/vecmath.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pbrt {
+
+// TextureTileCache Definition
+// Holds tiles of image texture levels in a fixed number of equally-sized
+// slots. A tile is found through an entry in its image's tile table that
+// gives the slot it is resident in; reading from a slot doesn't take any
+// locks, but is validated against a per-slot sequence number so that a
+// reader racing with the slot being reassigned to another tile retries
+// rather than returning stale data. When all slots are in use, a slot is
+// reclaimed using the CLOCK approximation of LRU replacement.
+class TextureTileCache {
+  public:
+    // TextureTileCache Public Constants
+    static constexpr size_t SlotBytes = 64 * 1024;
+    static constexpr int NotResident = -1, Loading = -2;
+
+    // TextureTileCache Public Methods
+    TextureTileCache(size_t maxBytes);
+    ~TextureTileCache();
+
+    TextureTileCache(const TextureTileCache &) = delete;
+    TextureTileCache &operator=(const TextureTileCache &) = delete;
+
+    uint64_t AllocateTileIds(size_t n) { return nextTileId.fetch_add(n); }
+
+    // Copies _n_ bytes starting at _offset_ in the tile from the given
+    // slot, returning false if the slot doesn't hold tile _tileId_.
+    bool Read(int slot, uint64_t tileId, size_t offset, size_t n, void *dst) const {
+        const Slot &s = slots[slot];
+        uint64_t seq = s.seq.load(std::memory_order_acquire);
+        if ((seq & 1) || s.tileId.load(std::memory_order_relaxed) != tileId)
+            return false;
+        std::memcpy(dst, s.data + offset, n);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != seq)
+            return false;
+        // Only write the reference bit if needed to avoid needless cache
+        // line traffic for frequently-accessed tiles.
+        if (!s.referenced.load(std::memory_order_relaxed))
+            s.referenced.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Makes the tile with the given id resident, calling _loadTile_ to
+    // initialize its contents. On return, *entry holds the tile's slot,
+    // or the tile is being loaded by another thread and the caller should
+    // try again.
+    void Load(std::atomic<int> *entry, uint64_t tileId,
+              const std::function<void(uint8_t *)> &loadTile);
+
+    // Detaches the cache from the _n_ tile table entries starting at
+    // _entries_ so that the table can be freed.
+    void Release(std::atomic<int> *entries, size_t n);
+
+    size_t SlotsUsed() const { return nSlotsAllocated; }
+    size_t MaxSlots() const { return nSlots; }
+
+    std::string ToString() const;
+
+  private:
+    // TextureTileCache::Slot Definition
+    struct Slot {
+        // Odd while the slot's contents are being replaced.
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> tileId{~uint64_t(0)};
+        mutable std::atomic<bool> referenced{false};
+        std::atomic<int> *entry = nullptr;
+        uint8_t *data = nullptr;
+    };
+
+    // TextureTileCache Private Methods
+    int ReclaimSlot();
+
+    // TextureTileCache Private Members
+    std::mutex mutex;
+    std::unique_ptr<Slot[]> slots;
+    size_t nSlots, nSlotsAllocated = 0, clockHand = 0;
+    std::atomic<uint64_t> nextTileId{0};
+};
+
+// TextureTileCache Global Declarations
+extern TextureTileCache *textureTileCache;
+
+void InitTextureTileCache(size_t maxBytes);
+
+// TiledImagePyramid Definition
+// An image pyramid whose larger levels are stored in tiles in a file and
+// are brought into memory on demand through the _TextureTileCache_. Levels
+// that fit in a single tile are kept in memory.
+//
+// The file is either a temporary one written by _Create()_ or a tiled MIP
+// file written by _WriteFile()_ (e.g., by "imgtool makemip"), in which
+// case the pyramid doesn't need to be generated at startup.
+class TiledImagePyramid {
+  public:
+    // TiledImagePyramid Public Methods
+    static TiledImagePyramid *Create(pstd::vector<Image> pyramid,
+                                     TextureTileCache *cache, Allocator alloc);
+
+    static bool IsTiledFile(const std::string &filename);
+    static void WriteFile(const std::string &filename, const pstd::vector<Image> &pyramid,
+                          const std::string &encoding, const RGBColorSpace *colorSpace,
+                          WrapMode wrapMode);
+    // The returned pyramid's levels can be accessed with _GetLevel()_;
+    // _cache_ must be non-null for texel lookups.
+    static TiledImagePyramid *Read(const std::string &filename, TextureTileCache *cache,
+                                   Allocator alloc, const RGBColorSpace **colorSpace,
+                                   WrapMode *wrapMode);
+
+    ~TiledImagePyramid();
+
+    int Levels() const { return nTiledLevels + int(tail.size()); }
+    Point2i LevelResolution(int level) const {
+        CHECK(level >= 0 && level < Levels());
+        return level < nTiledLevels ? levels[level].resolution
+                                    : tail[level - nTiledLevels].Resolution();
+    }
+    int NChannels() const { return nChannels; }
+    PixelFormat Format() const { return format; }
+    ColorEncodingHandle Encoding() const { return encoding; }
+    Point2i TileResolution() const { return tileResolution; }
+    bool HasCache() const { return cache != nullptr; }
+
+    // Returns the texel's channel values in _values_, which must have
+    // room for _NChannels()_ values.
+    void GetTexel(int level, Point2i p, WrapMode2D wrapMode, Float *values) const;
+    void Bilerp(int level, Point2f st, WrapMode2D wrapMode, Float *values) const;
+
+    Image GetLevel(int level, Allocator alloc) const;
+
+    size_t BytesUsed() const;
+    std::string ToString() const;
+
+    static Point2i TileResolution(PixelFormat format, int nChannels);
+
+    TiledImagePyramid(PixelFormat format, std::vector<std::string> channelNames,
+                      ColorEncodingHandle encoding, TextureTileCache *cache,
+                      Allocator alloc);
+
+  private:
+    // TiledImagePyramid::Level Definition
+    struct Level {
+        Point2i resolution;
+        int nTilesX;
+        int64_t firstTile;
+    };
+
+    // TiledImagePyramid Private Methods
+    void AllocateTileTable();
+    void ReadTile(int64_t tile, uint8_t *data) const;
+
+    // TiledImagePyramid Private Members
+    PixelFormat format;
+    std::vector<std::string> channelNames;
+    int nChannels, texelBytes;
+    ColorEncodingHandle encoding;
+    Point2i tileResolution;
+    size_t tileBytes;
+    int nTiledLevels = 0;
+    pstd::vector<Level> levels;
+    pstd::vector<Image> tail;
+
+    TextureTileCache *cache;
+    int64_t nTiles = 0;
+    uint64_t firstTileId = 0;
+    std::unique_ptr<std::atomic<int>[]> tileSlots;
+
+    FILE *file = nullptr;
+    int64_t tileDataOffset = 0;
+    mutable std::mutex fileMutex;
+    const uint8_t *mappedFile = nullptr;
+    size_t mappedFileLength = 0;
+};
+
+}  // namespace pbrt
+
+#endif  // PBRT_UTIL_TEXCACHE_H
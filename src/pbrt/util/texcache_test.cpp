@@ -0,0 +1,138 @@
+// pbrt is Copyright(c) 1998-2020 Matt Pharr, Wenzel Jakob, and Greg Humphreys.
+// The pbrt source code is licensed under the Apache License, Version 2.0.
+// SPDX: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <pbrt/pbrt.h>
+
+#include <pbrt/util/color.h>
+#include <pbrt/util/colorspace.h>
+#include <pbrt/util/image.h>
+#include <pbrt/util/parallel.h>
+#include <pbrt/util/rng.h>
+#include <pbrt/util/testimages.h>
+#include <pbrt/util/texcache.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace pbrt;
+
+TEST(TextureTileCache, TileResolution) {
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float})
+        for (int nc = 1; nc <= 4; ++nc) {
+            Point2i res = TiledImagePyramid::TileResolution(format, nc);
+            EXPECT_LE(res.x * res.y * nc * TexelBytes(format),
+                      TextureTileCache::SlotBytes);
+            EXPECT_GT(2 * res.x * res.y * nc * TexelBytes(format),
+                      TextureTileCache::SlotBytes);
+        }
+}
+
+TEST(TextureTileCache, MatchesImage) {
+    // A minimal cache so that lookups regularly cause evictions
+    TextureTileCache cache(0);
+    Allocator alloc;
+
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float})
+        for (int nc : {1, 3, 4}) {
+            Image image = RandomImage(format, {1000, 313}, nc);
+            WrapMode2D wrapMode(WrapMode::Repeat);
+            pstd::vector<Image> pyramid = Image::GeneratePyramid(image, wrapMode);
+            TiledImagePyramid *tiled = TiledImagePyramid::Create(
+                Image::GeneratePyramid(image, wrapMode), &cache, alloc);
+            ASSERT_EQ(pyramid.size(), tiled->Levels());
+
+            RNG rng(nc);
+            for (int level = 0; level < pyramid.size(); ++level) {
+                Point2i res = pyramid[level].Resolution();
+                EXPECT_EQ(res, tiled->LevelResolution(level));
+                for (int i = 0; i < 1000; ++i) {
+                    Point2i p(int(rng.Uniform<uint32_t>() % (3 * res.x)) - res.x,
+                              int(rng.Uniform<uint32_t>() % (3 * res.y)) - res.y);
+                    Float v[4];
+                    tiled->GetTexel(level, p, wrapMode, v);
+                    for (int c = 0; c < nc; ++c)
+                        EXPECT_EQ(pyramid[level].GetChannel(p, c, wrapMode), v[c]);
+                }
+            }
+            alloc.delete_object(tiled);
+        }
+    EXPECT_EQ(cache.SlotsUsed(), cache.MaxSlots());
+}
+
+TEST(TextureTileCache, Parallel) {
+    TextureTileCache cache(0);
+    Allocator alloc;
+    Image image = RandomImage(PixelFormat::Half, {2048, 2048}, 3);
+    WrapMode2D wrapMode(WrapMode::Clamp);
+    TiledImagePyramid *tiled = TiledImagePyramid::Create(
+        Image::GeneratePyramid(image, wrapMode), &cache, alloc);
+
+    std::atomic<int> nMismatches{0};
+    ParallelFor(0, 64, [&](int64_t seed) {
+        RNG rng(seed);
+        for (int i = 0; i < 2000; ++i) {
+            Point2i p(rng.Uniform<uint32_t>() % 2048, rng.Uniform<uint32_t>() % 2048);
+            Float v[3];
+            tiled->GetTexel(0, p, wrapMode, v);
+            for (int c = 0; c < 3; ++c)
+                if (v[c] != image.GetChannel(p, c))
+                    ++nMismatches;
+        }
+    });
+    EXPECT_EQ(0, nMismatches.load());
+    alloc.delete_object(tiled);
+}
+
+TEST(TextureTileCache, TiledFile) {
+    TextureTileCache cache(0);
+    Allocator alloc;
+    std::string filename = "test.mip";
+
+    for (PixelFormat format : {PixelFormat::U256, PixelFormat::Half, PixelFormat::Float})
+        for (int nc : {1, 3}) {
+            Image image = RandomImage(format, {700, 300}, nc);
+            pstd::vector<Image> pyramid = Image::GeneratePyramid(image, WrapMode::Clamp);
+            TiledImagePyramid::WriteFile(filename, pyramid, "sRGB", RGBColorSpace::sRGB,
+                                         WrapMode::Clamp);
+            ASSERT_TRUE(TiledImagePyramid::IsTiledFile(filename));
+
+            const RGBColorSpace *colorSpace;
+            WrapMode wrapMode;
+            // Check texel lookups through the cache
+            TiledImagePyramid *tiled = TiledImagePyramid::Read(filename, &cache, alloc,
+                                                               &colorSpace, &wrapMode);
+            EXPECT_EQ(RGBColorSpace::sRGB, colorSpace);
+            EXPECT_EQ(WrapMode::Clamp, wrapMode);
+            ASSERT_EQ(pyramid.size(), tiled->Levels());
+            RNG rng;
+            for (int level = 0; level < pyramid.size(); ++level) {
+                Point2i res = pyramid[level].Resolution();
+                for (int i = 0; i < 1000; ++i) {
+                    Point2i p(rng.Uniform<uint32_t>() % res.x,
+                              rng.Uniform<uint32_t>() % res.y);
+                    Float v[4];
+                    tiled->GetTexel(level, p, wrapMode, v);
+                    for (int c = 0; c < nc; ++c)
+                        EXPECT_EQ(pyramid[level].GetChannel(p, c), v[c]);
+                }
+            }
+            alloc.delete_object(tiled);
+
+            // Check levels read into memory
+            tiled = TiledImagePyramid::Read(filename, nullptr, alloc, &colorSpace,
+                                            &wrapMode);
+            for (int level = 0; level < pyramid.size(); ++level) {
+                Image levelImage = tiled->GetLevel(level, alloc);
+                ASSERT_EQ(pyramid[level].Resolution(), levelImage.Resolution());
+                EXPECT_EQ(0, memcmp(pyramid[level].RawPointer({0, 0}),
+                                    levelImage.RawPointer({0, 0}),
+                                    levelImage.BytesUsed()));
+            }
+            alloc.delete_object(tiled);
+        }
+    EXPECT_EQ(0, remove(filename.c_str()));
+}